@@ -0,0 +1,138 @@
+/**
+   Benchmark for extent-based block allocation.
+
+   It creates an EFS, fragments its free space by creating a number of
+   small files and deleting every other one, then writes and re-reads
+   one multi-megabyte pseudofile. That is done once with first-fit
+   allocation (extent_min=1), where the big file fills every small
+   gap, and once with the given minimum extent size, where it lands
+   in long runs of adjacent blocks.
+
+   Usage: bench-extents [megabytes=8] [extent_min=WHEFS_CONFIG_EXTENT_MIN_BLOCKS]
+
+   Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+   License: Public Domain
+*/
+#ifdef NDEBUG
+#  undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wh/whefs/whefs.h>
+
+enum {
+BlockSize = 1024 * 4,
+ChunkSize = 1024 * 64,
+SmallFileCount = 256,
+SmallFileBlocks = 2
+};
+
+static double now_ms()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+static void fill_chunk( unsigned char * buf, size_t n, size_t seed )
+{
+    size_t i = 0;
+    for( ; i < n; ++i ) buf[i] = (unsigned char)((seed + i) * 31);
+}
+
+static int run_one( char const * fname, size_t megs, whefs_id_type extentMin )
+{
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = NULL;
+    whefs_file * f = NULL;
+    char name[32];
+    static unsigned char buf[ChunkSize];
+    static unsigned char cmp[ChunkSize];
+    const size_t total = megs * 1024 * 1024;
+    size_t i, off;
+    double t0, tw, tr;
+    int rc;
+
+    opt.block_size = BlockSize;
+    opt.inode_count = SmallFileCount + 2;
+    opt.block_count = (whefs_id_type)((total / BlockSize) + (SmallFileCount * SmallFileBlocks) + 1);
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed" );
+    whefs_fs_setopt_extent_min( fs, extentMin );
+
+    /* Fragment the free space... */
+    memset( buf, 'x', SmallFileBlocks * BlockSize );
+    for( i = 0; i < SmallFileCount; ++i )
+    {
+        sprintf( name, "small-%u", (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fwrite( f, SmallFileBlocks * BlockSize, 1, buf );
+        whefs_fclose( f );
+    }
+    for( i = 0; i < SmallFileCount; i += 2 )
+    {
+        sprintf( name, "small-%u", (unsigned int)i );
+        rc = whefs_unlink_filename( fs, name );
+        assert( (whefs_rc.OK == rc) && "unlink failed" );
+    }
+
+    f = whefs_fopen( fs, "big", "r+" );
+    assert( f && "fopen(big) failed" );
+    t0 = now_ms();
+    for( off = 0; off < total; off += ChunkSize )
+    {
+        fill_chunk( buf, ChunkSize, off );
+        if( 1 != whefs_fwrite( f, ChunkSize, 1, buf ) )
+        {
+            fprintf( stderr, "write failed at offset %u\n", (unsigned int)off );
+            return 1;
+        }
+    }
+    whefs_fflush( f );
+    tw = now_ms() - t0;
+
+    whefs_fseek( f, 0, SEEK_SET );
+    t0 = now_ms();
+    for( off = 0; off < total; off += ChunkSize )
+    {
+        if( 1 != whefs_fread( f, ChunkSize, 1, buf ) )
+        {
+            fprintf( stderr, "read failed at offset %u\n", (unsigned int)off );
+            return 1;
+        }
+        fill_chunk( cmp, ChunkSize, off );
+        assert( (0 == memcmp( buf, cmp, ChunkSize )) && "data mismatch" );
+    }
+    tr = now_ms() - t0;
+    assert( total == whefs_fsize( f ) );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+
+    printf( "extent_min=%-4"WHEFS_ID_TYPE_PFMT" %uMB: write %8.2f ms (%7.2f MB/s), read %8.2f ms (%7.2f MB/s)\n",
+            extentMin, (unsigned int)megs,
+            tw, tw ? (megs * 1000.0 / tw) : 0.0,
+            tr, tr ? (megs * 1000.0 / tr) : 0.0 );
+    return 0;
+}
+
+int main( int argc, char const ** argv )
+{
+    char const * fname = "bench-extents.whefs";
+    size_t megs = 8;
+    whefs_id_type extentMin = WHEFS_CONFIG_EXTENT_MIN_BLOCKS;
+    int rc;
+    if( argc > 1 ) megs = (size_t)atoi( argv[1] );
+    if( argc > 2 ) extentMin = (whefs_id_type)atoi( argv[2] );
+    if( ! megs ) megs = 1;
+    rc = run_one( fname, megs, 1 );
+    if( ! rc ) rc = run_one( fname, megs, extentMin );
+    remove( fname );
+    if( ! rc ) puts("Done!");
+    return rc;
+}
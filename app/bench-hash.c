@@ -0,0 +1,189 @@
+/**
+   Microbenchmark for the inode name hash functions (see
+   whefs_fs_setopt_name_hash()).
+
+   For several generated corpora of file names it measures the
+   throughput of each hash function and the number of names whose
+   hash code is shared with another name of the corpus. Each such
+   collision costs whefs_inode_by_name() an extra name read when the
+   names are in the name cache.
+
+   Usage: bench-hash [names=100000] [rounds=20]
+
+   Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+   License: Public Domain
+*/
+#ifdef NDEBUG
+#  undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wh/whefs/whefs.h>
+
+static double now_ms()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+/** A list of generated names. */
+typedef struct
+{
+    char const * label;
+    char ** names;
+    size_t count;
+    size_t bytes; /* total length of all names */
+} corpus;
+
+static char const * words[] = {
+"main", "util", "config", "index", "readme", "test", "data", "report",
+"image", "thumb", "cache", "module", "parser", "driver", "client", "server"
+};
+enum { wordCount = sizeof(words)/sizeof(words[0]) };
+static char const * exts[] = { "c", "h", "txt", "json", "png", "log" };
+enum { extCount = sizeof(exts)/sizeof(exts[0]) };
+
+/** A small deterministic PRNG, so that all runs hash the same names. */
+static uint32_t rnd_state = 2463534242U;
+static uint32_t rnd()
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+/**
+   Fills c with count unique names of the given kind.
+*/
+static void corpus_fill( corpus * c, int kind, size_t count )
+{
+    char buf[WHEFS_MAX_FILENAME_LENGTH+1];
+    size_t i, n, k;
+    c->names = (char **)calloc( count, sizeof(char*) );
+    assert( c->names );
+    c->count = count;
+    c->bytes = 0;
+    for( i = 0; i < count; ++i )
+    {
+        switch( kind )
+        {
+          case 0:
+              c->label = "sequential (file-N)";
+              sprintf( buf, "file-%u", (unsigned int)i );
+              break;
+          case 1:
+              c->label = "camera (DCIM/NNN/IMG_NNNN.JPG)";
+              sprintf( buf, "DCIM/%03u/IMG_%04u.JPG", (unsigned int)(i / 10000), (unsigned int)(i % 10000) );
+              break;
+          case 2:
+              c->label = "source paths";
+              sprintf( buf, "src/%s/%s_%s%u.%s",
+                       words[i % wordCount], words[(i / wordCount) % wordCount],
+                       words[rnd() % wordCount], (unsigned int)i, exts[rnd() % extCount] );
+              break;
+          case 3:
+              c->label = "random [a-z]{6,30}";
+              n = 6 + (rnd() % 25);
+              for( k = 0; k < n; ++k ) buf[k] = (char)('a' + (rnd() % 26));
+              sprintf( buf + n, "-%x", (unsigned int)i );
+              break;
+          default:
+              c->label = "long paths (60-120 bytes)";
+              n = (size_t)sprintf( buf, "home/user/projects/%s/build/intermediates/%s/%s/",
+                                   words[rnd() % wordCount], words[rnd() % wordCount], words[rnd() % wordCount] );
+              k = 60 + (rnd() % 50);
+              while( n < k ) buf[n++] = (char)('a' + (rnd() % 26));
+              sprintf( buf + n, "-%u.%s", (unsigned int)i, exts[i % extCount] );
+              break;
+        };
+        n = strlen( buf );
+        c->names[i] = (char *)malloc( n + 1 );
+        assert( c->names[i] );
+        memcpy( c->names[i], buf, n + 1 );
+        c->bytes += n;
+    }
+}
+
+static void corpus_free( corpus * c )
+{
+    size_t i;
+    for( i = 0; i < c->count; ++i ) free( c->names[i] );
+    free( c->names );
+    c->names = 0;
+    c->count = 0;
+}
+
+static int cmp_hash( void const * lhs, void const * rhs )
+{
+    whefs_hashval_type const l = *((whefs_hashval_type const *)lhs);
+    whefs_hashval_type const r = *((whefs_hashval_type const *)rhs);
+    return (l < r) ? -1 : ((l > r) ? 1 : 0);
+}
+
+/**
+   Returns the number of names in c whose hash code (under f) is also
+   the hash code of another name in c.
+*/
+static size_t count_collisions( corpus const * c, whefs_name_hash_f f )
+{
+    whefs_hashval_type * h = (whefs_hashval_type *)malloc( c->count * sizeof(whefs_hashval_type) );
+    size_t i, rc = 0;
+    assert( h );
+    for( i = 0; i < c->count; ++i ) h[i] = f( c->names[i] );
+    qsort( h, c->count, sizeof(whefs_hashval_type), cmp_hash );
+    for( i = 0; i < c->count; ++i )
+    {
+        if( ((i > 0) && (h[i] == h[i-1])) || ((i + 1 < c->count) && (h[i] == h[i+1])) ) ++rc;
+    }
+    free( h );
+    return rc;
+}
+
+int main( int argc, char const ** argv )
+{
+    struct { char const * label; whefs_name_hash_f f; } funcs[] = {
+    { "djb2", whefs_hash_djb2 },
+    { "wy", whefs_hash_wy }
+    };
+    enum { funcCount = sizeof(funcs)/sizeof(funcs[0]), kinds = 5 };
+    size_t names = 100000, rounds = 20, r, i;
+    int kind, fn;
+    corpus c;
+    double t0, ms;
+    volatile whefs_hashval_type sink = 0;
+    if( argc > 1 ) names = (size_t)atoi( argv[1] );
+    if( argc > 2 ) rounds = (size_t)atoi( argv[2] );
+    if( names < 2 ) names = 2;
+    if( ! rounds ) rounds = 1;
+    printf( "%u names per corpus, %u round(s), %d-bit hash codes:\n",
+            (unsigned int)names, (unsigned int)rounds, (int)(sizeof(whefs_hashval_type) * 8) );
+    for( kind = 0; kind < kinds; ++kind )
+    {
+        corpus_fill( &c, kind, names );
+        printf( "  %s, average length %.1f:\n", c.label, (double)c.bytes / c.count );
+        for( fn = 0; fn < funcCount; ++fn )
+        {
+            t0 = now_ms();
+            for( r = 0; r < rounds; ++r )
+            {
+                for( i = 0; i < c.count; ++i ) sink ^= funcs[fn].f( c.names[i] );
+            }
+            ms = now_ms() - t0;
+            printf( "    %-5s %8.2f ns/name %9.1f MB/s   %6u colliding name(s)\n",
+                    funcs[fn].label,
+                    (ms * 1e6) / ((double)rounds * c.count),
+                    ((double)c.bytes * rounds) / (ms * 1000.0),
+                    (unsigned int)count_collisions( &c, funcs[fn].f ) );
+        }
+        corpus_free( &c );
+    }
+    puts("Done!");
+    return 0;
+}
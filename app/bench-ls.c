@@ -0,0 +1,204 @@
+/**
+   Pattern listing benchmark: how long whefs_ls() takes on an EFS with
+   many entries.
+
+   It creates an EFS with the given number of inodes, nearly all of
+   them used, named like sharded data files ("shard-NNN/part-NNNNN").
+   It then times:
+
+   - The glob matchers alone: whglob_matches() against a pattern
+     compiled by whglob_compile(), over all names.
+
+   - Listing one shard (a pattern with a literal prefix) with
+     whefs_ls(). The first call builds the sorted names index. The
+     listing is also timed without the in-memory names table (the
+     names are then scanned on storage), and by walking
+     whefs_fs_entry_foreach() with whglob_matches(), as a client
+     without whefs_ls() would.
+
+   - Listing with a pattern without a literal prefix, which has to
+     look at every name.
+
+   - Listing everything along with each entry's size: with
+     whefs_ls() followed by whefs_fopen() and whefs_fstat() for each
+     entry, and with whefs_ls_batch().
+
+   Usage: bench-ls [inodes=65000] [iterations=20]
+
+   (whefs_id_type is 16 bits wide, so an EFS holds at most 65534
+   inodes.)
+
+   Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+   License: Public Domain
+*/
+#ifdef NDEBUG
+#  undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wh/whefs/whefs.h>
+#include <wh/whefs/whefs_client_util.h>
+#include <wh/whglob.h>
+
+static double now_ms()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+enum { shardCount = 100 };
+
+/** Lists fs with whefs_ls() and returns the time it took, in milliseconds. */
+static double time_ls( whefs_fs * fs, char const * pattern, size_t expect )
+{
+    whefs_id_type count = 0;
+    double t0 = now_ms();
+    whefs_string * ls = whefs_ls( fs, pattern, &count );
+    t0 = now_ms() - t0;
+    assert( (expect == count) && "wrong entry count" );
+    whefs_string_finalize( ls, true );
+    return t0;
+}
+
+/** State for match_entry(). */
+typedef struct
+{
+    char const * pattern;
+    size_t count;
+} match_state;
+
+/** whefs_fs_entry_foreach() callback which counts matching entries. */
+static int match_entry( whefs_fs * fs, whefs_fs_entry const * ent, void * clientData )
+{
+    match_state * st = (match_state *)clientData;
+    if( whglob_matches( st->pattern, ent->name.string ) ) ++st->count;
+    return whefs_rc.OK;
+}
+
+int main( int argc, char const ** argv )
+{
+    char const * fname = "bench-ls.whefs";
+    char const * shardPattern = "shard-042/*";
+    char const * scanPattern = "*/part-0004?";
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = NULL;
+    whefs_file * f;
+    char name[32];
+    size_t inodes = 65000, iterations = 20, used, perShard, i, r, hits;
+    double t0, tinterp, tcomp, tfirst, tshard = 0, tnotable, tforeach, tscan = 0, tstat, tbatch;
+    whefs_listing * li = 0;
+    whefs_file_stats fst;
+    size_t bytes = 0;
+    whefs_string * all;
+    whefs_string * s;
+    whefs_id_type count = 0;
+    whglob * g;
+    match_state st;
+    int rc;
+    if( argc > 1 ) inodes = (size_t)atoi( argv[1] );
+    if( argc > 2 ) iterations = (size_t)atoi( argv[2] );
+    if( inodes < 1000 ) inodes = 1000;
+    if( inodes > 65534 ) inodes = 65534;
+    if( ! iterations ) iterations = 1;
+    used = inodes - 10;
+
+    opt.inode_count = (whefs_id_type)inodes;
+    opt.block_count = (whefs_id_type)inodes;
+    opt.block_size = 512;
+    opt.filename_length = 32;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed" );
+    for( i = 0; i < used; ++i )
+    {
+        sprintf( name, "shard-%03u/part-%05u", (unsigned int)(i % shardCount), (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+    perShard = (used / shardCount) + ((42 < (used % shardCount)) ? 1 : 0);
+
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+
+    /* The matchers alone. */
+    all = whefs_ls( fs, 0, &count );
+    assert( used == count );
+    g = whglob_compile( scanPattern );
+    assert( g );
+    hits = 0;
+    t0 = now_ms();
+    for( r = 0; r < iterations; ++r )
+    {
+        for( s = all; s; s = s->next ) hits += whglob_matches( scanPattern, s->string ) ? 1 : 0;
+    }
+    tinterp = now_ms() - t0;
+    t0 = now_ms();
+    for( r = 0; r < iterations; ++r )
+    {
+        for( s = all; s; s = s->next ) hits -= whglob_compiled_matches( g, s->string ) ? 1 : 0;
+    }
+    tcomp = now_ms() - t0;
+    assert( 0 == hits );
+    whglob_free( g );
+    whefs_string_finalize( all, true );
+
+    /* Listing one shard. */
+    tfirst = time_ls( fs, shardPattern, perShard );
+    for( r = 0; r < iterations; ++r ) tshard += time_ls( fs, shardPattern, perShard );
+    for( r = 0; r < iterations; ++r ) tscan += time_ls( fs, scanPattern, 10 );
+    st.pattern = shardPattern;
+    st.count = 0;
+    t0 = now_ms();
+    rc = whefs_fs_entry_foreach( fs, match_entry, &st );
+    tforeach = now_ms() - t0;
+    assert( (whefs_rc.OK == rc) && (perShard == st.count) );
+
+    /* Listing with metadata. */
+    t0 = now_ms();
+    all = whefs_ls( fs, 0, &count );
+    for( s = all; s; s = s->next )
+    {
+        f = whefs_fopen( fs, s->string, "r" );
+        assert( f && (whefs_rc.OK == whefs_fstat( f, &fst )) );
+        bytes += fst.bytes;
+        whefs_fclose( f );
+    }
+    whefs_string_finalize( all, true );
+    tstat = now_ms() - t0;
+    t0 = now_ms();
+    rc = whefs_ls_batch( fs, 0, &li );
+    assert( (whefs_rc.OK == rc) && (used == li->count) );
+    for( i = 0; i < li->count; ++i ) bytes -= li->sizes[i];
+    whefs_listing_free( li );
+    tbatch = now_ms() - t0;
+    assert( 0 == bytes );
+
+    whefs_fs_setopt_name_table( fs, false );
+    tnotable = time_ls( fs, shardPattern, perShard );
+    whefs_fs_finalize( fs );
+    remove( fname );
+
+    printf( "%u inodes (%u used, %u per shard), average of %u run(s):\n",
+            (unsigned int)inodes, (unsigned int)used, (unsigned int)perShard, (unsigned int)iterations );
+    printf( "  matching %u names against [%s]:\n", (unsigned int)used, scanPattern );
+    printf( "    whglob_matches():              %8.3f ms\n", tinterp / iterations );
+    printf( "    whglob_compiled_matches():     %8.3f ms\n", tcomp / iterations );
+    printf( "  whefs_ls(\"%s\"):\n", shardPattern );
+    printf( "    first call (builds index):     %8.3f ms\n", tfirst );
+    printf( "    later calls:                   %8.3f ms\n", tshard / iterations );
+    printf( "    without names table:           %8.3f ms\n", tnotable );
+    printf( "    whefs_fs_entry_foreach() + whglob_matches(): %8.3f ms\n", tforeach );
+    printf( "  whefs_ls(\"%s\"):            %8.3f ms\n", scanPattern, tscan / iterations );
+    printf( "  listing everything with sizes:\n" );
+    printf( "    whefs_ls() + whefs_fstat() each: %8.3f ms\n", tstat );
+    printf( "    whefs_ls_batch():                %8.3f ms\n", tbatch );
+    puts("Done!");
+    return 0;
+}
@@ -0,0 +1,167 @@
+/**
+   Startup benchmark: how long it takes to open an EFS with many
+   inodes and list its contents.
+
+   It creates an EFS with the given number of inodes, a quarter of
+   which are used, then repeatedly opens it read-only (whefs_openfs()
+   reads the options, hints, free-space map, inode table and used
+   bitsets in its second stage) and lists it with
+   whefs_fs_entry_foreach(). Listing is timed once more with the
+   in-memory inode table disabled, and once with the in-memory names
+   table disabled, along with the time needed to (re)load each
+   table. Finally it times failed name lookups with the hash cache
+   disabled: with and without the name filter, and then also without
+   the names table (the names are then scanned on storage).
+
+   Usage: bench-openfs [inodes=20000] [iterations=10]
+
+   Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+   License: Public Domain
+*/
+#ifdef NDEBUG
+#  undef NDEBUG
+#endif
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <wh/whefs/whefs.h>
+#include <wh/whefs/whefs_client_util.h>
+
+static double now_ms()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+}
+
+/** whefs_fs_entry_foreach() callback which counts entries. */
+static int count_entry( whefs_fs * fs, whefs_fs_entry const * ent, void * clientData )
+{
+    ++*((size_t *)clientData);
+    return whefs_rc.OK;
+}
+
+/** Lists fs and returns the time it took, in milliseconds. */
+static double time_listing( whefs_fs * fs, size_t expect )
+{
+    size_t count = 0;
+    double t0 = now_ms();
+    int rc = whefs_fs_entry_foreach( fs, count_entry, &count );
+    t0 = now_ms() - t0;
+    assert( (whefs_rc.OK == rc) && "listing failed" );
+    assert( (expect == count) && "wrong entry count" );
+    return t0;
+}
+
+/**
+   Looks up count names which do not exist in fs and returns the
+   elapsed time in milliseconds.
+*/
+static double time_misses( whefs_fs * fs, size_t count )
+{
+    char name[32];
+    whefs_file * f;
+    size_t i;
+    double t0 = now_ms();
+    for( i = 0; i < count; ++i )
+    {
+        sprintf( name, "missing-%u", (unsigned int)i );
+        f = whefs_fopen( fs, name, "r" );
+        assert( !f && "found a file which should not exist" );
+    }
+    return now_ms() - t0;
+}
+
+int main( int argc, char const ** argv )
+{
+    char const * fname = "bench-openfs.whefs";
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = NULL;
+    whefs_file * f;
+    char name[32];
+    size_t inodes = 20000, iterations = 10, used, i;
+    double t0, topen = 0, tlist = 0, tnotable, tload, tnonames, tloadnames, tmiss, tmissnf, tmissnt;
+    whefs_name_filter_stats fst = whefs_name_filter_stats_empty;
+    enum { misses = 100 };
+    int rc;
+    if( argc > 1 ) inodes = (size_t)atoi( argv[1] );
+    if( argc > 2 ) iterations = (size_t)atoi( argv[2] );
+    if( inodes < 8 ) inodes = 8;
+    if( ! iterations ) iterations = 1;
+    used = inodes / 4;
+
+    opt.inode_count = (whefs_id_type)inodes;
+    opt.block_count = (whefs_id_type)inodes;
+    opt.block_size = 512;
+    opt.filename_length = 32;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed" );
+    for( i = 0; i < used; ++i )
+    {
+        sprintf( name, "file-%u", (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fwrite( f, 16, 1, "0123456789abcdef" );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+
+    for( i = 0; i < iterations; ++i )
+    {
+        t0 = now_ms();
+        rc = whefs_openfs( fname, &fs, false );
+        topen += now_ms() - t0;
+        assert( (whefs_rc.OK == rc) && "openfs failed" );
+        tlist += time_listing( fs, used );
+        whefs_fs_finalize( fs );
+    }
+
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+    whefs_fs_setopt_inode_table( fs, false );
+    tnotable = time_listing( fs, used );
+    t0 = now_ms();
+    rc = whefs_fs_setopt_inode_table( fs, true );
+    tload = now_ms() - t0;
+    assert( (whefs_rc.OK == rc) && "loading the inode table failed" );
+    whefs_fs_setopt_name_table( fs, false );
+    tnonames = time_listing( fs, used );
+    t0 = now_ms();
+    rc = whefs_fs_setopt_name_table( fs, true );
+    tloadnames = now_ms() - t0;
+    assert( (whefs_rc.OK == rc) && "loading the names table failed" );
+    whefs_fs_finalize( fs );
+
+    /* Failed name lookups with the hash cache disabled, with and
+       without the name filter and the names table. */
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+    whefs_fs_setopt_hash_cache( fs, false, false );
+    tmiss = time_misses( fs, misses );
+    whefs_fs_name_filter_stats( fs, &fst );
+    whefs_fs_setopt_name_filter( fs, false );
+    tmissnf = time_misses( fs, misses );
+    whefs_fs_setopt_name_table( fs, false );
+    tmissnt = time_misses( fs, misses );
+    whefs_fs_finalize( fs );
+    remove( fname );
+
+    printf( "%u inodes (%u used), average of %u run(s):\n",
+            (unsigned int)inodes, (unsigned int)used, (unsigned int)iterations );
+    printf( "  whefs_openfs():                %8.3f ms\n", topen / iterations );
+    printf( "  listing:                       %8.3f ms\n", tlist / iterations );
+    printf( "  listing without inode table:   %8.3f ms\n", tnotable );
+    printf( "  loading the inode table:       %8.3f ms\n", tload );
+    printf( "  listing without names table:   %8.3f ms\n", tnonames );
+    printf( "  loading the names table:       %8.3f ms\n", tloadnames );
+    printf( "  %u failed lookups:            %8.3f ms (%u answered by the name filter, %u false positive(s))\n",
+            (unsigned int)misses, tmiss, (unsigned int)fst.negatives, (unsigned int)fst.false_positives );
+    printf( "  ... without the name filter:   %8.3f ms\n", tmissnf );
+    printf( "  ... and without names table:   %8.3f ms\n", tmissnt );
+    puts("Done!");
+    return 0;
+}
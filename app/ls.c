@@ -279,12 +279,16 @@ static int ls_dump_options_code()
 	   "%"PRIu32" /*block_size*/, "
 	   "%"WHEFS_ID_TYPE_PFMT" /*block_count*/, "
 	   "%"WHEFS_ID_TYPE_PFMT" /*inode_count*/, "
-	   "%"WHIO_SIZE_T_PFMT" /*filename_length*/ "
+	   "%"WHIO_SIZE_T_PFMT" /*filename_length*/, "
+	   "%"PRIu32" /*data_alignment*/, "
+	   "%"PRIu32" /*name_index*/ "
 	   "};",
 	   o->block_size,
 	   o->block_count ,
 	   o->inode_count ,
-	   o->filename_length
+	   o->filename_length,
+	   o->data_alignment,
+	   o->name_index
 	   );
     puts("");
     return 0;
@@ -293,11 +297,13 @@ static int ls_dump_options_code()
 static int ls_dump_mkfs_command()
 {
     whefs_fs_options const * o = whefs_fs_opt( WHEFSApp.fs );
-    printf("whefs-mkfs -b%"PRIu32" -c%"WHEFS_ID_TYPE_PFMT" -i%"WHEFS_ID_TYPE_PFMT" -s%"WHIO_SIZE_T_PFMT"\n",
+    printf("whefs-mkfs -b%"PRIu32" -c%"WHEFS_ID_TYPE_PFMT" -i%"WHEFS_ID_TYPE_PFMT" -s%"WHIO_SIZE_T_PFMT" -a%"PRIu32" -x%"PRIu32"\n",
 	   o->block_size,
 	   o->block_count ,
 	   o->inode_count ,
-	   o->filename_length
+	   o->filename_length,
+	   o->data_alignment,
+	   o->name_index
 	   );
     return 0;
 }
@@ -31,11 +31,15 @@ static int mkfs_do_mkfs()
     VERBOSE("VSF OPTIONS: block_size=%u "
 	   "block_count=%"WHEFS_ID_TYPE_PFMT" "
 	   "inode_count=%"WHEFS_ID_TYPE_PFMT" "
-	   "filename_length=%u\n",
+	   "filename_length=%u "
+	   "data_alignment=%"PRIu32" "
+	   "name_index=%"PRIu32"\n",
 	   fsopt->block_size,
 	   fsopt->block_count,
 	   fsopt->inode_count,
-	   fsopt->filename_length);
+	   fsopt->filename_length,
+	   fsopt->data_alignment,
+	   fsopt->name_index);
 
     if( fsopt->block_count < fsopt->inode_count )
     {
@@ -130,6 +134,10 @@ static ArgSpec MkfsArgSpec[] = {
 {"block-size",  ArgTypeUInt32, &ThisApp.fsopt.block_size, "Same as -b.", 0, 0},
 {"s",  ArgTypeUInt16, &ThisApp.fsopt.filename_length, "The maximum length of file names in the EFS.", 0, 0},
 {"string-length",  ArgTypeUInt16, &ThisApp.fsopt.filename_length, "Same as -s.", 0, 0},
+{"a",  ArgTypeUInt32, &ThisApp.fsopt.data_alignment, "Align block data to this many bytes (0 or a power of 2 which divides the block size). Use 4096 for EFSes used with direct i/o.", 0, 0},
+{"data-alignment",  ArgTypeUInt32, &ThisApp.fsopt.data_alignment, "Same as -a.", 0, 0},
+{"x",  ArgTypeUInt32, &ThisApp.fsopt.name_index, "Reserve an on-disk name index with at least this many slots (0=none). It is always made at least twice the inode count, so 1 is a sensible value.", 0, 0},
+{"name-index",  ArgTypeUInt32, &ThisApp.fsopt.name_index, "Same as -x.", 0, 0},
 {0}
 };
 
@@ -18,6 +18,7 @@
 #include <wh/whefs/whefs.h>
 #include <wh/whefs/whefs_client_util.h>
 #include <wh/whio/whio_encode.h>
+#include <wh/whio/whio_devs.h> /* whio_dev_for_filename_direct() */
 #include "WHEFSApp.c"
 #if 0
 #if 1
@@ -496,7 +497,98 @@ int test_hash()
     return 0;
 }
 
-extern void whefs_inode_hash_cache_sort(whefs_fs * fs );
+int test_hash_table()
+{
+    MARKER("starting name hash table tests\n");
+    whefs_hashid_table tbl = whefs_hashid_table_empty;
+    enum { Count = 1000 };
+    whefs_id_type i, id;
+    uint32_t cursor;
+    int found;
+    /* Many entries, with every hash value shared by 4 IDs. */
+    for( i = 1; i <= Count; ++i )
+    {
+        assert( whefs_rc.OK == whefs_hashid_table_insert( &tbl, i % 250, i ) );
+    }
+    assert( whefs_rc.OK == whefs_hashid_table_insert( &tbl, 7, 7 ) ); /* duplicates are no-ops */
+    assert( (Count == tbl.count) && "wrong entry count" );
+    cursor = 0; found = 0;
+    while( (id = whefs_hashid_table_search( &tbl, 7, &cursor )) )
+    {
+        assert( (7 == (id % 250)) && "search returned the wrong entry" );
+        ++found;
+    }
+    assert( (4 == found) && "search missed colliding entries" );
+    /* Remove every other entry; the rest must stay reachable. */
+    for( i = 1; i <= Count; i += 2 )
+    {
+        assert( whefs_rc.OK == whefs_hashid_table_remove( &tbl, i % 250, i ) );
+    }
+    assert( whefs_rc.RangeError == whefs_hashid_table_remove( &tbl, 1, 1 ) );
+    assert( (Count/2 == tbl.count) && "wrong entry count after removal" );
+    for( i = 1; i <= Count; ++i )
+    {
+        cursor = 0; found = 0;
+        while( (id = whefs_hashid_table_search( &tbl, i % 250, &cursor )) )
+        {
+            if( id == i ) found = 1;
+        }
+        assert( (found == !(i % 2)) && "entry (not) found after removal" );
+    }
+    assert( whefs_rc.OK == whefs_hashid_table_chomp_lv( &tbl ) );
+    assert( (Count/4 == tbl.count) && "chomp_lv did not remove half of the entries" );
+    whefs_hashid_table_clear( &tbl );
+    assert( (0 == tbl.count) && (0 == tbl.list) );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   "Ez" and "FY" have the same hash code with the default (djb2) name
+   hash, so files with those names must be told apart by name.
+*/
+int test_hash_collisions()
+{
+    MARKER("starting name hash collision tests\n");
+    char const * fname = "collide.whefs";
+    char const * names[] = { "Ez", "FY", "Ez.", "FY." };
+    enum { Count = sizeof(names)/sizeof(names[0]) };
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    char buf[8];
+    int i, rc = whefs_mkfs( fname, &ThisApp.fsopts, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    /* These names collide under djb2, which is no longer the default. */
+    assert( whefs_hash_djb2( names[0] ) == whefs_hash_djb2( names[1] ) );
+    assert( whefs_rc.OK == whefs_fs_setopt_name_hash( fs, whefs_hash_djb2 ) );
+    assert( whefs_rc.OK == whefs_fs_setopt_hash_cache( fs, true, true ) );
+    for( i = 0; i < Count; ++i )
+    {
+        f = whefs_fopen( fs, names[i], "r+" );
+        assert( f && "fopen failed" );
+        assert( 1 == whefs_fwrite( f, strlen(names[i]), 1, names[i] ) );
+        whefs_fclose( f );
+    }
+    for( i = Count - 1; i >= 0; --i )
+    {
+        f = whefs_fopen( fs, names[i], "r" );
+        assert( f && "re-fopen failed" );
+        memset( buf, 0, sizeof(buf) );
+        assert( strlen(names[i]) == whefs_fread( f, 1, sizeof(buf), buf ) );
+        assert( (0 == strcmp( buf, names[i] )) && "opened the wrong file" );
+        whefs_fclose( f );
+    }
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "Ez" ) );
+    assert( ! whefs_fopen( fs, "Ez", "r" ) && "unlinked file is still found" );
+    f = whefs_fopen( fs, "FY", "r" );
+    assert( f && "colliding file lost after unlink" );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
 int test_caching()
 {
     MARKER("Caching tests...\n");
@@ -567,7 +659,6 @@ int test_caching()
             putchar('w');
             ++writeCount;
         }
-        //if( 1 == L ) whefs_inode_hash_cache_sort(fs);
         for( i = 0; i < count; ++i )
         {
             putchar('c');
@@ -635,6 +726,1460 @@ int test_streams()
     return 0;
 }
 
+/**
+   Bit-at-a-time reference implementation of whbits_find_set() (val=1)
+   and whbits_find_unset() (val=0).
+*/
+static whbits_count_t test_whbits_find_ref( whbits const * b, whbits_count_t start,
+                                            whbits_count_t end, char val )
+{
+    if( end > b->sz_bits ) end = b->sz_bits;
+    for( ; start < end; ++start )
+    {
+        if( val == whbits_get( b, start ) ) return start;
+    }
+    return end;
+}
+
+/**
+   Tests whbits_find_set() and whbits_find_unset() against a
+   bit-at-a-time search, for every start bit (word-aligned or not) of
+   a bitset whose length is not a multiple of 64, with all bits set,
+   none set, and one bit different from the rest at each position.
+   Build with WHBITS_CONFIG_BUILTIN_CTZ=0 to test the portable
+   count-trailing-zeroes routine on gcc.
+*/
+int test_whbits_find()
+{
+    MARKER("starting bitset search tests\n");
+    enum { Bits = (64 * 3) + 13 };
+    whbits b = whbits_init_obj;
+    whbits_count_t start, odd, end, ends[4];
+    char fill;
+    assert( 0 == whbits_init( &b, Bits, 0xFF ) );
+    assert( (Bits == whbits_find_unset( &b, 0, Bits )) && "all bits set: expected no match" );
+    assert( (Bits == whbits_find_unset( &b, 5, Bits + 100 )) && "end should be clamped" );
+    assert( (70 == whbits_find_set( &b, 70, Bits )) );
+    assert( (9 == whbits_find_unset( &b, 9, 9 )) && "empty range" );
+    for( fill = 0; fill < 2; ++fill )
+    {
+        /* odd == Bits means that every bit has the value fill. */
+        for( odd = 0; odd <= Bits; ++odd )
+        {
+            memset( b.bytes, fill ? 0xFF : 0x00, b.sz_bytes );
+            if( odd < Bits )
+            {
+                if( fill ) whbits_unset( &b, odd );
+                else whbits_set( &b, odd );
+            }
+            for( start = 0; start <= Bits; ++start )
+            {
+                ends[0] = Bits;
+                ends[1] = Bits - 1;
+                ends[2] = start + 64;
+                ends[3] = start + 9;
+                for( end = 0; end < 4; ++end )
+                {
+                    assert( (test_whbits_find_ref( &b, start, ends[end], 1 ) == whbits_find_set( &b, start, ends[end] ))
+                            && "whbits_find_set() mismatch" );
+                    assert( (test_whbits_find_ref( &b, start, ends[end], 0 ) == whbits_find_unset( &b, start, ends[end] ))
+                            && "whbits_find_unset() mismatch" );
+                }
+            }
+        }
+    }
+    whbits_free_bits( &b );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Checks that block allocation state survives re-opening the EFS
+   (via the on-disk free-space map), including after blocks are
+   freed and after the block table is grown.
+*/
+static void test_freemap_fill( whefs_fs * fs, char const * name, char tag, size_t len )
+{
+    whefs_file * F = whefs_fopen( fs, name, "r+" );
+    char * buf = (char *)malloc( len );
+    assert( F && buf );
+    memset( buf, tag, len );
+    assert( 1 == whefs_fwrite( F, len, 1, buf ) );
+    whefs_fclose( F );
+    free( buf );
+}
+static void test_freemap_check( whefs_fs * fs, char const * name, char tag, size_t len )
+{
+    whefs_file * F = whefs_fopen( fs, name, "r" );
+    char * buf = (char *)malloc( len );
+    size_t i;
+    assert( F && buf );
+    assert( len == whefs_fsize( F ) );
+    assert( 1 == whefs_fread( F, len, 1, buf ) );
+    for( i = 0; i < len; ++i ) assert( (tag == buf[i]) && "freemap test: data mismatch" );
+    whefs_fclose( F );
+    free( buf );
+}
+int test_freemap()
+{
+    MARKER("starting free-space map tests\n");
+    char const * fname = "freemap.whefs";
+    whefs_fs * fs = 0;
+    const size_t bs = ThisApp.fsopts.block_size;
+    int rc = whefs_mkfs( fname, &ThisApp.fsopts, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    test_freemap_fill( fs, "a", 'a', bs * 3 );
+    test_freemap_fill( fs, "b", 'b', bs * 3 );
+    whefs_fs_finalize( fs );
+
+    rc = whefs_openfs( fname, &fs, true );
+    assert((rc == whefs_rc.OK) && "openfs failed :(" );
+    test_freemap_check( fs, "b", 'b', bs * 3 );
+    rc = whefs_unlink_filename( fs, "a" );
+    assert((rc == whefs_rc.OK) && "unlink failed :(" );
+    rc = whefs_fs_append_blocks( fs, 8 );
+    assert((rc == whefs_rc.OK) && "append_blocks failed :(" );
+    whefs_fs_finalize( fs );
+
+    rc = whefs_openfs( fname, &fs, true );
+    assert((rc == whefs_rc.OK) && "openfs failed :(" );
+    assert( (ThisApp.fsopts.block_count + 8) == whefs_fs_options_get(fs)->block_count );
+    /* Needs the blocks freed by "a", and more. */
+    test_freemap_fill( fs, "c", 'c', bs * (ThisApp.fsopts.block_count - 1) );
+    test_freemap_check( fs, "b", 'b', bs * 3 );
+    test_freemap_check( fs, "c", 'c', bs * (ThisApp.fsopts.block_count - 1) );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_direct()
+{
+    MARKER("starting aligned/direct-i/o tests\n");
+    char const * fname = "direct.whefs";
+    whefs_fs * fs = 0;
+    whefs_fs_options opt = ThisApp.fsopts;
+    opt.data_alignment = whio_dev_direct_alignment;
+    opt.block_size = whio_dev_direct_alignment * 2;
+    const size_t bs = opt.block_size;
+    whio_dev * dev = whio_dev_for_filename_direct( fname, "w+" );
+    assert( dev && "could not open direct-i/o device" );
+    MARKER("Direct i/o is %s.\n", whio_dev_is_direct( dev ) ? "enabled" : "not supported here" );
+    int rc = whefs_mkfs_dev( dev, &opt, &fs, true );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    assert( whefs_fs_options_get(fs)->data_alignment == opt.data_alignment );
+    test_freemap_fill( fs, "a", 'a', (bs * 3) + 17 );
+    test_freemap_fill( fs, "b", 'b', 100 );
+    whefs_fs_finalize( fs );
+
+    dev = whio_dev_for_filename_direct( fname, "r+" );
+    assert( dev && "could not re-open direct-i/o device" );
+    rc = whefs_openfs_dev( dev, &fs, true );
+    assert((rc == whefs_rc.OK) && "openfs failed :(" );
+    assert( whefs_fs_options_get(fs)->data_alignment == opt.data_alignment );
+    test_freemap_check( fs, "a", 'a', (bs * 3) + 17 );
+    test_freemap_check( fs, "b", 'b', 100 );
+    whefs_fs_finalize( fs );
+
+    opt.block_size = whio_dev_direct_alignment + 512; /* not a multiple of the alignment */
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.RangeError == rc) && "mkfs accepted a misaligned block size" );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Reads the pseudofile "ra" back in small sequential chunks (which
+   go through the read-ahead window) and checks it against the
+   pattern written by test_readahead(), then checks that a write via
+   another handle invalidates the reader's window.
+*/
+static void test_readahead_check( whefs_fs * fs, size_t len )
+{
+    whio_dev * rd = whefs_dev_open( fs, "ra", false );
+    whio_dev * wr;
+    char buf[100];
+    size_t pos = 0, i;
+    assert( rd );
+    while( pos < len )
+    {
+        const whio_size_t n = rd->api->read( rd, buf, sizeof(buf) );
+        assert( n && "short read!" );
+        for( i = 0; i < n; ++i, ++pos )
+        {
+            assert( (buf[i] == (char)('a' + ((pos / 7) % 26))) && "readahead test: data mismatch" );
+        }
+    }
+    assert( 0 == rd->api->read( rd, buf, sizeof(buf) ) );
+    rd->api->seek( rd, 0, SEEK_SET );
+    assert( 10 == rd->api->read( rd, buf, 10 ) ); /* fills the window */
+    wr = whefs_dev_open( fs, "ra", true );
+    assert( wr );
+    wr->api->seek( wr, 20, SEEK_SET );
+    assert( 5 == wr->api->write( wr, "XXXXX", 5 ) );
+    rd->api->seek( rd, 20, SEEK_SET );
+    assert( 5 == rd->api->read( rd, buf, 5 ) );
+    assert( (0 == memcmp( buf, "XXXXX", 5 )) && "read-ahead window was not invalidated by a write" );
+    for( i = 0; i < 5; ++i ) buf[i] = (char)('a' + (((20 + i) / 7) % 26));
+    assert( 5 == whio_dev_writeat( wr, 20, buf, 5 ) ); /* restore the pattern */
+    wr->api->finalize( wr );
+    rd->api->finalize( rd );
+}
+
+int test_readahead()
+{
+    MARKER("starting read-ahead tests\n");
+    char const * fname = "readahead.whefs";
+    whefs_fs * fs = 0;
+    const size_t bs = ThisApp.fsopts.block_size;
+    const size_t len = (bs * 12) + 123;
+    size_t i;
+    int pass;
+    char * buf = (char *)malloc( len );
+    assert( buf );
+    for( i = 0; i < len; ++i ) buf[i] = (char)('a' + ((i / 7) % 26));
+    for( pass = 0; pass < 2; ++pass )
+    {
+        whio_dev * fsdev = pass
+            ? whio_dev_for_filename_uring( fname, "w+", 0 )
+            : whio_dev_for_filename( fname, "w+" );
+        whio_dev * ra;
+        whio_dev * other;
+        int rc;
+        if( ! fsdev )
+        {
+            MARKER("io_uring is not available. Skipping that pass.\n");
+            continue;
+        }
+        rc = whefs_mkfs_dev( fsdev, &ThisApp.fsopts, &fs, true );
+        assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+        /* Interleave the blocks of two files so that the window spans non-adjacent blocks. */
+        whefs_fs_setopt_extent_min( fs, 1 );
+        ra = whefs_dev_open( fs, "ra", true );
+        other = whefs_dev_open( fs, "other", true );
+        assert( ra && other );
+        for( i = 0; i < len; i += bs )
+        {
+            const size_t n = ((len - i) < bs) ? (len - i) : bs;
+            assert( n == ra->api->write( ra, buf + i, n ) );
+            if( i < (bs * 6) ) assert( n == other->api->write( other, buf, n ) );
+        }
+        ra->api->finalize( ra );
+        other->api->finalize( other );
+        MARKER("Checking read-ahead on a %s device.\n", pass ? "io_uring" : "FILE" );
+        test_readahead_check( fs, len );
+        whefs_fs_setopt_readahead( fs, 0 );
+        test_readahead_check( fs, len );
+        whefs_fs_finalize( fs );
+    }
+    free( buf );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Checks that re-reading a small pseudofile is served by the page
+   cache, and that the cache sees writes made after the data was
+   cached.
+*/
+int test_pcache()
+{
+    MARKER("starting page cache tests\n");
+    char const * fname = "pcache.whefs";
+    whefs_fs * fs = 0;
+    whefs_cache_stats st1 = whefs_cache_stats_empty;
+    whefs_cache_stats st2 = whefs_cache_stats_empty;
+    char buf[300];
+    int i, rc = whefs_mkfs( fname, &ThisApp.fsopts, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    test_freemap_fill( fs, "hot", 'h', sizeof(buf) );
+    test_freemap_check( fs, "hot", 'h', sizeof(buf) );
+    whefs_fs_cache_stats( fs, &st1 );
+    for( i = 0; i < 10; ++i ) test_freemap_check( fs, "hot", 'h', sizeof(buf) );
+    whefs_fs_cache_stats( fs, &st2 );
+    MARKER("Re-reading a small file 10 times: %u hit(s), %u miss(es).\n",
+           (unsigned)(st2.hits - st1.hits), (unsigned)(st2.misses - st1.misses) );
+    assert( (st2.hits > st1.hits) && (st2.misses == st1.misses) && "expected only cache hits" );
+    assert( st2.pages && (st2.pages <= st2.capacity) );
+    /* Overwrite cached data and check that readers see it. */
+    test_freemap_fill( fs, "hot", 'H', sizeof(buf) );
+    test_freemap_check( fs, "hot", 'H', sizeof(buf) );
+    /* A budget of two pages, read through in small chunks, forces evictions. */
+    whefs_fs_setopt_cache_size( fs, 2 * st2.page_size );
+    whefs_fs_setopt_readahead( fs, 0 );
+    test_freemap_fill( fs, "a", 'a', ThisApp.fsopts.block_size * 3 );
+    for( i = 0; i < 3; ++i )
+    {
+        whio_dev * dev = whefs_dev_open( fs, "a", false );
+        whio_size_t n, k;
+        assert( dev );
+        while( (n = dev->api->read( dev, buf, 100 )) )
+        {
+            for( k = 0; k < n; ++k ) assert( ('a' == buf[k]) && "page cache test: data mismatch" );
+        }
+        dev->api->finalize( dev );
+        test_freemap_check( fs, "hot", 'H', sizeof(buf) );
+    }
+    whefs_fs_cache_stats( fs, &st1 );
+    assert( (st1.evictions > st2.evictions) && (st1.pages <= 2) );
+    whefs_fs_setopt_cache_size( fs, 0 );
+    test_freemap_check( fs, "hot", 'H', sizeof(buf) );
+    whefs_fs_dump_info( fs, stdout );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Checks that many small appends are buffered by the write-back cache,
+   visible to readers before they are written back, and intact after
+   an fflush() and after re-opening the EFS.
+*/
+int test_writeback()
+{
+    MARKER("starting write-back cache tests\n");
+    char const * fname = "writeback.whefs";
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whio_dev * dev;
+    whefs_cache_stats st1 = whefs_cache_stats_empty;
+    whefs_cache_stats st2 = whefs_cache_stats_empty;
+    enum { Count = 500, Len = 7 };
+    char buf[Len];
+    int i, k, rc = whefs_mkfs( fname, &ThisApp.fsopts, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    /* write-back is opt-in: by default the cache is write-through */
+    f = whefs_fopen( fs, "wt", "r+" );
+    assert( f && (1 == whefs_fwrite( f, Len, 1, "default" )) );
+    whefs_fs_cache_stats( fs, &st1 );
+    assert( ! st1.dirty && "the cache should be write-through by default" );
+    whefs_fclose( f );
+    whefs_fs_setopt_writeback( fs, 1024 * 1024, 3600 );
+    whefs_fs_cache_stats( fs, &st1 );
+    assert( ! st1.dirty );
+    f = whefs_fopen( fs, "wb", "r+" );
+    assert( f );
+    dev = whefs_fdev( f );
+    for( i = 0; i < Count; ++i )
+    {
+        for( k = 0; k < Len; ++k ) buf[k] = 'a' + ((i + k) % 26);
+        assert( (Len == dev->api->write( dev, buf, Len )) && "write failed" );
+    }
+    whefs_fs_cache_stats( fs, &st2 );
+    MARKER("%d %d-byte appends left %u dirty page(s).\n", Count, Len, (unsigned)st2.dirty );
+    assert( st2.dirty && (st2.writebacks == st1.writebacks) && "expected buffered writes" );
+    dev->api->seek( dev, 0, SEEK_SET );
+    for( i = 0; i < Count; ++i )
+    {
+        assert( Len == dev->api->read( dev, buf, Len ) );
+        for( k = 0; k < Len; ++k ) assert( (buf[k] == ('a' + ((i + k) % 26))) && "write-back test: data mismatch" );
+    }
+    whefs_fflush( f );
+    whefs_fs_cache_stats( fs, &st1 );
+    MARKER("fflush() wrote back %u page(s).\n", (unsigned)(st1.writebacks - st2.writebacks) );
+    assert( !st1.dirty && (st1.writebacks > st2.writebacks) );
+    assert( ((st1.writebacks - st2.writebacks) < Count) && "expected merged writes" );
+    /* A few more appends are written back on close. */
+    for( k = 0; k < Len; ++k ) buf[k] = 'z';
+    dev->api->write( dev, buf, Len );
+    whefs_fclose( f );
+    whefs_fs_cache_stats( fs, &st2 );
+    assert( ! st2.dirty );
+    whefs_fs_finalize( fs );
+    fs = 0;
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "re-opening EFS failed" );
+    f = whefs_fopen( fs, "wb", "r" );
+    assert( f );
+    dev = whefs_fdev( f );
+    assert( ((Count + 1) * Len) == whio_dev_size( dev ) );
+    for( i = 0; i < Count; ++i )
+    {
+        assert( Len == dev->api->read( dev, buf, Len ) );
+        for( k = 0; k < Len; ++k ) assert( (buf[k] == ('a' + ((i + k) % 26))) && "write-back test: data mismatch after re-open" );
+    }
+    assert( (Len == dev->api->read( dev, buf, Len )) && ('z' == buf[0]) );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Checks that the given pseudofile's contents match the first n
+   bytes of cmp.
+*/
+static void test_coalesced_check( whefs_fs * fs, char const * name, unsigned char const * cmp, size_t n )
+{
+    unsigned char buf[1024 * 2];
+    whefs_file * f = whefs_fopen( fs, name, "r" );
+    assert( f && (n <= sizeof(buf)) );
+    assert( (whio_size_t)n == whefs_fsize( f ) );
+    assert( 1 == whefs_fread( f, n, 1, buf ) );
+    assert( (0 == memcmp( buf, cmp, n )) && "coalesced write test: data mismatch" );
+    whefs_fclose( f );
+}
+
+/**
+   Tests writes which span several blocks, both physically adjacent
+   ones (written with one vectored write, including the headers of
+   newly-allocated blocks) and non-adjacent ones, at offsets which do
+   not fall on block boundaries.
+*/
+int test_coalesced_write()
+{
+    MARKER("starting coalesced write tests\n");
+    char const * fname = "coalesced.whefs";
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_inode ino = whefs_inode_empty;
+    whefs_block bl = whefs_block_empty;
+    enum { BS = 256, Total = BS * 7 };
+    unsigned char mirror[Total];
+    unsigned char buf[Total];
+    whefs_id_type prev = 0;
+    int adjacent = 0, gaps = 0;
+    size_t i;
+    int rc;
+    opt.block_size = BS;
+    opt.block_count = 32;
+    opt.inode_count = 8;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed :(" );
+    whefs_fs_setopt_extent_min( fs, 1 );
+    /* "a" gets blocks 1-2 and "b" block 3, so growing "a" leaves a gap
+       between its 2nd and 3rd blocks. */
+    memset( mirror, 'a', BS * 2 );
+    f = whefs_fopen( fs, "a", "r+" );
+    assert( f && (1 == whefs_fwrite( f, BS * 2, 1, mirror )) );
+    whefs_fclose( f );
+    memset( buf, 'b', BS );
+    f = whefs_fopen( fs, "b", "r+" );
+    assert( f && (1 == whefs_fwrite( f, BS, 1, buf )) );
+    whefs_fclose( f );
+    f = whefs_fopen( fs, "a", "r+" );
+    assert( f );
+    /* Crosses the gap and extends the file over new adjacent blocks. */
+    for( i = 0; i < (BS * 4); ++i ) buf[i] = (unsigned char)('A' + (i % 23));
+    whefs_fseek( f, BS + 100, SEEK_SET );
+    assert( 1 == whefs_fwrite( f, BS * 4, 1, buf ) );
+    memcpy( mirror + BS + 100, buf, BS * 4 );
+    /* Overwrites part of existing adjacent blocks, unaligned at both ends. */
+    for( i = 0; i < (BS * 2); ++i ) buf[i] = (unsigned char)('0' + (i % 10));
+    whefs_fseek( f, BS * 2 + 37, SEEK_SET );
+    assert( 1 == whefs_fwrite( f, BS * 2, 1, buf ) );
+    memcpy( mirror + BS * 2 + 37, buf, BS * 2 );
+    /* Starts mid-block and ends past the current EOF. */
+    for( i = 0; i < (BS + 50); ++i ) buf[i] = (unsigned char)('a' + (i % 26));
+    whefs_fseek( f, BS * 5 + 50, SEEK_SET );
+    assert( 1 == whefs_fwrite( f, BS + 50, 1, buf ) );
+    memcpy( mirror + BS * 5 + 50, buf, BS + 50 );
+    whefs_fclose( f );
+    test_coalesced_check( fs, "a", mirror, BS * 6 + 100 );
+    memset( buf, 'b', BS );
+    test_coalesced_check( fs, "b", buf, BS );
+    /* Re-opening the EFS reads the block chain back from storage. */
+    whefs_fs_finalize( fs );
+    fs = 0;
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "re-opening EFS failed" );
+    test_coalesced_check( fs, "a", mirror, BS * 6 + 100 );
+    test_coalesced_check( fs, "b", buf, BS );
+    f = whefs_fopen( fs, "a", "r" );
+    assert( f );
+    rc = whefs_inode_id_read( fs, f->inode, &ino );
+    assert( (whefs_rc.OK == rc) && ino.first_block );
+    for( bl.next_block = ino.first_block; bl.next_block; prev = bl.id )
+    {
+        rc = whefs_block_read( fs, bl.next_block, &bl );
+        assert( (whefs_rc.OK == rc) && "reading block chain failed" );
+        if( prev && (bl.id == (prev + 1)) ) ++adjacent;
+        else if( prev ) ++gaps;
+    }
+    MARKER("block chain has %d adjacent and %d non-adjacent link(s).\n", adjacent, gaps );
+    assert( adjacent && gaps && "expected both adjacent and non-adjacent blocks" );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Tests reads which span runs of physically adjacent blocks
+   (whio_dev_inode_read_run()), starting and ending mid-block and
+   crossing from one run to the next, against the same bytes read
+   one block at a time straight from the EFS.
+*/
+int test_read_run()
+{
+    MARKER("starting coalesced read tests\n");
+    char const * fname = "readrun.whefs";
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_inode ino = whefs_inode_empty;
+    whefs_block bl = whefs_block_empty;
+    enum { BS = 256, Total = BS * 6 };
+    /* {offset,length} pairs: within the first run, across the gap
+       between the runs, the two bytes on each side of the gap, within
+       the second run, and the whole file less a few bytes at each end. */
+    static const size_t reads[][2] = {
+    {10, BS * 2},
+    {BS + 100, BS * 3},
+    {(BS * 3) - 1, 2},
+    {(BS * 3) + 1, (BS * 2) + 10},
+    {50, Total - 100},
+    {0, Total}
+    };
+    unsigned char ref[Total];
+    unsigned char buf[Total];
+    whio_size_t got = 0, len;
+    whefs_id_type runs = 0;
+    size_t i;
+    int rc;
+    opt.block_size = BS;
+    opt.block_count = 32;
+    opt.inode_count = 8;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed :(" );
+    whefs_fs_setopt_extent_min( fs, 1 );
+    /* "a" gets blocks 1-3, "b" block 4 and "a" then 5-7: two runs
+       broken by a block of another file. */
+    for( i = 0; i < Total; ++i ) buf[i] = (unsigned char)(i % 251);
+    f = whefs_fopen( fs, "a", "r+" );
+    assert( f && (1 == whefs_fwrite( f, BS * 3, 1, buf )) );
+    whefs_fclose( f );
+    f = whefs_fopen( fs, "b", "r+" );
+    assert( f && (1 == whefs_fwrite( f, 7, 1, "bbbbbbb" )) );
+    whefs_fclose( f );
+    f = whefs_fopen( fs, "a", "r+" );
+    assert( f );
+    whefs_fseek( f, 0, SEEK_END );
+    assert( 1 == whefs_fwrite( f, BS * 3, 1, buf + (BS * 3) ) );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    fs = 0;
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "re-opening EFS failed" );
+    f = whefs_fopen( fs, "a", "r" );
+    assert( f && (Total == whefs_fsize( f )) );
+    /* The reference copy, read block by block. */
+    rc = whefs_inode_id_read( fs, f->inode, &ino );
+    assert( (whefs_rc.OK == rc) && ino.first_block );
+    for( bl.next_block = ino.first_block; bl.next_block; got += len )
+    {
+        if( bl.id && (bl.next_block != (bl.id + 1)) ) ++runs;
+        rc = whefs_block_read( fs, bl.next_block, &bl );
+        assert( (whefs_rc.OK == rc) && "reading block chain failed" );
+        len = ((Total - got) < BS) ? (Total - got) : BS;
+        assert( len == whefs_fs_readat( fs, whefs_block_data_pos( fs, &bl ), ref + got, len ) );
+    }
+    assert( (Total == got) && (1 == runs) && "expected two runs of adjacent blocks" );
+    assert( (0 == memcmp( ref, buf, Total )) && "read run test: reference data mismatch" );
+    for( i = 0; i < (sizeof(reads)/sizeof(reads[0])); ++i )
+    {
+        memset( buf, 0, Total );
+        whefs_fseek( f, reads[i][0], SEEK_SET );
+        assert( 1 == whefs_fread( f, reads[i][1], 1, buf ) );
+        assert( (0 == memcmp( buf, ref + reads[i][0], reads[i][1] )) && "read run test: data mismatch" );
+        assert( ((reads[i][0] + reads[i][1]) == whefs_fseek( f, 0, SEEK_CUR )) && "read run test: wrong position" );
+    }
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Creates pseudofile name with len bytes of content and returns the
+   ID of its first block.
+*/
+static whefs_id_type test_extent_file( whefs_fs * fs, char const * name, size_t len )
+{
+    static const unsigned char zeros[1024 * 4] = {0};
+    whefs_inode ino = whefs_inode_empty;
+    whefs_file * f = whefs_fopen( fs, name, "r+" );
+    assert( f && (len <= sizeof(zeros)) );
+    assert( 1 == whefs_fwrite( f, len, 1, zeros ) );
+    assert( whefs_rc.OK == whefs_inode_id_read( fs, f->inode, &ino ) );
+    whefs_fclose( f );
+    return ino.first_block;
+}
+
+/**
+   Tests extent-based block allocation (whefs_block_next_free_run()):
+   a multi-block write gets physically adjacent blocks, runs shorter
+   than the minimum extent size are skipped, and if no run is long
+   enough the longest one found is used.
+*/
+int test_extent_alloc()
+{
+    MARKER("starting extent allocation tests\n");
+    char const * fname = "extents.whefs";
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_inode ino = whefs_inode_empty;
+    whefs_block bl = whefs_block_empty;
+    enum { BS = 256 };
+    unsigned char buf[BS * 12];
+    whefs_id_type first = 0, count = 0, prev = 0, n = 0;
+    char name[16];
+    int i, rc;
+    opt.block_size = BS;
+    opt.block_count = 40;
+    opt.inode_count = 32;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert( (whefs_rc.OK == rc) && "mkfs failed :(" );
+    whefs_fs_setopt_extent_min( fs, 1 );
+    /* Blocks 1-20 get one file each... */
+    for( i = 1; i <= 20; ++i )
+    {
+        sprintf( name, "f%d", i );
+        assert( (i == test_extent_file( fs, name, 1 )) && "expected first-fit allocation" );
+    }
+    /* ... then gaps of 1, 3 and 2 blocks are freed. */
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "f2" ) );
+    for( i = 5; i <= 7; ++i )
+    {
+        sprintf( name, "f%d", i );
+        assert( whefs_rc.OK == whefs_unlink_filename( fs, name ) );
+    }
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "f10" ) );
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "f11" ) );
+    /* A 12-block write skips the short gaps when the minimum extent
+       size is 4, and its blocks are adjacent. */
+    whefs_fs_setopt_extent_min( fs, 4 );
+    f = whefs_fopen( fs, "big", "r+" );
+    assert( f );
+    memset( buf, 'x', sizeof(buf) );
+    assert( 1 == whefs_fwrite( f, sizeof(buf), 1, buf ) );
+    rc = whefs_inode_id_read( fs, f->inode, &ino );
+    assert( (whefs_rc.OK == rc) && (21 == ino.first_block) && "short gaps should have been skipped" );
+    for( bl.next_block = ino.first_block; bl.next_block; prev = bl.id, ++n )
+    {
+        rc = whefs_block_read( fs, bl.next_block, &bl );
+        assert( (whefs_rc.OK == rc) && "reading block chain failed" );
+        assert( (!prev || (bl.id == (prev + 1))) && "expected adjacent blocks" );
+    }
+    assert( 12 == n );
+    whefs_fclose( f );
+    /* Blocks 33-40 remain free, so no free run is 9 blocks long and a
+       request for 9 with a minimum of 9 falls back to the longest run
+       found. */
+    whefs_fs_setopt_extent_min( fs, 9 );
+    rc = whefs_block_next_free_run( fs, 0, 9, &first, &count, true );
+    assert( (whefs_rc.OK == rc) && (33 == first) && (8 == count) && "expected the longest (8-block) run" );
+    /* With those taken the longest is now the 3-block gap. */
+    rc = whefs_block_next_free_run( fs, 0, 9, &first, &count, true );
+    assert( (whefs_rc.OK == rc) && (5 == first) && (3 == count) && "expected the longest (3-block) run" );
+    /* And with a minimum of 2 the first long-enough run, not the first free block, wins. */
+    whefs_fs_setopt_extent_min( fs, 2 );
+    rc = whefs_block_next_free_run( fs, 0, 4, &first, &count, true );
+    assert( (whefs_rc.OK == rc) && (10 == first) && (2 == count) && "expected the first 2-block run" );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/** whefs_fs_entry_foreach() callback which sums up entry counts and sizes. */
+static int test_inode_table_sum( whefs_fs * fs, whefs_fs_entry const * ent, void * clientData )
+{
+    size_t * sums = (size_t *)clientData;
+    ++sums[0];
+    sums[1] += ent->size;
+    return whefs_rc.OK;
+}
+
+/**
+   Checks that listing a re-opened EFS, which is served by the
+   in-memory inode table, agrees with listing it from storage, and
+   that the table sees later changes.
+*/
+int test_inode_table()
+{
+    MARKER("starting inode table tests\n");
+    char const * fname = "itable.whefs";
+    char name[10];
+    whefs_fs * fs = 0;
+    size_t sums[2];
+    size_t expect = 0;
+    int i, rc = whefs_mkfs( fname, &ThisApp.fsopts, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 1; i <= 5; ++i )
+    {
+        sprintf( name, "t%d", i );
+        test_freemap_fill( fs, name, 't', i * 100 );
+        expect += i * 100;
+    }
+    whefs_fs_finalize( fs );
+    fs = 0;
+    rc = whefs_openfs( fname, &fs, true );
+    assert( (whefs_rc.OK == rc) && "re-opening EFS failed" );
+    sums[0] = sums[1] = 0;
+    assert( whefs_rc.OK == whefs_fs_entry_foreach( fs, test_inode_table_sum, sums ) );
+    assert( (5 == sums[0]) && (expect == sums[1]) && "inode table listing mismatch" );
+    /* Grow a file and remove one: the table must follow. */
+    test_freemap_fill( fs, "t1", 'T', 1000 );
+    expect += 900;
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "t2" ) );
+    expect -= 200;
+    sums[0] = sums[1] = 0;
+    whefs_fs_entry_foreach( fs, test_inode_table_sum, sums );
+    assert( (4 == sums[0]) && (expect == sums[1]) && "inode table not updated" );
+    /* ... and agree with the storage. */
+    assert( whefs_rc.OK == whefs_fs_setopt_inode_table( fs, false ) );
+    sums[0] = sums[1] = 0;
+    whefs_fs_entry_foreach( fs, test_inode_table_sum, sums );
+    assert( (4 == sums[0]) && (expect == sums[1]) && "inode table differs from storage" );
+    assert( whefs_rc.OK == whefs_fs_setopt_inode_table( fs, true ) );
+    test_freemap_check( fs, "t1", 'T', 1000 );
+    whefs_fs_dump_info( fs, stdout );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/** Returns the number of whefs_ls() matches for the given pattern. */
+static whefs_id_type test_name_table_count( whefs_fs * fs, char const * pattern )
+{
+    whefs_id_type count = 0;
+    whefs_string * ls = whefs_ls( fs, pattern, &count );
+    whefs_string_finalize( ls, true );
+    return count;
+}
+
+int test_name_table()
+{
+    MARKER("starting names table tests\n");
+    char const * fname = "ntable.whefs";
+    char name[16];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    int i, pass, rc;
+    opt.inode_count = 32;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 512;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < 20; ++i )
+    {
+        sprintf( name, "%s%02d", (i % 2) ? "odd" : "even", i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+    fs = 0;
+    rc = whefs_openfs( fname, &fs, true );
+    assert( (whefs_rc.OK == rc) && "re-opening EFS failed" );
+    /* Rename and remove some files: the table must follow. */
+    f = whefs_fopen( fs, "odd01", "r+" );
+    assert( f );
+    assert( whefs_rc.OK == whefs_file_name_set( f, "even01" ) );
+    whefs_fclose( f );
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "even00" ) );
+    for( pass = 0; pass < 2; ++pass )
+    { /* pass 0 uses the table, pass 1 the storage. */
+        assert( 10 == test_name_table_count( fs, "even*" ) );
+        assert( 9 == test_name_table_count( fs, "odd*" ) );
+        assert( 19 == test_name_table_count( fs, 0 ) );
+        assert( ! whefs_fopen( fs, "odd01", "r" ) );
+        f = whefs_fopen( fs, "even01", "r" );
+        assert( f && "renamed file not found" );
+        whefs_fclose( f );
+        assert( whefs_rc.OK == whefs_fs_setopt_hash_cache( fs, false, false ) );
+        assert( whefs_rc.OK == whefs_fs_setopt_name_table( fs, false ) );
+    }
+    assert( whefs_rc.OK == whefs_fs_setopt_name_table( fs, true ) );
+    assert( 10 == test_name_table_count( fs, "even*" ) );
+    whefs_fs_dump_info( fs, stdout );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+#include "../src/whefs_namescan.h"
+int test_name_scan()
+{
+    MARKER("starting name scan tests (%s)\n", whefs_name_scan_impl());
+    enum { Count = 37, MaxStride = 70 };
+    static const size_t strides[] = { 3, 8, 17, 40, MaxStride };
+    /* Names sharing a long prefix, so that matches need more than one compare. */
+    static char const * longPrefix = "shard/0123456789abcdef0123456789abcdef/";
+    unsigned char recs[(Count * MaxStride) + whefs_name_scan_pad];
+    char key[MaxStride];
+    char const * fname = "nscan.whefs";
+    char name[MaxStride];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    size_t s, i, k, n, expect;
+    int pass, rc;
+    for( s = 0; s < sizeof(strides)/sizeof(strides[0]); ++s )
+    {
+        size_t const stride = strides[s];
+        memset( recs, 0xAA, sizeof(recs) );
+        for( i = 0; i < Count; ++i )
+        {
+            sprintf( name, "%s%u", (stride > 50) ? longPrefix : "", (unsigned int)(i % 19) );
+            name[stride - 1] = 0;
+            memcpy( recs + (i * stride), name, strlen( name ) + 1 );
+        }
+        for( k = 0; k < Count; ++k )
+        { /* compare with a naive search, for exact and prefix matches */
+            memcpy( key, recs + (k * stride), stride );
+            for( n = strlen( key ) + 1; n > 0; --n )
+            {
+                for( expect = 0; expect < Count; ++expect )
+                {
+                    if( 0 == memcmp( recs + (expect * stride), key, n ) ) break;
+                }
+                assert( expect <= k );
+                assert( expect == whefs_name_scan( recs, stride, Count, key, n ) );
+            }
+        }
+        assert( Count == whefs_name_scan( recs, stride, Count, "x", (stride > 1) ? 2 : 1 ) );
+    }
+
+    opt.inode_count = 64;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 256;
+    opt.filename_length = 60;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < 40; ++i )
+    {
+        sprintf( name, "%s%02u", (i % 4) ? longPrefix : "other-", (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    assert( whefs_rc.OK == whefs_fs_setopt_hash_cache( fs, false, false ) );
+    for( pass = 0; pass < 2; ++pass )
+    { /* pass 0 scans the names table in memory, pass 1 on storage. */
+        for( i = 0; i < 40; ++i )
+        {
+            sprintf( name, "%s%02u", (i % 4) ? longPrefix : "other-", (unsigned int)i );
+            f = whefs_fopen( fs, name, "r" );
+            assert( f && "scan did not find the file" );
+            whefs_fclose( f );
+            name[strlen( name ) - 1] = 0; /* a prefix of the name */
+            assert( ! whefs_fopen( fs, name, "r" ) );
+        }
+        assert( ! whefs_fopen( fs, "other-01", "r" ) );
+        assert( 30 == test_name_table_count( fs, "shard/*" ) );
+        assert( 10 == test_name_table_count( fs, "other-*" ) );
+        assert( 8 == test_name_table_count( fs, "shard/0123456789abcdef0123456789abcdef/1?" ) );
+        assert( 0 == test_name_table_count( fs, "shard/x*" ) );
+        assert( whefs_rc.OK == whefs_fs_setopt_name_table( fs, false ) );
+    }
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+#include <wh/whglob.h>
+int test_glob_compiled()
+{
+    MARKER("starting compiled glob tests\n");
+    static const struct { char const * pattern; char const * str; int match; } cases[] = {
+    { "abc", "abc", 1 }, { "abc", "abcd", 0 }, { "abc*", "abcd", 1 },
+    { "*.c", "whefs.c", 1 }, { "*.c", "whefs.h", 0 }, { "*.[ch]", "whefs.h", 1 },
+    { "*[ch]", "x.c", 1 }, { "a*b*c", "aXbYc", 1 }, { "a*b*c", "aXcYb", 0 },
+    { "?", "", 0 }, { "??", "ab", 1 }, { "*?*", "", 0 }, { "a?c", "abbc", 0 },
+    { "[^a-c]x", "dx", 1 }, { "[^a-c]x", "bx", 0 }, { "[]]", "]", 1 },
+    { "[a-]", "-", 1 }, { "x[abc", "xa", 0 }, { "a\\*b", "a*b", 1 },
+    { "a\\*b", "aXb", 0 }, { "*a", "bbba", 1 }, { "shard-1?/*", "shard-12/part-3", 1 },
+    { "\xc3\xa9t\xc3\xa9*", "\xc3\xa9t\xc3\xa9.txt", 1 }, { "?t?", "\xc3\xa9t\xc3\xa9", 1 },
+    { "", "", 1 }, { "", "a", 0 }
+    };
+    char const * fname = "glob.whefs";
+    char name[32];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    whglob * g;
+    size_t i, plen;
+    int rc;
+    for( i = 0; i < sizeof(cases)/sizeof(cases[0]); ++i )
+    {
+        g = whglob_compile( cases[i].pattern );
+        assert( g );
+        if( cases[i].match != !!whglob_compiled_matches( g, cases[i].str )
+            || cases[i].match != !!whglob_matches( cases[i].pattern, cases[i].str ) )
+        {
+            MARKER("glob [%s] vs [%s]: expected %d\n", cases[i].pattern, cases[i].str, cases[i].match );
+            assert( 0 && "glob mismatch" );
+        }
+        whglob_free( g );
+    }
+    g = whglob_compile( "shard-0*.[ch]" );
+    assert( 0 == strcmp( "shard-0", whglob_prefix( g, &plen ) ) && (7 == plen) );
+    whglob_free( g );
+
+    /* Prefix listings with the sorted names index, which must follow renames. */
+    opt.inode_count = 64;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 256;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < 30; ++i )
+    {
+        sprintf( name, "shard-%u/part-%02u", (unsigned int)(i % 3), (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    assert( 10 == test_name_table_count( fs, "shard-1/*" ) );
+    assert( 4 == test_name_table_count( fs, "shard-1/part-1*" ) ); /* 10, 13, 16, 19 */
+    assert( 0 == test_name_table_count( fs, "shard-9*" ) );
+    f = whefs_fopen( fs, "shard-1/part-01", "r+" );
+    assert( f );
+    assert( whefs_rc.OK == whefs_file_name_set( f, "shard-2/part-01" ) );
+    whefs_fclose( f );
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "shard-1/part-04" ) );
+    f = whefs_fopen( fs, "shard-9/new", "r+" );
+    assert( f );
+    whefs_fclose( f );
+    assert( 8 == test_name_table_count( fs, "shard-1/*" ) );
+    assert( 11 == test_name_table_count( fs, "shard-2/*" ) );
+    assert( 1 == test_name_table_count( fs, "shard-9*" ) );
+    assert( 29 == test_name_table_count( fs, "*/part-*" ) );
+    whefs_fs_dump_info( fs, stdout );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_ls_batch()
+{
+    MARKER("starting batch listing tests\n");
+    char const * fname = "lsbatch.whefs";
+    char name[32];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_listing * li = 0;
+    whefs_string * ls;
+    whefs_string * s;
+    whefs_file_stats st;
+    whefs_id_type count = 0, i;
+    int rc, pass;
+    opt.inode_count = 40;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 128;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < 25; ++i )
+    {
+        sprintf( name, "%s-%02u.dat", (i % 2) ? "odd" : "even", (unsigned int)i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        assert( i == whefs_fwrite( f, 1, i, "0123456789012345678901234567890" ) );
+        whefs_fclose( f );
+    }
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "odd-03.dat" ) );
+    for( pass = 0; pass < 2; ++pass )
+    { /* pass 0 uses the in-memory names table, pass 1 the storage. */
+        static char const * patterns[] = { 0, "odd-*", "*-1?.dat", "none*" };
+        size_t p;
+        for( p = 0; p < sizeof(patterns)/sizeof(patterns[0]); ++p )
+        {
+            ls = whefs_ls( fs, patterns[p], &count );
+            assert( whefs_rc.OK == whefs_ls_batch( fs, patterns[p], &li ) );
+            assert( li && (li->count == count) );
+            for( i = 0, s = ls; i < li->count; ++i, s = s->next )
+            { /* same entries as whefs_ls(), along with the metadata fstat() reports */
+                assert( s && (0 == strcmp( s->string, li->names[i] )) );
+                assert( (i == 0) || (li->ids[i-1] < li->ids[i]) );
+                f = whefs_fopen( fs, li->names[i], "r" );
+                assert( f );
+                assert( whefs_rc.OK == whefs_fstat( f, &st ) );
+                assert( st.inode == li->ids[i] );
+                assert( st.bytes == li->sizes[i] );
+                assert( (li->sizes[i] == (whio_size_t)atoi( li->names[i] + (('o' == li->names[i][0]) ? 4 : 5) )) );
+                whefs_fclose( f );
+            }
+            assert( ! s );
+            whefs_string_finalize( ls, true );
+            whefs_listing_free( li );
+        }
+        assert( whefs_rc.OK == whefs_ls_batch( fs, "odd-*", &li ) );
+        assert( 11 == li->count );
+        whefs_listing_free( li );
+        assert( whefs_rc.OK == whefs_fs_setopt_name_table( fs, false ) );
+    }
+    assert( whefs_rc.ArgError == whefs_ls_batch( fs, 0, 0 ) );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_opened_nodes()
+{
+    MARKER("starting opened-inodes tests\n");
+    enum { Count = 150 };
+    char const * fname = "opened.whefs";
+    char name[16];
+    char buf[16];
+    whefs_file * files[Count];
+    whefs_file * dup;
+    whefs_fs_options opt = ThisApp.fsopts;
+    whefs_fs * fs = 0;
+    int i, rc;
+    opt.inode_count = Count + 10;
+    opt.block_count = Count + 10;
+    opt.block_size = 256;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    /* Enough concurrent opens to need several slabs and table growth. */
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "o%d", i );
+        files[i] = whefs_fopen( fs, name, "r+" );
+        assert( files[i] && "fopen failed" );
+        assert( 1 == whefs_fwrite( files[i], strlen(name), 1, name ) );
+    }
+    /* A second handle must share the first one's inode. */
+    dup = whefs_fopen( fs, "o77", "r" );
+    assert( dup && "second fopen failed" );
+    assert( 3 == whefs_fread( dup, 1, 3, buf ) );
+    assert( 0 == memcmp( buf, "o77", 3 ) && "second handle does not see the shared inode" );
+    whefs_fclose( dup );
+    /* Close in a scattered order so table removals shift probe runs. */
+    for( i = 0; i < Count; ++i )
+    {
+        int const x = (i * 7) % Count;
+        assert( (whefs_rc.OK == whefs_fclose( files[x] )) && "fclose failed" );
+    }
+    /* Reopening after everything was closed re-uses the freed entries. */
+    for( i = Count - 1; i >= 0; --i )
+    {
+        sprintf( name, "o%d", i );
+        files[i] = whefs_fopen( fs, name, "r" );
+        assert( files[i] && "re-fopen failed" );
+        memset( buf, 0, sizeof(buf) );
+        assert( strlen(name) == whefs_fread( files[i], 1, sizeof(buf), buf ) );
+        assert( 0 == strcmp( buf, name ) && "contents mismatch" );
+    }
+    for( i = 0; i < Count; i += 2 ) whefs_fclose( files[i] );
+    /* whefs_fs_finalize() closes the rest. */
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_closers()
+{
+    MARKER("starting close-at-shutdown tests\n");
+    enum { Count = 12 };
+    char const * fname = "closers.whefs";
+    char name[16];
+    whefs_file * files[Count];
+    whio_dev * devs[Count];
+    whio_stream * streams[Count];
+    whefs_fs_options opt = ThisApp.fsopts;
+    whefs_fs * fs = 0;
+    int i, round, rc;
+    opt.inode_count = (Count * 3) + 2;
+    opt.block_count = (Count * 3) + 2;
+    opt.block_size = 256;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    /* Open/close churn through all three handle types. */
+    for( round = 0; round < 50; ++round )
+    {
+        for( i = 0; i < Count; ++i )
+        {
+            sprintf( name, "f%d", i );
+            files[i] = whefs_fopen( fs, name, "r+" );
+            sprintf( name, "d%d", i );
+            devs[i] = whefs_dev_open( fs, name, true );
+            sprintf( name, "s%d", i );
+            streams[i] = whefs_stream_open( fs, name, true, true );
+            assert( files[i] && devs[i] && streams[i] && "open failed" );
+            whefs_fseek( files[i], 0, SEEK_END );
+            assert( 1 == whefs_fwrite( files[i], 1, 1, "f" ) );
+        }
+        /* Close from the middle of the list as well as both ends. */
+        for( i = 0; i < Count; ++i )
+        {
+            int const x = (i * 5) % Count;
+            assert( whefs_rc.OK == whefs_fclose( files[x] ) );
+            streams[x]->api->finalize( streams[x] );
+            devs[Count - 1 - x]->api->finalize( devs[Count - 1 - x] );
+        }
+    }
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "f%d", i );
+        files[i] = whefs_fopen( fs, name, "r" );
+        assert( files[i] && "re-fopen failed" );
+        assert( 50 == whefs_fseek( files[i], 0, SEEK_END ) );
+        sprintf( name, "d%d", i );
+        devs[i] = whefs_dev_open( fs, name, false );
+        sprintf( name, "s%d", i );
+        streams[i] = whefs_stream_open( fs, name, true, true );
+        assert( devs[i] && streams[i] && "open failed" );
+    }
+    for( i = 0; i < Count; i += 3 )
+    {
+        whefs_fclose( files[i] );
+        devs[i]->api->finalize( devs[i] );
+        streams[i]->api->finalize( streams[i] );
+    }
+    /* whefs_fs_finalize() must close the rest. */
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_name_index()
+{
+    MARKER("starting on-disk name index tests\n");
+    enum { Count = 100 };
+    char const * fname = "nameidx.whefs";
+    char const * collide[] = { "Ez", "FY", "Ez.", "FY." };
+    char name[16];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    int i, rc;
+    opt.inode_count = Count + 10;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 512;
+    opt.name_index = 1;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    assert( (whefs_fs_options_get(fs)->name_index >= 2 * opt.inode_count) && "index is too small" );
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "file-%03d", i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    for( i = 0; i < 4; ++i )
+    {
+        f = whefs_fopen( fs, collide[i], "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    for( i = 0; i < Count; i += 2 )
+    {
+        sprintf( name, "file-%03d", i );
+        assert( whefs_rc.OK == whefs_unlink_filename( fs, name ) );
+    }
+    f = whefs_fopen( fs, "file-001", "r+" );
+    assert( f );
+    assert( whefs_rc.OK == whefs_file_name_set( f, "renamed" ) );
+    whefs_fclose( f );
+    assert( whefs_rc.OK == whefs_unlink_filename( fs, "Ez" ) );
+    whefs_fs_finalize( fs );
+
+    /* A cold open without the name cache must be served by the index. */
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+    assert( whefs_fs_options_get(fs)->name_index >= 2 * opt.inode_count );
+    assert( whefs_rc.OK == whefs_fs_setopt_hash_cache( fs, false, false ) );
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "file-%03d", i );
+        f = whefs_fopen( fs, name, "r" );
+        assert( (((i % 2) && (1 != i)) == (0 != f)) && "name index lookup mismatch" );
+        if( f ) whefs_fclose( f );
+    }
+    f = whefs_fopen( fs, "renamed", "r" );
+    assert( f && "renamed file not found" );
+    whefs_fclose( f );
+    assert( ! whefs_fopen( fs, "Ez", "r" ) && "unlinked file is still found" );
+    for( i = 1; i < 4; ++i )
+    {
+        f = whefs_fopen( fs, collide[i], "r" );
+        assert( f && "colliding name not found" );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+int test_name_filter()
+{
+    MARKER("starting name filter tests\n");
+    enum { Count = 60, Misses = 200 };
+    char const * fname = "namefilter.whefs";
+    char name[16];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    whefs_name_filter_stats st = whefs_name_filter_stats_empty;
+    int i, rc;
+    opt.inode_count = Count + 10;
+    opt.block_count = opt.inode_count;
+    opt.block_size = 512;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "file-%03d", i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+
+    /* Without the hash cache, misses must be answered by the filter. */
+    rc = whefs_openfs( fname, &fs, true );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+    assert( whefs_rc.OK == whefs_fs_setopt_hash_cache( fs, false, false ) );
+    for( i = 0; i < Misses; ++i )
+    {
+        sprintf( name, "nope-%03d", i );
+        assert( ! whefs_fopen( fs, name, "r" ) && "found a nonexistent file" );
+    }
+    assert( whefs_rc.OK == whefs_fs_name_filter_stats( fs, &st ) );
+    assert( st.counters >= 8 * opt.inode_count );
+    assert( Misses == st.checks );
+    assert( st.checks == (st.negatives + st.false_positives) );
+    assert( (st.negatives > Misses * 9 / 10) && "too many false positives" );
+    /* The filter must follow unlinks and renames. */
+    for( i = 0; i < Count; i += 3 )
+    {
+        sprintf( name, "file-%03d", i );
+        assert( whefs_rc.OK == whefs_unlink_filename( fs, name ) );
+    }
+    f = whefs_fopen( fs, "file-001", "r+" );
+    assert( f );
+    assert( whefs_rc.OK == whefs_file_name_set( f, "renamed" ) );
+    whefs_fclose( f );
+    for( i = 0; i < Count; ++i )
+    {
+        sprintf( name, "file-%03d", i );
+        f = whefs_fopen( fs, name, "r" );
+        assert( ((i % 3) && (1 != i)) == (0 != f) && "filtered lookup mismatch" );
+        if( f ) whefs_fclose( f );
+    }
+    f = whefs_fopen( fs, "renamed", "r" );
+    assert( f && "renamed file not found" );
+    whefs_fclose( f );
+    whefs_fs_name_filter_stats( fs, &st );
+    MARKER("Name filter: %u checks, %u negatives, %u false positive(s)\n",
+           (unsigned int)st.checks, (unsigned int)st.negatives, (unsigned int)st.false_positives );
+    assert( whefs_rc.OK == whefs_fs_setopt_name_filter( fs, false ) );
+    whefs_fs_name_filter_stats( fs, &st );
+    assert( 0 == st.counters );
+    assert( ! whefs_fopen( fs, "file-000", "r" ) );
+    f = whefs_fopen( fs, "file-002", "r" );
+    assert( f && "lookup without the filter failed" );
+    whefs_fclose( f );
+    whefs_fs_finalize( fs );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
+#if WHEFS_CONFIG_ENABLE_THREADS
+#include <pthread.h>
+enum { ThreadFiles = 4, ThreadFileSize = 20000, ThreadRounds = 15 };
+/** Per-thread state for test_threads(). */
+struct test_thread_arg
+{
+    whefs_fs * fs;
+    int id;
+    int rc;
+};
+
+/** Returns the expected byte at pos of test_threads()' file #id. */
+static unsigned char test_thread_byte( int id, size_t pos )
+{
+    return (unsigned char)((pos * 31 + id * 7) & 0xff);
+}
+
+/** Repeatedly reads and checks pseudofile "r-<id>", in odd-sized chunks. */
+static void * test_thread_reader( void * vp )
+{
+    struct test_thread_arg * a = (struct test_thread_arg *)vp;
+    unsigned char buf[333];
+    char name[16];
+    int r;
+    sprintf( name, "r-%d", a->id );
+    for( r = 0; (r < ThreadRounds) && !a->rc; ++r )
+    {
+        size_t pos = 0, got, i;
+        whefs_file * f = whefs_fopen( a->fs, name, "r" );
+        if( ! f ) { a->rc = 1; break; }
+        if( ThreadFileSize != whefs_fsize( f ) ) a->rc = 2;
+        while( !a->rc && (got = whefs_fread( f, 1, sizeof(buf), buf )) )
+        {
+            for( i = 0; i < got; ++i )
+            {
+                if( buf[i] != test_thread_byte( a->id, pos + i ) ) { a->rc = 3; break; }
+            }
+            pos += got;
+        }
+        if( !a->rc && (ThreadFileSize != pos) ) a->rc = 4;
+        whefs_fclose( f );
+    }
+    return 0;
+}
+
+/** Grows pseudofile "w-<id>" (allocating blocks) and reads it back. */
+static void * test_thread_writer( void * vp )
+{
+    struct test_thread_arg * a = (struct test_thread_arg *)vp;
+    unsigned char buf[500];
+    char name[16];
+    size_t pos, i;
+    whefs_file * f;
+    sprintf( name, "w-%d", a->id );
+    f = whefs_fopen( a->fs, name, "r+" );
+    if( ! f ) { a->rc = 1; return 0; }
+    for( pos = 0; pos < ThreadFileSize; pos += sizeof(buf) )
+    {
+        for( i = 0; i < sizeof(buf); ++i ) buf[i] = test_thread_byte( a->id, pos + i );
+        if( 1 != whefs_fwrite( f, sizeof(buf), 1, buf ) ) { a->rc = 2; break; }
+    }
+    whefs_frewind( f );
+    for( pos = 0; !a->rc && (pos < ThreadFileSize); pos += sizeof(buf) )
+    {
+        if( 1 != whefs_fread( f, sizeof(buf), 1, buf ) ) { a->rc = 3; break; }
+        for( i = 0; i < sizeof(buf); ++i )
+        {
+            if( buf[i] != test_thread_byte( a->id, pos + i ) ) { a->rc = 4; break; }
+        }
+    }
+    whefs_fclose( f );
+    return 0;
+}
+
+/** Creates, lists, stats and unlinks pseudofiles while the others do i/o. */
+static void * test_thread_meta( void * vp )
+{
+    struct test_thread_arg * a = (struct test_thread_arg *)vp;
+    whefs_file_stats st;
+    whefs_listing * li = 0;
+    whefs_file * f;
+    char name[16];
+    int r;
+    for( r = 0; (r < ThreadRounds * 4) && !a->rc; ++r )
+    {
+        sprintf( name, "tmp-%d", r );
+        f = whefs_fopen( a->fs, name, "r+" );
+        if( ! f ) { a->rc = 1; break; }
+        if( (1 != whefs_fwrite( f, 5, 1, "hello" ))
+            || (5 != whefs_fsize( f )) || (whefs_rc.OK != whefs_fstat( f, &st )) ) a->rc = 2;
+        whefs_fclose( f );
+        if( (whefs_rc.OK != whefs_ls_batch( a->fs, "r-*", &li )) || (ThreadFiles != li->count) ) a->rc = 3;
+        whefs_listing_free( li );
+        if( whefs_rc.OK != whefs_unlink_filename( a->fs, name ) ) a->rc = 4;
+    }
+    return 0;
+}
+#endif /* WHEFS_CONFIG_ENABLE_THREADS */
+
+int test_threads()
+{
+    MARKER("starting thread tests\n");
+#if WHEFS_CONFIG_ENABLE_THREADS
+    enum { ThreadCount = ThreadFiles * 2 + 1 };
+    char const * fname = "threads.whefs";
+    char name[16];
+    unsigned char buf[ThreadFileSize];
+    pthread_t th[ThreadCount];
+    struct test_thread_arg args[ThreadCount];
+    whefs_fs * fs = 0;
+    whefs_file * f;
+    whefs_fs_options opt = whefs_fs_options_default;
+    int i, pass, rc;
+    size_t k;
+    opt.inode_count = 64;
+    opt.block_size = 1024;
+    opt.block_count = (ThreadFiles * 2 * ThreadFileSize) / opt.block_size + 32;
+    rc = whefs_mkfs( fname, &opt, &fs );
+    assert((rc == whefs_rc.OK) && "mkfs failed :(" );
+    for( i = 0; i < ThreadFiles; ++i )
+    {
+        sprintf( name, "r-%d", i );
+        f = whefs_fopen( fs, name, "r+" );
+        assert( f && "fopen failed" );
+        for( k = 0; k < ThreadFileSize; ++k ) buf[k] = test_thread_byte( i, k );
+        assert( 1 == whefs_fwrite( f, ThreadFileSize, 1, buf ) );
+        whefs_fclose( f );
+    }
+    for( pass = 0; pass < 2; ++pass )
+    { /* pass 0 goes straight to storage, pass 1 uses the page cache and read-ahead. */
+        if( pass )
+        {
+            whefs_fs_setopt_cache_size( fs, 64 * 1024 );
+            whefs_fs_setopt_readahead( fs, 4 );
+            for( i = 0; i < ThreadFiles; ++i )
+            {
+                sprintf( name, "w-%d", i );
+                assert( whefs_rc.OK == whefs_unlink_filename( fs, name ) );
+            }
+        }
+        for( i = 0; i < ThreadCount; ++i )
+        {
+            void * (*func)( void * ) = (i < ThreadFiles)
+                ? test_thread_reader
+                : ((i < (ThreadFiles * 2)) ? test_thread_writer : test_thread_meta);
+            args[i].fs = fs;
+            args[i].id = i % ThreadFiles;
+            args[i].rc = 0;
+            assert( 0 == pthread_create( &th[i], 0, func, &args[i] ) );
+        }
+        for( i = 0; i < ThreadCount; ++i )
+        {
+            pthread_join( th[i], 0 );
+            if( args[i].rc )
+            {
+                MARKER("thread #%d failed with code %d\n", i, args[i].rc );
+            }
+            assert( 0 == args[i].rc );
+        }
+    }
+    whefs_fs_finalize( fs );
+    /* the written files must have survived */
+    rc = whefs_openfs( fname, &fs, false );
+    assert( (whefs_rc.OK == rc) && "openfs failed" );
+    for( i = 0; i < ThreadFiles; ++i )
+    {
+        sprintf( name, "w-%d", i );
+        f = whefs_fopen( fs, name, "r" );
+        assert( f && (ThreadFileSize == whefs_fsize( f )) );
+        assert( 1 == whefs_fread( f, ThreadFileSize, 1, buf ) );
+        for( k = 0; k < ThreadFileSize; ++k ) assert( buf[k] == test_thread_byte( i, k ) );
+        whefs_fclose( f );
+    }
+    whefs_fs_finalize( fs );
+    remove( fname );
+#else
+    MARKER("skipped: WHEFS_CONFIG_ENABLE_THREADS is off\n");
+#endif
+    MARKER("ending test\n");
+    return 0;
+}
+
 int main( int argc, char const ** argv )
 {
     WHEFSApp.usageText = "[flags]";
@@ -655,7 +2200,28 @@ int main( int argc, char const ** argv )
     //if(!rc) rc =  test_multiple_files();
     //if(!rc) rc = test_streams();
     //if(!rc) rc =  test_truncate();
+    if(!rc) rc =  test_hash_table();
+    if(!rc) rc =  test_hash_collisions();
     if(!rc) rc =  test_caching();
+    if(!rc) rc =  test_whbits_find();
+    if(!rc) rc =  test_freemap();
+    if(!rc) rc =  test_direct();
+    if(!rc) rc =  test_readahead();
+    if(!rc) rc =  test_pcache();
+    if(!rc) rc =  test_writeback();
+    if(!rc) rc =  test_coalesced_write();
+    if(!rc) rc =  test_read_run();
+    if(!rc) rc =  test_extent_alloc();
+    if(!rc) rc =  test_inode_table();
+    if(!rc) rc =  test_name_table();
+    if(!rc) rc =  test_name_scan();
+    if(!rc) rc =  test_glob_compiled();
+    if(!rc) rc =  test_ls_batch();
+    if(!rc) rc =  test_opened_nodes();
+    if(!rc) rc =  test_closers();
+    if(!rc) rc =  test_name_index();
+    if(!rc) rc =  test_name_filter();
+    if(!rc) rc =  test_threads();
     printf("Done rc=%d=[%s].\n",rc,
 	   (0==rc)
 	   ? "You win :)"
@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <wh/whio/whio.h>
 #include <wh/whio/whio_encode.h>
+#include <sys/stat.h> /* fstat() */
 
 #ifndef WHIO_ENABLE_ZLIB
 #define WHIO_ENABLE_ZLIB 0
@@ -334,6 +335,178 @@ int test_subdev()
     return 0;
 }
 
+/**
+   Checks whio_dev_readat(), whio_dev_writeat() and the vectored
+   whio_dev_readvat()/whio_dev_writevat() against dev, which must be
+   at least 64 bytes long. If dev has native positional members, also
+   checks that they (and the vectored variants built on them) leave
+   the cursor alone.
+*/
+static void test_readat_dev( whio_dev * dev, char const * label )
+{
+    char buf[20];
+    whio_size_t szrc;
+    const whio_size_t opos = 3;
+    MARKER("readat/writeat on %s device (native=%s)\n", label, dev->api->readat ? "yes" : "no" );
+    dev->api->seek( dev, opos, SEEK_SET );
+    szrc = whio_dev_writeat( dev, 40, "0123456789", 10 );
+    assert( (10 == szrc) && "writeat() failed!" );
+    memset( buf, 0, sizeof(buf) );
+    szrc = whio_dev_readat( dev, 42, buf, 5 );
+    assert( (5 == szrc) && "readat() failed!" );
+    assert( (0 == memcmp( buf, "23456", 5 )) && "readat() got wrong data!" );
+    if( dev->api->readat && dev->api->writeat )
+    {
+        assert( (opos == dev->api->tell( dev )) && "native readat/writeat moved the cursor!" );
+    }
+    {
+        char hdr[3] = {'h','d','r'};
+        char a[4], b[6];
+        whio_iovec iov[3];
+        iov[0].base = hdr; iov[0].len = sizeof(hdr);
+        iov[1].base = (void *)"ABCDEF"; iov[1].len = 6;
+        iov[2].base = 0; iov[2].len = 0; /* empty segments are skipped */
+        szrc = whio_dev_writevat( dev, 20, iov, 3 );
+        assert( (9 == szrc) && "writevat() failed!" );
+        iov[0].base = a; iov[0].len = sizeof(a);
+        iov[1].base = b; iov[1].len = sizeof(b);
+        szrc = whio_dev_readvat( dev, 19, iov, 2 );
+        assert( (10 == szrc) && "readvat() failed!" );
+        assert( (0 == memcmp( a+1, "hdr", 3 )) && (0 == memcmp( b, "ABCDEF", 6 ))
+                && "readvat() got wrong data!" );
+        if( (dev->api->readvat && dev->api->writevat)
+            || (dev->api->readat && dev->api->writeat && !dev->api->readv && !dev->api->writev) )
+        {
+            assert( (opos == dev->api->tell( dev )) && "positional vectored i/o moved the cursor!" );
+        }
+    }
+}
+
+int test_readat()
+{
+    MARKER("starting test\n");
+    char const * fname = "readat.iodev";
+    char zeros[64];
+    memset( zeros, 0, sizeof(zeros) );
+    whio_dev * dev = whio_dev_for_filename( fname, "w+" );
+    assert( dev );
+    dev->api->write( dev, zeros, sizeof(zeros) );
+    test_readat_dev( dev, "file" );
+    dev->api->finalize( dev );
+    dev = whio_dev_for_filename_direct( fname, "r+" );
+    assert( dev );
+    test_readat_dev( dev, "direct" );
+    {
+        /* An unaligned append is padded to a whole unit on disk,
+           and only trimmed back by flush(). */
+        struct stat st;
+        int fd = -1;
+        assert( whio_rc.OK == whio_dev_ioctl( dev, whio_dev_ioctl_FILE_fd, &fd ) );
+        assert( 3 == whio_dev_writeat( dev, sizeof(zeros), "end", 3 ) );
+        assert( (sizeof(zeros) + 3) == whio_dev_size( dev ) );
+        assert( (0 == fstat( fd, &st )) && (whio_dev_direct_alignment == st.st_size)
+                && "expected a padded tail before flush()" );
+        assert( whio_rc.OK == dev->api->flush( dev ) );
+        assert( (0 == fstat( fd, &st )) && ((sizeof(zeros) + 3) == st.st_size)
+                && "flush() did not trim the padding" );
+    }
+    whio_dev * sub = whio_dev_subdev_create( dev, 8, 8 + sizeof(zeros) );
+    assert( sub );
+    test_readat_dev( sub, "subdev" );
+    sub->api->finalize( sub );
+    dev->api->finalize( dev );
+    if( whio_dev_uring_is_available() )
+    {
+        dev = whio_dev_for_filename_uring( fname, "r+", 0 );
+        assert( dev );
+        test_readat_dev( dev, "io_uring" );
+        dev->api->finalize( dev );
+    }
+    remove( fname );
+
+    dev = whio_dev_for_membuf( sizeof(zeros), 0 );
+    assert( dev );
+    test_readat_dev( dev, "membuf" );
+    dev->api->finalize( dev );
+
+    dev = whio_dev_for_memmap_rw( zeros, sizeof(zeros) );
+    assert( dev );
+    test_readat_dev( dev, "memmap" );
+    dev->api->finalize( dev );
+    MARKER("ending test\n");
+    return 0;
+}
+
+/**
+   Checks the io_uring device's asynchronous API: queues more writes
+   than the ring can hold, reaps them, then queues reads of the same
+   blocks and checks their contents.
+*/
+int test_uring()
+{
+    MARKER("starting test\n");
+    if( ! whio_dev_uring_is_available() )
+    {
+        MARKER("io_uring is not available. Skipping test.\n");
+        return 0;
+    }
+    char const * fname = "uring.iodev";
+    enum { BlockSize = 512, BlockCount = 40 };
+    static char out[BlockCount][BlockSize];
+    static char in[BlockCount][BlockSize];
+    whio_dev_uring_completion done[BlockCount];
+    whio_size_t i, n, got = 0;
+    int rc;
+    whio_dev * dev = whio_dev_for_filename_uring( fname, "w+", 8 );
+    assert( dev );
+    for( i = 0; i < BlockCount; ++i )
+    {
+        memset( out[i], 'a' + (i % 26), BlockSize );
+        rc = whio_dev_uring_queue_write( dev, i * BlockSize, out[i], BlockSize, out[i] );
+        assert( (whio_rc.OK == rc) && "queue_write() failed!" );
+    }
+    assert( (whio_rc.OK == whio_dev_uring_submit( dev )) && "submit() failed!" );
+    while( got < BlockCount )
+    {
+        n = whio_dev_uring_wait( dev, done, BlockCount, 1 );
+        assert( n && "wait() returned no completions!" );
+        for( i = 0; i < n; ++i )
+        {
+            assert( (0 == done[i].err) && (BlockSize == done[i].bytes) && "async write failed!" );
+        }
+        got += n;
+    }
+    assert( (0 == whio_dev_uring_pending( dev )) && "pending() should be 0 here!" );
+    assert( (BlockCount * BlockSize == dev->api->seek( dev, 0, SEEK_END )) && "wrong file size!" );
+    for( i = 0; i < BlockCount; ++i )
+    {
+        rc = whio_dev_uring_queue_read( dev, i * BlockSize, in[i], BlockSize, in[i] );
+        assert( (whio_rc.OK == rc) && "queue_read() failed!" );
+    }
+    /* A synchronous call in the middle of the batch must not lose the async completions. */
+    {
+        char c = 0;
+        assert( (1 == whio_dev_readat( dev, BlockSize * 3, &c, 1 )) && ('d' == c) );
+    }
+    got = 0;
+    while( got < BlockCount )
+    {
+        n = whio_dev_uring_wait( dev, done, BlockCount, BlockCount - got );
+        for( i = 0; i < n; ++i )
+        {
+            const whio_size_t id = (whio_size_t)(((char *)done[i].tag - in[0]) / BlockSize);
+            assert( (id < BlockCount) && (BlockSize == done[i].bytes) && "async read failed!" );
+            assert( (0 == memcmp( in[id], out[id], BlockSize )) && "async read got wrong data!" );
+        }
+        got += n;
+    }
+    MARKER("%u async writes and reads done with a queue depth of 8.\n", (unsigned)BlockCount );
+    dev->api->finalize( dev );
+    remove( fname );
+    MARKER("ending test\n");
+    return 0;
+}
+
 #include <wh/whio/whio_zlib.h>
 #if WHIO_ENABLE_ZLIB
 #include "zlib.h" // Z_DEFAULT_COMPRESSION
@@ -549,6 +722,8 @@ int main( int argc, char const ** argv )
     if(!rc) rc =  test_memmap();
     if(!rc) rc =  test_stream();
     if(!rc) rc =  test_subdev();
+    if(!rc) rc =  test_readat();
+    if(!rc) rc =  test_uring();
 #if WHIO_ENABLE_ZLIB
     if(!rc) rc =  test_gzip();
 #endif
@@ -15,6 +15,8 @@ ${srcd}/whio.c
 ${srcd}/whio_common.c
 ${srcd}/whio_dev.c
 ${srcd}/whio_dev_FILE.c
+${srcd}/whio_dev_direct.c
+${srcd}/whio_dev_uring.c
 ${srcd}/whio_dev_fileno.c
 ${srcd}/whio_dev_mem.c
 ${srcd}/whio_dev_subdev.c
@@ -45,6 +47,10 @@ ${srcd}/whefs_encode.c
 ${srcd}/whefs.c
 ${srcd}/whefs_fs.c
 ${srcd}/whefs_block.c
+${srcd}/whefs_freemap.c
+${srcd}/whefs_nameidx.c
+${srcd}/whefs_namescan.c
+${srcd}/whefs_pcache.c
 ${srcd}/whefs_inode.c
 ${srcd}/whefs_hash.c
 ${srcd}/whefs_nodedev.c
@@ -66,6 +72,7 @@ ${srcd}/whdbg.h
 ${inc_efs}/whefs_config.h
 ${inc_efs}/whefs.h
 ${srcd}/whefs_hash.h
+${srcd}/whefs_namescan.h
 ${inc_efs}/whefs_string.h
 ${srcd}/whefs_encode.h
 ${srcd}/whefs_inode.h
@@ -374,6 +374,33 @@ struct whefs_fs_options
        WHEFS_MAX_FILENAME_LENGTH.
     */
     uint16_t filename_length;
+    /**
+       If greater than 1, mkfs lays out the EFS so that the blocks
+       table and the data part of every block start at a multiple of
+       this many bytes. Each block's header is then padded up to
+       the alignment, so this is only economical with block sizes
+       much larger than the alignment. It must be 0 (no alignment) or
+       a power of two, and block_size must be a multiple of it.
+
+       This is intended for use with unbuffered i/o devices (see
+       whio_dev_for_filename_direct()), whose transfers must be
+       aligned: with a data_alignment of whio_dev_direct_alignment,
+       whole-block i/o on such a device bypasses its internal bounce
+       buffer. This cannot be changed after mkfs.
+    */
+    uint32_t data_alignment;
+    /**
+       If not 0, mkfs reserves an on-disk hashtable mapping inode
+       names to inode IDs, which lets a freshly opened EFS resolve a
+       name with a couple of small reads instead of scanning the
+       whole names table. The index gets at least this many slots,
+       rounded up to a power of 2 no smaller than twice inode_count.
+       The index costs (whefs_sizeof_encoded_id_type+5) bytes per
+       slot and one extra write per name change. After opening an
+       EFS this holds the real number of slots. This cannot be
+       changed after mkfs.
+    */
+    uint32_t name_index;
 };
 typedef struct whefs_fs_options whefs_fs_options;
 
@@ -399,7 +426,7 @@ typedef struct whefs_fs_options whefs_fs_options;
    inode_count.
 */
 #define WHEFS_FS_OPTIONS_INIT(BLOCK_SIZE,INODE_COUNT,FN_LEN) \
-    { WHEFS_MAGIC_DEFAULT, BLOCK_SIZE, INODE_COUNT, INODE_COUNT, FN_LEN }
+    { WHEFS_MAGIC_DEFAULT, BLOCK_SIZE, INODE_COUNT, INODE_COUNT, FN_LEN, 0, 0 }
 /**
    Static initializer for whefs_fs_options object, using
    some rather arbitrary defaults.
@@ -409,7 +436,9 @@ typedef struct whefs_fs_options whefs_fs_options;
     1024 * 8, /* block_size */ \
     128, /* block_count */ \
     128, /* node_count */ \
-    64 /* filename_length */ \
+    64, /* filename_length */ \
+    0, /* data_alignment */ \
+    0 /* name_index */ \
     }
 /**
    Static initializer for whefs_fs_options object, with
@@ -420,7 +449,9 @@ typedef struct whefs_fs_options whefs_fs_options;
     0, /* block_size */ \
     0, /* block_count */ \
     0, /* node_count */ \
-    0 /* filename_length */ \
+    0, /* filename_length */ \
+    0, /* data_alignment */ \
+    0 /* name_index */ \
     }
 
 /**
@@ -1220,6 +1251,122 @@ int whefs_inode_hash_cache_chomp_lv( whefs_fs * fs );
 */
 int whefs_fs_setopt_hash_cache( whefs_fs * fs, bool on, bool loadNow );
 
+/**
+   Enables or disables fs's in-memory filter of inode names (see
+   WHEFS_CONFIG_ENABLE_NAME_FILTER). Enabling it does not build the
+   filter: the first search for a name which the other caches cannot
+   answer does. Disabling it frees the filter. The statistics (see
+   whefs_fs_name_filter_stats()) are kept either way.
+
+   This is a runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if !fs.
+*/
+int whefs_fs_setopt_name_filter( whefs_fs * fs, bool on );
+
+/**
+   The signature of inode name hash functions (see
+   whefs_fs_setopt_name_hash()). They must return the same value for
+   equal strings, and should return 0 if name is null.
+*/
+typedef whefs_hashval_type (*whefs_name_hash_f)( char const * name );
+
+/**
+   The "djb2" string hash (hash*33+c), which was the only name hash
+   in older versions of whefs. It is simple but processes one byte at
+   a time and mixes poorly: e.g. "Ez" and "FY" have the same hash.
+   Its result is always a 32-bit value.
+*/
+whefs_hashval_type whefs_hash_djb2( char const * name );
+
+/**
+   A fast string hash modeled on wyhash, which processes names 8 or
+   16 bytes at a time. Its 64-bit result is folded to 32 bits if
+   WHEFS_CONFIG_HASHVAL_BITS is 32. The values depend on the
+   platform's byte order, so they must not be stored. This is the
+   default name hash.
+*/
+whefs_hashval_type whefs_hash_wy( char const * name );
+
+/**
+   Sets the function used to hash inode names for fs's name cache. If
+   f is 0 then the default (whefs_hash_wy()) is used. Changing the
+   function empties the name cache.
+
+   Hash collisions never produce wrong results (names with the same
+   hash are told apart by comparing the names), but each one costs an
+   extra name read, so the function should distribute the EFS's
+   names well.
+
+   This is a runtime-only setting: it is not stored in the EFS. The
+   on-disk name index (see whefs_fs_options::name_index) always uses
+   whefs_hash_djb2().
+
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if !fs.
+*/
+int whefs_fs_setopt_name_hash( whefs_fs * fs, whefs_name_hash_f f );
+
+/**
+   Statistics about a whefs_fs's name filter. See
+   whefs_fs_name_filter_stats().
+*/
+struct whefs_name_filter_stats
+{
+    /** Number of name searches which consulted the filter. */
+    uint64_t checks;
+    /**
+       Number of those searches which the filter answered with "no
+       such name", without any i/o.
+    */
+    uint64_t negatives;
+    /**
+       Number of those searches for which the filter said "maybe" but
+       the name did not exist.
+    */
+    uint64_t false_positives;
+    /** Number of filter counters, or 0 if the filter is not built. */
+    uint32_t counters;
+};
+/** Convenience typedef. */
+typedef struct whefs_name_filter_stats whefs_name_filter_stats;
+/** Empty initialization object. */
+#define whefs_name_filter_stats_empty_m {0,0,0,0}
+/** Empty initialization object. */
+extern const whefs_name_filter_stats whefs_name_filter_stats_empty;
+
+/**
+   Copies the current statistics of fs's name filter to tgt. Returns
+   whefs_rc.OK on success or whefs_rc.ArgError if either argument is
+   0.
+*/
+int whefs_fs_name_filter_stats( whefs_fs const * fs, whefs_name_filter_stats * tgt );
+
+/**
+   Enables or disables fs's in-memory copy of its inode table (see
+   WHEFS_CONFIG_ENABLE_INODE_TABLE). Enabling it loads the table
+   immediately, with a single read. Disabling it frees the table.
+
+   This is a runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !fs, or the
+   error code from loading the table, in which case the table stays
+   disabled.
+*/
+int whefs_fs_setopt_inode_table( whefs_fs * fs, bool on );
+
+/**
+   Enables or disables fs's in-memory copy of its inode names table
+   (see WHEFS_CONFIG_ENABLE_NAME_TABLE). Enabling it loads the table
+   immediately, with a single read. Disabling it frees the table.
+
+   This is a runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !fs, or the
+   error code from loading the table, in which case the table stays
+   disabled.
+*/
+int whefs_fs_setopt_name_table( whefs_fs * fs, bool on );
+
 /**
    By default if a whefs_fs object is closed while pseudofile handles
    are still opened then they will be properly closed at that time to
@@ -1240,6 +1387,125 @@ int whefs_fs_setopt_hash_cache( whefs_fs * fs, bool on, bool loadNow );
 */
 int whefs_fs_setopt_autoclose_files( whefs_fs * fs, bool on );
 
+/**
+   Sets the minimum number of physically adjacent blocks the block
+   allocator requires when it starts a new extent for a growing
+   pseudofile. Free runs shorter than this are skipped (but not
+   lost) as long as a long-enough run exists elsewhere in the EFS. If
+   no such run exists, the allocator falls back to the longest run
+   it found, so this option never causes an allocation to fail.
+
+   A value of 1 gives plain first-fit allocation. A value of 0 is
+   treated as 1. The default is WHEFS_CONFIG_EXTENT_MIN_BLOCKS.
+
+   This is a runtime-only setting: it is not stored in the EFS and
+   does not affect the on-disk format.
+
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if !fs.
+*/
+int whefs_fs_setopt_extent_min( whefs_fs * fs, whefs_id_type count );
+
+/**
+   Sets the size, in blocks, of the read-ahead window used by
+   pseudofile i/o devices (see whefs_dev_open()) which detect
+   sequential reading. Each handle allocates a buffer of that many
+   blocks the first time it reads ahead. A value of 0 disables
+   read-ahead. The default is WHEFS_CONFIG_READAHEAD_BLOCKS.
+
+   The new value applies to the next window any handle fills,
+   including handles which are already opened. This is a
+   runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if !fs.
+*/
+int whefs_fs_setopt_readahead( whefs_fs * fs, uint32_t blocks );
+
+/**
+   Sets the memory budget, in bytes, of fs's page cache, which keeps
+   recently-read pages of the EFS's storage in memory (see
+   WHEFS_CONFIG_CACHE_BYTES). A value of 0 disables the cache. Any
+   currently-cached pages are discarded, but the statistics (see
+   whefs_fs_cache_stats()) are kept.
+
+   This is a runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if !fs.
+*/
+int whefs_fs_setopt_cache_size( whefs_fs * fs, whio_size_t bytes );
+
+/**
+   Statistics about a whefs_fs's page cache. See
+   whefs_fs_cache_stats().
+*/
+struct whefs_cache_stats
+{
+    /** Number of page lookups served from memory. */
+    uint64_t hits;
+    /** Number of page lookups which had to read from storage. */
+    uint64_t misses;
+    /** Number of pages evicted to make room for others. */
+    uint64_t evictions;
+    /** Number of reads which bypassed the cache because of their size. */
+    uint64_t bypasses;
+    /** The size of one page, in bytes. */
+    uint32_t page_size;
+    /** The maximum number of pages the cache holds. */
+    uint32_t capacity;
+    /** The number of pages currently cached. */
+    uint32_t pages;
+    /** Number of dirty pages written back to storage. */
+    uint64_t writebacks;
+    /** The number of pages currently dirty. */
+    uint32_t dirty;
+};
+/** Convenience typedef. */
+typedef struct whefs_cache_stats whefs_cache_stats;
+/** Empty initialization object. */
+#define whefs_cache_stats_empty_m {0,0,0,0,WHEFS_CONFIG_CACHE_PAGE_SIZE,0,0,0,0}
+/** Empty initialization object. */
+extern const whefs_cache_stats whefs_cache_stats_empty;
+
+/**
+   Copies the current statistics of fs's page cache to tgt. Returns
+   whefs_rc.OK on success or whefs_rc.ArgError if either argument is
+   0.
+*/
+int whefs_fs_cache_stats( whefs_fs const * fs, whefs_cache_stats * tgt );
+
+/**
+   Sets the write-back limits of fs's page cache (see
+   WHEFS_CONFIG_CACHE_DIRTY_BYTES): at most maxDirtyBytes bytes
+   (rounded up to whole pages) of written data are buffered, for at
+   most maxAgeSeconds seconds (but see whefs_fs_writeback()). Write-back
+   is off by default. If maxDirtyBytes is 0, all dirty pages
+   are written back and the cache becomes write-through. Write-back
+   also requires that the cache itself is enabled (see
+   whefs_fs_setopt_cache_size()).
+
+   This is a runtime-only setting: it is not stored in the EFS.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !fs, or an
+   error code if writing back dirty pages fails.
+*/
+int whefs_fs_setopt_writeback( whefs_fs * fs, whio_size_t maxDirtyBytes, uint32_t maxAgeSeconds );
+
+/**
+   Writes back the dirty pages of fs's page cache if the oldest of
+   them is older than the configured age limit (see
+   whefs_fs_setopt_writeback()), or unconditionally if force is
+   true.
+
+   whefs has no background flusher thread. Buffered writes check the
+   age limit themselves, but nothing else does: an application which
+   enables write-back must call this function periodically (e.g. from
+   a timer or idle handler) if the age limit is to hold for an EFS
+   which is not being written to.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !fs, or
+   whefs_rc.IOError if writing back fails.
+*/
+int whefs_fs_writeback( whefs_fs * fs, bool force );
+
 
 #ifdef __cplusplus
 } /* extern "C" */
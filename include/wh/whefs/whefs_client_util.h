@@ -17,6 +17,14 @@ extern "C" {
    A pattern of null or an empty string is equivalent to a pattern of
    "*" (but much faster, since it doesn't need to be compared).
 
+   The pattern is compiled once (see whglob_compile()). If it starts
+   with literal characters (e.g. "shard-042-*"), only the names which
+   start with those are compared with it. Those are found with a
+   binary search of a sorted index of the in-memory names table (see
+   WHEFS_CONFIG_ENABLE_NAME_TABLE), which the first such call builds,
+   or else by scanning the names table. The entries are always listed
+   in inode order.
+
    The returned list must be freed by calling whefs_string_finalize()
    and passing true as the second parameter.
 
@@ -48,6 +56,72 @@ extern "C" {
 */
 whefs_string * whefs_ls( struct whefs_fs * fs, char const * pattern, whefs_id_type * count );
 
+/** @struct whefs_listing
+
+   A batch of EFS entries, as fetched by whefs_ls_batch(). The fields
+   of entry #i (0 through count-1) are names[i], ids[i], sizes[i],
+   mtimes[i] and blocks[i]. The object, its arrays and the name
+   strings all live in one block of memory, which is freed by
+   whefs_listing_free().
+*/
+struct whefs_listing
+{
+    /** Number of entries. */
+    whefs_id_type count;
+    /** The entries' names. */
+    char const ** names;
+    /** The entries' sizes, in bytes. */
+    whio_size_t * sizes;
+    /** The entries' last modification times. */
+    uint32_t * mtimes;
+    /** The entries' inode IDs. */
+    whefs_id_type * ids;
+    /** The IDs of the entries' first data blocks (0 if they have none). */
+    whefs_id_type * blocks;
+};
+typedef struct whefs_listing whefs_listing;
+
+/**
+   A variant of whefs_ls() which also fetches each entry's metadata,
+   so that callers which need it do not have to open or stat each
+   entry (this is the equivalent of a "readdir plus").
+
+   Entries are selected exactly as for whefs_ls(): pattern may be 0 or
+   empty to match all entries, and they are listed in inode order.
+
+   On success *tgt is pointed to a new listing, which the caller must
+   free by passing it to whefs_listing_free(), and whefs_rc.OK is
+   returned. If nothing matches, the listing has a count of 0. On
+   error *tgt is set to 0 and one of these is returned:
+
+   - fs or tgt are null: whefs_rc.ArgError
+
+   - allocation fails: whefs_rc.AllocError
+
+   - reading an entry fails: some propagated error code.
+
+   Example:
+
+   @code
+   whefs_listing * li = 0;
+   whefs_id_type i;
+   if( whefs_rc.OK == whefs_ls_batch( myFS, "*.log", &li ) )
+   {
+       for( i = 0; i < li->count; ++i )
+       {
+           printf("%s\t%u\n", li->names[i], (unsigned int)li->sizes[i] );
+       }
+       whefs_listing_free( li );
+   }
+   @endcode
+*/
+int whefs_ls_batch( struct whefs_fs * fs, char const * pattern, whefs_listing ** tgt );
+
+/**
+   Frees a listing fetched by whefs_ls_batch(). li may be 0.
+*/
+void whefs_listing_free( whefs_listing * li );
+
 
 /**
    Imports all contents from src into the VFS pseudofile named fname.
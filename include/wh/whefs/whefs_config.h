@@ -153,7 +153,7 @@ in place of hard-coding the printf format specifier.
 
     @see WHEFS_MAGIC_STRING_PREFIX WHEFS_MAGIC_STRING
 */
-static const uint32_t whefs_fs_magic_bytes[] = { 2009, 12, 1, WHEFS_ID_TYPE_BITS, 0 };
+static const uint32_t whefs_fs_magic_bytes[] = { 2026, 10, 19, WHEFS_ID_TYPE_BITS, 0 };
 /** @def WHEFS_MAGIC_STRING_PREFIX
 
     WHEFS_MAGIC_STRING_PREFIX is an internal helper macro to avoid
@@ -164,7 +164,7 @@ static const uint32_t whefs_fs_magic_bytes[] = { 2009, 12, 1, WHEFS_ID_TYPE_BITS
 
     @see whefs_fs_magic_bytes WHEFS_MAGIC_STRING
 */
-#define WHEFS_MAGIC_STRING_PREFIX "whefs version 20091201 with "
+#define WHEFS_MAGIC_STRING_PREFIX "whefs version 20261019 with "
 
 #if WHEFS_ID_TYPE_BITS == 8
 /* for very, very limited filesystems. There's lots of room for overflows here! */
@@ -196,6 +196,49 @@ static const uint32_t whefs_fs_magic_bytes[] = { 2009, 12, 1, WHEFS_ID_TYPE_BITS
 #  error "WHEFS_ID_TYPE_BITS must be <= WHIO_SIZE_T_BITS"
 #endif
 
+/** @def WHEFS_CONFIG_HASHVAL_BITS
+
+WHEFS_CONFIG_HASHVAL_BITS sets the size of whefs_hashval_type, the
+type of the inode name hash codes kept in the (in-memory) name
+cache. It must be 32 or 64. Each cached name costs
+sizeof(whefs_hashval_type) plus about 4 bytes. With 32 bits and a
+good hash function, about one pair of names in 100000 shares a hash
+code. The cache resolves such collisions by comparing the names,
+but each one costs an extra name read. With 64 bits there are
+practically none.
+
+Hash codes are never stored in an EFS, so this does not affect the
+file format.
+*/
+#if !defined(WHEFS_CONFIG_HASHVAL_BITS)
+#define WHEFS_CONFIG_HASHVAL_BITS 32
+#endif
+
+/** @typedef whefs_hashval_type
+
+   The integral type whefs uses to store hash values. See
+   WHEFS_CONFIG_HASHVAL_BITS.
+*/
+/** @def WHEFS_HASHVAL_TYPE_PFMT
+
+   printf format specifier for use with whefs_hashval_type.
+*/
+/** @def WHEFS_HASHVAL_TYPE_SFMT
+
+   scanf format specifier for use with whefs_hashval_type.
+*/
+#if WHEFS_CONFIG_HASHVAL_BITS == 32
+#  define WHEFS_HASHVAL_TYPE_PFMT "08"PRIxLEAST32
+#  define WHEFS_HASHVAL_TYPE_SFMT SCNu32
+    typedef uint32_t whefs_hashval_type;
+#elif WHEFS_CONFIG_HASHVAL_BITS == 64
+#  define WHEFS_HASHVAL_TYPE_PFMT "016"PRIxLEAST64
+#  define WHEFS_HASHVAL_TYPE_SFMT SCNu64
+    typedef uint64_t whefs_hashval_type;
+#else
+#  error "WHEFS_CONFIG_HASHVAL_BITS must be one of: 32, 64"
+#endif
+
 /** @def WHEFS_MAGIC_STRING
 
    The default magic cookie string used by the library.
@@ -259,9 +302,41 @@ the files which need it.
 
 /** @def WHEFS_CONFIG_ENABLE_THREADS
 
-WHEFS_CONFIG_ENABLE_THREADS doesn't yet do anything. It is reserved for
-when some form of thread locking is enabled.
-
+If WHEFS_CONFIG_ENABLE_THREADS is true then a whefs_fs object and
+the pseudofiles opened from it may be used from multiple threads at
+once. This requires pthreads (link with -pthread) and a compiler which
+supports the __thread storage class and the __atomic builtins (gcc
+4.7+ or clang). The library must be compiled with _XOPEN_SOURCE=700
+(or a similar feature-test macro) for the pthreads rwlock and
+recursive mutex declarations to be visible in strict ISO C modes.
+config.make's WHEFS_ENABLE_THREADS option sets all of this up.
+
+Each EFS has a reader/writer lock which guards its metadata (the
+in-use bitsets, hints, free map, caches, inode/names tables and the
+opened-inodes table) and each opened inode has its own lock:
+
+- i/o on a whefs_file, whio_dev or whio_stream opened from an EFS
+(read, write, seek, truncate, flush...) holds the EFS lock shared and
+the inode's lock. Thus threads using different pseudofiles run in
+parallel, and the handles of a single pseudofile are serialized. The
+storage device and the page cache are not thread-safe, so the parts of
+such operations which access them are serialized by another,
+fs-internal, lock. Copies out of a handle's read-ahead window (see
+whefs_fs_setopt_readahead()) do not need that lock.
+
+- Opening, closing, unlinking and renaming pseudofiles, listing them
+(whefs_ls() and friends), whefs_fstat(), whefs_fs_flush(),
+whefs_fs_append_blocks() and the like hold the EFS lock exclusively.
+
+A single whefs_file (or whio_dev/whio_stream) handle should still only
+be used by one thread at a time, as its cursor is shared. The
+whefs_fs_setopt_xxx() routines are not locked: call them before
+sharing the EFS between threads. whefs_fs_finalize() must not be
+called while other threads are still using the EFS.
+
+This option cannot be used together with
+WHEFS_CONFIG_ENABLE_STATIC_MALLOC, and whio's
+WHIO_CONFIG_ENABLE_STATIC_MALLOC should be off as well.
 */
 #if !defined(WHEFS_CONFIG_ENABLE_THREADS)
 #  define WHEFS_CONFIG_ENABLE_THREADS 0
@@ -299,6 +374,67 @@ whefs_fs_set_inode_hash_cache().
 #define WHEFS_CONFIG_ENABLE_STRINGS_HASH_CACHE 1
 #endif
 
+/** @def WHEFS_CONFIG_ENABLE_NAME_FILTER
+
+If WHEFS_CONFIG_ENABLE_NAME_FILTER is true then each EFS keeps an
+in-memory counting Bloom filter of its inode names, so that most
+searches for names which do not exist (e.g. the check done when
+opening a file for creation) fail without reading the names
+table. The filter is built by the first search which needs it
+(one pass over the names table) and costs 8-16 bytes per inode.
+
+The filter can be toggled at runtime using
+whefs_fs_setopt_name_filter().
+*/
+#if !defined(WHEFS_CONFIG_ENABLE_NAME_FILTER)
+#define WHEFS_CONFIG_ENABLE_NAME_FILTER 1
+#endif
+
+/** @def WHEFS_CONFIG_ENABLE_INODE_TABLE
+
+If WHEFS_CONFIG_ENABLE_INODE_TABLE is true then opening an EFS reads
+its whole inode table with a single read and keeps a decoded copy in
+memory, so that opening files and iterating over inodes
+(whefs_inode_foreach(), whefs_fs_entry_foreach(), whefs_ls()) do not
+need one read per inode. The table costs about 16 bytes per inode.
+
+The table can be loaded or freed at runtime using
+whefs_fs_setopt_inode_table().
+*/
+#if !defined(WHEFS_CONFIG_ENABLE_INODE_TABLE)
+#define WHEFS_CONFIG_ENABLE_INODE_TABLE 1
+#endif
+
+/** @def WHEFS_CONFIG_ENABLE_NAME_TABLE
+
+If WHEFS_CONFIG_ENABLE_NAME_TABLE is true then opening an EFS reads
+its whole inode names table with a single read and keeps the names
+in one block of memory, so that listing (whefs_ls(),
+whefs_fs_entry_foreach()) and searching for inodes by name do not
+need one read per name. The table costs filename_length+1 bytes per
+inode (see whefs_fs_options).
+
+The table can be loaded or freed at runtime using
+whefs_fs_setopt_name_table().
+*/
+#if !defined(WHEFS_CONFIG_ENABLE_NAME_TABLE)
+#define WHEFS_CONFIG_ENABLE_NAME_TABLE 1
+#endif
+
+/** @def WHEFS_CONFIG_ENABLE_SIMD
+
+If WHEFS_CONFIG_ENABLE_SIMD is true then searches through the inode
+names table which the hash cache cannot answer compare 16 (SSE2) or
+32 (AVX2) bytes of a name record per instruction, if the compiler
+targets those instruction sets (SSE2 is always available on x86-64;
+AVX2 needs e.g. -mavx2). Otherwise, and on other platforms, they
+compare one 64-bit word at a time. The results are the same either
+way.
+*/
+#if !defined(WHEFS_CONFIG_ENABLE_SIMD)
+#define WHEFS_CONFIG_ENABLE_SIMD 1
+#endif
+
 /** @def WHEFS_CONFIG_ENABLE_STATIC_MALLOC
 
     See WHIO_CONFIG_ENABLE_STATIC_MALLOC, from whio_config.h, for a full
@@ -308,6 +444,9 @@ whefs_fs_set_inode_hash_cache().
 #if !defined(WHEFS_CONFIG_ENABLE_STATIC_MALLOC)
 #define WHEFS_CONFIG_ENABLE_STATIC_MALLOC 0
 #endif
+#if WHEFS_CONFIG_ENABLE_THREADS && WHEFS_CONFIG_ENABLE_STATIC_MALLOC
+#  error "WHEFS_CONFIG_ENABLE_STATIC_MALLOC is not thread-safe and cannot be used with WHEFS_CONFIG_ENABLE_THREADS!"
+#endif
 
 
 /** @def WHEFS_CONFIG_ENABLE_MMAP
@@ -352,7 +491,11 @@ whefs_fs_set_inode_hash_cache().
 If WHEFS_CONFIG_ENABLE_BITSET_CACHE is true then the EFS caches
 (using a bitset) whether or not any given inode or block is marked as
 used.  This speeds up some operations dramatically but costs malloced
-memory: 1 bit per inode plus 1 bit per block plus 1 byte.
+memory: 1 bit per inode plus 1 bit per block plus 1 byte. (The
+block bitset is allocated regardless of this setting, since it also
+holds the in-memory copy of the EFS's persistent free-space map, which
+is always maintained. With this option enabled, opening an EFS takes
+the used-blocks cache straight from that map.)
 
 This approach to caching is going to Cause Grief (or at least
 Discomfort) when dealing with multi-app concurrency issues, as we
@@ -366,6 +509,132 @@ performance than we lose when it is disabled.
 #define WHEFS_CONFIG_ENABLE_BITSET_CACHE 1
 #endif
 
+/** @def WHEFS_CONFIG_EXTENT_MIN_BLOCKS
+
+When a pseudofile grows, whefs tries to give it runs ("extents") of
+physically adjacent blocks. WHEFS_CONFIG_EXTENT_MIN_BLOCKS is the
+default minimum length of a run the allocator will accept when it has
+to start a new extent (i.e. when the blocks directly following the
+file's last block are not free). Shorter free gaps are skipped as long
+as a long-enough run exists somewhere else in the EFS. If the request
+is smaller than this value, the request size is used as the minimum.
+
+A value of 1 disables the gap-skipping behaviour, giving first-fit
+allocation.
+
+The value can be changed at runtime with whefs_fs_setopt_extent_min().
+*/
+#if !defined(WHEFS_CONFIG_EXTENT_MIN_BLOCKS)
+#define WHEFS_CONFIG_EXTENT_MIN_BLOCKS 8
+#endif
+
+/** @def WHEFS_CONFIG_COALESCE_MAX_BYTES
+
+When a pseudofile read spans blocks which are physically adjacent in
+the EFS, the inode i/o device serves them with one read() of the
+underlying storage instead of one per block. Because each block's data
+is preceeded by its on-disk header, the read goes through a scratch
+buffer owned by the device, and the data is copied out of it.
+WHEFS_CONFIG_COALESCE_MAX_BYTES is the maximum size of that buffer,
+and therefore of a single coalesced read.
+
+A value of 0 disables coalescing, giving one read() per block.
+*/
+#if !defined(WHEFS_CONFIG_COALESCE_MAX_BYTES)
+#define WHEFS_CONFIG_COALESCE_MAX_BYTES (1024 * 256)
+#endif
+
+/** @def WHEFS_CONFIG_CACHE_BYTES
+
+Each whefs_fs keeps a cache of recently-read pages of its storage
+device, which serves small reads (block data, block headers, inode
+records and names) from memory. WHEFS_CONFIG_CACHE_BYTES is the
+default memory budget of that cache, in bytes. The memory is only
+allocated once the EFS is first read from.
+
+A value of 0 disables the cache. The budget can be changed at runtime
+with whefs_fs_setopt_cache_size().
+*/
+#if !defined(WHEFS_CONFIG_CACHE_BYTES)
+#define WHEFS_CONFIG_CACHE_BYTES (1024 * 256)
+#endif
+
+/** @def WHEFS_CONFIG_CACHE_PAGE_SIZE
+
+The size, in bytes, of the pages kept by the cache described for
+WHEFS_CONFIG_CACHE_BYTES. Pages are aligned to multiples of this
+size in the storage device.
+*/
+#if !defined(WHEFS_CONFIG_CACHE_PAGE_SIZE)
+#define WHEFS_CONFIG_CACHE_PAGE_SIZE 4096
+#endif
+
+/** @def WHEFS_CONFIG_CACHE_DIRTY_BYTES
+
+If this is non-zero, the page cache described for
+WHEFS_CONFIG_CACHE_BYTES also buffers small writes (block headers,
+inode records, freemap updates and small data writes) instead of
+passing them straight to the storage device. Writes to the same page
+are merged in memory, and dirty pages are written back, with adjacent
+pages coalesced into one vectored write, when:
+
+- whefs_fflush(), whefs_fs_flush() or whefs_fclose() (or closing the
+EFS) is called.
+
+- more than WHEFS_CONFIG_CACHE_DIRTY_BYTES bytes (rounded up to whole
+pages) are dirty.
+
+- a buffered write finds that the oldest dirty data is more than
+WHEFS_CONFIG_CACHE_DIRTY_SECONDS seconds old.
+
+- a dirty page has to be evicted.
+
+whefs has no background flusher: if an EFS is not written to, its
+dirty data stays in memory, however old it is, until the client
+calls whefs_fs_writeback() (e.g. from a timer) or one of the flush
+routines.
+
+Until then, data written to an EFS can be lost if the application
+crashes. Dirty pages of the free-space map are always written back
+before any other pages, so a crash can only leak blocks, as with
+write-through, but the order of the other metadata updates is only
+guaranteed at flush points. Other processes using the same EFS (see
+WHEFS_CONFIG_ENABLE_FCNTL) do not see buffered writes.
+
+The default is 0, which makes the cache write-through. Both limits
+can be changed at runtime with whefs_fs_setopt_writeback().
+*/
+#if !defined(WHEFS_CONFIG_CACHE_DIRTY_BYTES)
+#define WHEFS_CONFIG_CACHE_DIRTY_BYTES 0
+#endif
+
+/** @def WHEFS_CONFIG_CACHE_DIRTY_SECONDS
+
+The maximum age, in seconds, of buffered writes. See
+WHEFS_CONFIG_CACHE_DIRTY_BYTES.
+*/
+#if !defined(WHEFS_CONFIG_CACHE_DIRTY_SECONDS)
+#define WHEFS_CONFIG_CACHE_DIRTY_SECONDS 5
+#endif
+
+/** @def WHEFS_CONFIG_READAHEAD_BLOCKS
+
+When a pseudofile is read sequentially in chunks smaller than a few
+blocks, the inode i/o device reads ahead of the reader: it fills a
+per-handle buffer with the next WHEFS_CONFIG_READAHEAD_BLOCKS blocks'
+worth of data and serves subsequent reads from memory. If the EFS
+lives on a whio_dev_for_filename_uring() device, the next window is
+requested asynchronously as soon as the reader reaches the end of the
+current one, so the storage i/o overlaps with the client's
+processing.
+
+A value of 0 disables read-ahead. The value can be changed at runtime
+with whefs_fs_setopt_readahead().
+*/
+#if !defined(WHEFS_CONFIG_READAHEAD_BLOCKS)
+#define WHEFS_CONFIG_READAHEAD_BLOCKS 8
+#endif
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
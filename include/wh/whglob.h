@@ -1,5 +1,6 @@
 #if !defined(WANDERINGHORSE_NET_WHGLOB_H_INCLUDED)
 #define WANDERINGHORSE_NET_WHGLOB_H_INCLUDED 1
+#include <stddef.h> /* size_t */
 /** @page whglob_page_main whglob Globbing Functions
    
     This is a small API for doing string matching using glob or SQL
@@ -63,6 +64,49 @@ extern "C" {
     */
     int whglob_matches_like( char const * pattern, char const * str, char caseSensitive );
 
+    /**
+       Opaque type for glob patterns compiled by whglob_compile().
+    */
+    typedef struct whglob whglob;
+
+    /**
+       Compiles a glob pattern (see whglob_matches() for the rules)
+       for use with whglob_compiled_matches(). This is worthwhile
+       when one pattern is compared to many strings: the pattern is
+       parsed only once, runs of literal characters are compared
+       with strncmp(), and strings which do not start and end with
+       the pattern's literal prefix and suffix are rejected before
+       anything else is done.
+
+       Returns 0 if pattern is 0 or on allocation error. The caller
+       owns the returned object and must eventually pass it to
+       whglob_free().
+    */
+    whglob * whglob_compile( char const * pattern );
+
+    /**
+       Frees a pattern compiled by whglob_compile(). g may be 0.
+    */
+    void whglob_free( whglob * g );
+
+    /**
+       Returns non-0 if str matches the compiled pattern g. For
+       strings which are valid UTF-8 the result is the same as
+       whglob_matches(pattern, str) (strings with invalid UTF-8
+       sequences might compare differently, since literals are
+       compared byte-wise here). Returns 0 if either argument is 0.
+    */
+    int whglob_compiled_matches( whglob const * g, char const * str );
+
+    /**
+       Returns the literal characters at the start of g's pattern
+       (e.g. "abc" for "abc*.[ch]", or "" for "*.c"), which every
+       matching string starts with. If len is not 0 then it is set to
+       the length of the prefix, in bytes. The returned string is
+       owned by g. Returns 0 if !g.
+    */
+    char const * whglob_prefix( whglob const * g, size_t * len );
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
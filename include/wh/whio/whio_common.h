@@ -210,6 +210,27 @@ typedef struct whio_impl_data whio_impl_data;
 */
 extern const whio_impl_data whio_impl_data_empty;
 
+/**
+   Describes one buffer segment for the vectored i/o routines,
+   e.g. whio_dev_api::writev() and whio_dev_writev(). It mirrors
+   POSIX's struct iovec but uses whio_size_t for the length. As with
+   struct iovec, base is non-const so that the same type can be used
+   for both reading and writing; write routines do not modify the
+   memory it points to.
+*/
+struct whio_iovec
+{
+    /** Start of the segment's memory. */
+    void * base;
+    /** Length of the segment, in bytes. */
+    whio_size_t len;
+};
+typedef struct whio_iovec whio_iovec;
+/**
+   Static initializer for whio_iovec objects.
+*/
+#define whio_iovec_empty_m {0/*base*/,0/*len*/}
+
 /**
    Tries to convert an fopen()-compatible mode string to a number
    compatible with whio_dev::iomode() and whio_stream::iomode().
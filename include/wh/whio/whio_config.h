@@ -93,6 +93,24 @@ extern "C" {
 #  define WHIO_CONFIG_ENABLE_STATIC_MALLOC 0
 #endif
 
+/** @def WHIO_CONFIG_ENABLE_URING
+
+   If WHIO_CONFIG_ENABLE_URING is true then the io_uring-based
+   whio_dev (whio_dev_for_filename_uring()) is built. It requires
+   Linux 5.6 or later and the kernel's <linux/io_uring.h> header, but
+   not liburing. If it is false, that factory function always fails
+   and whio_dev_uring_is_available() returns false.
+
+   It defaults to on for Linux builds.
+*/
+#if !defined(WHIO_CONFIG_ENABLE_URING)
+#  if defined(__linux__)
+#    define WHIO_CONFIG_ENABLE_URING 1
+#  else
+#    define WHIO_CONFIG_ENABLE_URING 0
+#  endif
+#endif
+
 #if defined(WHIO_SIZE_T_BITS)
 # error "WHIO_SIZE_T_BITS must not be defined before including this file! Edit this file instead!"
 #endif
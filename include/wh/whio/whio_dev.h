@@ -296,6 +296,67 @@ struct whio_dev_api
        or otherwise invalid.
     */
     short (*iomode)( struct whio_dev * dev );
+
+    /**
+       Reads up to n bytes from absolute position pos of the device
+       into dest and returns the number of bytes read, as for read().
+       Unlike a seek() followed by a read(), this should not change
+       the device's cursor position, and it needs only one call (one
+       syscall, for file-based devices).
+
+       This member is optional: devices which cannot do better than
+       seek() plus read() should set it to 0. Clients should call
+       whio_dev_readat() instead of this function, as that routine
+       uses the seek()/read() fallback when this member is 0. Because
+       of that fallback, clients must not rely on the cursor position
+       after calling whio_dev_readat().
+    */
+    whio_size_t (*readat)( struct whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n );
+
+    /**
+       The write() counterpart of readat(), with the same conventions.
+       May be 0. Clients should call whio_dev_writeat() instead of
+       this function.
+    */
+    whio_size_t (*writeat)( struct whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n );
+
+    /**
+       Scatter-read: reads into each of the count segments of iov, in
+       order, starting at the current cursor position, and returns the
+       total number of bytes read. A return value smaller than the sum
+       of the segment lengths means EOF or an error was encountered.
+
+       This member is optional and may be 0. Clients should call
+       whio_dev_readv() instead of this function, as that routine
+       falls back to one read() per segment when this member is 0.
+    */
+    whio_size_t (*readv)( struct whio_dev * dev, whio_iovec const * iov, whio_size_t count );
+
+    /**
+       Gather-write: the write() counterpart of readv(), with the same
+       conventions. May be 0. Clients should call whio_dev_writev()
+       instead of this function.
+    */
+    whio_size_t (*writev)( struct whio_dev * dev, whio_iovec const * iov, whio_size_t count );
+
+    /**
+       The positional counterpart of readv(): reads into the count
+       segments of iov starting at absolute position pos, without
+       using or changing the cursor (e.g. one preadv() call, for
+       file-based devices). Returns the total number of bytes read.
+
+       This member is optional and may be 0. Clients should call
+       whio_dev_readvat() instead of this function, as that routine
+       falls back to seek() plus readv() when this member is 0.
+    */
+    whio_size_t (*readvat)( struct whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
+
+    /**
+       The write counterpart of readvat(), with the same conventions.
+       May be 0. Clients should call whio_dev_writevat() instead of
+       this function.
+    */
+    whio_size_t (*writevat)( struct whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
 };
 typedef struct whio_dev_api whio_dev_api;
 
@@ -458,14 +519,55 @@ int whio_dev_rewind( whio_dev * dev );
 whio_size_t whio_dev_write( whio_dev * dev, void const * data, whio_size_t n );
 
 /**
-   Positions dev to pos and then writes n bytes from data to it. May return
-   either whio_rc.SizeTError (if the seek fails) or the result of calling
-   dev->api->write( dev, data, n );
+   Writes n bytes from data to dev, starting at position pos. If
+   dev->api->writeat is set, the result of calling it is returned,
+   otherwise dev is positioned to pos and then written to. May
+   return either whio_rc.SizeTError (if the seek fails) or the number
+   of bytes written.
+
+   The cursor position of dev after this call is unspecified.
 */
 whio_size_t whio_dev_writeat( whio_dev * dev, whio_size_t pos, void const * data, whio_size_t n );
 
+/**
+   The read counterpart of whio_dev_writeat(), using
+   dev->api->readat if it is set.
+*/
 whio_size_t whio_dev_readat( whio_dev * dev, whio_size_t pos, void * data, whio_size_t n );
 
+/**
+   Reads into the count segments of iov, in order, from the current
+   position of dev. Uses dev->api->readv if it is set, otherwise it
+   calls dev->api->read() once per segment, stopping at the first
+   short read. Returns the total number of bytes read.
+*/
+whio_size_t whio_dev_readv( whio_dev * dev, whio_iovec const * iov, whio_size_t count );
+
+/**
+   The write counterpart of whio_dev_readv(), using dev->api->writev
+   if it is set.
+*/
+whio_size_t whio_dev_writev( whio_dev * dev, whio_iovec const * iov, whio_size_t count );
+
+/**
+   Reads into the count segments of iov, in order, starting at
+   position pos of dev. If dev->api->readvat is set, the result of
+   calling it is returned. Otherwise, if dev has readat() but not
+   readv(), readat() is called once per segment, else dev is
+   positioned to pos and then whio_dev_readv() is called. Returns
+   whio_rc.SizeTError if that seek fails, else the total number of
+   bytes read.
+
+   The cursor position of dev after this call is unspecified.
+*/
+whio_size_t whio_dev_readvat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
+
+/**
+   The write counterpart of whio_dev_readvat(), using
+   dev->api->writevat if it is set.
+*/
+whio_size_t whio_dev_writevat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
+
 /**
    Copies all of src, from the beginning to EOF, to dest, starting
    at dest's current position. Returns whio_rc.OK on success.
@@ -131,6 +131,192 @@ whio_dev * whio_dev_for_filename( char const * fname, char const * mode );
 */
 whio_dev * whio_dev_for_fileno( int filedescriptor, char const * mode );
 
+enum {
+/**
+   The alignment, in bytes, which the direct-i/o device
+   (whio_dev_for_filename_direct()) uses for file offsets, transfer
+   lengths and memory buffers. This covers both 512-byte and
+   4k-sector devices.
+*/
+whio_dev_direct_alignment = 4096,
+/**
+   The size of the direct-i/o device's internal bounce buffer. Must be
+   a multiple of whio_dev_direct_alignment.
+*/
+whio_dev_direct_buffer_size = 1024 * 64
+};
+
+/**
+   Creates a whio_dev which does unbuffered i/o on the given file,
+   bypassing the OS page cache. This is intended for large container
+   files whose caching is managed by the client (e.g. whefs' own
+   caches), to avoid holding the same data in memory twice.
+
+   The mode argument is interpreted like fopen()'s "r", "r+", "w",
+   "w+", "a" and "a+" modes, with the exception that "a" modes only
+   start the cursor at the end of the file - writes may still be
+   positioned anywhere.
+
+   On Linux the file is opened with O_DIRECT, and on Mac OS X
+   F_NOCACHE is set on it. If the platform or filesystem does not
+   support that (e.g. tmpfs rejects O_DIRECT), the file is opened
+   normally and the device still works, but goes through the page
+   cache. whio_dev_is_direct() reports which case applies.
+
+   Alignment is handled internally: requests whose file position,
+   length and memory address are multiples of
+   whio_dev_direct_alignment are passed straight to the OS, and all
+   others go through an aligned bounce buffer. Unaligned writes
+   require reading back the partially-overwritten units, so clients
+   should prefer aligned, multi-kilobyte requests (e.g. by creating
+   EFSes with whefs_fs_options::data_alignment set).
+
+   A write which ends mid-unit is padded with zeroes to the end of
+   that unit, so the file may be physically longer than the device
+   reports until the next flush(), truncate() or close() trims it
+   back. Other users of the same file (e.g. via
+   whio_dev_ioctl_FILE_fd) may see that padding in the meantime.
+
+   The device supports the readat()/writeat() members and the
+   whio_dev_ioctl_FILE_fd, whio_dev_ioctl_GENERAL_name and
+   whio_dev_ioctl_FCNTL_xxx ioctls. The fname string is not copied
+   and must outlive the device if whio_dev_ioctl_GENERAL_name is
+   used.
+
+   Returns 0 on error.
+*/
+whio_dev * whio_dev_for_filename_direct( char const * fname, char const * mode );
+
+/**
+   Returns true if dev was created by whio_dev_for_filename_direct()
+   and it could enable unbuffered i/o for the file.
+*/
+bool whio_dev_is_direct( whio_dev * dev );
+
+enum {
+/**
+   The io_uring queue depth whio_dev_for_filename_uring() uses when
+   passed a depth of 0.
+*/
+whio_dev_uring_default_depth = 64
+};
+
+/**
+   Creates a whio_dev which does its file i/o through a Linux
+   io_uring instance with (at least) the given queue depth (0 means
+   whio_dev_uring_default_depth). The mode argument is interpreted as
+   for whio_dev_for_filename_direct().
+
+   All whio_dev_api members work as for a whio_dev_for_filename()
+   device, so the result can be used anywhere a whio_dev can, but the
+   device's real purpose is the asynchronous API:
+   whio_dev_uring_queue_read() and whio_dev_uring_queue_write() queue
+   positional requests, whio_dev_uring_submit() hands every queued
+   request to the kernel in one system call, and
+   whio_dev_uring_poll()/whio_dev_uring_wait() reap their completions
+   in batches.
+
+   Synchronous and asynchronous requests may be mixed. Note that the
+   kernel does not order requests relative to each other, so clients
+   must not queue overlapping writes, or reads of regions with writes
+   still in flight. flush() waits for all requests in flight before
+   syncing the file, and close() waits for them (and discards their
+   completions).
+
+   The device supports the whio_dev_ioctl_FILE_fd,
+   whio_dev_ioctl_GENERAL_name and whio_dev_ioctl_FCNTL_xxx ioctls.
+   The fname string is not copied and must outlive the device if
+   whio_dev_ioctl_GENERAL_name is used.
+
+   Returns 0 on error, including when the kernel does not support
+   io_uring (or it is disabled by policy) or the library was built
+   without WHIO_CONFIG_ENABLE_URING.
+*/
+whio_dev * whio_dev_for_filename_uring( char const * fname, char const * mode, unsigned int depth );
+
+/**
+   Returns true if io_uring instances can be created in this process,
+   i.e. if whio_dev_for_filename_uring() can succeed.
+*/
+bool whio_dev_uring_is_available();
+
+/**
+   Returns true if dev was created by whio_dev_for_filename_uring(),
+   i.e. if it supports the whio_dev_uring_xxx() API.
+*/
+bool whio_dev_is_uring( whio_dev * dev );
+
+/**
+   Describes the completion of a request queued via
+   whio_dev_uring_queue_read() or whio_dev_uring_queue_write().
+*/
+struct whio_dev_uring_completion
+{
+    /** The tag passed to the queue function. */
+    void * tag;
+    /**
+       The number of bytes read or written. May be less than requested
+       (e.g. for reads at EOF).
+    */
+    whio_size_t bytes;
+    /** 0 on success, else an errno value. */
+    int err;
+};
+typedef struct whio_dev_uring_completion whio_dev_uring_completion;
+
+/**
+   Queues a read of n bytes at the given device position into
+   dest. The request is not passed to the kernel until
+   whio_dev_uring_submit(), whio_dev_uring_poll() or
+   whio_dev_uring_wait() is called, or a synchronous operation is
+   performed on dev. dest must stay valid until the request's
+   completion has been reaped. tag is an opaque value for the client,
+   reported back in the request's whio_dev_uring_completion.
+
+   If more requests are queued than the ring can hold, this function
+   submits them and, if needed, waits for some completions, which are
+   kept until the client reaps them.
+
+   Returns whio_rc.OK on success, whio_rc.ArgError if dev is not an
+   io_uring device or dest is null or n is 0, whio_rc.AllocError if
+   memory for the request's completion could not be reserved, or
+   whio_rc.IOError if the request could not be queued.
+*/
+int whio_dev_uring_queue_read( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n, void * tag );
+
+/**
+   The write counterpart of whio_dev_uring_queue_read(). src must
+   stay valid until the request's completion has been reaped. Returns
+   whio_rc.AccessError if dev is read-only.
+*/
+int whio_dev_uring_queue_write( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n, void * tag );
+
+/**
+   Passes all queued requests to the kernel without waiting for them.
+   Returns whio_rc.OK on success.
+*/
+int whio_dev_uring_submit( whio_dev * dev );
+
+/**
+   Submits any queued requests, then copies up to max already-available
+   completions into dest, oldest first, without blocking. Returns the
+   number of completions copied.
+*/
+whio_size_t whio_dev_uring_poll( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max );
+
+/**
+   Like whio_dev_uring_poll(), but blocks until at least min
+   completions (capped at max and at the number of requests pending)
+   are available.
+*/
+whio_size_t whio_dev_uring_wait( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max, whio_size_t min );
+
+/**
+   Returns the number of queued requests whose completions have not
+   yet been reaped by the client.
+*/
+whio_size_t whio_dev_uring_pending( whio_dev * dev );
+
 
 /**
    Creates a new whio_dev object which wraps an in-memory buffer. The
@@ -118,6 +118,25 @@ struct whio_stream_api
        or otherwise invalid.
     */
     short (*iomode)( struct whio_stream * dev );
+
+    /**
+       Scatter-read: reads into each of the count segments of iov, in
+       order, and returns the total number of bytes read. A return
+       value smaller than the sum of the segment lengths means EOF or
+       an error was encountered.
+
+       This member is optional and may be 0. Clients should call
+       whio_stream_readv() instead of this function, as that routine
+       falls back to one read() per segment when this member is 0.
+    */
+    whio_size_t (*readv)( struct whio_stream * self, whio_iovec const * iov, whio_size_t count );
+
+    /**
+       Gather-write: the write() counterpart of readv(), with the same
+       conventions. May be 0. Clients should call whio_stream_writev()
+       instead of this function.
+    */
+    whio_size_t (*writev)( struct whio_stream * self, whio_iovec const * iov, whio_size_t count );
 };
 
 typedef struct whio_stream_api whio_stream_api;
@@ -220,6 +239,18 @@ whio_size_t whio_stream_writefv(whio_stream * stream, char const * fmt, va_list
 */
 whio_size_t whio_stream_writef( whio_stream * stream, char const * fmt, ... );
 
+/**
+   Equivalent to whio_dev_readv() except that it takes a whio_stream
+   object instead of a whio_dev.
+*/
+whio_size_t whio_stream_readv( whio_stream * stream, whio_iovec const * iov, whio_size_t count );
+
+/**
+   Equivalent to whio_dev_writev() except that it takes a whio_stream
+   object instead of a whio_dev.
+*/
+whio_size_t whio_stream_writev( whio_stream * stream, whio_iovec const * iov, whio_size_t count );
+
 /**
    Convenience function to read the next character from a whio_stream. If tgt
    is not 0 then it is assigned to the value of the character.
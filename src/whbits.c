@@ -2,6 +2,7 @@
 #include <stddef.h> /* size_t on my box */
 #include <string.h> /* memset() */
 #include <stdlib.h> /* malloc()/free() */
+#include <stdint.h> /* uint64_t */
 
 const whbits whbits_init_obj = WHBITS_INIT;
 
@@ -94,3 +95,105 @@ char whbits_get( whbits const * b, whbits_count_t bitNum )
     if( ! b || (bitNum  > b->sz_bits) ) return 0;
     return WHBITS_GET(b,bitNum);
 }
+
+/**
+   If WHBITS_CONFIG_BUILTIN_CTZ is true then __builtin_ctzll() is used
+   to find the lowest set bit of a word, else a portable routine is.
+   It defaults to true for gcc-compatible compilers. Define it to 0
+   to build (and test) the portable routine there.
+*/
+#if !defined(WHBITS_CONFIG_BUILTIN_CTZ)
+#  if defined(__GNUC__)
+#    define WHBITS_CONFIG_BUILTIN_CTZ 1
+#  else
+#    define WHBITS_CONFIG_BUILTIN_CTZ 0
+#  endif
+#endif
+
+#if WHBITS_CONFIG_BUILTIN_CTZ
+#  define WHBITS_CTZ64(X) ((whbits_count_t)__builtin_ctzll(X))
+#else
+/** Portable count-trailing-zeroes. x must not be 0. */
+static whbits_count_t whbits_ctz64( uint64_t x )
+{
+    whbits_count_t n = 0;
+    if( !(x & 0xFFFFFFFFU) ) { x >>= 32; n += 32; }
+    if( !(x & 0xFFFFU) ) { x >>= 16; n += 16; }
+    if( !(x & 0xFFU) ) { x >>= 8; n += 8; }
+    while( !(x & 0x01) ) { x >>= 1; ++n; }
+    return n;
+}
+#  define WHBITS_CTZ64(X) whbits_ctz64(X)
+#endif
+
+/**
+   Assembles 8 bytes of a bitset into a word such that bit N of the
+   word is bit N of the bitset (relative to src). Compilers turn this
+   into a single load on little-endian machines, and it is correct on
+   big-endian ones.
+*/
+static uint64_t whbits_load64( unsigned char const * src )
+{
+    return ((uint64_t)src[0])
+        | ((uint64_t)src[1] << 8)
+        | ((uint64_t)src[2] << 16)
+        | ((uint64_t)src[3] << 24)
+        | ((uint64_t)src[4] << 32)
+        | ((uint64_t)src[5] << 40)
+        | ((uint64_t)src[6] << 48)
+        | ((uint64_t)src[7] << 56);
+}
+
+/**
+   Internal impl of whbits_find_unset() and whbits_find_set(). Returns
+   the index of the first bit in [start,end) whose value is val (0 or
+   1), or end if there is none.
+*/
+static whbits_count_t whbits_find( whbits const * b, whbits_count_t start,
+                                   whbits_count_t end, unsigned char val )
+{
+    /* We search for set bits in (bits XOR flip). */
+    const unsigned char flip8 = val ? 0x00 : 0xFF;
+    const uint64_t flip64 = val ? (uint64_t)0 : ~(uint64_t)0;
+    whbits_count_t i = start;
+    if( ! b || !b->bytes ) return start;
+    if( end > b->sz_bits ) end = b->sz_bits;
+    /* Bit-wise up to the next byte boundary... */
+    for( ; (i < end) && (i % 8); ++i )
+    {
+        if( val == WHBITS_GET(b,i) ) return i;
+    }
+    /* ... byte-wise up to the next 64-bit boundary... */
+    for( ; ((i + 8) <= end) && (i % 64); i += 8 )
+    {
+        if( flip8 != b->bytes[i/8] ) break;
+    }
+    /* ... then a word at a time... */
+    if( !(i % 64) )
+    {
+        for( ; (i + 64) <= end; i += 64 )
+        {
+            const uint64_t w = whbits_load64( b->bytes + (i/8) ) ^ flip64;
+            if( w ) return i + WHBITS_CTZ64(w);
+        }
+        for( ; ((i + 8) <= end) && (flip8 == b->bytes[i/8]); i += 8 )
+        {
+        }
+    }
+    /* ... and whatever is left. */
+    for( ; i < end; ++i )
+    {
+        if( val == WHBITS_GET(b,i) ) return i;
+    }
+    return end;
+}
+
+whbits_count_t whbits_find_unset( whbits const * b, whbits_count_t start, whbits_count_t end )
+{
+    return whbits_find( b, start, end, 0 );
+}
+
+whbits_count_t whbits_find_set( whbits const * b, whbits_count_t start, whbits_count_t end )
+{
+    return whbits_find( b, start, end, 1 );
+}
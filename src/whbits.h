@@ -81,6 +81,23 @@ char whbits_unset( whbits * b, whbits_count_t bitNum );
 */
 char whbits_get( whbits const * b, whbits_count_t bitNum );
 
+/**
+   Searches b for the first unset bit in the range [start,end). Bits
+   are examined a 64-bit word at a time where possible, so long runs
+   of set bits are skipped quickly.
+
+   end is clamped to b->sz_bits. Returns the index of the first unset
+   bit, or end (after clamping) if every bit in the range is set or
+   the range is empty. If !b or b has no bytes, start is returned.
+*/
+whbits_count_t whbits_find_unset( whbits const * b, whbits_count_t start, whbits_count_t end );
+
+/**
+   The counterpart of whbits_find_unset(), searching for the first set
+   bit in the range [start,end).
+*/
+whbits_count_t whbits_find_set( whbits const * b, whbits_count_t start, whbits_count_t end );
+
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -36,13 +36,15 @@ void whefs_block_update_used( whefs_fs * fs, whefs_block const * bl )
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
     /*if( ! whefs_block_id_is_valid( fs, bl ? bl->id : 0) ) return; // this is relatively costly here */
     if( ! fs->bits.b_loaded ) return;
+    /* When the free-space map is loaded it owns fs->bits.b, and
+       whefs_block_flush() updates it via whefs_fs_freemap_mark(). */
     if( bl->flags & WHEFS_FLAG_Used )
     {
-	WHEFS_BCACHE_SET_USED(fs,bl->id);
+	if( ! fs->freemap.loaded ) WHEFS_BCACHE_SET_USED(fs,bl->id);
     }
     else
     {
-	WHEFS_BCACHE_UNSET_USED(fs,bl->id);
+	if( ! fs->freemap.loaded ) WHEFS_BCACHE_UNSET_USED(fs,bl->id);
 	if( fs->hints.unused_block_start > bl->id )
 	{
 	    fs->hints.unused_block_start = bl->id;
@@ -53,8 +55,10 @@ void whefs_block_update_used( whefs_fs * fs, whefs_block const * bl )
 
 whio_size_t whefs_fs_sizeof_block( whefs_fs_options const * opt )
 {
+    /* With data_alignment, the header is padded so that the next
+       block's data also lands on an aligned offset. */
     return opt
-	? (opt->block_size + whefs_sizeof_encoded_block)
+	? WHEFS_OPT_ALIGN(opt, (opt->block_size + whefs_sizeof_encoded_block))
 	: 0;
 }
 
@@ -63,8 +67,8 @@ static whio_size_t whefs_block_id_data_pos( whefs_fs const * fs, whefs_id_type i
 {
     whio_size_t rc = whefs_block_id_pos( fs, id );
     if( rc )
-    {
-	rc += whefs_sizeof_encoded_block;
+    { /* skip the (possibly padded) header */
+	rc += fs->sizes[WHEFS_SZ_BLOCK] - fs->options.block_size;
     }
     return rc;
 }
@@ -108,18 +112,35 @@ int whefs_block_seek_data( whefs_fs const * fs, whefs_block const * bl, whio_siz
 */
 static const unsigned char whefs_block_tag_char = 'B';
 
+int whefs_block_encode( whefs_block const * bl, unsigned char * dest )
+{
+    whio_size_t off = 1;
+    if( ! bl || !dest ) return whefs_rc.ArgError;
+    memset( dest, 0, whefs_sizeof_encoded_block );
+    dest[0] = whefs_block_tag_char;
+    off += whefs_id_encode( dest + off, bl->id );
+    off += whio_encode_uint8( dest + off, bl->flags );
+    whefs_id_encode( dest + off, bl->next_block );
+    return whefs_rc.OK;
+}
+
 int whefs_block_flush( whefs_fs * fs, whefs_block const * bl )
 {
     int rc = whefs_rc.OK;
+    whio_size_t pos;
     /*if( ! whefs_block_id_is_valid(fs,bl ? bl->id : 0) ) return whefs_rc.ArgError; */
     if( ! whefs_fs_is_rw(fs) ) return whefs_rc.AccessError;
-    rc = whefs_block_id_seek( fs, bl->id );
-    if( whefs_rc.OK != rc )
+    pos = whefs_block_id_pos( fs, bl->id );
+    if( ! pos )
     {
-        WHEFS_DBG_ERR("FAILED setting correct write position for block #%"WHEFS_ID_TYPE_PFMT"! rc=%d", bl->id, rc );
-        return rc;
+        WHEFS_DBG_ERR("Invalid block #%"WHEFS_ID_TYPE_PFMT"!", bl->id );
+        return whefs_rc.ArgError;
+    }
+    if( bl->flags & WHEFS_FLAG_Used )
+    { /* Mark it used in the free-space map before the header says so. */
+	rc = whefs_fs_freemap_mark( fs, bl->id, true );
+	if( whefs_rc.OK != rc ) return rc;
     }
-
     {
 #if 0
         whio_size_t check = 0;
@@ -134,15 +155,10 @@ int whefs_block_flush( whefs_fs * fs, whefs_block const * bl )
         check = whefs_dev_id_encode( fs->dev, bl->next_block );
         if( whefs_sizeof_encoded_id_type != check ) return whefs_rc.IOError;
 #else
-        unsigned char buf[whefs_sizeof_encoded_block] = {0};
-        whio_size_t off = 1;
+        unsigned char buf[whefs_sizeof_encoded_block];
         whio_size_t wsz;
-        /* TODO: use whefs_encode_xxx() here */
-        buf[0] = whefs_block_tag_char;
-        off += whefs_id_encode( buf + off, bl->id );
-        off += whio_encode_uint8( buf + off, bl->flags );
-        whefs_id_encode( buf + off, bl->next_block );
-        wsz = fs->dev->api->write( fs->dev, buf, whefs_sizeof_encoded_block );
+        whefs_block_encode( bl, buf );
+        wsz = whefs_fs_writeat( fs, pos, buf, whefs_sizeof_encoded_block );
         if( whefs_sizeof_encoded_block != wsz )
         {
             WHEFS_DBG_ERR("FAILED flushing block info to disk for block #%"WHEFS_ID_TYPE_PFMT". wsz=%"WHIO_SIZE_T_PFMT, bl->id, wsz );
@@ -150,6 +166,11 @@ int whefs_block_flush( whefs_fs * fs, whefs_block const * bl )
         }
 #endif
     }
+    if( ! (bl->flags & WHEFS_FLAG_Used) )
+    { /* ... and free only after the header says so. */
+	rc = whefs_fs_freemap_mark( fs, bl->id, false );
+	if( whefs_rc.OK != rc ) return rc;
+    }
     whefs_block_update_used( fs, bl );
     /*WHEFS_DBG("block_write for block #%u returning %d", bl->id, rc ); */
     return rc;
@@ -196,7 +217,7 @@ int whefs_block_read( whefs_fs * fs, whefs_id_type bid, whefs_block * bl )
 	return whefs_rc.ArgError;
     }
     to = whefs_block_id_pos( fs, bid );
-    if( (whefs_rc.SizeTError == fs->dev->api->seek( fs->dev, to, SEEK_SET )) )
+    if( ! to )
     {
         return whefs_rc.IOError;
     }
@@ -220,7 +241,7 @@ int whefs_block_read( whefs_fs * fs, whefs_id_type bid, whefs_block * bl )
         unsigned char buf[whefs_sizeof_encoded_block];
         whio_size_t iorc;
         memset( buf, 0, whefs_sizeof_encoded_block );
-        iorc = fs->dev->api->read( fs->dev, buf, whefs_sizeof_encoded_block );
+        iorc = whefs_fs_readat( fs, to, buf, whefs_sizeof_encoded_block );
         if( iorc != whefs_sizeof_encoded_block )
         {
             WHEFS_DBG_ERR("read() error while reading block #%"WHEFS_ID_TYPE_PFMT". "
@@ -249,10 +270,6 @@ int whefs_block_wipe_data( whefs_fs * fs, whefs_block const * bl, whio_size_t st
     whio_size_t count;
     if( startPos >= bs ) return whefs_rc.RangeError;
     seekPos = startPos + whefs_block_data_pos(fs, bl);
-    if( whefs_fs_seek( fs, (off_t)seekPos, SEEK_SET ) != seekPos )
-    {
-        return whio_rc.IOError;
-    }
     count = bs - startPos;
     {
 	enum { bufSize = 1024 * 4 };
@@ -268,7 +285,7 @@ int whefs_block_wipe_data( whefs_fs * fs, whefs_block const * bl, whio_size_t st
 	{
 	    const size_t x = count - total;
             const size_t wsz = (bufSize > x) ? x : bufSize;
-	    wrc = whefs_fs_write( fs, buf, wsz);
+	    wrc = whefs_fs_writeat( fs, seekPos + total, buf, wsz);
 	    if( ! wrc ) break;
             if( wsz != wrc ) return whefs_rc.IOError;
 	    total += wrc;
@@ -370,11 +387,15 @@ int whefs_block_next_free( whefs_fs * fs, whefs_block * tgt, bool markUsed )
     for( ; i <= fs->options.block_count; ++i )
     {
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
-        /* TODO(?): i think we could skip 8 entries at a time as long as (0xFF & fs->bits.b.bytes[i*8]) */
-	if( fs->bits.b_loaded && WHEFS_BCACHE_IS_USED(fs,i) )
-	{
-	    /*WHEFS_DBG("Got cached block USED entry for block #%u", i ); */
-	    continue;
+	if( fs->bits.b_loaded )
+	{ /* Jump straight to the next block the cache doesn't mark as used,
+	     skipping regions the free-space map says are full. */
+	    whbits_count_t x;
+	    i = whefs_fs_freemap_next_candidate( fs, i );
+	    if( i > fs->options.block_count ) break;
+	    x = whbits_find_unset( &fs->bits.b, i, (whbits_count_t)fs->options.block_count + 1 );
+	    if( x > fs->options.block_count ) break;
+	    i = (whefs_id_type)x;
 	}
 	/*WHEFS_DBG("Cache says block #%i is unused. markUsed=%d", i, markUsed ); */
 #endif
@@ -412,3 +433,135 @@ int whefs_block_next_free( whefs_fs * fs, whefs_block * tgt, bool markUsed )
     return whefs_rc.FSFull;
 }
 
+
+/**
+   Counts the free blocks in the contiguous run starting at block
+   #start, stopping after max blocks, at the first used block, or at
+   the end of the EFS. On success *len is set to the run length (0 if
+   start itself is not free) and whefs_rc.OK is returned.
+
+   If the used-blocks cache is loaded, it is kept in sync by every
+   whefs_block_flush() and is authoritative for this process, so the
+   run is measured from the cache without any i/o. Otherwise each
+   block's on-disk metadata is read.
+*/
+static int whefs_block_run_length( whefs_fs * fs, whefs_id_type start,
+                                   whefs_id_type max, whefs_id_type * len )
+{
+    whefs_block bl = whefs_block_empty;
+    whefs_id_type i = start;
+    whefs_id_type n = 0;
+    int rc;
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+    if( fs->bits.b_loaded )
+    {
+	whbits_count_t end = (whbits_count_t)start + max;
+	if( end > ((whbits_count_t)fs->options.block_count + 1) )
+	{
+	    end = (whbits_count_t)fs->options.block_count + 1;
+	}
+	*len = (whefs_id_type)(whbits_find_set( &fs->bits.b, start, end ) - start);
+	return whefs_rc.OK;
+    }
+#endif
+    for( ; (n < max) && (i <= fs->options.block_count); ++i, ++n )
+    {
+	rc = whefs_block_read( fs, i, &bl );
+	if( whefs_rc.OK != rc ) return rc;
+	if( WHEFS_FLAG_Used & bl.flags ) break;
+    }
+    *len = n;
+    return whefs_rc.OK;
+}
+
+int whefs_block_next_free_run( whefs_fs * fs, whefs_id_type near, whefs_id_type want,
+                               whefs_id_type * first, whefs_id_type * count, bool flush )
+{
+    whefs_block bl = whefs_block_empty;
+    whefs_id_type minRun, i, len, k;
+    whefs_id_type bestStart = 0;
+    whefs_id_type bestLen = 0;
+    whefs_id_type firstFree = 0;
+    int rc;
+    if( ! fs || !first || !count || !want ) return whefs_rc.ArgError;
+    minRun = fs->alloc.extent_min ? fs->alloc.extent_min : 1;
+    if( minRun > want ) minRun = want;
+    if( whefs_block_id_is_valid( fs, near ) )
+    { /* Try to extend the caller's current extent in place. */
+	rc = whefs_block_run_length( fs, near, want, &len );
+	if( whefs_rc.OK != rc ) return rc;
+	if( len )
+	{
+	    bestStart = near;
+	    bestLen = len;
+	}
+    }
+    if( ! bestLen )
+    {
+	i = fs->hints.unused_block_start;
+	if( ! i ) i = 1;
+	while( i <= fs->options.block_count )
+	{
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+	    if( fs->bits.b_loaded )
+	    {
+		whbits_count_t x;
+		i = whefs_fs_freemap_next_candidate( fs, i );
+		if( i > fs->options.block_count ) break;
+		x = whbits_find_unset( &fs->bits.b, i, (whbits_count_t)fs->options.block_count + 1 );
+		if( x > fs->options.block_count ) break;
+		i = (whefs_id_type)x;
+	    }
+#endif
+	    rc = whefs_block_run_length( fs, i, want, &len );
+	    if( whefs_rc.OK != rc ) return rc;
+	    if( ! len )
+	    {
+		++i;
+		continue;
+	    }
+	    if( ! firstFree ) firstFree = i;
+	    if( len > bestLen )
+	    {
+		bestStart = i;
+		bestLen = len;
+	    }
+	    if( len >= minRun ) break;
+	    /* Block (i+len) is known to be used, so skip over it as well. */
+	    i += len + 1;
+	}
+    }
+    if( ! bestLen )
+    {
+	WHEFS_DBG_ERR("VFS appears to be full :(");
+	return whefs_rc.FSFull;
+    }
+    /* Mark the whole run in the free-space map at once, so that the
+       flushes below (or the caller's) don't have to do it block by
+       block. */
+    rc = whefs_fs_freemap_mark_range( fs, bestStart, bestLen, true );
+    if( whefs_rc.OK != rc ) return rc;
+    for( k = 0; flush && (k < bestLen); ++k )
+    {
+	bl.id = bestStart + k;
+	bl.flags = WHEFS_FLAG_Used;
+	bl.next_block = ((k+1) < bestLen) ? (bl.id + 1) : 0;
+	rc = whefs_block_flush( fs, &bl );
+	if( whefs_rc.OK != rc ) return rc;
+    }
+    if( firstFree )
+    { /* Everything between the old hint and firstFree is used. If we
+	 skipped a short gap, leave it for the next search. */
+	fs->hints.unused_block_start = (firstFree == bestStart)
+	    ? (bestStart + bestLen)
+	    : firstFree;
+    }
+    else if( (fs->hints.unused_block_start >= bestStart)
+	     && (fs->hints.unused_block_start < (bestStart + bestLen)) )
+    {
+	fs->hints.unused_block_start = bestStart + bestLen;
+    }
+    *first = bestStart;
+    *count = bestLen;
+    return whefs_rc.OK;
+}
@@ -21,25 +21,11 @@ int whefs_inode_hash_cache_load( whefs_fs * fs )
     whefs_id_type i;
     whefs_id_type count = 0;
     if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ) return whefs_rc.OK;
-    if( ! fs->cache.hashes )
-    {
-        whefs_id_type toAlloc = 16 /* arbitrary */;
-        if( toAlloc > fs->options.inode_count ) toAlloc = fs->options.inode_count;
-        whefs_hashid_list_alloc( &fs->cache.hashes, toAlloc );
-    }
-    if( ! fs->cache.hashes ) return whefs_rc.AllocError;
-    else if( !fs->cache.hashes->maxAlloc )
-    {
-        fs->cache.hashes->maxAlloc = fs->options.inode_count;
-    }
-
-    /*whefs_hashid h = whefs_hashid_empty; */
     memset( buf, 0, bufSize );
     /* ensure that whefs_inode_name_get() won't malloc(): */
     name.string = (char *)buf;
     name.alloced = bufSize;
     name.length = 0;
-    fs->cache.hashes->skipAutoSort = true; /* optimization to avoid extra sorting via whefs_inode_name_get() */
     for( i = fs->options.inode_count; i >=1 ; --i )
     {
         /**
@@ -67,131 +53,183 @@ int whefs_inode_hash_cache_load( whefs_fs * fs )
         if( whefs_rc.OK != rc ) break;
         ++count;
     }
-    fs->cache.hashes->skipAutoSort = false;
-    whefs_hashid_list_sort(fs->cache.hashes);
+    if( whefs_rc.OK == rc ) fs->cache.complete = true;
     WHEFS_DBG_CACHE("Loaded all used inodes into cache with %"WHEFS_ID_TYPE_PFMT" name(s).",count);
     return rc;
 }
 int whefs_inode_hash_cache_chomp_lv( whefs_fs * fs )
 {
+    int rc;
     if( ! fs ) return whefs_rc.ArgError;
-    if( ! fs->cache.hashes || !fs->cache.hashes->count ) return whefs_rc.OK;
-    return whefs_hashid_list_chomp_lv( fs->cache.hashes );
+    WHEFS_FS_WRLOCK(fs);
+    fs->cache.complete = false;
+    rc = whefs_hashid_table_chomp_lv( &fs->cache.hashes );
+    WHEFS_FS_UNLOCK(fs);
+    return rc;
 }
 
-whefs_id_type whefs_inode_hash_cache_search_ndx(whefs_fs * fs, char const * name )
+whefs_id_type whefs_inode_hash_cache_search_id(whefs_fs * fs, char const * name )
 {
-    if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ) return whefs_rc.IDTypeEnd;
-    if( fs->cache.hashes && !fs->cache.hashes->isSorted )
-    {
-        WHEFS_DBG_CACHE("Achtung: auto-sorting dirty name cache before search starts.");
-        whefs_inode_hash_cache_sort(fs);
-    }
-#if 0
-    return ( ! fs->cache.hashes )
-        ? whefs_rc.IDTypeEnd
-        : whefs_hashid_list_index_of( fs->cache.hashes, fs->cache.hashfunc(name) );
-#else
-    if( ! fs->cache.hashes )
-    {
-        WHEFS_DBG_CACHE("Cache check failed (cache is empty) for name [%s].",name);
-        return whefs_rc.IDTypeEnd;
-    }
-    else
-    {
-        whefs_id_type const rc = whefs_hashid_list_index_of( fs->cache.hashes, fs->cache.hashfunc(name) );
-        WHEFS_DBG_CACHE("Cache %s for name [%s].",((rc==whefs_rc.IDTypeEnd) ? "miss" : "hit"), name);
-        return rc;
-    }
-#endif    
+    whefs_id_type id;
+    uint32_t cursor = 0;
+    if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) || !name ) return 0;
+    id = whefs_hashid_table_search( &fs->cache.hashes, fs->cache.hashfunc(name), &cursor );
+    WHEFS_DBG_CACHE("Cache %s for name [%s].",(id ? "hit" : "miss"), name);
+    return id;
 }
 
-whefs_id_type whefs_inode_hash_cache_search_id(whefs_fs * fs, char const * name )
+void whefs_inode_name_uncache(whefs_fs * fs, whefs_id_type id, char const * name )
 {
-    if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ) return 0;
-    if( ! fs->cache.hashes ) return 0;
-    else
+    if( !fs || ! name || !*name  ) return;
+    whefs_hashid_table_remove( &fs->cache.hashes, fs->cache.hashfunc(name), id );
+}
+
+int whefs_inode_hash_cache( whefs_fs * fs, whefs_id_type id, char const * name )
+{
+    int rc;
+    whefs_hashval_type h;
+    if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) )
     {
-        whefs_id_type n = whefs_inode_hash_cache_search_ndx( fs, name );
-        WHEFS_DBG_CACHE("Cache %s for name [%s].",((n==whefs_rc.IDTypeEnd) ? "miss" : "hit"), name);
-        return ( n == whefs_rc.IDTypeEnd )
-            ? 0
-            : fs->cache.hashes->list[n].id;
+        return whefs_rc.OK;
     }
+    if( ! fs || !name || !*name ) return whefs_rc.ArgError;
+    h = fs->cache.hashfunc( name );
+    rc = whefs_hashid_table_insert( &fs->cache.hashes, h, id );
+    if( whefs_rc.OK != rc ) fs->cache.complete = false;
+    WHEFS_DBG_CACHE("Added to name cache: hash[%"WHEFS_HASHVAL_TYPE_PFMT"]=id[%"WHEFS_ID_TYPE_PFMT"], name=[%s], rc=%d", h, id, name, rc );
+    return rc;
 }
 
+const whefs_name_filter_stats whefs_name_filter_stats_empty = whefs_name_filter_stats_empty_m;
 
+enum {
+/** Number of counters each name sets in the name filter. */
+whefs_name_filter_probes = 4,
+/** Minimum number of filter counters per inode. */
+whefs_name_filter_ratio = 8
+};
 
-void whefs_inode_hash_cache_sort(whefs_fs * fs )
+/**
+   Calculates the positions of name's counters in a filter with the
+   given number of counters (a power of 2) and stores them in pos.
+   The positions come from double hashing a single whefs_hash_cstring()
+   value, whatever hash function the hash cache uses.
+*/
+static void whefs_name_filter_positions( char const * name, uint32_t size, uint32_t * pos )
 {
-    if( fs->cache.hashes && ! fs->cache.hashes->isSorted )
+    uint32_t h1 = (uint32_t)whefs_hash_cstring( name );
+    uint32_t h2 = h1;
+    int i;
+    h1 ^= h1 >> 16;
+    h1 *= 0x45d9f3bU;
+    h1 ^= h1 >> 16;
+    h2 = ((h2 >> 15) | (h2 << 17)) * 0x27d4eb2dU;
+    h2 |= 1; /* odd, so that the probes differ for any power-of-2 size */
+    for( i = 0; i < whefs_name_filter_probes; ++i )
     {
-        whefs_hashid_list_sort( fs->cache.hashes );
+        pos[i] = (h1 + (i * h2)) & (size - 1);
     }
 }
 
+void whefs_name_filter_clear( whefs_fs * fs )
+{
+    if( ! fs ) return;
+    free( fs->cache.filter.counts );
+    fs->cache.filter.counts = 0;
+    fs->cache.filter.size = 0;
+    fs->cache.filter.loaded = false;
+}
 
-void whefs_inode_name_uncache(whefs_fs * fs, char const * name )
+int whefs_name_filter_reset( whefs_fs * fs )
 {
-    if( !fs->cache.hashes || ! name || !*name  ) return;
-    else {
-        const whefs_id_type ndx = whefs_inode_hash_cache_search_ndx( fs, name );
-        if( whefs_rc.IDTypeEnd != ndx )
-        {
-            fs->cache.hashes->list[ndx] = whefs_hashid_empty;
-            fs->cache.hashes->isSorted = false;
-        }
+    uint32_t size = 64;
+    if( ! fs ) return whefs_rc.ArgError;
+    while( size < ((uint32_t)fs->options.inode_count * whefs_name_filter_ratio) ) size *= 2;
+    if( size != fs->cache.filter.size )
+    {
+        whefs_name_filter_clear( fs );
+        fs->cache.filter.counts = (unsigned char *)malloc( size );
+        if( ! fs->cache.filter.counts ) return whefs_rc.AllocError;
+        fs->cache.filter.size = size;
     }
+    memset( fs->cache.filter.counts, 0, size );
+    fs->cache.filter.loaded = true;
+    return whefs_rc.OK;
 }
 
-int whefs_inode_hash_cache( whefs_fs * fs, whefs_id_type id, char const * name )
+int whefs_name_filter_load( whefs_fs * fs )
 {
-    int rc = whefs_rc.OK;
-    whefs_hashval_type h;
-    whefs_hashid H;
-    whefs_id_type ndx;
-    if( ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) )
+    whefs_string name = whefs_string_empty;
+    enum { bufSize = WHEFS_MAX_FILENAME_LENGTH+1 };
+    unsigned char buf[bufSize];
+    int rc;
+    whefs_id_type i;
+    if( ! fs ) return whefs_rc.ArgError;
+    rc = whefs_name_filter_reset( fs );
+    if( whefs_rc.OK != rc ) return rc;
+    memset( buf, 0, bufSize );
+    /* ensure that whefs_inode_name_get() won't malloc(): */
+    name.string = (char *)buf;
+    name.alloced = bufSize;
+    name.length = 0;
+    for( i = 2; i <= fs->options.inode_count; ++i )
     {
-        return whefs_rc.OK;
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+        if( fs->bits.i_loaded && ! WHEFS_ICACHE_IS_USED(fs,i) ) continue;
+#endif
+        rc = whefs_inode_name_get( fs, i, &name ); /* this also caches the name hash */
+        assert( (name.string == (char *)buf) && "Internal memory management foo-foo." );
+        if( whefs_rc.OK != rc ) break;
+        whefs_name_filter_add( fs, name.string );
     }
-    if( ! fs || !name || !*name ) return whefs_rc.ArgError;
-    if( ! fs->cache.hashes )
+    if( whefs_rc.OK != rc )
     {
-        const whefs_id_type max = fs->options.inode_count;
-        whefs_id_type dflt = 100/sizeof(whefs_hashid) /*for lack of a better default value.*/;
-        if( dflt > max ) dflt = max;
-        rc = whefs_hashid_list_alloc( &fs->cache.hashes, dflt );
-        if( fs->cache.hashes )
-        {
-            fs->cache.hashes->maxAlloc = max;
-        }
+        whefs_name_filter_clear( fs );
+        return rc;
     }
-    if( whefs_rc.OK != rc ) return rc;
-    h = fs->cache.hashfunc( name );
-#if 1
-    ndx = whefs_hashid_list_index_of( fs->cache.hashes, h );
-    if( whefs_rc.IDTypeEnd != ndx )
+    if( WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ) fs->cache.complete = true;
+    WHEFS_DBG_CACHE("Built name filter with %"PRIu32" counters.",fs->cache.filter.size);
+    return whefs_rc.OK;
+}
+
+void whefs_name_filter_add( whefs_fs * fs, char const * name )
+{
+    uint32_t pos[whefs_name_filter_probes];
+    unsigned char * c;
+    int i;
+    if( ! fs || ! fs->cache.filter.loaded || !name || !*name ) return;
+    whefs_name_filter_positions( name, fs->cache.filter.size, pos );
+    for( i = 0; i < whefs_name_filter_probes; ++i )
     {
-        if(0) WHEFS_DBG("CHECKING: name cache count[%"WHEFS_ID_TYPE_PFMT"], alloced=[%"WHEFS_ID_TYPE_PFMT"], hash [%"WHEFS_HASHVAL_TYPE_PFMT"] for name [%s], ndx=[%"WHEFS_ID_TYPE_PFMT"]",
-                        fs->cache.hashes->count, fs->cache.hashes->alloced, h, name, ndx );
-        if( fs->cache.hashes->list[ndx].id == id ) return whefs_rc.OK;
-        WHEFS_DBG_ERR("ERROR: name cache hash collision on hash code "
-                      "%"WHEFS_HASHVAL_TYPE_PFMT" "
-                      "between inodes #"
-                      "%"WHEFS_ID_TYPE_PFMT
-                      " and #%"WHEFS_ID_TYPE_PFMT"!",
-                      h, id, ndx );
-        return whefs_rc.InternalError;
+        c = fs->cache.filter.counts + pos[i];
+        if( *c < 0xff ) ++*c;
     }
-    WHEFS_DBG_CACHE("ADDING: name cache count[%"WHEFS_ID_TYPE_PFMT"], alloced=[%"WHEFS_ID_TYPE_PFMT"], hash [%"WHEFS_HASHVAL_TYPE_PFMT"] for name [%s]",
-                          fs->cache.hashes->count, fs->cache.hashes->alloced, h, name );
-#endif
-    H = whefs_hashid_empty;
-    H.hash = h;
-    H.id = id;
-    rc = whefs_hashid_list_add( fs->cache.hashes, &H );
-    WHEFS_DBG_CACHE("Added to name cache: hash[%"WHEFS_HASHVAL_TYPE_PFMT"]=id[%"WHEFS_ID_TYPE_PFMT"], name=[%s], rc=%d", H.hash, H.id, name, rc );
-    return whefs_rc.OK;
 }
 
+void whefs_name_filter_remove( whefs_fs * fs, char const * name )
+{
+    uint32_t pos[whefs_name_filter_probes];
+    unsigned char * c;
+    int i;
+    if( ! fs || ! fs->cache.filter.loaded || !name || !*name ) return;
+    whefs_name_filter_positions( name, fs->cache.filter.size, pos );
+    for( i = 0; i < whefs_name_filter_probes; ++i )
+    {
+        c = fs->cache.filter.counts + pos[i];
+        /* A saturated counter no longer knows how many names share it. */
+        if( *c && (*c < 0xff) ) --*c;
+    }
+}
 
+bool whefs_name_filter_test( whefs_fs const * fs, char const * name )
+{
+    uint32_t pos[whefs_name_filter_probes];
+    int i;
+    if( ! fs || ! fs->cache.filter.loaded || !name ) return true;
+    whefs_name_filter_positions( name, fs->cache.filter.size, pos );
+    for( i = 0; i < whefs_name_filter_probes; ++i )
+    {
+        if( ! fs->cache.filter.counts[pos[i]] ) return false;
+    }
+    return true;
+}
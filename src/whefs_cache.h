@@ -30,32 +30,25 @@ extern "C" {
 
    - Allocation of the cache fails: whefs_rc.AllocError
 
-   - An entry already exists for the same hash code: whefs_rc.InternalError. If
-   this ever actually happens, i'll try other hashes or build a better hashtable.
-
-
-   This routine is much faster if the cache is sorted before calling
-   this.  If you're going to add lots of items at once, do so with the
-   lower-level cache list API, then sort it, then mark is as unsorted (or sort it).
+   Several inodes may share a hash code: the cache keeps one entry
+   per (hash,id) pair, and adding an existing pair is a no-op.
 */
 int whefs_inode_hash_cache( whefs_fs * fs, whefs_id_type id, char const * name );
 
 /**
    If a cached entry is found with the same hashcode as name, the id
-   of that inode is returned, else 0.
+   of that inode is returned, else 0. Since hash codes may collide,
+   the caller must check the inode's name if it needs an exact match.
+   Use whefs_hashid_table_search() on fs->cache.hashes to visit all
+   inodes with the same hash code.
 */
 whefs_id_type whefs_inode_hash_cache_search_id(whefs_fs * fs, char const * name );
-/**
-   If a cached entry is found with the same hashcode as name, the index
-   of that entry in the cache is returned, else whefs_rc.IDTypeEnd.
-*/
-whefs_id_type whefs_inode_hash_cache_search_ndx(whefs_fs * fs, char const * name );
 
 /**
-   Searches for a cache entry with the same hash as name. If it finds
-   it, it removes it. The cache becomes unsorted by this.
+   Removes the cache entry mapping the hash of name to inode
+   id, if any.
 */
-void whefs_inode_name_uncache(whefs_fs * fs, char const * name );
+void whefs_inode_name_uncache(whefs_fs * fs, whefs_id_type id, char const * name );
 
 /**
    Iterates over all inodes and caches the name entries for all
@@ -65,10 +58,44 @@ void whefs_inode_name_uncache(whefs_fs * fs, char const * name );
 int whefs_inode_hash_cache_load( whefs_fs * fs );
 
 /**
-   Sorts the name cache, if it is loaded. It shouldn't strictly be
-   in the public API, but it may need to be.
+   Allocates (or re-zeroes) fs's name filter and marks it as loaded,
+   i.e. as describing an EFS with no named inodes. Used by mkfs and
+   whefs_name_filter_load(). Returns whefs_rc.OK or
+   whefs_rc.AllocError.
+*/
+int whefs_name_filter_reset( whefs_fs * fs );
+
+/**
+   Builds fs's name filter from the names of all used inodes. As a
+   side effect the names are also added to the hash cache (if it is
+   enabled), which is then marked as complete. On error the filter is
+   freed and not loaded.
+*/
+int whefs_name_filter_load( whefs_fs * fs );
+
+/**
+   Frees fs's name filter and marks it as not loaded. Its statistics
+   are kept.
+*/
+void whefs_name_filter_clear( whefs_fs * fs );
+
+/**
+   Adds name to fs's name filter, if it is loaded. Does nothing for
+   empty names.
+*/
+void whefs_name_filter_add( whefs_fs * fs, char const * name );
+
+/**
+   Removes name, which must have been added before, from fs's name
+   filter, if it is loaded. Does nothing for empty names.
+*/
+void whefs_name_filter_remove( whefs_fs * fs, char const * name );
+
+/**
+   Returns false if fs's name filter is loaded and says that no inode
+   has the given name, else true.
 */
-void whefs_inode_hash_cache_sort(whefs_fs * fs );
+bool whefs_name_filter_test( whefs_fs const * fs, char const * name );
 
 #ifdef __cplusplus
 } /* extern "C" */
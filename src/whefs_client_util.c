@@ -2,6 +2,7 @@
 #include <wh/whefs/whefs_client_util.h>
 #include <wh/whglob.h>
 #include <string.h> /* memset() */
+#include <stdlib.h> /* free() */
 
 int whefs_test_insert_dummy_files( whefs_fs * fs )
 {
@@ -122,19 +123,29 @@ int whefs_fs_dump_to_FILE( whefs_fs * fs, FILE * out )
     unsigned char buf[bufSize];
     size_t rlen = 0;
     if( ! fs || !out || !fs->dev ) return whefs_rc.ArgError;
-    fs->dev->api->seek( fs->dev, 0L, SEEK_SET );
-    while( (rlen = fs->dev->api->read( fs->dev, buf, bufSize ) ) )
+    WHEFS_FS_WRLOCK(fs);
+    rc = whefs_fs_pcache_flush( fs ); /* we read fs->dev directly */
+    if( whefs_rc.OK == rc )
     {
-	if( 1 != fwrite( buf, rlen, 1, out ) )
-	{
-	    rc = whefs_rc.IOError;
-	    break;
-	}
+        fs->dev->api->seek( fs->dev, 0L, SEEK_SET );
+        while( (rlen = fs->dev->api->read( fs->dev, buf, bufSize ) ) )
+        {
+            if( 1 != fwrite( buf, rlen, 1, out ) )
+            {
+                rc = whefs_rc.IOError;
+                break;
+            }
+        }
     }
+    WHEFS_FS_UNLOCK(fs);
     return rc;
 }
 
-int whefs_import_dev( whefs_fs * fs, whio_dev * src, char const * fname, bool overwrite )
+/**
+   The implementation of whefs_import_dev(), which must be called
+   with fs locked exclusively.
+*/
+static int whefs_import_dev_impl( whefs_fs * fs, whio_dev * src, char const * fname, bool overwrite )
 {
     int rc = whefs_rc.OK;
     whefs_inode ino = whefs_inode_empty;
@@ -249,6 +260,16 @@ int whefs_import_dev( whefs_fs * fs, whio_dev * src, char const * fname, bool ov
     }
 }
 
+int whefs_import_dev( whefs_fs * fs, whio_dev * src, char const * fname, bool overwrite )
+{
+    int rc;
+    if( ! fs ) return whefs_rc.ArgError;
+    WHEFS_FS_WRLOCK(fs);
+    rc = whefs_import_dev_impl( fs, src, fname, overwrite );
+    WHEFS_FS_UNLOCK(fs);
+    return rc;
+}
+
 int whefs_fs_dump_to_filename( whefs_fs * fs, char const * filename )
 {
     FILE * f;
@@ -274,6 +295,7 @@ int whefs_fs_entry_foreach( whefs_fs * fs, whefs_fs_entry_foreach_f func, void *
     memset(buf,0,bufSize);
     ent.name.string = buf;
     ent.name.alloced = bufSize;
+    WHEFS_FS_WRLOCK(fs);
     for( ; i <= fs->options.inode_count; ++i )
     {
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
@@ -301,60 +323,151 @@ int whefs_fs_entry_foreach( whefs_fs * fs, whefs_fs_entry_foreach_f func, void *
         rc = func( fs, &ent, foreachData );
         if( whefs_rc.OK != rc ) break;
     }
+    WHEFS_FS_UNLOCK(fs);
     assert( (ent.name.string == buf) && "Internal error: illegal (re)alloc on string bytes!");
     return rc;
 }
 
 
-whefs_string * whefs_ls( whefs_fs * fs, char const * pattern, whefs_id_type * count  )
+/**
+   Cursor over the used entries of an EFS whose names match a glob
+   pattern, shared by whefs_ls() and whefs_ls_batch().
+*/
+typedef struct whefs_ls_cursor
 {
-    /* FIXME: reimplement in terms of whefs_fs_entry_foreach(). */
-    const whefs_id_type nc = whefs_fs_options_get(fs)->inode_count;
-    whefs_id_type id = 2; /* ID 1 is reserved for root node entry. */
-    int rc = whefs_rc.OK;
-    whefs_string * head = 0;
-    whefs_string * str = 0;
-    whefs_string * prev = 0;
-    whefs_string theString = whefs_string_empty;
-    whefs_inode tmpn = whefs_inode_empty;
-    if( ! fs ) return 0;
-    if( count ) *count = 0;
-    for( ; id <= nc; ++id )
+    whefs_fs * fs;
+    /** Compiled pattern, or 0 to match everything. */
+    whglob * glob;
+    /** The pattern's literal prefix, owned by glob. */
+    char const * prefix;
+    size_t plen;
+    /** If true, cand holds the candidates from the sorted names index. */
+    bool indexed;
+    whefs_id_type * cand;
+    whefs_id_type candCount;
+    whefs_id_type ci;
+    /** The next inode ID to look at (when !indexed). Wider than
+        whefs_id_type so that it cannot wrap after the last ID. */
+    size_t id;
+} whefs_ls_cursor;
+
+/**
+   Initializes cur for walking the entries of fs which match pattern
+   (0 or "" for all entries). On success the caller must eventually
+   pass cur to whefs_ls_cursor_end().
+*/
+static int whefs_ls_cursor_start( whefs_ls_cursor * cur, whefs_fs * fs, char const * pattern )
+{
+    memset( cur, 0, sizeof(whefs_ls_cursor) );
+    cur->fs = fs;
+    cur->id = 2; /* ID 1 is reserved for root node entry. */
+    if( pattern && *pattern )
+    {
+	cur->glob = whglob_compile( pattern );
+	if( ! cur->glob ) return whefs_rc.AllocError;
+	cur->prefix = whglob_prefix( cur->glob, &cur->plen );
+    }
+    /* Walking the entries fills the caches (and the sorted names
+       index), so fs stays locked exclusively until the cursor ends. */
+    WHEFS_FS_WRLOCK(fs);
+    if( cur->plen )
+    { /* Only names starting with the prefix can match. Look them up in
+	 the sorted names index or, without an in-memory names table,
+	 let whefs_fs_name_scan() find them. */
+	cur->indexed = (whefs_rc.OK == whefs_fs_names_prefix( fs, cur->prefix, &cur->cand, &cur->candCount ));
+    }
+    return whefs_rc.OK;
+}
+
+/** Unlocks cur's fs and frees cur's resources. */
+static void whefs_ls_cursor_end( whefs_ls_cursor * cur )
+{
+    WHEFS_FS_UNLOCK(cur->fs);
+    free( cur->cand );
+    whglob_free( cur->glob );
+    memset( cur, 0, sizeof(whefs_ls_cursor) );
+}
+
+/**
+   Finds the next used entry matching cur's pattern. On success its
+   inode is copied to ino, its name to name, and whefs_rc.OK is
+   returned. Returns whefs_rc.RangeError after the last entry, or
+   another error code if reading fails.
+*/
+static int whefs_ls_cursor_next( whefs_ls_cursor * cur, whefs_inode * ino, whefs_string * name )
+{
+    whefs_fs * fs = cur->fs;
+    const whefs_id_type nc = fs->options.inode_count;
+    whefs_id_type id, next;
+    char const * mem;
+    int rc;
+    for( ; ; )
     {
+	if( cur->indexed )
+	{
+	    if( cur->ci == cur->candCount ) return whefs_rc.RangeError;
+	    id = cur->cand[cur->ci++];
+	    if( id < 2 ) continue;
+	}
+	else
+	{
+	    if( cur->id > nc ) return whefs_rc.RangeError;
+	    id = (whefs_id_type)cur->id;
+	    if( cur->plen )
+	    {
+		next = 0;
+		rc = whefs_fs_name_scan( fs, cur->prefix, true, id, &next );
+		if( whefs_rc.OK != rc ) return rc;
+		if( ! next ) return whefs_rc.RangeError;
+		id = next;
+	    }
+	    cur->id = (size_t)id + 1;
+	}
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
 	if( fs->bits.i_loaded && !WHEFS_ICACHE_IS_USED(fs,id) )
 	{
 	    continue;
 	}
-	/*WHEFS_DBG("Cache says inode #%i is used.", i ); */
 #endif
-	rc = whefs_inode_name_get( fs, id, &theString );
+	if( cur->glob )
+	{ /* with an in-memory names table we can match without copying */
+	    mem = whefs_fs_name_peek( fs, id );
+	    if( mem && !whglob_compiled_matches( cur->glob, mem ) ) continue;
+	}
+	rc = whefs_inode_name_get( fs, id, name );
 	if( whefs_rc.OK != rc )
 	{
 	    WHEFS_DBG_ERR("whefs_inode_name_get() failed! rc=%d",rc);
-	    whefs_string_clear( &theString, false );
-	    return head;
+	    return rc;
 	}
-	if(0) WHEFS_DBG("Here. id=%"WHEFS_ID_TYPE_PFMT" str.len=%u str=[%s]",
-			id, theString.length, theString.string);
-	if( pattern && *pattern && !whglob_matches( pattern, theString.string ) )
+	if( cur->glob && !whglob_compiled_matches( cur->glob, name->string ) )
 	{
 	    continue;
 	}
-        if(1)
-        {/* make sure it's marked as used, or skip it */
-#if 0
-            uint32_t flagcheck = 0;
-            whefs_inode_read_flags( fs, id, &flagcheck );
-            if( ! (flagcheck & WHEFS_FLAG_Used) ) continue;
-#else
-            rc = whefs_inode_id_read( fs, id, &tmpn );
-            if( whefs_rc.OK != rc ) break;
-            if( ! (tmpn.flags & WHEFS_FLAG_Used) ) continue;
-#endif
-        }
+	/* make sure it's marked as used, or skip it */
+	rc = whefs_inode_id_read( fs, id, ino );
+	if( whefs_rc.OK != rc ) return rc;
+	if( ! (ino->flags & WHEFS_FLAG_Used) ) continue;
+	return whefs_rc.OK;
+    }
+}
+
+whefs_string * whefs_ls( whefs_fs * fs, char const * pattern, whefs_id_type * count  )
+{
+    /* FIXME: reimplement in terms of whefs_fs_entry_foreach(). */
+    whefs_string * head = 0;
+    whefs_string * str = 0;
+    whefs_string * prev = 0;
+    whefs_string theString = whefs_string_empty;
+    whefs_inode tmpn = whefs_inode_empty;
+    whefs_ls_cursor cur;
+    if( ! fs ) return 0;
+    if( count ) *count = 0;
+    if( whefs_rc.OK != whefs_ls_cursor_start( &cur, fs, pattern ) ) return 0;
+    while( whefs_rc.OK == whefs_ls_cursor_next( &cur, &tmpn, &theString ) )
+    {
 	str = whefs_string_alloc();
-	if( ! str ) return head;
+	if( ! str ) break;
 	if( ! head ) head = str;
 	*str = theString;
         theString = whefs_string_empty; /* take over ownership of theString.string */
@@ -363,6 +476,120 @@ whefs_string * whefs_ls( whefs_fs * fs, char const * pattern, whefs_id_type * co
 	if( count ) ++(*count);
     }
     whefs_string_clear( &theString, false );
+    whefs_ls_cursor_end( &cur );
     return head;
 }
 
+/**
+   Appends n bytes of src to the buffer *buf, which has *alloced bytes
+   and is used up to *used, growing it as needed. Returns false on
+   allocation error.
+*/
+static bool whefs_listing_append( void ** buf, size_t * used, size_t * alloced, void const * src, size_t n )
+{
+    if( (*used + n) > *alloced )
+    {
+	size_t const sz = (*alloced ? (*alloced * 2) : 1024) + n;
+	void * re = realloc( *buf, sz );
+	if( ! re ) return false;
+	*buf = re;
+	*alloced = sz;
+    }
+    memcpy( ((unsigned char *)*buf) + *used, src, n );
+    *used += n;
+    return true;
+}
+
+/** Rounds n up to a multiple of the alignment needed by whefs_listing's arrays. */
+#define WHEFS_LISTING_ALIGN(N) ((((N) + sizeof(void*) - 1) / sizeof(void*)) * sizeof(void*))
+
+int whefs_ls_batch( whefs_fs * fs, char const * pattern, whefs_listing ** tgt )
+{
+    /* Collect the entries in two growing buffers, then move them
+       into one block sized for the result. */
+    whefs_ls_cursor cur;
+    whefs_string name = whefs_string_empty;
+    whefs_inode ino = whefs_inode_empty;
+    whefs_inode_rec rec;
+    whefs_inode_rec * recs = 0;
+    char * names = 0;
+    whefs_id_type * ids = 0;
+    size_t iUsed = 0, iAlloced = 0, dUsed = 0, dAlloced = 0, nUsed = 0, nAlloced = 0;
+    size_t n = 0, i, sz, off;
+    whefs_listing * li;
+    unsigned char * mem;
+    char * str;
+    int rc;
+    if( ! fs || ! tgt ) return whefs_rc.ArgError;
+    *tgt = 0;
+    rc = whefs_ls_cursor_start( &cur, fs, pattern );
+    if( whefs_rc.OK != rc ) return rc;
+    while( whefs_rc.OK == (rc = whefs_ls_cursor_next( &cur, &ino, &name )) )
+    {
+	rec.first_block = ino.first_block;
+	rec.data_size = ino.data_size;
+	rec.mtime = ino.mtime;
+	rec.flags = 0;
+	if( ! whefs_listing_append( (void **)&recs, &iUsed, &iAlloced, &rec, sizeof(whefs_inode_rec) )
+	    || ! whefs_listing_append( (void **)&ids, &dUsed, &dAlloced, &ino.id, sizeof(whefs_id_type) )
+	    || ! whefs_listing_append( (void **)&names, &nUsed, &nAlloced, name.string, name.length + 1 ) )
+	{
+	    rc = whefs_rc.AllocError;
+	    break;
+	}
+	++n;
+    }
+    whefs_string_clear( &name, false );
+    whefs_ls_cursor_end( &cur );
+    if( whefs_rc.RangeError == rc ) rc = whefs_rc.OK; /* end of the list */
+    if( whefs_rc.OK == rc )
+    {
+	sz = WHEFS_LISTING_ALIGN(sizeof(whefs_listing))
+	    + WHEFS_LISTING_ALIGN(n * sizeof(char const *))
+	    + WHEFS_LISTING_ALIGN(n * sizeof(whio_size_t))
+	    + WHEFS_LISTING_ALIGN(n * sizeof(uint32_t))
+	    + WHEFS_LISTING_ALIGN(n * sizeof(whefs_id_type)) * 2
+	    + nUsed;
+	mem = (unsigned char *) malloc( sz );
+	if( ! mem ) rc = whefs_rc.AllocError;
+    }
+    if( whefs_rc.OK == rc )
+    {
+	li = (whefs_listing *) mem;
+	off = WHEFS_LISTING_ALIGN(sizeof(whefs_listing));
+	li->count = (whefs_id_type)n;
+	li->names = (char const **)(mem + off);
+	off += WHEFS_LISTING_ALIGN(n * sizeof(char const *));
+	li->sizes = (whio_size_t *)(mem + off);
+	off += WHEFS_LISTING_ALIGN(n * sizeof(whio_size_t));
+	li->mtimes = (uint32_t *)(mem + off);
+	off += WHEFS_LISTING_ALIGN(n * sizeof(uint32_t));
+	li->ids = (whefs_id_type *)(mem + off);
+	off += WHEFS_LISTING_ALIGN(n * sizeof(whefs_id_type));
+	li->blocks = (whefs_id_type *)(mem + off);
+	off += WHEFS_LISTING_ALIGN(n * sizeof(whefs_id_type));
+	str = (char *)(mem + off);
+	if( nUsed ) memcpy( str, names, nUsed );
+	for( i = 0; i < n; ++i )
+	{
+	    li->names[i] = str;
+	    str += strlen( str ) + 1;
+	    li->ids[i] = ids[i];
+	    li->sizes[i] = recs[i].data_size;
+	    li->mtimes[i] = recs[i].mtime;
+	    li->blocks[i] = recs[i].first_block;
+	}
+	*tgt = li;
+    }
+    free( recs );
+    free( ids );
+    free( names );
+    return rc;
+}
+#undef WHEFS_LISTING_ALIGN
+
+void whefs_listing_free( whefs_listing * li )
+{
+    free( li );
+}
+
@@ -21,6 +21,7 @@
 */
 
 #include <assert.h>
+#include <time.h> /* time_t */
 #include <wh/whefs/whefs.h>
 #include "whefs_inode.h"
 #include "whdbg.h"
@@ -133,9 +134,11 @@ WHEFS_OFF_CLIENT_MAGIC,
 WHEFS_OFF_OPTIONS,
 WHEFS_OFF_HINTS/*not yet used*/,
 WHEFS_OFF_INODE_NAMES,
+WHEFS_OFF_NAME_INDEX,
 WHEFS_OFF_INODES_NO_STR,
 WHEFS_OFF_BLOCK_TABLE,
 WHEFS_OFF_BLOCKS,
+WHEFS_OFF_FREEMAP,
 WHEFS_OFF_EOF,
 WHEFS_OFF_COUNT /* must be the last entry! */
 };
@@ -149,9 +152,69 @@ WHEFS_SZ_INODE_NAME,
 WHEFS_SZ_BLOCK,
 WHEFS_SZ_OPTIONS,
 WHEFS_SZ_HINTS,
+WHEFS_SZ_FREEMAP,
+WHEFS_SZ_NAME_INDEX,
 WHEFS_SZ_COUNT /* must be the last entry! */
 };
 
+enum {
+/**
+   The number of blocks covered by each free count in the on-disk
+   free-space map (see whefs_fs_freemap_write()). Changing this
+   changes the EFS file format.
+*/
+whefs_freemap_region_blocks = 4096
+};
+
+/**
+   One page slot of a whefs_fs's page cache (see whefs_pcache.c).
+*/
+typedef struct whefs_pcache_page
+{
+    /** Page number: the page's device offset divided by the page size. */
+    whio_size_t pgno;
+    /**
+       Number of valid bytes in the page. Less than the page size
+       only for the last page of the device.
+    */
+    whio_size_t len;
+    /** (Index+1) of the next page in the same hash bucket, or 0. */
+    whio_size_t next;
+    /**
+       If dirty is true, bytes [dlo,dhi) of the page have been
+       modified in memory but not yet written to the device.
+    */
+    whio_size_t dlo;
+    /** See dlo. */
+    whio_size_t dhi;
+    /** CLOCK reference bit. */
+    bool ref;
+    /** True if the slot holds a page. */
+    bool used;
+    /** True if the page has unwritten changes. */
+    bool dirty;
+} whefs_pcache_page;
+/** Empty initialization object. */
+#define whefs_pcache_page_empty_m {0,0,0,0,0,false,false,false}
+/** Empty initialization object. */
+static const whefs_pcache_page whefs_pcache_page_empty = whefs_pcache_page_empty_m;
+
+/**
+   The persistent fields of one inode, as held in whefs_fs::itable.
+   The inode ID is implied by the record's position in the table.
+*/
+typedef struct whefs_inode_rec
+{
+    /** See whefs_inode::first_block. */
+    whefs_id_type first_block;
+    /** See whefs_inode::data_size. */
+    uint32_t data_size;
+    /** See whefs_inode::mtime. */
+    uint32_t mtime;
+    /** See whefs_inode::flags. */
+    uint8_t flags;
+} whefs_inode_rec;
+
 /** @def WHEFS_FS_HASH_CACHE_IS_ENABLED
 
 WHEFS_FS_HASH_CACHE_IS_ENABLED() returns true if whefs_fs object FS
@@ -185,11 +248,19 @@ WHEFS_CLOSER_TYPE_STREAM = 's'
    them from fs->closers when they are closed. If the fs is
    shut down before the client closes the objects in that list
    then whefs_fs_finalize() closes them all.
-   
+
+   Every whefs_file and whio_stream handed out by the public API
+   wraps exactly one inode device (see whefs_dev_for_inode()), so the
+   list entries are embedded in those devices' private data instead
+   of being allocated separately. Adding and removing entries is
+   therefore constant-time and never allocates.
 */
 struct whefs_fs_closer_list
 {
-    /** Must be a value from enum whefs_fs_closer_types. */
+    /**
+       Must be a value from enum whefs_fs_closer_types, or 0 if this
+       entry is not in a list.
+    */
     char type;
     /**
        The object pointed to by this object. It MUST be properly set
@@ -210,27 +281,23 @@ struct whefs_fs_closer_list
 typedef struct whefs_fs_closer_list whefs_fs_closer_list;
 
 /** Empty initialize object for whefs_fs_closer_list instances. */
-#define whefs_fs_closer_list_empty_m { 0/*type*/,{/*item*/NULL},NULL/*next*/}
+#define whefs_fs_closer_list_empty_m { 0/*type*/,{/*item*/NULL},NULL/*next*/,NULL/*prev*/}
 
 /** Empty initialize object for whefs_fs_closer_list instances. */
 extern const whefs_fs_closer_list whefs_fs_closer_list_empty;
 
 /**
-   Allocates a new whefs_fs_closer_list instance containing
-   zero-initialized values.
-*/
-whefs_fs_closer_list * whefs_fs_closer_list_alloc();
-
-/**
-   Frees x and re-links its neighbors to one-another.
+   Returns the close-at-shutdown list entry embedded in dev, or 0 if
+   dev was not created by whefs_dev_for_inode() (or has been closed).
+   Implemented in whefs_nodedev.c.
 */
-void whefs_fs_closer_list_free( whefs_fs_closer_list * x );
+whefs_fs_closer_list * whefs_dev_closer_entry( whio_dev const * dev );
 
 /**
-   Closes the item referenced by head. If right is true then
-   all items to the right of head are also closed.
+   Closes every object in fs->closers, in the order they were added,
+   and empties the list.
 */
-int whefs_fs_closer_list_close( whefs_fs_closer_list * head, bool right );
+int whefs_fs_closer_list_close( whefs_fs * fs );
 
 /**
    Adds f to fs's close-at-shutdown list. Since a whefs_file is
@@ -274,17 +341,11 @@ int whefs_fs_closer_dev_remove( whefs_fs * fs, whio_dev const * d );
    whio_dev d, it MUST own d, and d MUST have been added to fs via
    whefs_fs_closer_dev_add(), or results are undefined.
 
-   Closing s will automatically remove it from the list.
+   Closing s will automatically remove it from the list, as s closes
+   d, which removes its entry.
 */
 int whefs_fs_closer_stream_add( whefs_fs * fs, whio_stream * s, whio_dev const * d );
 
-/**
-   Removes s from fs's close-at-shutdown list.
-
-   See whefs_fs_closer_file_remove() for more info.
-*/
-int whefs_fs_closer_stream_remove( whefs_fs * fs, whio_stream const * s );
-
 /**
    Main filesystem structure.
 */
@@ -370,10 +431,39 @@ struct whefs_fs
     */
     uint32_t filesize;
     /**
-       All "opened" inodes are store in this linked list.
+       All "opened" inodes, in an open-addressing hash table keyed by
+       inode ID. The inodes themselves live in slabs of
+       whefs_inode_list objects which are never moved or freed before
+       the fs is, so pointers to opened inodes stay valid while they
+       are opened. See whefs_inode_open().
+    */
+    struct whefs_opened_nodes
+    {
+        /**
+           (mask+1) slots, each 0 or pointing to an opened inode.
+           Collisions are resolved by linear probing.
+        */
+        whefs_inode ** slots;
+        /** Slot count minus 1. The slot count is a power of 2. */
+        whio_size_t mask;
+        /** Number of opened inodes. */
+        whio_size_t count;
+        /** List of allocated slabs. */
+        struct whefs_inode_slab * slabs;
+        /** Unused entries of the slabs, linked via their next members. */
+        whefs_inode_list * free;
+    } opened_nodes;
+    /**
+       Objects to close in whefs_fs_finalize() if the client has not
+       done so. The entries are owned by the objects, not the list.
     */
-    whefs_inode_list * opened_nodes;
-    whefs_fs_closer_list * closers;
+    struct whefs_fs_closers
+    {
+        /** First (oldest) entry. */
+        whefs_fs_closer_list * head;
+        /** Last (newest) entry, to which new entries are appended. */
+        whefs_fs_closer_list * tail;
+    } closers;
     /**
        IFF the fs thinks that it is using file-based storage it may
        try to enable some locking features. This is the file number of
@@ -438,23 +528,228 @@ struct whefs_fs
 	whefs_id_type unused_inode_start;
     } hints;
 
+    /**
+       Runtime-only block allocation policy.
+    */
+    struct _alloc
+    {
+        /**
+           Minimum length of a run of adjacent free blocks which
+           whefs_block_next_free_run() will accept when starting a
+           new extent. See whefs_fs_setopt_extent_min().
+        */
+        whefs_id_type extent_min;
+    } alloc;
+
+    /**
+       Runtime-only read-ahead policy for pseudofile i/o devices.
+    */
+    struct _readahead
+    {
+        /**
+           Size of the read-ahead window, in blocks. 0 disables
+           read-ahead. See whefs_fs_setopt_readahead().
+        */
+        uint32_t blocks;
+    } readahead;
+
+    /**
+       In-memory state of the persistent free-space map. The map's
+       bitset is fs->bits.b itself; this holds the per-region free
+       counts.
+    */
+    struct _freemap
+    {
+        /**
+           Number of free blocks in each region of
+           whefs_freemap_region_blocks blocks.
+        */
+        uint32_t * counts;
+        /** Number of entries in counts. */
+        whefs_id_type regions;
+        /** Total number of free blocks. */
+        whefs_id_type free;
+        /**
+           True once the map has been read or written, from which
+           point on whefs_fs_freemap_mark() keeps it up to date.
+        */
+        bool loaded;
+    } freemap;
+
+    /**
+       In-memory state of the optional on-disk name index (see
+       whefs_nameidx.c).
+    */
+    struct _nameidx
+    {
+        /**
+           Number of slots in the index, or 0 if the EFS has no index
+           (or it has not yet been read or written).
+        */
+        uint32_t slots;
+    } nameidx;
+
+    /**
+       The page cache for reads of, and buffered writes to, fs->dev.
+       See whefs_pcache.c.
+    */
+    struct whefs_pcache
+    {
+        /** Memory budget, in bytes. 0 disables the cache. */
+        whio_size_t budget;
+        /**
+           Page memory: stats.capacity pages of stats.page_size
+           bytes. Allocated on first use.
+        */
+        unsigned char * mem;
+        /** Per-page state, parallel to mem. */
+        whefs_pcache_page * pages;
+        /**
+           Hash table of (bucketMask+1) entries mapping page numbers
+           to (index+1) of the first page of each chain.
+        */
+        whio_size_t * buckets;
+        whio_size_t bucketMask;
+        /** The CLOCK hand. */
+        whio_size_t hand;
+        /**
+           Maximum number of bytes (rounded up to whole pages) which
+           may be dirty before they are all written back. 0 makes the
+           cache write-through.
+        */
+        whio_size_t dirtyMax;
+        /**
+           Maximum age, in seconds, of the oldest dirty data before
+           all of it is written back.
+        */
+        uint32_t dirtyAge;
+        /** Time at which the oldest dirty page became dirty. */
+        time_t dirtySince;
+        whefs_cache_stats stats;
+    } pcache;
+
+    /**
+       In-memory copy of the on-disk inode table, loaded with a
+       single read and kept up to date by whefs_inode_flush(). While
+       it is loaded, whefs_inode_id_read() does no i/o.
+    */
+    struct whefs_itable
+    {
+        /**
+           Records for inodes 1 through count, indexed by (ID-1). 0 if
+           the table is not loaded.
+        */
+        whefs_inode_rec * list;
+        /** Number of entries in list. */
+        whefs_id_type count;
+        /** If true, the table is loaded when the EFS is opened. */
+        bool enabled;
+    } itable;
+
+    /**
+       In-memory mirror of the on-disk inode names table, loaded with
+       a single read and kept up to date by whefs_fs_name_write().
+       While it is loaded, reading a name does no i/o.
+    */
+    struct whefs_name_table
+    {
+        /**
+           The names of inodes 1 through count, NUL-terminated, each
+           in a slot of stride bytes starting at (ID-1)*stride. 0 if
+           the table is not loaded.
+        */
+        char * mem;
+        /** Size of each slot: fs->options.filename_length+1. */
+        uint32_t stride;
+        /** Number of slots in mem. */
+        whefs_id_type count;
+        /**
+           The IDs of the named inodes, sorted by name, for prefix
+           searches (see whefs_fs_names_prefix()). Built by the first
+           such search, kept sorted by whefs_fs_name_write() and freed
+           along with mem. 0 if not built.
+        */
+        whefs_id_type * sorted;
+        /** Number of entries in sorted. */
+        whefs_id_type sortedCount;
+        /** If true, the table is loaded when the EFS is opened. */
+        bool enabled;
+    } names;
+
     /**
        Client-configurable vfs options. Except in some very controlled
        circumstances, these must not change after initialization of
        the vfs state or the fs will become corrupted.
     */
     whefs_fs_options options;
-    /** Holder for threading-related data. */
+    /**
+       Holder for threading-related data. See
+       WHEFS_CONFIG_ENABLE_THREADS and whefs_fs_rwlock_acquire().
+    */
     struct thread_info
     {
         int placeholder;
 #if WHEFS_CONFIG_ENABLE_THREADS
+        /**
+           Guards the fs-wide metadata: the bitsets, hints, free map,
+           caches, names/inode tables, opened-node table and closer
+           list. Held shared by i/o on pseudofiles and exclusively by
+           everything which changes or lazily builds that metadata.
+        */
+        pthread_rwlock_t rw;
+        /**
+           Identifies the thread which holds rw exclusively (the
+           address of a thread-local token), or 0. Only ever set by
+           that thread, and read atomically.
+        */
+        void * owner;
+        /** Nesting depth of the owner's acquisitions of rw. */
+        unsigned int depth;
+        /**
+           Serializes access to fs->dev and fs->pcache (and the
+           block allocator, which i/o on pseudofiles can trigger)
+           among threads holding rw shared. Recursive.
+        */
+        pthread_mutex_t io;
 #endif
     } threads;
     struct _caches
     {
-        whefs_hashid_list * hashes;
-        whefs_hashval_type (*hashfunc)( char const * vstr);
+        /** Maps inode name hashes to inode IDs. See whefs_inode_hash_cache(). */
+        whefs_hashid_table hashes;
+        /** Hashes names for the cache. See whefs_fs_setopt_name_hash(). */
+        whefs_name_hash_f hashfunc;
+        /**
+           True if hashes is known to hold every named inode, in which
+           case a name whose hash is not in it does not exist. Set by
+           whefs_inode_hash_cache_load(), by mkfs and by full scans in
+           whefs_inode_by_name(); cleared by anything which may drop
+           entries.
+        */
+        bool complete;
+        /**
+           Counting Bloom filter of the names of all named inodes. See
+           whefs_name_filter_load().
+        */
+        struct _filter
+        {
+            /**
+               size 8-bit counters. Each name increments
+               whefs_name_filter_probes of them; a counter which
+               reaches 255 is never decremented again.
+            */
+            unsigned char * counts;
+            /** Number of entries in counts (a power of 2). */
+            uint32_t size;
+            /** True if the filter should be used. */
+            bool enabled;
+            /**
+               True if counts holds every named inode, from which
+               point on whefs_fs_name_write() keeps it up to date.
+            */
+            bool loaded;
+            whefs_name_filter_stats stats;
+        } filter;
     } cache;
 };
 
@@ -506,6 +801,16 @@ whio_size_t whefs_fs_write( whefs_fs * fs, void const * src, whio_size_t n );
    number of bytes written, or 0 if seek fails.
 */
 whio_size_t whefs_fs_writeat( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n );
+/**
+   Equivalent to whio_dev_readvat() on fs's underlying i/o device,
+   but returns 0 if the seek fails.
+*/
+whio_size_t whefs_fs_readvat( whefs_fs * fs, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
+/**
+   Equivalent to whio_dev_writevat() on fs's underlying i/o device,
+   but returns 0 if the seek fails.
+*/
+whio_size_t whefs_fs_writevat( whefs_fs * fs, whio_size_t pos, whio_iovec const * iov, whio_size_t count );
 /**
    Equivalent to calling whio_dev::seek() on fs's underlying i/o
    device.
@@ -531,6 +836,14 @@ int whefs_block_read( whefs_fs * fs, whefs_id_type id, whefs_block * bl );
 */
 whio_size_t whefs_fs_sizeof_block( whefs_fs_options const * opt );
 
+/**
+   Rounds X up to a multiple of opt->data_alignment, or returns X if
+   that option is not in effect.
+*/
+#define WHEFS_OPT_ALIGN(OPT,X) (((OPT)->data_alignment > 1) \
+    ? ((((X) + (OPT)->data_alignment - 1) / (OPT)->data_alignment) * (OPT)->data_alignment) \
+    : (X))
+
 /**
    Reads the block following bl.  bl must be a valid block object
    (with a valid ID) and nextBlock must be valid memory (which will be
@@ -574,6 +887,35 @@ int whefs_block_flush( whefs_fs * fs, whefs_block const * bl );
 */
 int whefs_block_next_free( whefs_fs * fs, whefs_block * tgt, bool markUsed );
 
+/**
+   Reserves a run (extent) of up to 'want' physically adjacent free
+   blocks, marking them as used in the free-space map. If flush is
+   true, the blocks of the run are chained together on disk (each
+   one's next_block is the following block's ID, and the last one's
+   next_block is 0), so appending them in order to an inode's block
+   list requires no further block flushes except to link the run to
+   the inode's previous tail block. If flush is false, no block
+   headers are written: the caller must write them (e.g. as part of
+   the data write which the blocks were reserved for).
+
+   If 'near' is a valid block ID and that block is free then the run
+   starts there, regardless of its length. This is used to extend an
+   inode's existing tail extent. Otherwise the search starts at
+   fs->hints.unused_block_start and returns the first run which is at
+   least min(want, fs->alloc.extent_min) blocks long. If no such run
+   exists then the longest run found is used.
+
+   On success, whefs_rc.OK is returned, *first is set to the ID of
+   the first block of the run and *count is set to its length (1 to
+   want, inclusive). If no free blocks are left, whefs_rc.FSFull is
+   returned. If any arguments are invalid (!fs, !first, !count, or
+   !want), whefs_rc.ArgError is returned. On error, first and count
+   are not modified. An i/o error while reading or writing block
+   metadata is propagated back to the caller.
+*/
+int whefs_block_next_free_run( whefs_fs * fs, whefs_id_type near, whefs_id_type want,
+                               whefs_id_type * first, whefs_id_type * count, bool flush );
+
 /**
    Zeroes out parts of the given data block. Unlike most routines,
    which require only that bl->id is valid, bl must be fully populated
@@ -621,6 +963,15 @@ whio_size_t whefs_block_id_pos( whefs_fs const * fs, whefs_id_type id );
 */
 whio_size_t whefs_block_data_pos( whefs_fs const * fs, whefs_block const * bl );
 
+/**
+   Encodes bl's on-disk header into dest, which must be at least
+   whefs_sizeof_encoded_block bytes long. This is the exact byte
+   sequence whefs_block_flush() writes at whefs_block_id_pos().
+   Returns whefs_rc.OK on success or whefs_rc.ArgError if either
+   argument is null.
+*/
+int whefs_block_encode( whefs_block const * bl, unsigned char * dest );
+
 /**
    Seeks to the given block's on-disk position. Returns whefs_rc.OK
    on success.
@@ -879,6 +1230,306 @@ int whefs_fs_hints_write( whefs_fs * fs );
    routine fails then an i/o or consistency error was encountered.
 */
 int whefs_fs_hints_read( whefs_fs * fs );
+
+/**
+   Returns the on-disk size of the free-space map for the given
+   options, or 0 if !opt.
+*/
+whio_size_t whefs_fs_sizeof_freemap( whefs_fs_options const * opt );
+
+/**
+   Recalculates the per-region free counts from fs->bits.b and writes
+   the whole free-space map to fs->offsets[WHEFS_OFF_FREEMAP]. After
+   this succeeds, fs->freemap.loaded is true.
+
+   Used by mkfs and whefs_fs_append_blocks(). fs->bits.b must be
+   accurate when this is called.
+
+   On error, fs->err is set and returned.
+*/
+int whefs_fs_freemap_write( whefs_fs * fs );
+
+/**
+   Reads the free-space map from fs->offsets[WHEFS_OFF_FREEMAP] into
+   fs->bits.b and fs->freemap. fs->bits.b must have been initialized
+   for the current block count.
+
+   On error, fs->err is set and returned.
+*/
+int whefs_fs_freemap_read( whefs_fs * fs );
+
+/**
+   Marks block #id as used or free in the free-space map, writing the
+   changed bitset byte and region count to disk. This is a no-op if
+   the map is not loaded or the bit already has the given state.
+
+   whefs_block_flush() calls this before writing a header which marks
+   a block as used and after writing one which marks it as free.
+*/
+int whefs_fs_freemap_mark( whefs_fs * fs, whefs_id_type id, bool used );
+
+/**
+   Like whefs_fs_freemap_mark(), but for the count blocks starting at
+   block #first. The changed bitset bytes are written with a single
+   write, followed by each affected region count, so marking a whole
+   extent costs a handful of writes instead of two per block.
+*/
+int whefs_fs_freemap_mark_range( whefs_fs * fs, whefs_id_type first, whefs_id_type count, bool used );
+
+/**
+   Returns the first block ID at or after id which lies in a region
+   with free blocks, or (fs->options.block_count+1) if there is no
+   such region. If the map is not loaded, id is returned.
+*/
+whefs_id_type whefs_fs_freemap_next_candidate( whefs_fs const * fs, whefs_id_type id );
+
+/**
+   Frees the memory owned by fs->freemap and marks it as not loaded.
+*/
+void whefs_fs_freemap_clear( whefs_fs * fs );
+
+/**
+   Returns the number of name index slots for the given options, or
+   0 if opt has no name index (see whefs_fs_options::name_index).
+*/
+uint32_t whefs_fs_name_index_slots( whefs_fs_options const * opt );
+
+/**
+   Returns the on-disk size of the name index for the given options,
+   or 0 if opt has no name index.
+*/
+whio_size_t whefs_fs_sizeof_name_index( whefs_fs_options const * opt );
+
+/**
+   Writes an empty name index to fs->offsets[WHEFS_OFF_NAME_INDEX]
+   and sets fs->nameidx.slots. Used by mkfs. Does nothing if
+   fs->options has no name index.
+
+   On error, fs->err is set and returned.
+*/
+int whefs_fs_name_index_write( whefs_fs * fs );
+
+/**
+   Verifies the name index header and sets fs->nameidx.slots. Used
+   by whefs_openfs(). Does nothing if fs->options has no name index.
+
+   On error, fs->err is set and returned.
+*/
+int whefs_fs_name_index_read( whefs_fs * fs );
+
+/**
+   Adds an entry for the given name/id pair to the name index. Does
+   nothing if fs has no index or name is empty.
+*/
+int whefs_fs_name_index_insert( whefs_fs * fs, char const * name, whefs_id_type id );
+
+/**
+   Removes the entry for the given name/id pair from the name
+   index. Does nothing if fs has no index, name is empty or the
+   entry is not found.
+*/
+int whefs_fs_name_index_remove( whefs_fs * fs, char const * name, whefs_id_type id );
+
+/**
+   Collects the IDs of (at most max) inodes whose names have the
+   same index hash as the given name into ids and sets *count to the
+   number of IDs collected. The caller must compare the names, as the
+   hashes may collide.
+
+   Returns whefs_rc.OK if every candidate was collected, so that no
+   other inode can have the given name. Returns whefs_rc.RangeError
+   if fs has no index or there were more than max candidates, in
+   which case the caller must fall back to another search.
+*/
+int whefs_fs_name_index_search( whefs_fs * fs, char const * name, whefs_id_type * ids, uint32_t max, uint32_t * count );
+
+/**
+   Reads n bytes at position pos of fs->dev into dest, via fs's page
+   cache if it is enabled and the read is small enough, and returns
+   the number of bytes read. fs->dev must be valid.
+*/
+whio_size_t whefs_fs_pcache_read( whefs_fs * fs, whio_size_t pos, void * dest, whio_size_t n );
+
+/**
+   Must be called after n bytes from src are written to position pos
+   of fs->dev. Copies them into any cached pages they overlap. If src
+   is 0, the overlapped pages are dropped instead.
+*/
+void whefs_fs_pcache_update( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n );
+
+/**
+   Writes n bytes from src to position pos of fs->dev. If write-back
+   is enabled and the write is small enough, the data only goes into
+   fs's page cache, to be written back later. Returns the number of
+   bytes written.
+*/
+whio_size_t whefs_fs_pcache_write( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n );
+
+/**
+   Writes back any dirty cached data in the n bytes at position pos
+   of fs->dev, e.g. before reading that range from fs->dev directly.
+   Returns whefs_rc.OK on success.
+*/
+int whefs_fs_pcache_sync( whefs_fs * fs, whio_size_t pos, whio_size_t n );
+
+/**
+   Writes back all dirty pages of fs's page cache, coalescing
+   adjacent ones. Returns whefs_rc.OK on success.
+*/
+int whefs_fs_pcache_flush( whefs_fs * fs );
+
+/**
+   Writes back all dirty pages, then drops all pages from fs's page
+   cache, but keeps its memory. Must be called before writing to
+   fs->dev other than via the whefs_fs_writeXXX() routines.
+*/
+void whefs_fs_pcache_clear( whefs_fs * fs );
+
+/**
+   Writes back all dirty pages, then frees all memory owned by fs's
+   page cache. It will be reallocated on the next i/o if the cache is
+   enabled.
+*/
+void whefs_fs_pcache_free( whefs_fs * fs );
+
+/**
+   Reads the whole inode table of fs with one read and decodes it into
+   fs->itable, replacing any previously loaded copy. This also fills
+   in the used-inodes cache (if enabled). On error the table is left
+   unloaded. Returns whefs_rc.OK on success.
+*/
+int whefs_fs_itable_load( whefs_fs * fs );
+
+/**
+   Frees the memory used for tracking fs's opened inodes. It must only
+   be called once no inodes are opened, during finalization of fs.
+*/
+void whefs_inode_opened_free( whefs_fs * fs );
+
+/**
+   Frees fs->itable's memory. Subsequent inode reads go to storage.
+*/
+void whefs_fs_itable_free( whefs_fs * fs );
+
+/**
+   Reads the whole inode names table of fs with one read and decodes
+   it into fs->names, replacing any previously loaded copy. On error
+   the table is left unloaded. Returns whefs_rc.OK on success.
+*/
+int whefs_fs_names_load( whefs_fs * fs );
+
+/**
+   Frees fs->names's memory. Subsequent name reads go to storage.
+*/
+void whefs_fs_names_free( whefs_fs * fs );
+
+/**
+   Returns the name of inode #id from fs->names, without copying it,
+   or 0 if the names table is not loaded or id is out of range. The
+   returned string is empty for unnamed inodes. It is valid until the
+   inode's name changes or the table is freed.
+*/
+char const * whefs_fs_name_peek( whefs_fs const * fs, whefs_id_type id );
+
+/**
+   Searches the names of inodes start through
+   fs->options.inode_count, in ID order, for the first one which
+   equals name (if prefix is false) or starts with name (if prefix is
+   true). On success *id is set to the ID of that inode, or to 0 if
+   none matches, and whefs_rc.OK is returned.
+
+   The names are compared by whefs_name_scan() (see
+   whefs_namescan.h): in place in fs->names if that is loaded, else
+   in chunks read from the names table on storage. Unlike the name
+   search in whefs_inode_by_name() this does not add the names it
+   visits to the hash cache.
+
+   Returns whefs_rc.ArgError if any argument is 0 or name is empty,
+   whefs_rc.AllocError if the chunk buffer cannot be allocated, or
+   whefs_rc.IOError if reading the names table fails.
+*/
+int whefs_fs_name_scan( whefs_fs * fs, char const * name, bool prefix,
+                        whefs_id_type start, whefs_id_type * id );
+
+/**
+   Looks up the inodes whose names start with prefix, using a binary search of fs->names.sorted (which is built
+   first if needed). On success *ids is set to a malloc()'d array of
+   their IDs, in ascending order, which the caller must free(), *count
+   is set to its length, and whefs_rc.OK is returned. If nothing
+   matches, *ids is set to 0 and *count to 0.
+
+   Returns whefs_rc.UnsupportedError if fs->names is not loaded,
+   whefs_rc.ArgError if any argument is 0, or whefs_rc.AllocError.
+*/
+int whefs_fs_names_prefix( whefs_fs * fs, char const * prefix,
+                           whefs_id_type ** ids, whefs_id_type * count );
+
+#if WHEFS_CONFIG_ENABLE_THREADS
+/**
+   Initializes m as a recursive mutex. Returns 0 on success, else
+   an errno value from pthread_mutex_init().
+*/
+int whefs_mutex_init_recursive( pthread_mutex_t * m );
+
+/**
+   Initializes fs->threads. Must be called once per whefs_fs before
+   it is used. Returns whefs_rc.OK or whefs_rc.InternalError.
+*/
+int whefs_fs_threads_init( whefs_fs * fs );
+
+/**
+   Frees fs->threads' resources. No lock may be held on fs.
+*/
+void whefs_fs_threads_destroy( whefs_fs * fs );
+
+/**
+   Acquires fs's metadata lock (fs->threads.rw), exclusively if write
+   is true, else shared. Acquisitions are recursive for a thread which
+   holds the lock exclusively (whether it asks for a shared or an
+   exclusive lock the second time), which lets public API routines
+   which lock it call each other. A thread which holds the lock shared
+   must not try to acquire it exclusively.
+
+   Each call must be paired with a call to whefs_fs_rwlock_release().
+   Use the WHEFS_FS_RDLOCK(), WHEFS_FS_WRLOCK() and WHEFS_FS_UNLOCK()
+   macros instead of calling this directly: they are no-ops if
+   WHEFS_CONFIG_ENABLE_THREADS is false.
+*/
+void whefs_fs_rwlock_acquire( whefs_fs * fs, bool write );
+
+/**
+   Releases a lock acquired by whefs_fs_rwlock_acquire().
+*/
+void whefs_fs_rwlock_release( whefs_fs * fs );
+
+/**
+   Locks the mutex of ino, which must be an opened inode (one of the
+   entries of fs->opened_nodes). It serializes i/o on the inode's
+   devices, which share the inode's size and block list. Recursive.
+*/
+void whefs_inode_lock( whefs_inode * ino );
+
+/**
+   Unlocks a mutex locked by whefs_inode_lock().
+*/
+void whefs_inode_unlock( whefs_inode * ino );
+
+#  define WHEFS_FS_RDLOCK(FS) whefs_fs_rwlock_acquire((FS),false)
+#  define WHEFS_FS_WRLOCK(FS) whefs_fs_rwlock_acquire((FS),true)
+#  define WHEFS_FS_UNLOCK(FS) whefs_fs_rwlock_release(FS)
+#  define WHEFS_FS_IO_LOCK(FS) pthread_mutex_lock(&(FS)->threads.io)
+#  define WHEFS_FS_IO_UNLOCK(FS) pthread_mutex_unlock(&(FS)->threads.io)
+#  define WHEFS_INODE_LOCK(INO) whefs_inode_lock(INO)
+#  define WHEFS_INODE_UNLOCK(INO) whefs_inode_unlock(INO)
+#else
+#  define WHEFS_FS_RDLOCK(FS) ((void)0)
+#  define WHEFS_FS_WRLOCK(FS) ((void)0)
+#  define WHEFS_FS_UNLOCK(FS) ((void)0)
+#  define WHEFS_FS_IO_LOCK(FS) ((void)0)
+#  define WHEFS_FS_IO_UNLOCK(FS) ((void)0)
+#  define WHEFS_INODE_LOCK(INO) ((void)0)
+#  define WHEFS_INODE_UNLOCK(INO) ((void)0)
+#endif /* WHEFS_CONFIG_ENABLE_THREADS */
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
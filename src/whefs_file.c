@@ -191,6 +191,7 @@ whefs_file * whefs_fopen( whefs_fs * fs, char const * name, char const * mode )
     f->fs = fs;
     f->flags = flags;
     rc = whefs_rc.IOError;
+    WHEFS_FS_WRLOCK(fs);
     /*WHEFS_DBG_FYI("fopen(fs,[%s],[%s]) flags=0x%08x ISRW=%d", name, mode, flags, WHEFS_FILE_ISRW(f) ); */
     rc = WHEFS_FILE_ISRW(f)
 	? whefs_fopen_rw( f, name )
@@ -205,11 +206,16 @@ whefs_file * whefs_fopen( whefs_fs * fs, char const * name, char const * mode )
         
         whefs_fs_closer_file_add( fs, f );
     }
+    WHEFS_FS_UNLOCK(fs);
     /*WHEFS_DBG("opened whefs_file [%s]. mode=%s, flags=%08x", name, mode, f->flags ); */
     return f;
 }
 
-whio_dev * whefs_dev_open( whefs_fs * fs, char const * name, bool writeMode )
+/**
+   The implementation of whefs_dev_open(), which must be called with
+   fs locked exclusively.
+*/
+static whio_dev * whefs_dev_open_impl( whefs_fs * fs, char const * name, bool writeMode )
 {
     if( ! fs || !name ) return 0;
     else if( writeMode && ! whefs_fs_is_rw(fs) )
@@ -249,38 +255,23 @@ whio_dev * whefs_dev_open( whefs_fs * fs, char const * name, bool writeMode )
     }
 }
 
-
-/**
-   Internal type to allow us to properly disconnect a whio_stream
-   object from close-at-shutdown without needing to add a custom
-   whio_stream implementation.
-*/
-typedef struct
-{
-    whefs_fs * fs;
-    whio_stream const * stream;
-} whefs_stream_closer_kludge;
-
-/** v must be-a populated whefs_stream_closer_kludge.
-    Removes v->stream from fs' closer list and frees
-    v.
-*/
-static void whefs_stream_closer_kludge_dtor( void * v )
+whio_dev * whefs_dev_open( whefs_fs * fs, char const * name, bool writeMode )
 {
-    if(0) whefs_stream_closer_kludge_dtor(0); /* avoid "static func defined but not used" warning. */
-    if(v)
-    {
-        /*WHEFS_DBG("Removing whio_stream from closer list."); */
-        whefs_stream_closer_kludge * k = (whefs_stream_closer_kludge*)v;
-        whefs_fs_closer_stream_remove( k->fs, k->stream );
-        free( k );
-    }
+    whio_dev * dev;
+    if( ! fs ) return 0;
+    WHEFS_FS_WRLOCK(fs);
+    dev = whefs_dev_open_impl( fs, name, writeMode );
+    WHEFS_FS_UNLOCK(fs);
+    return dev;
 }
 
-whio_stream * whefs_stream_open( whefs_fs * fs, char const * name, bool writeMode, bool append )
+/**
+   The implementation of whefs_stream_open(), which must be called
+   with fs locked exclusively.
+*/
+static whio_stream * whefs_stream_open_impl( whefs_fs * fs, char const * name, bool writeMode, bool append )
 {
-    whio_dev * d = whefs_dev_open( fs, name, writeMode );
-    whefs_stream_closer_kludge * k;
+    whio_dev * d = whefs_dev_open_impl( fs, name, writeMode );
     whio_stream * s;
     if( ! d ) return 0;
     if( writeMode )
@@ -294,29 +285,29 @@ whio_stream * whefs_stream_open( whefs_fs * fs, char const * name, bool writeMod
             d->api->truncate( d, 0 );
         }
     }
-    k = (whefs_stream_closer_kludge*)malloc(sizeof(whefs_stream_closer_kludge));
-    if( ! k )
-    {
-        d->api->finalize(d);
-        return 0;
-    }
     s = whio_stream_for_dev( d, true );
     if( ! s )
     {
-        free(k);
         d->api->finalize(d);
     }
     else
     {
-        k->fs = fs;
-        k->stream = s;
+        /* Closing s closes d, which removes s' entry from the closer list. */
         whefs_fs_closer_stream_add( fs, s, d );
-        d->client.data = k;
-        d->client.dtor = whefs_stream_closer_kludge_dtor;
     }
     return s;
 }
 
+whio_stream * whefs_stream_open( whefs_fs * fs, char const * name, bool writeMode, bool append )
+{
+    whio_stream * s;
+    if( ! fs ) return 0;
+    WHEFS_FS_WRLOCK(fs);
+    s = whefs_stream_open_impl( fs, name, writeMode, append );
+    WHEFS_FS_UNLOCK(fs);
+    return s;
+}
+
 
 whio_dev * whefs_fdev( whefs_file * f )
 {
@@ -355,10 +346,13 @@ int whefs_fclose( whefs_file * f )
     int rc = f ? whefs_rc.OK : whefs_rc.ArgError;
     if( whefs_rc.OK == rc )
     {
-        whefs_fs_closer_file_remove( f->fs, f );
-	if( WHEFS_FILE_ISRW(f) && WHEFS_FILE_ISOPENED(f) ) whefs_fs_flush( f->fs );
+        whefs_fs * fs = f->fs;
+        WHEFS_FS_WRLOCK(fs);
+        whefs_fs_closer_file_remove( fs, f );
+	if( WHEFS_FILE_ISRW(f) && WHEFS_FILE_ISOPENED(f) ) whefs_fs_flush( fs );
 	if( f->dev ) f->dev->api->finalize(f->dev);
 	whefs_file_free(f);
+        WHEFS_FS_UNLOCK(fs);
     }
     return rc;
 }
@@ -461,11 +455,14 @@ int whefs_unlink_filename( whefs_fs * fs, char const * fname )
     if( ! fs || !fname ) return whefs_rc.ArgError;
     else {
         whefs_inode ino = whefs_inode_empty;
-        int rc = whefs_inode_by_name( fs, (char const *) /* FIXME: signedness*/ fname, &ino );
+        int rc;
+        WHEFS_FS_WRLOCK(fs);
+        rc = whefs_inode_by_name( fs, (char const *) /* FIXME: signedness*/ fname, &ino );
         if( whefs_rc.OK == rc )
         {
             rc = whefs_inode_unlink( fs, &ino );
         }
+        WHEFS_FS_UNLOCK(fs);
         return rc;
     }
 }
@@ -492,17 +489,21 @@ int whefs_fstat( whefs_file const * f, whefs_file_stats * st )
     if( ! f || !st ) return whefs_rc.ArgError;
     *st = whefs_file_stats_empty;
     st->inode = f->inode;
+    WHEFS_FS_WRLOCK(f->fs);
     rc = whefs_inode_id_read( f->fs, f->inode, &ino );
-    if( whefs_rc.OK != rc ) return rc;
-    st->bytes = ino.data_size;
-    bl.id = bid;
-    while( bl.id )
+    if( whefs_rc.OK == rc )
     {
-	++st->blocks;
-	rc = whefs_block_read( f->fs, bl.id, &bl );
-	if( whefs_rc.OK != rc ) return rc;
-	bl.id = bl.next_block;
+        st->bytes = ino.data_size;
+        bl.id = bid;
+        while( bl.id )
+        {
+            ++st->blocks;
+            rc = whefs_block_read( f->fs, bl.id, &bl );
+            if( whefs_rc.OK != rc ) break;
+            bl.id = bl.next_block;
+        }
     }
+    WHEFS_FS_UNLOCK(f->fs);
     return rc;
 }
 
@@ -512,16 +513,19 @@ int whefs_file_name_set( whefs_file * f, char const * newName )
     int rc;
     if( ! f || (! newName || !*newName) ) return whefs_rc.ArgError;
     if( ! WHEFS_FILE_ISRW(f) ) return whefs_rc.AccessError;
+    WHEFS_FS_WRLOCK(f->fs);
     rc = whefs_inode_search_opened( f->fs, f->inode, &ino );
     if( whefs_rc.OK != rc )
     {
 	WHEFS_DBG_ERR("This should never ever happen: f appears to be a valid whefs_file, but we could find no associated opened inode!");
-	return rc;
     }
-    rc = whefs_inode_name_set( f->fs, ino->id, newName );
-    if( whefs_rc.OK != rc ) return rc;
-    /*whefs_inode_flush( f->fs, ino ); */
-    return whefs_rc.OK;
+    else
+    {
+        rc = whefs_inode_name_set( f->fs, ino->id, newName );
+        /*whefs_inode_flush( f->fs, ino ); */
+    }
+    WHEFS_FS_UNLOCK(f->fs);
+    return rc;
 }
 
 char const * whefs_file_name_get( whefs_file * f )
@@ -538,7 +542,10 @@ char const * whefs_file_name_get( whefs_file * f )
     }
     return ino->name.string;
 #else
-    int rc =whefs_inode_name_get( f->fs, f->inode, &f->name );
+    int rc;
+    WHEFS_FS_WRLOCK(f->fs);
+    rc = whefs_inode_name_get( f->fs, f->inode, &f->name );
+    WHEFS_FS_UNLOCK(f->fs);
     if( whefs_rc.OK != rc )
     {
 	WHEFS_DBG_ERR("This should never ever happen: f appears to be a "
@@ -553,12 +560,17 @@ whio_size_t whefs_fsize( whefs_file const * f )
 {
 #if 1
     whefs_inode * ino = 0;
-    int rc;
+    whio_size_t sz = whefs_rc.SizeTError;
     if( ! f ) return whefs_rc.SizeTError;
-    rc = whefs_inode_search_opened( f->fs, f->inode, &ino );
-    return (whefs_rc.OK == rc)
-	? ino->data_size
-	: whefs_rc.SizeTError;
+    WHEFS_FS_RDLOCK(f->fs);
+    if( whefs_rc.OK == whefs_inode_search_opened( f->fs, f->inode, &ino ) )
+    {
+        WHEFS_INODE_LOCK(ino);
+        sz = ino->data_size;
+        WHEFS_INODE_UNLOCK(ino);
+    }
+    WHEFS_FS_UNLOCK(f->fs);
+    return sz;
 #else /* faster, but not technically const */
     return (f && f->dev)
 	? whio_dev_size( f->dev )
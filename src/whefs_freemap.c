@@ -0,0 +1,260 @@
+/**
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/
+
+  License: Public Domain
+
+  This file contains the persistent free-space map: an on-disk copy
+  of the used-blocks bitset plus a per-region count of free blocks,
+  stored directly after the blocks table.
+
+  On-disk layout (starting at fs->offsets[WHEFS_OFF_FREEMAP]):
+
+  - 1 tag byte ('F')
+  - one encoded uint32 per region of whefs_freemap_region_blocks
+    blocks, holding the number of free blocks in that region.
+  - the bitset bytes, using the same bit layout as fs->bits.b (bit N
+    is set if block #N is used; bit 0 is always set).
+
+  The block headers remain the authoritative record of block
+  state. whefs_block_flush() updates the map before writing a header
+  which marks a block as used, and after writing one which marks a
+  block as free, so an interrupted update can only leave a block
+  marked as used in the map (a leaked block), never the reverse.
+*/
+
+#include "whefs_details.c"
+#include "whefs_encode.h"
+#include <stdlib.h> /* malloc(), realloc(), free() */
+#include <string.h> /* memcpy() */
+
+static const unsigned char whefs_freemap_tag_char = 'F';
+
+/**
+   Returns the number of free-count regions needed for the given block
+   count. Region #0 also covers the reserved block ID 0.
+*/
+static whefs_id_type whefs_freemap_regions_for( whefs_id_type blockCount )
+{
+    return (whefs_id_type)((blockCount / whefs_freemap_region_blocks) + 1);
+}
+
+/**
+   Returns the number of bitset bytes stored in the map for the given
+   block count.
+*/
+static whio_size_t whefs_freemap_bytes_for( whefs_id_type blockCount )
+{
+    return (whio_size_t)((blockCount / 8) + 1);
+}
+
+whio_size_t whefs_fs_sizeof_freemap( whefs_fs_options const * opt )
+{
+    if( ! opt ) return 0;
+    return 1 /* tag */
+        + (whio_sizeof_encoded_uint32 * whefs_freemap_regions_for( opt->block_count ))
+        + whefs_freemap_bytes_for( opt->block_count );
+}
+
+/** Returns the on-disk position of the given region's free count. */
+static whio_size_t whefs_freemap_count_pos( whefs_fs const * fs, whefs_id_type region )
+{
+    return fs->offsets[WHEFS_OFF_FREEMAP] + 1
+        + (region * whio_sizeof_encoded_uint32);
+}
+
+/** Returns the on-disk position of the bitset byte holding block #id. */
+static whio_size_t whefs_freemap_byte_pos( whefs_fs const * fs, whefs_id_type id )
+{
+    return whefs_freemap_count_pos( fs, fs->freemap.regions ) + (id / 8);
+}
+
+/**
+   (Re)allocates fs->freemap.counts for the current block count and
+   fills it in from fs->bits.b. Does no i/o.
+*/
+static int whefs_freemap_count( whefs_fs * fs )
+{
+    const whefs_id_type bc = fs->options.block_count;
+    const whefs_id_type regions = whefs_freemap_regions_for( bc );
+    uint32_t * counts;
+    whefs_id_type r;
+    whbits_count_t i, end, used;
+    counts = (uint32_t *) realloc( fs->freemap.counts, regions * sizeof(uint32_t) );
+    if( ! counts ) return whefs_rc.AllocError;
+    fs->freemap.counts = counts;
+    fs->freemap.regions = regions;
+    fs->freemap.free = 0;
+    for( r = 0; r < regions; ++r )
+    {
+        i = (whbits_count_t)r * whefs_freemap_region_blocks;
+        end = i + whefs_freemap_region_blocks;
+        if( end > ((whbits_count_t)bc + 1) ) end = (whbits_count_t)bc + 1;
+        used = 0;
+        while( i < end )
+        { /* alternate between runs of used and free bits */
+            const whbits_count_t x = whbits_find_unset( &fs->bits.b, i, end );
+            used += x - i;
+            i = (x < end) ? whbits_find_set( &fs->bits.b, x, end ) : end;
+        }
+        counts[r] = (uint32_t)((end - (whbits_count_t)r * whefs_freemap_region_blocks) - used);
+        fs->freemap.free += counts[r];
+    }
+    return whefs_rc.OK;
+}
+
+int whefs_fs_freemap_write( whefs_fs * fs )
+{
+    whio_size_t len, nbytes;
+    unsigned char * buf;
+    unsigned char * bp;
+    whefs_id_type r;
+    int rc;
+    if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    else if( !whefs_fs_is_rw(fs) ) return whefs_rc.AccessError;
+    else if( !fs->bits.b.bytes ) return whefs_rc.InternalError;
+    whbits_set( &fs->bits.b, 0 ); /* block ID 0 is reserved for "not a block". */
+    rc = whefs_freemap_count( fs );
+    if( whefs_rc.OK != rc ) return fs->err = rc;
+    nbytes = whefs_freemap_bytes_for( fs->options.block_count );
+    len = whefs_fs_sizeof_freemap( &fs->options );
+    buf = (unsigned char *) malloc( len );
+    if( ! buf ) return fs->err = whefs_rc.AllocError;
+    bp = buf;
+    *(bp++) = whefs_freemap_tag_char;
+    for( r = 0; r < fs->freemap.regions; ++r )
+    {
+        bp += whio_encode_uint32( bp, fs->freemap.counts[r] );
+    }
+    memcpy( bp, fs->bits.b.bytes, nbytes );
+    rc = (len == whefs_fs_writeat( fs, fs->offsets[WHEFS_OFF_FREEMAP], buf, len ))
+        ? whefs_rc.OK
+        : whefs_rc.IOError;
+    free( buf );
+    if( whefs_rc.OK != rc ) return fs->err = rc;
+    fs->freemap.loaded = true;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_freemap_read( whefs_fs * fs )
+{
+    whio_size_t len, nbytes;
+    unsigned char * buf;
+    unsigned char const * bp;
+    uint32_t * counts;
+    whefs_id_type r, regions;
+    int rc = whefs_rc.OK;
+    if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    else if( !fs->bits.b.bytes ) return whefs_rc.InternalError;
+    regions = whefs_freemap_regions_for( fs->options.block_count );
+    nbytes = whefs_freemap_bytes_for( fs->options.block_count );
+    if( nbytes > fs->bits.b.sz_bytes ) return fs->err = whefs_rc.InternalError;
+    len = whefs_fs_sizeof_freemap( &fs->options );
+    counts = (uint32_t *) realloc( fs->freemap.counts, regions * sizeof(uint32_t) );
+    if( ! counts ) return fs->err = whefs_rc.AllocError;
+    fs->freemap.counts = counts;
+    fs->freemap.regions = regions;
+    fs->freemap.free = 0;
+    buf = (unsigned char *) malloc( len );
+    if( ! buf ) return fs->err = whefs_rc.AllocError;
+    if( len != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_FREEMAP], buf, len ) )
+    {
+        rc = whefs_rc.IOError;
+    }
+    else if( whefs_freemap_tag_char != buf[0] )
+    {
+        rc = whefs_rc.ConsistencyError;
+    }
+    else
+    {
+        bp = buf + 1;
+        for( r = 0; (r < regions) && (whefs_rc.OK == rc); ++r )
+        {
+            rc = whio_decode_uint32( bp, &counts[r] );
+            fs->freemap.free += counts[r];
+            bp += whio_sizeof_encoded_uint32;
+        }
+        if( whefs_rc.OK == rc )
+        {
+            memcpy( fs->bits.b.bytes, bp, nbytes );
+            fs->freemap.loaded = true;
+        }
+    }
+    free( buf );
+    if( whefs_rc.OK != rc ) fs->err = rc;
+    return rc;
+}
+
+int whefs_fs_freemap_mark_range( whefs_fs * fs, whefs_id_type first, whefs_id_type count, bool used )
+{
+    unsigned char buf[whio_sizeof_encoded_uint32];
+    const whefs_id_type bc = fs->options.block_count;
+    whefs_id_type id, last, r;
+    whio_size_t len;
+    bool changed = false;
+    if( ! fs->freemap.loaded || !first || !count || (first > bc) ) return whefs_rc.OK;
+    last = ((count - 1) > (bc - first)) ? bc : (first + count - 1);
+    for( id = first; id <= last; ++id )
+    {
+        if( (WHBITS_GET(&fs->bits.b,id) ? true : false) == used ) continue;
+        r = id / whefs_freemap_region_blocks;
+        if( used )
+        {
+            whbits_set( &fs->bits.b, id );
+            if( fs->freemap.counts[r] ) --fs->freemap.counts[r];
+            if( fs->freemap.free ) --fs->freemap.free;
+        }
+        else
+        {
+            whbits_unset( &fs->bits.b, id );
+            ++fs->freemap.counts[r];
+            ++fs->freemap.free;
+        }
+        changed = true;
+    }
+    if( ! changed ) return whefs_rc.OK;
+    len = (last / 8) - (first / 8) + 1;
+    if( len != whefs_fs_writeat( fs, whefs_freemap_byte_pos( fs, first ), &WHBITS_BYTEFOR(&fs->bits.b,first), len ) )
+    {
+        return fs->err = whefs_rc.IOError;
+    }
+    for( r = first / whefs_freemap_region_blocks; r <= (last / whefs_freemap_region_blocks); ++r )
+    {
+        whio_encode_uint32( buf, fs->freemap.counts[r] );
+        if( whio_sizeof_encoded_uint32 != whefs_fs_writeat( fs, whefs_freemap_count_pos( fs, r ), buf, whio_sizeof_encoded_uint32 ) )
+        {
+            return fs->err = whefs_rc.IOError;
+        }
+    }
+    return whefs_rc.OK;
+}
+
+int whefs_fs_freemap_mark( whefs_fs * fs, whefs_id_type id, bool used )
+{
+    return whefs_fs_freemap_mark_range( fs, id, 1, used );
+}
+
+whefs_id_type whefs_fs_freemap_next_candidate( whefs_fs const * fs, whefs_id_type id )
+{
+    whefs_id_type r;
+    if( ! fs->freemap.loaded ) return id;
+    if( ! fs->freemap.free ) return fs->options.block_count + 1;
+    for( r = id / whefs_freemap_region_blocks; r < fs->freemap.regions; ++r )
+    {
+        if( fs->freemap.counts[r] )
+        {
+            const whefs_id_type start = r * whefs_freemap_region_blocks;
+            return (start > id) ? start : id;
+        }
+    }
+    return fs->options.block_count + 1;
+}
+
+void whefs_fs_freemap_clear( whefs_fs * fs )
+{
+    if( ! fs ) return;
+    free( fs->freemap.counts );
+    fs->freemap.counts = 0;
+    fs->freemap.regions = 0;
+    fs->freemap.free = 0;
+    fs->freemap.loaded = false;
+}
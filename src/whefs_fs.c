@@ -17,6 +17,7 @@
 #include <wh/whefs/whefs_string.h>
 #include "whefs_encode.h"
 #include "whefs_cache.h"
+#include "whefs_namescan.h"
 #include "whefs_details.c"
 #include <wh/whio/whio_devs.h>
 #include <wh/whio/whio_encode.h>
@@ -55,9 +56,14 @@ but i need to look closer to be sure.
 #if WHEFS_CONFIG_ENABLE_THREADS
 /**
    WHEFS_FS_STRUCT_THREAD_INFO is the initializer for whefs_fs.threads.
+   whefs_fs_threads_init() re-initializes the locks.
 */
 #  define WHEFS_FS_STRUCT_THREAD_INFO {/*threads*/ \
-        0 /* placeholder */ \
+        0, /* placeholder */ \
+        PTHREAD_RWLOCK_INITIALIZER, /* rw */ \
+        0, /* owner */ \
+        0U, /* depth */ \
+        PTHREAD_MUTEX_INITIALIZER /* io */ \
     }
 #else
 #  define WHEFS_FS_STRUCT_THREAD_INFO {0/* placeholder */}
@@ -67,8 +73,16 @@ but i need to look closer to be sure.
 /* whefs_fs::cache struct ... */
 #define WHEFS_FS_STRUCT_CACHE                \
     {/*cache*/                                  \
-        0/*hashes*/,                        \
-        whefs_hash_cstring/*hashfunc*/,     \
+        whefs_hashid_table_empty_m/*hashes*/, \
+        whefs_hash_wy/*hashfunc*/,     \
+        false/*complete*/, \
+        { /* filter */ \
+            0, /* counts */ \
+            0, /* size */ \
+            WHEFS_CONFIG_ENABLE_NAME_FILTER ? true : false, /* enabled */ \
+            false, /* loaded */ \
+            whefs_name_filter_stats_empty_m /* stats */ \
+        } \
     }
 
 /* whefs_fs::bits struct ... */
@@ -87,6 +101,77 @@ but i need to look closer to be sure.
 	2 /* unused_inode_start == 2 b/c IDs 0 and 1 are reserved for not-an-inode and the root node */  \
     }
 
+/* whefs_fs::alloc struct ... */
+#define WHEFS_FS_STRUCT_ALLOC                  \
+    { /* alloc */ \
+	WHEFS_CONFIG_EXTENT_MIN_BLOCKS /* extent_min */ \
+    }
+
+/* whefs_fs::readahead struct ... */
+#define WHEFS_FS_STRUCT_READAHEAD                  \
+    { /* readahead */ \
+	WHEFS_CONFIG_READAHEAD_BLOCKS /* blocks */ \
+    }
+
+/* whefs_fs::pcache struct ... */
+#define WHEFS_FS_STRUCT_PCACHE                  \
+    { /* pcache */ \
+        WHEFS_CONFIG_CACHE_BYTES, /* budget */ \
+        0, /* mem */ \
+        0, /* pages */ \
+        0, /* buckets */ \
+        0, /* bucketMask */ \
+        0, /* hand */ \
+        WHEFS_CONFIG_CACHE_DIRTY_BYTES, /* dirtyMax */ \
+        WHEFS_CONFIG_CACHE_DIRTY_SECONDS, /* dirtyAge */ \
+        0, /* dirtySince */ \
+        whefs_cache_stats_empty_m /* stats */ \
+    }
+
+/* whefs_fs::freemap struct ... */
+#define WHEFS_FS_STRUCT_FREEMAP                  \
+    { /* freemap */ \
+        0, /* counts */ \
+        0, /* regions */ \
+        0, /* free */ \
+        false /* loaded */ \
+    }
+
+/* whefs_fs::nameidx struct ... */
+#define WHEFS_FS_STRUCT_NAMEIDX                  \
+    { /* nameidx */ \
+        0 /* slots */ \
+    }
+
+/* whefs_fs::opened_nodes struct ... */
+#define WHEFS_FS_STRUCT_OPENED_NODES                  \
+    { /* opened_nodes */ \
+        0, /* slots */ \
+        0, /* mask */ \
+        0, /* count */ \
+        0, /* slabs */ \
+        0 /* free */ \
+    }
+
+/* whefs_fs::itable struct ... */
+#define WHEFS_FS_STRUCT_ITABLE                  \
+    { /* itable */ \
+        0, /* list */ \
+        0, /* count */ \
+        WHEFS_CONFIG_ENABLE_INODE_TABLE ? true : false /* enabled */ \
+    }
+
+/* whefs_fs::names struct ... */
+#define WHEFS_FS_STRUCT_NAMES                  \
+    { /* names */ \
+        0, /* mem */ \
+        0, /* stride */ \
+        0, /* count */ \
+        0, /* sorted */ \
+        0, /* sortedCount */ \
+        WHEFS_CONFIG_ENABLE_NAME_TABLE ? true : false /* enabled */ \
+    }
+
 /**
    An empty whefs_fs object for us in initializing new objects.
 */
@@ -98,11 +183,18 @@ but i need to look closer to be sure.
     0, /* dev */ \
     true, /* ownsDev */ \
     0, /* filesize */ \
-    0, /* opened_nodes */ \
-    0, /* closers */ \
+    WHEFS_FS_STRUCT_OPENED_NODES, \
+    {0,0}, /* closers */ \
     0, /* fileno */ \
     WHEFS_FS_STRUCT_BITS,    \
     WHEFS_FS_STRUCT_HINTS,   \
+    WHEFS_FS_STRUCT_ALLOC,   \
+    WHEFS_FS_STRUCT_READAHEAD,   \
+    WHEFS_FS_STRUCT_FREEMAP, \
+    WHEFS_FS_STRUCT_NAMEIDX, \
+    WHEFS_FS_STRUCT_PCACHE, \
+    WHEFS_FS_STRUCT_ITABLE, \
+    WHEFS_FS_STRUCT_NAMES, \
     WHEFS_FS_OPTIONS_DEFAULT, \
     WHEFS_FS_STRUCT_THREAD_INFO, \
     WHEFS_FS_STRUCT_CACHE,       \
@@ -147,6 +239,14 @@ static whefs_fs * whefs_fs_alloc()
 #endif /* WHEFS_CONFIG_ENABLE_STATIC_MALLOC */
     if( ! obj ) obj = (whefs_fs *) malloc( sizeof(whefs_fs) );
     if( obj ) *obj = whefs_fs_empty;
+#if WHEFS_CONFIG_ENABLE_THREADS
+    /* (WHEFS_CONFIG_ENABLE_STATIC_MALLOC is off in this case) */
+    if( obj && (whefs_rc.OK != whefs_fs_threads_init( obj )) )
+    {
+        free( obj );
+        obj = 0;
+    }
+#endif
     return obj;
 }
 /** @internal
@@ -155,8 +255,11 @@ static whefs_fs * whefs_fs_alloc()
 */
 static void whefs_fs_free( whefs_fs * obj )
 {
-    if( obj ) *obj = whefs_fs_empty;
-    else return;
+    if( ! obj ) return;
+#if WHEFS_CONFIG_ENABLE_THREADS
+    whefs_fs_threads_destroy( obj );
+#endif
+    *obj = whefs_fs_empty;
 #if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
     if( (obj < &whefs_fs_alloc_slots.objs[0]) ||
 	(obj > &whefs_fs_alloc_slots.objs[whefs_fs_alloc_count-1]) )
@@ -177,6 +280,72 @@ static void whefs_fs_free( whefs_fs * obj )
 }
 
 
+#if WHEFS_CONFIG_ENABLE_THREADS
+/**
+   Each thread's address of this identifies it as the owner of a
+   whefs_fs::threads.rw lock which it holds exclusively.
+*/
+static __thread char whefs_thread_token;
+
+int whefs_mutex_init_recursive( pthread_mutex_t * m )
+{
+    pthread_mutexattr_t attr;
+    int rc = pthread_mutexattr_init( &attr );
+    if( rc ) return rc;
+    rc = pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+    if( ! rc ) rc = pthread_mutex_init( m, &attr );
+    pthread_mutexattr_destroy( &attr );
+    return rc;
+}
+
+int whefs_fs_threads_init( whefs_fs * fs )
+{
+    if( pthread_rwlock_init( &fs->threads.rw, 0 ) ) return whefs_rc.InternalError;
+    if( whefs_mutex_init_recursive( &fs->threads.io ) )
+    {
+        pthread_rwlock_destroy( &fs->threads.rw );
+        return whefs_rc.InternalError;
+    }
+    fs->threads.owner = 0;
+    fs->threads.depth = 0;
+    return whefs_rc.OK;
+}
+
+void whefs_fs_threads_destroy( whefs_fs * fs )
+{
+    pthread_mutex_destroy( &fs->threads.io );
+    pthread_rwlock_destroy( &fs->threads.rw );
+}
+
+void whefs_fs_rwlock_acquire( whefs_fs * fs, bool write )
+{
+    if( &whefs_thread_token == __atomic_load_n( &fs->threads.owner, __ATOMIC_RELAXED ) )
+    { /* we already hold it exclusively */
+        ++fs->threads.depth;
+    }
+    else if( write )
+    {
+        pthread_rwlock_wrlock( &fs->threads.rw );
+        __atomic_store_n( &fs->threads.owner, (void*)&whefs_thread_token, __ATOMIC_RELAXED );
+        fs->threads.depth = 1;
+    }
+    else
+    {
+        pthread_rwlock_rdlock( &fs->threads.rw );
+    }
+}
+
+void whefs_fs_rwlock_release( whefs_fs * fs )
+{
+    if( &whefs_thread_token == __atomic_load_n( &fs->threads.owner, __ATOMIC_RELAXED ) )
+    {
+        if( --fs->threads.depth ) return;
+        __atomic_store_n( &fs->threads.owner, (void*)0, __ATOMIC_RELAXED );
+    }
+    pthread_rwlock_unlock( &fs->threads.rw );
+}
+#endif /* WHEFS_CONFIG_ENABLE_THREADS */
+
 int whefs_fs_lock( whefs_fs * fs, bool writeLock, off_t start, int whence, off_t len )
 {
 #if WHEFS_CONFIG_ENABLE_FCNTL
@@ -329,6 +498,7 @@ static int whefs_fs_mmap_connect( whefs_fs * fs )
             whio_dev_api_mmap.flush = whio_dev_mmap_flush;
             whio_dev_api_mmap.close = whio_dev_mmap_close;
         }
+        whefs_fs_pcache_flush( fs );
         dsz = whio_dev_size( fs->dev );
         m = mmap( 0, dsz, whefs_fs_is_rw(fs) ? PROT_WRITE : PROT_READ, MAP_SHARED, fs->fileno, 0 );
         if( ! m )
@@ -413,23 +583,87 @@ whio_size_t whefs_fs_read( whefs_fs * fs, void * dest, whio_size_t n )
 }
 whio_size_t whefs_fs_write( whefs_fs * fs, void const * src, whio_size_t n )
 {
-    return (fs && fs->dev)
-	? fs->dev->api->write( fs->dev, src, n )
-	: 0;
+    whio_size_t pos, x;
+    if( ! fs || !fs->dev ) return 0;
+    pos = fs->dev->api->tell( fs->dev );
+    if( whio_rc.SizeTError != pos ) whefs_fs_pcache_sync( fs, pos, n );
+    x = fs->dev->api->write( fs->dev, src, n );
+    if( whio_rc.SizeTError != pos ) whefs_fs_pcache_update( fs, pos, 0, n );
+    else whefs_fs_pcache_clear( fs );
+    return x;
 }
 
 whio_size_t whefs_fs_writeat( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n )
 {
-    whio_size_t x = whefs_fs_seek( fs, (off_t)pos, SEEK_SET );
-    if( x != pos ) return 0;
-    return whefs_fs_write( fs, src, n );
+    whio_size_t x;
+    if( ! fs || !fs->dev ) return 0;
+    if( fs->pcache.budget ) return whefs_fs_pcache_write( fs, pos, src, n );
+    x = whio_dev_writeat( fs->dev, pos, src, n );
+    return (whio_rc.SizeTError == x) ? 0 : x;
 }
 
 whio_size_t whefs_fs_readat( whefs_fs * fs, whio_size_t pos, void * dest, whio_size_t n )
 {
-    whio_size_t x = whefs_fs_seek( fs, (off_t)pos, SEEK_SET );
-    if( x != pos ) return 0;
-    return whefs_fs_read( fs, dest, n );
+    whio_size_t x;
+    if( ! fs || !fs->dev ) return 0;
+    if( fs->pcache.budget ) return whefs_fs_pcache_read( fs, pos, dest, n );
+    x = whio_dev_readat( fs->dev, pos, dest, n );
+    return (whio_rc.SizeTError == x) ? 0 : x;
+}
+
+whio_size_t whefs_fs_readvat( whefs_fs * fs, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t x, i, total = 0;
+    if( ! fs || !fs->dev ) return 0;
+    if( fs->pcache.budget )
+    {
+        for( i = 0; i < count; ++i ) total += iov[i].len;
+    }
+    if( total && (total <= (fs->pcache.budget / 8)) )
+    { /* small enough for the page cache: read it one segment at a time */
+        for( i = 0, total = 0; i < count; ++i )
+        {
+            if( ! iov[i].len ) continue;
+            x = whefs_fs_pcache_read( fs, pos + total, iov[i].base, iov[i].len );
+            total += x;
+            if( x != iov[i].len ) break;
+        }
+        return total;
+    }
+    if( total && (whefs_rc.OK != whefs_fs_pcache_sync( fs, pos, total )) ) return 0;
+    x = whio_dev_readvat( fs->dev, pos, iov, count );
+    return (whio_rc.SizeTError == x) ? 0 : x;
+}
+
+whio_size_t whefs_fs_writevat( whefs_fs * fs, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t x, i, done = 0;
+    if( ! fs || !fs->dev ) return 0;
+    if( fs->pcache.budget && fs->pcache.dirtyMax )
+    {
+        for( i = 0; i < count; ++i ) done += iov[i].len;
+    }
+    if( done && (done <= (fs->pcache.budget / 8)) )
+    { /* small enough to be buffered: write it one segment at a time */
+        for( i = 0, done = 0; i < count; ++i )
+        {
+            if( ! iov[i].len ) continue;
+            x = whefs_fs_pcache_write( fs, pos + done, iov[i].base, iov[i].len );
+            done += x;
+            if( x != iov[i].len ) break;
+        }
+        return done;
+    }
+    done = 0;
+    x = whio_dev_writevat( fs->dev, pos, iov, count );
+    if( whio_rc.SizeTError == x ) return 0;
+    for( i = 0; (i < count) && (done < x); ++i )
+    {
+        const whio_size_t len = ((x - done) < iov[i].len) ? (x - done) : iov[i].len;
+        whefs_fs_pcache_update( fs, pos + done, iov[i].base, len );
+        done += len;
+    }
+    return x;
 }
 
 whio_size_t whefs_fs_seek( whefs_fs * fs, off_t offset, int whence )
@@ -452,7 +686,12 @@ int whefs_fs_flush( whefs_fs * fs )
     {
         if( whefs_fs_is_rw(fs) )
         {
-            return fs->dev->api->flush( fs->dev );
+            int rc;
+            WHEFS_FS_WRLOCK(fs);
+            rc = whefs_fs_pcache_flush( fs );
+            if( whefs_rc.OK == rc ) rc = fs->dev->api->flush( fs->dev );
+            WHEFS_FS_UNLOCK(fs);
+            return rc;
         }
         return whefs_rc.AccessError;
     }
@@ -473,70 +712,69 @@ WHEFS_ERR_IO_WRITE   = WHEFS_ERR_IO | 0x02
 
 void whefs_fs_caches_names_clear( whefs_fs * fs )
 {
-    if( fs->cache.hashes )
+    if( fs->cache.hashes.count )
     {
-        WHEFS_DBG_CACHE("Emptying names hash cache using %"WHEFS_ID_TYPE_PFMT" of %"WHEFS_ID_TYPE_PFMT" entries and %u bytes.",
-                        fs->cache.hashes->count,
-                        fs->cache.hashes->alloced,
-                        whefs_hashid_list_sizeof(fs->cache.hashes) );
-#if 0
-        whefs_hashid * h = 0;
-	whefs_id_type i;
-        for( i = 0; i < fs->cache.hashes->count; ++i )
-        {
-            h = &fs->cache.hashes->list[i];
-            WHEFS_DBG_CACHE("inode #%"WHEFS_ID_TYPE_PFMT" cached entry.", h->id);
-        }
-#endif
-        whefs_hashid_list_alloc( &fs->cache.hashes, 0 );/* reminder: we keep fs->cache.hashes itself until finalization. */
+        WHEFS_DBG_CACHE("Emptying names hash cache using %"PRIu32" of %"PRIu32" entries and %u bytes.",
+                        fs->cache.hashes.count,
+                        fs->cache.hashes.alloced,
+                        (unsigned int)whefs_hashid_table_sizeof(&fs->cache.hashes) );
     }
+    whefs_hashid_table_clear( &fs->cache.hashes );
+    fs->cache.complete = false;
 }
 void whefs_fs_caches_clear( whefs_fs * fs )
 {
     whbits_free_bits( &fs->bits.i );
     whbits_free_bits( &fs->bits.b );
     whefs_fs_caches_names_clear( fs );
+    whefs_name_filter_clear( fs );
 }
 
 void whefs_fs_finalize( whefs_fs * fs )
 {
     if( ! fs ) return;
+    WHEFS_FS_WRLOCK(fs); /* waits for other threads' operations to finish */
     whefs_fs_flush(fs);
     whefs_fs_mmap_disconnect( fs );
     whefs_fs_hints_write( fs );
-    if( fs->closers )
+    if( fs->closers.head )
     {
         if( ! (fs->flags & WHEFS_FLAG_FS_NoAutoCloseFiles) )
         {
-            whefs_fs_closer_list * x;
             WHEFS_DBG_WARN("We're closing with opened objects! Closing them...");
-            while( fs->closers->prev )
-            {
-                fs->closers = fs->closers->prev;
-            }
-            x = fs->closers;
-            fs->closers = 0; /* we must do this b/c whefs_fs_closer_list_close() will indirectly use this list. */
-            whefs_fs_closer_list_close( x, true );
+            whefs_fs_closer_list_close( fs );
         }
         else
         {
             WHEFS_DBG_WARN("We're closing with opened objects and auto-close of files is disabled! They are leaking and MUST NOT be properly destroyed now!");
-            whefs_fs_closer_list_free( fs->closers );
+            fs->closers.head = fs->closers.tail = 0;
         }
-        fs->closers = 0;
     }
-    if( fs->opened_nodes )
+    if( fs->opened_nodes.count )
     {
+        whio_size_t i = 0;
 	WHEFS_DBG_WARN("We're closing with opened inodes! Closing them...");
-        while( fs->opened_nodes )
+        while( i <= fs->opened_nodes.mask )
         {
-            WHEFS_DBG_WARN("Auto-closing inode #%"WHEFS_ID_TYPE_PFMT", but leaking its whefs_file, whio_dev, or whio_stream handle (if any).",fs->opened_nodes->inode.id);
-            whefs_inode_close( fs, &fs->opened_nodes->inode, fs->opened_nodes->inode.writer );
-            /* reminder: whefs_inode_close() updates fs->opened_nodes directly. */
+            whefs_inode * ino = fs->opened_nodes.slots[i];
+            if( ! ino )
+            {
+                ++i;
+                continue;
+            }
+            WHEFS_DBG_WARN("Auto-closing inode #%"WHEFS_ID_TYPE_PFMT", but leaking its whefs_file, whio_dev, or whio_stream handle (if any).",ino->id);
+            whefs_inode_close( fs, ino, ino->writer );
+            /* reminder: whefs_inode_close() updates fs->opened_nodes directly,
+               possibly moving another inode into slot i. */
 	}
         /* this doesn't stop us from leaking unclosed whefs_file/whio_dev/whio_stream handles! */
     }
+    whefs_inode_opened_free(fs);
     whefs_fs_caches_clear(fs);
+    whefs_fs_freemap_clear(fs);
+    whefs_fs_pcache_free(fs);
+    whefs_fs_itable_free(fs);
+    whefs_fs_names_free(fs);
     whefs_fs_setopt_hash_cache( fs, false, false );
     if( fs->dev )
     {
@@ -550,6 +788,7 @@ void whefs_fs_finalize( whefs_fs * fs )
 	if( fs->ownsDev ) fs->dev->api->finalize( fs->dev );
 	fs->dev = 0;
     }
+    WHEFS_FS_UNLOCK(fs);
     whefs_fs_free( fs );
 }
 
@@ -572,6 +811,7 @@ static int whefs_mkfs_write_magic( whefs_fs * fs )
     if( ! fs || !fs->dev ) return whefs_rc.ArgError;
     else {
         whio_size_t wrc;
+        whefs_fs_pcache_clear( fs ); /* we bypass whefs_fs_writeat() */
         /*
           TODO: encode the butes in a buffer and only do one write().
           
@@ -608,14 +848,13 @@ int whefs_fs_hints_write( whefs_fs * fs )
         whefs_id_type h[2];
         h[0] = fs->hints.unused_inode_start;
         h[1] = fs->hints.unused_block_start;
-        fs->dev->api->seek( fs->dev, fs->offsets[WHEFS_OFF_HINTS], SEEK_SET );
         hlen = (sizeof(h)/sizeof(h[0]));
         *(bp++) = whefs_hints_tag_char;
         for( i = 0; i < hlen; ++i )
         {
             bp += whefs_id_encode( bp, h[i] );
         }
-        wrc = whio_dev_write( fs->dev, buf, Len );
+        wrc = whefs_fs_writeat( fs, fs->offsets[WHEFS_OFF_HINTS], buf, Len );
         return fs->err =
             (wrc == Len)
             ? whefs_rc.OK
@@ -625,17 +864,11 @@ int whefs_fs_hints_write( whefs_fs * fs )
 int whefs_fs_hints_read( whefs_fs * fs )
 {
     enum { Len = whefs_sizeof_encoded_hints };
-    whio_size_t sk;
     unsigned char buf[Len+1];
     unsigned char * bp = buf;
     if( ! fs || !fs->dev ) return whefs_rc.ArgError;
-    sk = fs->dev->api->seek( fs->dev, fs->offsets[WHEFS_OFF_HINTS], SEEK_SET );
     buf[Len] = 0;
-    if( sk != fs->offsets[WHEFS_OFF_HINTS] )
-    {
-        return fs->err = whefs_rc.IOError;
-    }
-    else if( Len != whio_dev_read( fs->dev, buf, Len ) )
+    if( Len != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_HINTS], buf, Len ) )
     {
         return fs->err = whefs_rc.IOError;
     }
@@ -664,6 +897,7 @@ int whefs_fs_hints_read( whefs_fs * fs )
 static int whefs_mkfs_write_options( whefs_fs * fs )
 {
     size_t pos, sz;
+    whefs_fs_pcache_clear( fs ); /* we bypass whefs_fs_writeat() */
     whefs_fs_seek( fs, fs->offsets[WHEFS_OFF_OPTIONS], SEEK_SET );
     assert( fs->dev->api->tell( fs->dev ) == fs->offsets[WHEFS_OFF_OPTIONS] );
     pos = whio_dev_encode_size_t( fs->dev, fs->options.block_size );
@@ -672,6 +906,10 @@ static int whefs_mkfs_write_options( whefs_fs * fs )
     sz = whefs_dev_id_encode( fs->dev, fs->options.inode_count );
     if( whefs_sizeof_encoded_id_type != sz ) return whefs_rc.IOError;
     pos += whio_dev_encode_uint16( fs->dev, fs->options.filename_length );
+    sz = whio_dev_encode_uint32( fs->dev, fs->options.data_alignment );
+    if( whio_sizeof_encoded_uint32 != sz ) return whefs_rc.IOError;
+    sz = whio_dev_encode_uint32( fs->dev, fs->options.name_index );
+    if( whio_sizeof_encoded_uint32 != sz ) return whefs_rc.IOError;
     return (pos>0) /* <--- this is not technically correct. */
 	? whefs_rc.OK
 	: whefs_rc.IOError;
@@ -687,6 +925,8 @@ static size_t whefs_fs_sizeof_options()
 	+ whefs_sizeof_encoded_id_type /* block_count */
 	+ whefs_sizeof_encoded_id_type /* inode_count */
 	+ whio_sizeof_encoded_uint16 /* filename_length */
+	+ whio_sizeof_encoded_uint32 /* data_alignment */
+	+ whio_sizeof_encoded_uint32 /* name_index */
 	;
 }
 
@@ -707,30 +947,17 @@ size_t whefs_fs_sizeof_name( whefs_fs_options const * opt )
 */
 static unsigned char const whefs_inode_name_tag_char = '"';
 
-int whefs_inode_name_get( whefs_fs * fs, whefs_id_type id, whefs_string * tgt )
-{ /* Maintenance reminder: this "should" be in whefs_inode.c, but it's not because
-     of whefs_inode_name_tag_char.
-   */
-    int rc = 0;
-    enum { bufSize = whefs_sizeof_encoded_inode_name };
-    unsigned char buf[bufSize + 1];
-    whio_size_t toRead, spos, rsz;
-    unsigned char * bufP;
+/**
+   Decodes the name record of inode #id from buf, which must hold
+   whefs_fs_sizeof_name(&fs->options) bytes, and copies the name to
+   dest, which must be at least fs->options.filename_length+1 bytes
+   long. Returns whefs_rc.OK on success.
+*/
+static int whefs_fs_name_decode( whefs_fs const * fs, whefs_id_type id, unsigned char const * buf, char * dest )
+{
+    int rc;
+    unsigned char const * bufP;
     uint16_t sl;
-    if( ! tgt || ! whefs_inode_id_is_valid( fs, id ) ) return whefs_rc.ArgError;
-    assert(fs->sizes[WHEFS_SZ_INODE_NAME] && "fs has not been set up properly!");
-    memset( buf, 0, bufSize + 1 );
-    toRead = whefs_fs_sizeof_name(&fs->options);
-    assert( toRead <= bufSize );
-    spos = fs->offsets[WHEFS_OFF_INODE_NAMES]
-        + (fs->sizes[WHEFS_SZ_INODE_NAME] * (id-1));
-    rsz = whefs_fs_readat( fs, spos, buf, toRead );
-    if( toRead != rsz )
-    {
-	WHEFS_DBG_ERR("Error #%d reading inode #"WHEFS_ID_TYPE_PFMT"'s name record!",rc,id);
-	return whefs_rc.IOError;
-    }
-    /*unsigned char const * buf = fs->buffers.nodeName; */
     if( buf[0] != whefs_inode_name_tag_char )
     {
 	WHEFS_DBG_ERR("Error reading inode #%"WHEFS_ID_TYPE_PFMT"'s name record! "
@@ -752,22 +979,366 @@ int whefs_inode_name_get( whefs_fs * fs, whefs_id_type id, whefs_string * tgt )
     }
     bufP += whio_sizeof_encoded_uint16; /* skip over size field */
     /*bufP += whio_sizeof_encoded_uint64; // skip hash field */
-    rc = whefs_string_copy_cstring( tgt, (char const *)bufP );
+    if( sl > fs->options.filename_length ) sl = fs->options.filename_length;
+    memcpy( dest, bufP, sl );
+    dest[sl] = 0;
+    return whefs_rc.OK;
+}
+
+char const * whefs_fs_name_peek( whefs_fs const * fs, whefs_id_type id )
+{
+    return (fs->names.mem && id && (id <= fs->names.count))
+        ? (fs->names.mem + ((id - 1) * fs->names.stride))
+        : 0;
+}
+
+/**
+   Reads and decodes inode #id's name record, copying the name to
+   dest, which must be at least WHEFS_MAX_FILENAME_LENGTH+1 bytes
+   long. Returns whefs_rc.OK on success. If the names table is held
+   in memory (see whefs_fs_names_load()) this does no i/o.
+*/
+static int whefs_fs_name_read( whefs_fs * fs, whefs_id_type id, char * dest )
+{
+    int rc = 0;
+    enum { bufSize = whefs_sizeof_encoded_inode_name };
+    unsigned char buf[bufSize + 1];
+    whio_size_t toRead, spos, rsz;
+    char const * mem = whefs_fs_name_peek( fs, id );
+    if( mem )
+    {
+        memcpy( dest, mem, strlen( mem ) + 1 );
+        return whefs_rc.OK;
+    }
+    assert(fs->sizes[WHEFS_SZ_INODE_NAME] && "fs has not been set up properly!");
+    memset( buf, 0, bufSize + 1 );
+    toRead = whefs_fs_sizeof_name(&fs->options);
+    assert( toRead <= bufSize );
+    spos = fs->offsets[WHEFS_OFF_INODE_NAMES]
+        + (fs->sizes[WHEFS_SZ_INODE_NAME] * (id-1));
+    rsz = whefs_fs_readat( fs, spos, buf, toRead );
+    if( toRead != rsz )
+    {
+	WHEFS_DBG_ERR("Error #%d reading inode #"WHEFS_ID_TYPE_PFMT"'s name record!",rc,id);
+	return whefs_rc.IOError;
+    }
+    return whefs_fs_name_decode( fs, id, buf, dest );
+}
+
+int whefs_fs_names_load( whefs_fs * fs )
+{
+    whefs_id_type nc;
+    whio_size_t rs;
+    whio_size_t len;
+    uint32_t stride;
+    unsigned char * buf;
+    char * mem;
+    whefs_id_type i;
+    int rc = whefs_rc.OK;
+    if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    nc = fs->options.inode_count;
+    rs = fs->sizes[WHEFS_SZ_INODE_NAME];
+    len = nc * rs;
+    stride = (uint32_t)fs->options.filename_length + 1;
+    whefs_fs_names_free( fs );
+    if( ! nc ) return whefs_rc.OK;
+    /* the padding lets whefs_name_scan() search the table in place */
+    mem = (char *) calloc( (nc * stride) + whefs_name_scan_pad, 1 );
+    buf = (unsigned char *) malloc( len );
+    if( !mem || !buf )
+    {
+        free( mem );
+        free( buf );
+        return whefs_rc.AllocError;
+    }
+    if( len != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_INODE_NAMES], buf, len ) )
+    {
+        WHEFS_DBG_ERR("Could not read the %"WHIO_SIZE_T_PFMT"-byte names table!", len );
+        rc = whefs_rc.IOError;
+    }
+    for( i = 0; (i < nc) && (whefs_rc.OK == rc); ++i )
+    {
+        rc = whefs_fs_name_decode( fs, i + 1, buf + (i * rs), mem + (i * stride) );
+    }
+    free( buf );
+    if( whefs_rc.OK != rc )
+    {
+        free( mem );
+        return rc;
+    }
+    fs->names.mem = mem;
+    fs->names.stride = stride;
+    fs->names.count = nc;
+    return whefs_rc.OK;
+}
+
+void whefs_fs_names_free( whefs_fs * fs )
+{
+    if( ! fs ) return;
+    free( fs->names.mem );
+    fs->names.mem = 0;
+    fs->names.stride = 0;
+    fs->names.count = 0;
+    free( fs->names.sorted );
+    fs->names.sorted = 0;
+    fs->names.sortedCount = 0;
+}
+
+/** A (name,id) pair, for sorting the names table with qsort(). */
+typedef struct
+{
+    char const * name;
+    whefs_id_type id;
+} whefs_name_ref;
+
+/** qsort() comparison function for whefs_name_ref: by name, then ID. */
+static int whefs_name_ref_cmp( void const * lhs, void const * rhs )
+{
+    whefs_name_ref const * l = (whefs_name_ref const *)lhs;
+    whefs_name_ref const * r = (whefs_name_ref const *)rhs;
+    int const rc = strcmp( l->name, r->name );
+    return rc ? rc : ((l->id < r->id) ? -1 : (l->id > r->id));
+}
+
+/** qsort() comparison function for whefs_id_type. */
+static int whefs_id_cmp( void const * lhs, void const * rhs )
+{
+    whefs_id_type const l = *((whefs_id_type const *)lhs);
+    whefs_id_type const r = *((whefs_id_type const *)rhs);
+    return (l < r) ? -1 : (l > r);
+}
+
+/**
+   Returns the position of the first entry of fs->names.sorted which
+   does not sort before the pair (name,id).
+*/
+static size_t whefs_fs_names_lower_bound( whefs_fs const * fs, char const * name, whefs_id_type id )
+{
+    size_t lo = 0, hi = fs->names.sortedCount, mid;
+    whefs_name_ref l, r;
+    r.name = name;
+    r.id = id;
+    while( lo < hi )
+    {
+        mid = lo + ((hi - lo) / 2);
+        l.id = fs->names.sorted[mid];
+        l.name = whefs_fs_name_peek( fs, l.id );
+        if( whefs_name_ref_cmp( &l, &r ) < 0 ) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+   Builds fs->names.sorted, if it is not already built. fs->names
+   must be loaded.
+*/
+static int whefs_fs_names_sort( whefs_fs * fs )
+{
+    const whefs_id_type nc = fs->names.count;
+    whefs_name_ref * refs;
+    whefs_id_type i, n = 0;
+    char const * name;
+    if( fs->names.sorted ) return whefs_rc.OK;
+    /* Room for every inode, so that renames never need to realloc. */
+    fs->names.sorted = (whefs_id_type *) malloc( nc * sizeof(whefs_id_type) );
+    refs = (whefs_name_ref *) malloc( nc * sizeof(whefs_name_ref) );
+    if( !fs->names.sorted || !refs )
+    {
+        free( fs->names.sorted );
+        fs->names.sorted = 0;
+        free( refs );
+        return whefs_rc.AllocError;
+    }
+    for( i = 1; i <= nc; ++i )
+    {
+        name = whefs_fs_name_peek( fs, i );
+        if( ! *name ) continue;
+        refs[n].name = name;
+        refs[n].id = i;
+        ++n;
+    }
+    qsort( refs, n, sizeof(whefs_name_ref), whefs_name_ref_cmp );
+    for( i = 0; i < n; ++i ) fs->names.sorted[i] = refs[i].id;
+    fs->names.sortedCount = n;
+    free( refs );
+    return whefs_rc.OK;
+}
+
+/**
+   Removes inode #id from fs->names.sorted, if that is built. name
+   must be the inode's name in fs->names, i.e. this must be called
+   before the name is changed.
+*/
+static void whefs_fs_names_sorted_remove( whefs_fs * fs, whefs_id_type id, char const * name )
+{
+    size_t pos;
+    if( !fs->names.sorted || !*name ) return;
+    pos = whefs_fs_names_lower_bound( fs, name, id );
+    if( (pos < fs->names.sortedCount) && (fs->names.sorted[pos] == id) )
+    {
+        memmove( fs->names.sorted + pos, fs->names.sorted + pos + 1,
+                 (fs->names.sortedCount - pos - 1) * sizeof(whefs_id_type) );
+        --fs->names.sortedCount;
+    }
+}
+
+/**
+   Inserts inode #id, whose name in fs->names is name, into
+   fs->names.sorted, if that is built.
+*/
+static void whefs_fs_names_sorted_insert( whefs_fs * fs, whefs_id_type id, char const * name )
+{
+    size_t pos;
+    if( !fs->names.sorted || !*name ) return;
+    assert( fs->names.sortedCount < fs->names.count );
+    pos = whefs_fs_names_lower_bound( fs, name, id );
+    memmove( fs->names.sorted + pos + 1, fs->names.sorted + pos,
+             (fs->names.sortedCount - pos) * sizeof(whefs_id_type) );
+    fs->names.sorted[pos] = id;
+    ++fs->names.sortedCount;
+}
+
+int whefs_fs_names_prefix( whefs_fs * fs, char const * prefix,
+                           whefs_id_type ** ids, whefs_id_type * count )
+{
+    size_t plen, pos, end, n;
+    whefs_id_type * rv;
+    int rc;
+    if( !fs || !prefix || !ids || !count ) return whefs_rc.ArgError;
+    *ids = 0;
+    *count = 0;
+    if( ! fs->names.mem ) return whefs_rc.UnsupportedError;
+    rc = whefs_fs_names_sort( fs );
+    if( whefs_rc.OK != rc ) return rc;
+    plen = strlen( prefix );
+    pos = whefs_fs_names_lower_bound( fs, prefix, 0 );
+    for( end = pos; (end < fs->names.sortedCount)
+             && (0 == strncmp( whefs_fs_name_peek( fs, fs->names.sorted[end] ), prefix, plen )); ++end )
+    {
+    }
+    n = end - pos;
+    if( ! n ) return whefs_rc.OK;
+    rv = (whefs_id_type *) malloc( n * sizeof(whefs_id_type) );
+    if( ! rv ) return whefs_rc.AllocError;
+    memcpy( rv, fs->names.sorted + pos, n * sizeof(whefs_id_type) );
+    qsort( rv, n, sizeof(whefs_id_type), whefs_id_cmp );
+    *ids = rv;
+    *count = (whefs_id_type)n;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_setopt_name_table( whefs_fs * fs, bool on )
+{
+    int rc = whefs_rc.OK;
+    if( ! fs ) return whefs_rc.ArgError;
+    if( on && !fs->names.mem && fs->dev ) rc = whefs_fs_names_load( fs );
+    else if( ! on ) whefs_fs_names_free( fs );
+    fs->names.enabled = (on && (whefs_rc.OK == rc));
+    return rc;
+}
+
+int whefs_fs_name_scan( whefs_fs * fs, char const * name, bool prefix,
+                        whefs_id_type start, whefs_id_type * id )
+{
+    enum { firstChunk = 16, /* records read by the first read */
+           maxChunk = 256 /* records read by later reads */
+    };
+    const whefs_id_type nc = fs ? fs->options.inode_count : 0;
+    const size_t hdr = whefs_sizeof_encoded_inode_name_header;
+    size_t slen, hit, pos, n, chunk, i;
+    whio_size_t rs, len;
+    unsigned char * buf;
+    unsigned char const * rec;
+    uint16_t sl;
+    int rc = whefs_rc.OK;
+    if( !fs || !name || !*name || !id ) return whefs_rc.ArgError;
+    *id = 0;
+    if( ! start ) start = 1;
+    slen = strlen( name );
+    if( (start > nc) || (slen > fs->options.filename_length) ) return whefs_rc.OK;
+    if( fs->names.mem && (nc <= fs->names.count) )
+    {
+        n = nc - start + 1;
+        hit = whefs_name_scan( (unsigned char const *)whefs_fs_name_peek( fs, start ),
+                               fs->names.stride, n, name, prefix ? slen : (slen + 1) );
+        if( hit < n ) *id = (whefs_id_type)(start + hit);
+        return whefs_rc.OK;
+    }
+    /**
+       Read the table in chunks and compare the name fields of the
+       records in the buffer, then check the length field of each
+       candidate. The chunks start small because listings call this
+       once per match, and grow for long runs of non-matches.
+    */
+    rs = fs->sizes[WHEFS_SZ_INODE_NAME];
+    assert( rs > slen + hdr );
+    buf = (unsigned char *) calloc( (maxChunk * rs) + hdr + whefs_name_scan_pad, 1 );
+    if( ! buf ) return whefs_rc.AllocError;
+    chunk = firstChunk;
+    for( i = start; (i <= nc) && !*id; i += n )
+    {
+        n = nc - i + 1;
+        if( n > chunk ) n = chunk;
+        len = n * rs;
+        if( len != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_INODE_NAMES] + (rs * (i - 1)), buf, len ) )
+        {
+            WHEFS_DBG_ERR("Could not read %"WHIO_SIZE_T_PFMT" bytes of the names table at inode #%"WHEFS_ID_TYPE_PFMT"!", len, (whefs_id_type)i );
+            rc = whefs_rc.IOError;
+            break;
+        }
+        for( pos = 0; pos < n; pos += hit + 1 )
+        {
+            hit = whefs_name_scan( buf + hdr + (pos * rs), rs, n - pos, name, slen );
+            if( (pos + hit) >= n ) break;
+            rec = buf + ((pos + hit) * rs);
+            if( (rec[0] != whefs_inode_name_tag_char)
+                || (whio_rc.OK != whio_decode_uint16( rec + 1 + whefs_sizeof_encoded_id_type, &sl )) )
+            {
+                WHEFS_DBG_ERR("Inode #%"WHEFS_ID_TYPE_PFMT"'s name record is corrupt!", (whefs_id_type)(i + pos + hit) );
+                rc = whefs_rc.ConsistencyError;
+                break;
+            }
+            if( prefix ? (sl >= slen) : (sl == slen) )
+            {
+                *id = (whefs_id_type)(i + pos + hit);
+                break;
+            }
+        }
+        if( whefs_rc.OK != rc ) break;
+        if( chunk < maxChunk ) chunk *= 2;
+    }
+    free( buf );
+    return rc;
+}
+
+int whefs_inode_name_get( whefs_fs * fs, whefs_id_type id, whefs_string * tgt )
+{ /* Maintenance reminder: this "should" be in whefs_inode.c, but it's not because
+     of whefs_inode_name_tag_char.
+   */
+    int rc;
+    char buf[WHEFS_MAX_FILENAME_LENGTH+1];
+    char const * name;
+    if( ! tgt || ! whefs_inode_id_is_valid( fs, id ) ) return whefs_rc.ArgError;
+    name = whefs_fs_name_peek( fs, id );
+    if( ! name )
+    {
+        rc = whefs_fs_name_read( fs, id, buf );
+        if( whefs_rc.OK != rc ) return rc;
+        name = buf;
+    }
+    rc = whefs_string_copy_cstring( tgt, name );
     if( whio_rc.OK != rc )
     {
 	WHEFS_DBG_ERR("Copying of inode #"WHEFS_ID_TYPE_PFMT"'s name record failed! "
 		      "RC=%d. String is [%s]",
-		      id, rc, bufP );
+		      id, rc, name );
+	return rc;
     }
     if( tgt->length )
     {
         /*WHEFS_DBG("Caching inode name [%s]",tgt->string); */
         whefs_inode_hash_cache( fs, id, tgt->string );
-        /* A necessary evil to avoid lots of O(N) searches. */
-        if( fs->cache.hashes && ! fs->cache.hashes->skipAutoSort )
-        {
-            whefs_inode_hash_cache_sort(fs);
-        }
     }
     return rc;
 }
@@ -790,6 +1361,7 @@ int whefs_fs_name_write( whefs_fs * fs, whefs_id_type id, char const * name )
         unsigned char const * dbgStr;
         off_t spos;
         whio_size_t sz;
+        char old[WHEFS_MAX_FILENAME_LENGTH+1];
         for( ; c && *c && (i < fs->options.filename_length); ++i, ++c, ++slen )
         {
         }
@@ -797,6 +1369,11 @@ int whefs_fs_name_write( whefs_fs * fs, whefs_id_type id, char const * name )
         { /** too long! */
             return whefs_rc.RangeError;
         }
+        if( fs->nameidx.slots || fs->cache.filter.loaded )
+        { /* we need the old name to find its name index and filter entries */
+            rc = whefs_fs_name_read( fs, id, old );
+            if( whefs_rc.OK != rc ) return rc;
+        }
         /**
            Encode the string to a temp buffer then write it in one go to
            disk. Takes more code than plain i/o, but using this approach
@@ -829,6 +1406,22 @@ int whefs_fs_name_write( whefs_fs * fs, whefs_id_type id, char const * name )
         {
             WHEFS_DBG("Writing inode #%"WHEFS_ID_TYPE_PFMT"[%s] name: [%s]",id,name,dbgStr);
         }
+        if( fs->names.mem && (id <= fs->names.count) )
+        {
+            char * mem = fs->names.mem + ((id - 1) * fs->names.stride);
+            whefs_fs_names_sorted_remove( fs, id, mem );
+            memcpy( mem, name, slen );
+            mem[slen] = 0;
+            whefs_fs_names_sorted_insert( fs, id, mem );
+        }
+        if( (fs->nameidx.slots || fs->cache.filter.loaded) && (0 != strcmp( old, name )) )
+        {
+            whefs_name_filter_remove( fs, old );
+            whefs_name_filter_add( fs, name );
+            rc = whefs_fs_name_index_remove( fs, old, id );
+            if( whefs_rc.OK == rc ) rc = whefs_fs_name_index_insert( fs, name, id );
+            return rc;
+        }
         return whefs_rc.OK;
     }
 
@@ -863,8 +1456,9 @@ static int whefs_mkfs_write_names_table( whefs_fs * fs )
 whio_size_t whefs_fs_calculate_size( whefs_fs_options const * opt )
 {
     static const whio_size_t sz = (whio_size_t)whio_sizeof_encoded_uint32;
+    whio_size_t head;
     if( ! opt ) return 0;
-    else return (whio_size_t)(
+    head = (whio_size_t)(
         (whio_sizeof_encoded_uint32 * whefs_fs_magic_bytes_len) /* core magic */
 	+ sz /* file size header */
 	+ whio_sizeof_encoded_uint16 /* client magic size */
@@ -872,8 +1466,13 @@ whio_size_t whefs_fs_calculate_size( whefs_fs_options const * opt )
 	+ whefs_fs_sizeof_options()
         + whefs_sizeof_encoded_hints
 	+ (whefs_fs_sizeof_name( opt ) * opt->inode_count)/* inode names table */
+	+ whefs_fs_sizeof_name_index( opt )
 	+ (whefs_sizeof_encoded_inode * opt->inode_count) /* inode table */
+	);
+    return (whio_size_t)(
+        WHEFS_OPT_ALIGN(opt, head) /* blocks table starts aligned */
 	+ (whefs_fs_sizeof_block( opt ) * opt->block_count)/* blocks table */
+	+ whefs_fs_sizeof_freemap( opt )
 	);
 }
 
@@ -1020,9 +1619,13 @@ static int whefs_fs_init_bitset_inodes( whefs_fs * fs )
     return whefs_rc.OK;
 }
 
+/**
+   Sets up (or re-sizes) fs->bits.b. Unlike the inode bitset, this one
+   is allocated even if WHEFS_CONFIG_ENABLE_BITSET_CACHE is off, as it
+   also holds the in-memory copy of the on-disk free-space map.
+*/
 static int whefs_fs_init_bitset_blocks( whefs_fs * fs )
 {
-#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
     /*WHEFS_DBG("Setting up bitsets for fs@0x%p", (void const *)fs ); */
     const size_t bbits = 1; /* flag: used */
     size_t bbc;
@@ -1034,8 +1637,7 @@ static int whefs_fs_init_bitset_blocks( whefs_fs * fs )
     WHEFS_DBG("Initialized bitsets. block count/bits/bytes=%u/%u/%u",
 	      fs->options.block_count, fs->bits.b.sz_bits, fs->bits.b.sz_bytes );
 #endif
-    WHEFS_ICACHE_SET_USED(fs,0); /* inode ID 0 is reserved for "not a block". */
-#endif /* WHEFS_CONFIG_ENABLE_BITSET_CACHE */
+    whbits_set( &fs->bits.b, 0 ); /* block ID 0 is reserved for "not a block". */
     return whefs_rc.OK;
 }
 
@@ -1056,9 +1658,111 @@ static int whefs_fs_init_bitsets( whefs_fs * fs )
     return rc;
 }
 
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+/**
+   Fills in bits #1 through #count of the given bitset from the used
+   flags of a table of count fixed-size records (inodes or block
+   headers), record #N being at position (pos + (N-1)*stride) of
+   fs->dev. Each record starts with the given tag byte, followed by an
+   encoded ID and then the encoded uint8 flags. Bit #0 is left as is.
+
+   The records are used straight from memory if fs is mmap()ed.
+   Otherwise, if they are densely packed, they are read in large
+   chunks, and if they are not (block headers are followed by the
+   block's data), only their first recLen bytes are read. Either way
+   the flags are gathered one bitset byte (eight records) at a time,
+   so no per-record decoding or bit twiddling is needed.
+
+   Returns whefs_rc.OK on success, whefs_rc.IOError on a read error or
+   whefs_rc.ConsistencyError if a record does not start with tag.
+*/
+static int whefs_fs_load_used_bits( whefs_fs * fs, whbits * bits, whio_size_t pos,
+                                    whio_size_t stride, whio_size_t recLen,
+                                    whefs_id_type count, unsigned char tag )
+{
+    enum { ChunkBytes = 1024 * 64,
+           FlagOff = 1 /* tag */ + whefs_sizeof_encoded_id_type + 1 /* uint8 tag */ };
+    const bool dense = (stride <= (recLen * 4));
+    unsigned char * buf = 0;
+    unsigned char const * mem = 0;
+    whio_size_t bstride = stride; /* distance between records in mem */
+    whio_size_t perChunk = count;
+    whefs_id_type id = 1;
+    int rc = whefs_rc.OK;
+#if WHEFS_CONFIG_ENABLE_MMAP
+    if( fs->flags & WHEFS_FLAG_FS_IsMMapped )
+    {
+        mem = (unsigned char const *)((WhioDevMMapInfo const *)fs->dev->client.data)->mem + pos;
+    }
+#endif
+    if( ! mem )
+    {
+        if( ! dense ) bstride = recLen;
+        /* a multiple of 8 records, so each chunk fills whole bitset bytes */
+        perChunk = ((ChunkBytes / bstride) + 7) & ~((whio_size_t)7);
+        if( perChunk > count ) perChunk = count;
+        buf = (unsigned char *) malloc( perChunk * bstride );
+        if( ! buf ) return whefs_rc.AllocError;
+    }
+    while( (id <= count) && (whefs_rc.OK == rc) )
+    {
+        const whio_size_t n = ((count - id + 1) < perChunk) ? (count - id + 1) : perChunk;
+        const whefs_id_type end = id + n;
+        unsigned char const * rec;
+        whio_size_t i;
+        if( buf )
+        {
+            if( dense )
+            {
+                const whio_size_t len = ((n - 1) * stride) + recLen;
+                if( len != whefs_fs_readat( fs, pos + ((id - 1) * stride), buf, len ) ) rc = whefs_rc.IOError;
+            }
+            else
+            {
+                for( i = 0; (i < n) && (whefs_rc.OK == rc); ++i )
+                {
+                    if( recLen != whefs_fs_readat( fs, pos + ((id - 1 + i) * stride), buf + (i * recLen), recLen ) )
+                    {
+                        rc = whefs_rc.IOError;
+                    }
+                }
+            }
+            rec = buf;
+        }
+        else
+        {
+            rec = mem + ((id - 1) * stride);
+        }
+        while( (id < end) && (whefs_rc.OK == rc) )
+        { /* one bitset byte per pass */
+            const whefs_id_type stop = (((id / 8) + 1) * 8) < end ? (((id / 8) + 1) * 8) : end;
+            unsigned char set = 0, mask = 0, bad = 0;
+            const whefs_id_type first = id;
+            for( ; id < stop; ++id, rec += bstride )
+            {
+                const unsigned char bit = (unsigned char)(1 << (id % 8));
+                bad |= (unsigned char)(rec[0] ^ tag);
+                mask |= bit;
+                if( rec[FlagOff] & WHEFS_FLAG_Used ) set |= bit;
+            }
+            if( bad )
+            {
+                WHEFS_DBG_ERR("A record in the ID range #%"WHEFS_ID_TYPE_PFMT"..#%"WHEFS_ID_TYPE_PFMT" is not tagged with '%c'!",
+                              first, id - 1, tag );
+                rc = whefs_rc.ConsistencyError;
+                break;
+            }
+            bits->bytes[first / 8] = (unsigned char)((bits->bytes[first / 8] & ~mask) | set);
+        }
+    }
+    free( buf );
+    return rc;
+}
+#endif /* WHEFS_CONFIG_ENABLE_BITSET_CACHE */
+
 /**
    Initializes the internal inode cache, reading the state from
-   storage.
+   storage (or from the in-memory inode table, if it is loaded).
 
    Returns whefs_rc.OK on success.
 */
@@ -1067,31 +1771,20 @@ static int whefs_fs_inode_cache_load( whefs_fs * fs )
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
     WHEFS_DBG_CACHE("Loading inode bitset cache.");
     if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    else if( fs->itable.list )
+    { /* whefs_fs_itable_load() already did this. */
+        fs->bits.i_loaded = true;
+    }
     else {
-        const whefs_id_type nc = whefs_fs_options_get(fs)->inode_count;
-        whefs_id_type id = 2; /* root node (id=1) is always considered used */
-        int rc = 0;
-        uint32_t flags;
-        whefs_inode ino = whefs_inode_empty;
-        for( ; id <= nc; ++id )
+        const int rc = whefs_fs_load_used_bits( fs, &fs->bits.i, fs->offsets[WHEFS_OFF_INODES_NO_STR],
+                                                fs->sizes[WHEFS_SZ_INODE_NO_STR], whefs_sizeof_encoded_inode,
+                                                fs->options.inode_count, 'I' /* see whefs_inode.c */ );
+        if( whefs_rc.OK != rc )
         {
-            /*WHEFS_DBG("Trying to cache inode #%"WHEFS_ID_TYPE_PFMT"'s state.", id); */
-            flags = 0;
-            rc = whefs_inode_id_read( fs, id, &ino );
-            if( whefs_rc.OK != rc )
-            {
-                WHEFS_DBG_ERR("Error #%d while reading inode #%"WHEFS_ID_TYPE_PFMT"!", rc, id);
-                return rc;
-            }
-            if( ino.flags & WHEFS_FLAG_Used )
-            {
-                WHEFS_ICACHE_SET_USED(fs,id);
-            }
-            else
-            {
-                WHEFS_ICACHE_UNSET_USED(fs,id);
-            }
+            WHEFS_DBG_ERR("Error #%d while loading the inode cache!", rc );
+            return rc;
         }
+        WHEFS_ICACHE_SET_USED(fs,1); /* the root node is always considered used */
         fs->bits.i_loaded = true;
         /*WHEFS_DBG_FYI("Initialized inode cache (entries: %u)", count); */
     }
@@ -1105,24 +1798,20 @@ static int whefs_fs_inode_cache_load( whefs_fs * fs )
 static int whefs_fs_block_cache_load( whefs_fs * fs )
 {
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
-    /* FIXME: instead of using whefs_block_read(), simply extract the
-       flags field from each block entry. That'll be much faster. */
     if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    else if( fs->freemap.loaded )
+    { /* The free-space map's bitset is the block cache, and its
+         free counts must stay in sync with it. */
+        fs->bits.b_loaded = true;
+    }
     else {
-        const size_t bc = whefs_fs_options_get(fs)->block_count;
-        size_t id = 1;
-        int rc = 0;
-        whefs_block bl;
-        for( ; id <= bc; ++id )
+        const int rc = whefs_fs_load_used_bits( fs, &fs->bits.b, fs->offsets[WHEFS_OFF_BLOCKS],
+                                                fs->sizes[WHEFS_SZ_BLOCK], whefs_sizeof_encoded_block,
+                                                fs->options.block_count, 'B' /* see whefs_block.c */ );
+        if( whefs_rc.OK != rc )
         {
-            bl = whefs_block_empty;
-            rc = whefs_block_read( fs, id, &bl ); /* this will update the used-blocks cache */
-            if( whefs_rc.OK != rc )
-            {
-                WHEFS_DBG_ERR("Error #%d while reading block #%u!", rc, id);
-                return rc;
-            }
-            /*WHEFS_DBG("block cache. #%u is %s",bl.id, (WHEFS_BCACHE_IS_USED(fs,id) ? "used" : "unused") ); */
+            WHEFS_DBG_ERR("Error #%d while loading the block cache!", rc );
+            return rc;
         }
         /*WHEFS_DBG("Initialized block cache."); */
         fs->bits.b_loaded = true;
@@ -1164,6 +1853,8 @@ static void whefs_fs_init_sizes( whefs_fs * fs )
     fs->sizes[WHEFS_SZ_BLOCK] = whefs_fs_sizeof_block( &fs->options );
     fs->sizes[WHEFS_SZ_OPTIONS] = whefs_fs_sizeof_options();
     fs->sizes[WHEFS_SZ_HINTS] = whefs_sizeof_encoded_hints;
+    fs->sizes[WHEFS_SZ_FREEMAP] = whefs_fs_sizeof_freemap( &fs->options );
+    fs->sizes[WHEFS_SZ_NAME_INDEX] = whefs_fs_sizeof_name_index( &fs->options );
     fs->offsets[WHEFS_OFF_CORE_MAGIC] = 0;
 
     sz = /* core magic len */
@@ -1196,22 +1887,30 @@ static void whefs_fs_init_sizes( whefs_fs * fs )
     sz = /* names table size */
 	(fs->options.inode_count * fs->sizes[WHEFS_SZ_INODE_NAME]);
 
-    fs->offsets[WHEFS_OFF_INODES_NO_STR] =
+    fs->offsets[WHEFS_OFF_NAME_INDEX] =
 	fs->offsets[WHEFS_OFF_INODE_NAMES]
 	+ sz;
+
+    fs->offsets[WHEFS_OFF_INODES_NO_STR] =
+	fs->offsets[WHEFS_OFF_NAME_INDEX]
+	+ fs->sizes[WHEFS_SZ_NAME_INDEX];
     sz = /* new inodes table size */
 	(fs->options.inode_count * fs->sizes[WHEFS_SZ_INODE_NO_STR]);
 
-    fs->offsets[WHEFS_OFF_BLOCKS] =
+    fs->offsets[WHEFS_OFF_BLOCKS] = WHEFS_OPT_ALIGN(&fs->options,
 	fs->offsets[WHEFS_OFF_INODES_NO_STR]
-	+ sz;
+	+ sz);
     sz = /* blocks table size */
 	(fs->options.block_count * fs->sizes[WHEFS_SZ_BLOCK]);
 
-    fs->offsets[WHEFS_OFF_EOF] =
+    fs->offsets[WHEFS_OFF_FREEMAP] =
 	fs->offsets[WHEFS_OFF_BLOCKS]
 	+ sz;
 
+    fs->offsets[WHEFS_OFF_EOF] =
+	fs->offsets[WHEFS_OFF_FREEMAP]
+	+ fs->sizes[WHEFS_SZ_FREEMAP];
+
 #if 0
     fprintf( stdout, "\tOffsets:\n");
 #define OFF(X) fprintf(stdout,"\t\tfs->offsets[%s]\t= %u\n",# X, fs->offsets[WHEFS_OFF_ ## X])
@@ -1221,8 +1920,10 @@ static void whefs_fs_init_sizes( whefs_fs * fs )
     OFF(OPTIONS);
     OFF(HINTS);
     OFF(INODE_NAMES);
+    OFF(NAME_INDEX);
     OFF(INODES_NO_STR);
     OFF(BLOCKS);
+    OFF(FREEMAP);
     OFF(EOF);
 #undef OFF
 #define OFF(X) fprintf(stdout,"\t\tfs->sizes[%s]\t= %u\n",# X, fs->sizes[WHEFS_SZ_ ## X])
@@ -1231,6 +1932,7 @@ static void whefs_fs_init_sizes( whefs_fs * fs )
     OFF(BLOCK);
     OFF(OPTIONS);
     OFF(HINTS);
+    OFF(FREEMAP);
     fflush(stdout);
     assert(0 && "on purpose");
 #undef OFF
@@ -1253,6 +1955,8 @@ static int whefs_mkfs_stage1( whefs_fs_options const * opt, whefs_fs ** tgt )
 	|| !opt->magic.length
 	|| !opt->magic.data
 	|| (opt->block_count < opt->inode_count)
+	|| (opt->data_alignment & (opt->data_alignment - 1)) /* not a power of 2 */
+	|| ((opt->data_alignment > 1) && (opt->block_size % opt->data_alignment))
 	)
     {
 	return whefs_rc.RangeError;
@@ -1261,9 +1965,9 @@ static int whefs_mkfs_stage1( whefs_fs_options const * opt, whefs_fs ** tgt )
         int rc;
         whefs_fs * fs = whefs_fs_alloc();
         if( ! fs ) return whefs_rc.AllocError;
-        *fs = whefs_fs_empty;
         fs->flags |= WHEFS_FLAG_ReadWrite;
         fs->options = *opt;
+        fs->options.name_index = whefs_fs_name_index_slots( opt );
         
         whefs_fs_init_sizes( fs );
         
@@ -1280,14 +1984,15 @@ static int whefs_mkfs_stage1( whefs_fs_options const * opt, whefs_fs ** tgt )
 }
 
 /**
-   Moves the seek position to fs->offsets[WHEFS_OFF_SIZE] and
-   writes fs->filesize to that location.
+   Writes fs->filesize to fs->offsets[WHEFS_OFF_SIZE]. The device
+   cursor position is unspecified afterwards.
 */
 static int whefs_fs_write_filesize( whefs_fs * fs )
 {
+    unsigned char buf[whio_sizeof_encoded_uint32];
     whio_size_t ck;
-    fs->dev->api->seek( fs->dev, fs->offsets[WHEFS_OFF_SIZE], SEEK_SET );
-    ck = whio_dev_encode_uint32( fs->dev, fs->filesize );
+    whio_encode_uint32( buf, fs->filesize );
+    ck = whefs_fs_writeat( fs, fs->offsets[WHEFS_OFF_SIZE], buf, whio_sizeof_encoded_uint32 );
     return ( whio_sizeof_encoded_uint32 == ck )
         ? whefs_rc.OK
         : whefs_rc.IOError;
@@ -1324,10 +2029,19 @@ static int whefs_mkfs_stage2( whefs_fs * fs )
     CHECKRC;
     rc = whefs_mkfs_write_names_table( fs );
     CHECKRC;
+    if( fs->cache.filter.enabled )
+    { /* every name is empty, so an empty filter is complete. */
+        rc = whefs_name_filter_reset( fs );
+        CHECKRC;
+    }
     rc = whefs_mkfs_write_inodelist( fs );
     CHECKRC;
     rc = whefs_mkfs_write_blocklist( fs );
     CHECKRC;
+    rc = whefs_fs_freemap_write( fs );
+    CHECKRC;
+    rc = whefs_fs_name_index_write( fs );
+    CHECKRC;
 #undef CHECKRC
     whefs_fs_flush(fs);
     fs->filesize = whio_dev_size( fs->dev );
@@ -1340,10 +2054,32 @@ static int whefs_mkfs_stage2( whefs_fs * fs )
 	whefs_fs_finalize( fs );
 	return whefs_rc.ConsistencyError;
     }
-    fs->offsets[WHEFS_OFF_EOF] = fs->dev->api->tell( fs->dev );
+    fs->offsets[WHEFS_OFF_EOF] = szcheck;
     whefs_fs_write_filesize( fs );
 
     whefs_fs_flush( fs );
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+    /*
+      A fresh EFS has no used blocks and only the reserved inodes in
+      use, which is exactly what whefs_fs_init_bitsets() set up, so
+      the caches are accurate without reading anything back. From
+      here on they are kept in sync by the block/inode flush routines
+      (and the free-space map), which lets the allocators scan them a
+      word at a time.
+    */
+    fs->bits.i_loaded = true;
+    fs->bits.b_loaded = true;
+#endif
+    /* No inode has a name yet, so the (empty) name cache knows them all. */
+    fs->cache.complete = WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ? true : false;
+    if( fs->itable.enabled && (whefs_rc.OK != (rc = whefs_fs_itable_load( fs ))) )
+    { /* not fatal: inode reads simply go to storage. */
+        WHEFS_DBG_WARN("Could not load the inode table (error #%d). Continuing without it.", rc );
+    }
+    if( fs->names.enabled && (whefs_rc.OK != (rc = whefs_fs_names_load( fs ))) )
+    { /* not fatal: name reads simply go to storage. */
+        WHEFS_DBG_WARN("Could not load the names table (error #%d). Continuing without it.", rc );
+    }
     return whefs_rc.OK;
 }
 
@@ -1514,6 +2250,10 @@ static int whefs_openfs_stage2( whefs_fs * fs )
     CHECK;
     rc = whio_dev_decode_uint16( fs->dev, &opt->filename_length );
     CHECK;
+    rc = whio_dev_decode_uint32( fs->dev, &opt->data_alignment );
+    CHECK;
+    rc = whio_dev_decode_uint32( fs->dev, &opt->name_index );
+    CHECK;
 #undef CHECK
     whefs_fs_init_sizes( fs );
 
@@ -1533,6 +2273,37 @@ static int whefs_openfs_stage2( whefs_fs * fs )
 	whefs_fs_finalize( fs );
 	return rc;
     }
+    rc = whefs_fs_freemap_read( fs );
+    if( whefs_rc.OK != rc )
+    {
+	WHEFS_DBG_ERR("Reading of free-space map failed rc %d!", rc);
+	whefs_fs_finalize( fs );
+	return rc;
+    }
+    rc = whefs_fs_name_index_read( fs );
+    if( whefs_rc.OK != rc )
+    {
+	WHEFS_DBG_ERR("Reading of name index failed rc %d!", rc);
+	whefs_fs_finalize( fs );
+	return rc;
+    }
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+    /* The map's bitset is the used-blocks cache, so it need not be
+       rebuilt by reading every block header. */
+    fs->bits.b_loaded = true;
+#endif
+    if( fs->itable.enabled && (whefs_rc.OK != (rc = whefs_fs_itable_load( fs ))) )
+    { /* not fatal: inode reads simply go to storage. */
+        WHEFS_DBG_WARN("Could not load the inode table (error #%d). Continuing without it.", rc );
+    }
+    if( fs->names.enabled && (whefs_rc.OK != (rc = whefs_fs_names_load( fs ))) )
+    { /* not fatal: name reads simply go to storage. */
+        WHEFS_DBG_WARN("Could not load the names table (error #%d). Continuing without it.", rc );
+    }
+    if( (whefs_rc.OK != (rc = whefs_fs_inode_cache_load( fs ))) )
+    { /* not fatal: inode searches simply go to storage. */
+        WHEFS_DBG_WARN("Could not load the inode cache (error #%d). Continuing without it.", rc );
+    }
 #if WHEFS_LOAD_CACHES_ON_OPEN
     //WHEFS_DBG_CACHE("Pre-loading inode cache.");
     rc = whefs_fs_caches_load( fs );
@@ -1553,7 +2324,6 @@ int whefs_openfs_dev( whio_dev * dev, whefs_fs ** tgt, bool takeDev )
     if( ! dev || !tgt ) return whefs_rc.ArgError;
     fs = whefs_fs_alloc();
     if( ! fs ) return whefs_rc.AllocError;
-    *fs = whefs_fs_empty;
     /* FIXME: do a 1-byte write test to see if the device is writeable,
        or add a parameter to the function defining the write mode.
     */
@@ -1579,7 +2349,6 @@ int whefs_openfs( char const * filename, whefs_fs ** tgt, bool writeMode )
     if( ! filename || !tgt ) return whefs_rc.ArgError;
     fs = whefs_fs_alloc();
     if( ! fs ) return whefs_rc.AllocError;
-    *fs = whefs_fs_empty;
     fs->flags |= (writeMode ? WHEFS_FLAG_ReadWrite : WHEFS_FLAG_Read);
     if( ! whefs_open_FILE( filename, fs, writeMode, false ) )
     {
@@ -1620,6 +2389,7 @@ void whefs_fs_dump_info( whefs_fs const * fs, FILE * out )
     X(whefs_block),
     X(whefs_hashid),
     X(whefs_hashid_list),
+    X(whefs_hashid_table),
     X(whefs_fs_closer_list),
     {0,0}
     };
@@ -1646,6 +2416,8 @@ void whefs_fs_dump_info( whefs_fs const * fs, FILE * out )
 	     "\tblock count: %"WHEFS_ID_TYPE_PFMT"\n"
 	     "\tmax inode count: %"WHEFS_ID_TYPE_PFMT" (1 is reserved for the root dir entry!)\n"
 	     "\tmax filename length: %u (WHEFS_MAX_FILENAME_LENGTH=%u)\n"
+	     "\tdata alignment: %"PRIu32"\n"
+	     "\tname index slots: %"PRIu32"\n"
 	     "\tmagic cookie length: %"PRIu32"\n"
 	     "\tContainer size:\n\t\tcalculated =\t\t%"WHIO_SIZE_T_PFMT"\n\t\tdevice-reported =\t%"WHIO_SIZE_T_PFMT"\n",
 	     whefs_sizeof_encoded_inode, (uint64_t)whefs_fs_sizeof_name(&fs->options),
@@ -1654,6 +2426,8 @@ void whefs_fs_dump_info( whefs_fs const * fs, FILE * out )
 	     o->block_count,
 	     o->inode_count,
 	     o->filename_length, WHEFS_MAX_FILENAME_LENGTH,
+	     o->data_alignment,
+	     o->name_index,
 	     (uint32_t)o->magic.length,
 	     whefs_fs_calculate_size(&fs->options),
 	     whio_dev_size(fs->dev)
@@ -1667,15 +2441,50 @@ void whefs_fs_dump_info( whefs_fs const * fs, FILE * out )
     OFF(OPTIONS);
     OFF(HINTS);
     OFF(INODE_NAMES);
+    OFF(NAME_INDEX);
     OFF(INODES_NO_STR);
     OFF(BLOCKS);
+    OFF(FREEMAP);
     OFF(EOF);
 #undef OFF
 #endif
-
+    if( fs->freemap.loaded )
+    {
+	fprintf( out, "\tFree blocks: %"WHEFS_ID_TYPE_PFMT" of %"WHEFS_ID_TYPE_PFMT" (%"WHEFS_ID_TYPE_PFMT" map regions)\n",
+		 fs->freemap.free, o->block_count, fs->freemap.regions );
+    }
+    if( fs->pcache.budget )
+    {
+        whefs_cache_stats const * st = &fs->pcache.stats;
+	fprintf( out, "\tPage cache: %"PRIu32" of %"PRIu32" %"PRIu32"-byte pages used. "
+                 "%"PRIu64" hit(s), %"PRIu64" miss(es), %"PRIu64" eviction(s), %"PRIu64" bypass(es). "
+                 "%"PRIu32" dirty, %"PRIu64" written back.\n",
+		 st->pages, (uint32_t)(fs->pcache.budget / st->page_size), st->page_size,
+                 st->hits, st->misses, st->evictions, st->bypasses,
+                 st->dirty, st->writebacks );
+    }
+    if( fs->itable.list )
+    {
+	fprintf( out, "\tInode table: %"WHEFS_ID_TYPE_PFMT" record(s) (%u bytes) held in memory.\n",
+		 fs->itable.count, (unsigned int)(fs->itable.count * sizeof(whefs_inode_rec)) );
+    }
+    if( fs->names.mem )
+    {
+	fprintf( out, "\tNames table: %"WHEFS_ID_TYPE_PFMT" name(s) (%u bytes) held in memory.\n",
+		 fs->names.count, (unsigned int)(fs->names.count * fs->names.stride) );
+	if( fs->names.sorted )
+	{
+	    fprintf( out, "\tSorted names index: %"WHEFS_ID_TYPE_PFMT" name(s) (%u bytes).\n",
+		     fs->names.sortedCount, (unsigned int)(fs->names.count * sizeof(whefs_id_type)) );
+	}
+    }
 }
 
-int whefs_fs_append_blocks( whefs_fs * fs, whefs_id_type count )
+/**
+   The implementation of whefs_fs_append_blocks(), which must be
+   called with fs locked exclusively.
+*/
+static int whefs_fs_append_blocks_impl( whefs_fs * fs, whefs_id_type count )
 {
     whefs_block bl = whefs_block_empty;
     whefs_id_type id;
@@ -1695,11 +2504,14 @@ int whefs_fs_append_blocks( whefs_fs * fs, whefs_id_type count )
        before truncating, then reconnect it (if the device supports it)
        afterwards.
     */
+    whefs_fs_pcache_clear( fs ); /* the device is about to change size */
     whefs_fs_mmap_disconnect(fs);
     opt = &fs->options;
     oldCount = opt->block_count;
     oldEOF = fs->offsets[WHEFS_OFF_EOF];
-    newEOF = oldEOF + (whefs_fs_sizeof_block(opt) * count);
+    opt->block_count += count;
+    newEOF = whefs_fs_calculate_size( opt );
+    opt->block_count = oldCount;
     rc = fs->dev->api->truncate( fs->dev, newEOF );
     /*WHEFS_DBG("Adding %"WHEFS_ID_TYPE_PFMT" blocks to fs (current count=%"WHEFS_ID_TYPE_PFMT").",count,oldCount); */
     if( whio_rc.OK != rc )
@@ -1709,9 +2521,13 @@ int whefs_fs_append_blocks( whefs_fs * fs, whefs_id_type count )
         whefs_fs_mmap_connect(fs);
         return fs->err = rc;
     }
-    fs->offsets[WHEFS_OFF_EOF] = newEOF;
     fs->filesize = newEOF;
     opt->block_count += count;
+    /* The free-space map lives after the blocks table, so it moves
+       to the end of the new blocks. It is rewritten from memory
+       below, so until then it must not be updated in place. */
+    fs->freemap.loaded = false;
+    whefs_fs_init_sizes( fs );
     /* FIXME: error handling! */
     /* If anything goes wrong here, the EFS *will* be corrupted. */
     whefs_fs_write_filesize( fs );
@@ -1724,11 +2540,22 @@ int whefs_fs_append_blocks( whefs_fs * fs, whefs_id_type count )
         rc = whefs_block_wipe( fs, &bl, true, true, false );
         if( whefs_rc.OK != rc ) break;
     }
+    if( whefs_rc.OK == rc ) rc = whefs_fs_freemap_write( fs );
     whefs_fs_flush( fs );
     whefs_fs_mmap_connect( fs ); /* We need to re-mmap() to account for the new size! */
     return rc;
 }
 
+int whefs_fs_append_blocks( whefs_fs * fs, whefs_id_type count )
+{
+    int rc;
+    if( ! fs ) return whefs_rc.ArgError;
+    WHEFS_FS_WRLOCK(fs);
+    rc = whefs_fs_append_blocks_impl( fs, count );
+    WHEFS_FS_UNLOCK(fs);
+    return rc;
+}
+
 int whefs_fs_setopt_autoclose_files( whefs_fs * fs, bool on )
 {
     if( ! fs ) return whefs_rc.ArgError;
@@ -1737,6 +2564,20 @@ int whefs_fs_setopt_autoclose_files( whefs_fs * fs, bool on )
     return whefs_rc.OK;
 }
 
+int whefs_fs_setopt_extent_min( whefs_fs * fs, whefs_id_type count )
+{
+    if( ! fs ) return whefs_rc.ArgError;
+    fs->alloc.extent_min = count ? count : 1;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_setopt_readahead( whefs_fs * fs, uint32_t blocks )
+{
+    if( ! fs ) return whefs_rc.ArgError;
+    fs->readahead.blocks = blocks;
+    return whefs_rc.OK;
+}
+
 int whefs_fs_setopt_hash_cache( whefs_fs * fs, bool on, bool loadNow )
 {
     int rc = whefs_rc.OK;
@@ -1754,17 +2595,46 @@ int whefs_fs_setopt_hash_cache( whefs_fs * fs, bool on, bool loadNow )
     else
     {
         fs->flags &= ~WHEFS_FLAG_FS_EnableHashCache;
-        whefs_hashid_list_free( fs->cache.hashes );
-        fs->cache.hashes = 0;
+        whefs_fs_caches_names_clear( fs );
     }
     if( whefs_rc.OK != rc )
     {
-        whefs_hashid_list_free( fs->cache.hashes );
+        whefs_fs_caches_names_clear( fs );
         if( on ) fs->flags &= ~WHEFS_FLAG_FS_EnableHashCache;
     }
     return rc;
 }
 
+int whefs_fs_setopt_name_filter( whefs_fs * fs, bool on )
+{
+    if( ! fs ) return whefs_rc.ArgError;
+    if( ! on ) whefs_name_filter_clear( fs );
+    fs->cache.filter.enabled = on;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_setopt_name_hash( whefs_fs * fs, whefs_name_hash_f f )
+{
+    if( ! fs ) return whefs_rc.ArgError;
+    if( ! f ) f = whefs_hash_wy;
+    if( f != fs->cache.hashfunc )
+    { /* the cached hash codes are useless now. */
+        whefs_fs_caches_names_clear( fs );
+        fs->cache.hashfunc = f;
+    }
+    return whefs_rc.OK;
+}
+
+int whefs_fs_name_filter_stats( whefs_fs const * fs, whefs_name_filter_stats * tgt )
+{
+    if( ! fs || !tgt ) return whefs_rc.ArgError;
+    WHEFS_FS_RDLOCK((whefs_fs *)fs);
+    *tgt = fs->cache.filter.stats;
+    tgt->counters = fs->cache.filter.loaded ? fs->cache.filter.size : 0;
+    WHEFS_FS_UNLOCK((whefs_fs *)fs);
+    return whefs_rc.OK;
+}
+
 
 #ifdef __cplusplus
 } /* extern "C"*/
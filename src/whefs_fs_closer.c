@@ -2,286 +2,149 @@
    Implementations for the whefs_fs_closer_list-related API.
 */
 #include "whefs_details.c"
-#include <stdlib.h> /* malloc() and co. */
 
 const whefs_fs_closer_list whefs_fs_closer_list_empty = whefs_fs_closer_list_empty_m;
 
 
 /**
-   Unlinks x from its neighbors.
+   Appends x, which must not currently be in a list, to fs->closers.
 */
-static void whefs_fs_closer_list_unlink( whefs_fs_closer_list * x )
+static void whefs_fs_closer_link( whefs_fs * fs, whefs_fs_closer_list * x )
 {
-    if( x->prev ) { x->prev->next = x->next; }
-    if( x->next ) { x->next->prev = x->prev; }
-    x->prev = x->next = NULL;
+    x->next = NULL;
+    x->prev = fs->closers.tail;
+    if( fs->closers.tail ) fs->closers.tail->next = x;
+    else fs->closers.head = x;
+    fs->closers.tail = x;
 }
 
-
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
-enum {
-/**
-   The number of elements to statically allocate
-   in the whefs_fs_closer_list_alloc_slots object.
-*/
-whefs_fs_closer_list_alloc_count = 4
-};
-static struct
-{
-    whefs_fs_closer_list objs[whefs_fs_closer_list_alloc_count];
-    char used[whefs_fs_closer_list_alloc_count];
-    size_t next;
-    const size_t count;
-} whefs_fs_closer_list_alloc_slots = { { whefs_fs_closer_list_empty_m }, {0}, 0, whefs_fs_closer_list_alloc_count };
-#endif
 /**
-   Allocates a new zero-initialized object. Ownership is passed
-   to the caller.
+   Unlinks x from fs->closers and clears it. Does nothing if x is not
+   in a list.
 */
-whefs_fs_closer_list * whefs_fs_closer_list_alloc()
+static void whefs_fs_closer_unlink( whefs_fs * fs, whefs_fs_closer_list * x )
 {
-    whefs_fs_closer_list * obj = 0;
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
-    size_t i = whefs_fs_closer_list_alloc_slots.next;
-    for( ; i < whefs_fs_closer_list_alloc_slots.count; ++i )
-    {
-	if( whefs_fs_closer_list_alloc_slots.used[i] ) continue;
-	whefs_fs_closer_list_alloc_slots.used[i] = 1;
-	whefs_fs_closer_list_alloc_slots.next = i+1;
-	obj = &whefs_fs_closer_list_alloc_slots.objs[i];
-	break;
-    }
-#endif /* WHEFS_CONFIG_ENABLE_STATIC_MALLOC */
-    if( ! obj ) obj = (whefs_fs_closer_list *) malloc( sizeof(whefs_fs_closer_list) );
-    if( obj ) *obj = whefs_fs_closer_list_empty;
-    return obj;
-}
-
-/**
-   Unlinks obj from its neighbors and deallocates it. Ownership of
-   obj is transfered to this function.
-*/
-void whefs_fs_closer_list_free( whefs_fs_closer_list * obj )
-{
-    if( ! obj ) return;
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
-    if( (obj < &whefs_fs_closer_list_alloc_slots.objs[0]) ||
-	(obj > &whefs_fs_closer_list_alloc_slots.objs[whefs_fs_closer_list_alloc_slots.count-1]) )
-    { /* it does not belong to us */
-        whefs_fs_closer_list_unlink( obj );
-        *obj = whefs_fs_closer_list_empty;
-	free(obj);
-	return;
-    }
-    else
-    {
-        whefs_fs_closer_list_unlink( obj );
-        *obj = whefs_fs_closer_list_empty;
-	const size_t ndx = (obj - &whefs_fs_closer_list_alloc_slots.objs[0]);
-	whefs_fs_closer_list_alloc_slots.used[ndx] = 0;
-	if( ndx < whefs_fs_closer_list_alloc_slots.next ) whefs_fs_closer_list_alloc_slots.next = ndx;
-	return;
-    }
-#else
-    whefs_fs_closer_list_unlink( obj );
-    *obj = whefs_fs_closer_list_empty;
-    free(obj);
-#endif /* WHEFS_CONFIG_ENABLE_STATIC_MALLOC */
+    if( ! x->type ) return;
+    if( x->prev ) { x->prev->next = x->next; }
+    else if( fs->closers.head == x ) { fs->closers.head = x->next; }
+    if( x->next ) { x->next->prev = x->prev; }
+    else if( fs->closers.tail == x ) { fs->closers.tail = x->prev; }
+    *x = whefs_fs_closer_list_empty;
 }
 
 
-int whefs_fs_closer_list_close( whefs_fs_closer_list * head, bool right )
+int whefs_fs_closer_list_close( whefs_fs * fs )
 {
     int rc = whefs_rc.OK;
-    whefs_fs_closer_list * x = head;
-    if( ! head ) return whefs_rc.ArgError;
-    for( ; x; head = x )
+    whefs_fs_closer_list * x;
+    whefs_fs_closer_list * next;
+    whefs_fs_closer_list li;
+    if( ! fs ) return whefs_rc.ArgError;
+    x = fs->closers.head;
+    /* We detach the whole list first b/c the close routines update the list indirectly. */
+    fs->closers.head = fs->closers.tail = NULL;
+    for( ; x; x = next )
     {
-        x = head->next;
-        /* We unlink head before closing b/c the close routines may update the list indirectly. */
-        whefs_fs_closer_list_unlink(head);
-        switch( head->type )
+        next = x->next;
+        /* The entry lives in the object we are about to close, so copy
+           it and mark it unlinked before closing. */
+        li = *x;
+        *x = whefs_fs_closer_list_empty;
+        switch( li.type )
         {
           case WHEFS_CLOSER_TYPE_FILE:
-              whefs_fclose( head->item.file );
+              whefs_fclose( li.item.file );
               break;
           case WHEFS_CLOSER_TYPE_DEV:
-              head->item.dev->api->finalize( head->item.dev );
+              li.item.dev->api->finalize( li.item.dev );
               break;
           case WHEFS_CLOSER_TYPE_STREAM:
-              head->item.stream->api->finalize( head->item.stream );
+              li.item.stream->api->finalize( li.item.stream );
               break;
           default:
               WHEFS_DBG_ERR("Internal error whefs_fs_closer_list entry does not have a supported type field. Possibly leaking an object here!");
               rc = whefs_rc.InternalError;
               break;
         };
-        whefs_fs_closer_list_free(head);
-        if( ! right ) break;
     }
     return rc;
 }
 
 /**
-   Removes the given object from fs->closers. fs->closers must
-   contain an entry where entry->type==type and entry->item.XXX==obj,
-   where XXX is dependent on entry->type.
+   Removes the entry for the given inode device from fs->closers,
+   regardless of which type of object it currently stands for.
 
-   Returns whefs_rc.OK on sucess.
+   Returns whefs_rc.OK on sucess. Not finding an entry is considered
+   success (see whefs_fs_closer_file_remove()).
 */
-static int whefs_fs_closer_remove( whefs_fs * fs, char type, void const * obj )
+static int whefs_fs_closer_remove( whefs_fs * fs, whio_dev const * d )
 {
     whefs_fs_closer_list * li;
-    int rc;
-    bool foundOne;
-    if( ! fs || ! obj ) return whefs_rc.ArgError;
-    li = fs->closers;
-    if( ! li ) return whefs_rc.RangeError;
-    while( li->prev ) li = li->prev;
-    rc = whefs_rc.OK;
-    foundOne = false;
-    for( ; li ; li = li->next )
-    {
-        if( li->type != type ) continue;
-        switch( type )
-        {
-          case WHEFS_CLOSER_TYPE_FILE:
-              if( (void const *)li->item.file != obj ) continue;
-              foundOne = true;
-              break;
-          case WHEFS_CLOSER_TYPE_DEV:
-              if( (void const *)li->item.dev != obj ) continue;
-              foundOne = true;
-              break;
-          case WHEFS_CLOSER_TYPE_STREAM:
-              if( (void const *)li->item.stream != obj ) continue;
-              foundOne = true;
-              break;
-          default:
-              WHEFS_DBG_ERR("Internal error whefs_fs_closer_list entry does not have a supported type field.");
-              rc = whefs_rc.InternalError;
-              break;
-        };
-        if( foundOne )
-        {
-            if( fs->closers == li )
-            {
-                fs->closers = li->prev ? li->prev : li->next;
-            }
-            whefs_fs_closer_list_free( li );
-            li = 0;
-            break;
-        }
-    }
-    return rc;
+    if( ! fs || ! d ) return whefs_rc.ArgError;
+    li = whefs_dev_closer_entry( d );
+    if( ! li ) return whefs_rc.ArgError;
+    whefs_fs_closer_unlink( fs, li );
+    return whefs_rc.OK;
 }
 
-
 /**
-   Creates a new, empty whefs_fs_closer_list object and
-   appends it to fs->closers.
+   Sets the entry for the inode device d to the given type and object,
+   adding it to fs->closers if it is not already there. If it is
+   there (as a WHEFS_CLOSER_TYPE_DEV entry) then it is "promoted" to
+   the new type in place, so that the entry keeps its place in the
+   close order.
 */
-static whefs_fs_closer_list * whefs_fs_closer_add( whefs_fs * fs )
+static int whefs_fs_closer_set( whefs_fs * fs, whio_dev const * d, char type, void * obj )
 {
     whefs_fs_closer_list * li;
-    if( ! fs ) return NULL;
-    li = whefs_fs_closer_list_alloc();
-    if( ! li ) return NULL;
-    if( ! fs->closers )
+    if( ! fs || ! d || ! obj ) return whefs_rc.ArgError;
+    li = whefs_dev_closer_entry( d );
+    if( ! li ) return whefs_rc.ArgError;
+    if( ! li->type ) whefs_fs_closer_link( fs, li );
+    li->type = type;
+    switch( type )
     {
-        fs->closers = li;
-    }
-    else
-    {
-        whefs_fs_closer_list * tail = fs->closers;
-        while( tail->next ) tail = tail->next;
-        tail->next = li;
-        li->prev = tail;
-    }
-    return li;
+      case WHEFS_CLOSER_TYPE_FILE:
+          li->item.file = (whefs_file *)obj;
+          break;
+      case WHEFS_CLOSER_TYPE_DEV:
+          li->item.dev = (whio_dev *)obj;
+          break;
+      case WHEFS_CLOSER_TYPE_STREAM:
+          li->item.stream = (whio_stream *)obj;
+          break;
+      default:
+          whefs_fs_closer_unlink( fs, li );
+          return whefs_rc.InternalError;
+    };
+    return whefs_rc.OK;
 }
 
 int whefs_fs_closer_file_add( whefs_fs * fs, whefs_file * f )
 {
-    whefs_fs_closer_list * li;
-    if( ! fs || ! f ) return whefs_rc.ArgError;
-    li = fs->closers;
-    if( li )
-    { /** If we find f->dev in the list then we
-          promote the entry to type WHEFS_CLOSER_TYPE_FILE.
-      */
-        while( li->prev ) li = li->prev;
-        for( ; li ; li = li->next )
-        {
-            if( li->type != WHEFS_CLOSER_TYPE_DEV ) continue;
-            if( li->item.dev != f->dev ) continue;
-            li->type = WHEFS_CLOSER_TYPE_FILE;
-            li->item.file = f;
-            break;
-        }
-    }
-    else
-    {
-        li = whefs_fs_closer_add(fs);
-        if( ! li ) return whefs_rc.AllocError /* that's a guess */;
-        li->type = WHEFS_CLOSER_TYPE_FILE;
-        li->item.file = f;
-    }
-    return whefs_rc.OK;
+    return f
+        ? whefs_fs_closer_set( fs, f->dev, WHEFS_CLOSER_TYPE_FILE, f )
+        : whefs_rc.ArgError;
 }
 
 int whefs_fs_closer_file_remove( whefs_fs * fs, whefs_file const * f )
 {
-    return whefs_fs_closer_remove( fs, WHEFS_CLOSER_TYPE_FILE, f );
+    return f
+        ? whefs_fs_closer_remove( fs, f->dev )
+        : whefs_rc.ArgError;
 }
 
 int whefs_fs_closer_dev_add( whefs_fs * fs, whio_dev * d )
 {
-    whefs_fs_closer_list * li;
-    if( ! fs || ! d ) return whefs_rc.ArgError;
-    li = whefs_fs_closer_add(fs);
-    if( ! li ) return whefs_rc.AllocError /* that's a guess */;
-    li->type = WHEFS_CLOSER_TYPE_DEV;
-    li->item.dev = d;
-    return whefs_rc.OK;
+    return whefs_fs_closer_set( fs, d, WHEFS_CLOSER_TYPE_DEV, d );
 }
 
 int whefs_fs_closer_dev_remove( whefs_fs * fs, whio_dev const * d )
 {
-    return whefs_fs_closer_remove( fs, WHEFS_CLOSER_TYPE_DEV, d );
+    return whefs_fs_closer_remove( fs, d );
 }
 
 int whefs_fs_closer_stream_add( whefs_fs * fs, whio_stream * s, whio_dev const * d )
 {
-    whefs_fs_closer_list * li;
-    if( ! fs || ! s || !d ) return whefs_rc.ArgError;
-    li = fs->closers;
-    if( li )
-    { /** If we find f->dev in the list then we
-          promote the entry to type WHEFS_CLOSER_TYPE_STREAM.
-      */
-        while( li->prev ) li = li->prev;
-        for( ; li ; li = li->next )
-        {
-            if( li->type != WHEFS_CLOSER_TYPE_DEV ) continue;
-            if( d != li->item.dev ) continue;
-            li->type = WHEFS_CLOSER_TYPE_STREAM;
-            li->item.stream = s;
-            break;
-        }
-        if( ! li ) return whefs_rc.RangeError;
-    }
-    else
-    { /* re-evaluate this. Is this sane? */
-        li = whefs_fs_closer_add(fs);
-        if( ! li ) return whefs_rc.AllocError /* that's a guess */;
-        li->type = WHEFS_CLOSER_TYPE_STREAM;
-        li->item.stream = s;
-    }
-    return whefs_rc.OK;
-}
-
-int whefs_fs_closer_stream_remove( whefs_fs * fs, whio_stream const * s )
-{
-    return whefs_fs_closer_remove( fs, WHEFS_CLOSER_TYPE_STREAM, s );
+    return whefs_fs_closer_set( fs, d, WHEFS_CLOSER_TYPE_STREAM, s );
 }
@@ -8,11 +8,14 @@
 
 const whefs_hashid whefs_hashid_empty = whefs_hashid_empty_m;
 
-whefs_hashval_type whefs_hash_cstring( char const * vstr)
+whefs_hashval_type whefs_hash_djb2( char const * vstr )
 {
-#if 1
-    /* "djb2" algo code taken from: http://www.cse.yorku.ca/~oz/hash.html */
-    whefs_hashval_type hash = 5381;
+    /* "djb2" algo code taken from: http://www.cse.yorku.ca/~oz/hash.html
+
+       Maintenance reminder: the on-disk name index stores these
+       values, so this must not change.
+    */
+    uint32_t hash = 5381;
     int c = 0;
     if( ! vstr ) return 0U;
     while( (c = *vstr++) )
@@ -20,19 +23,90 @@ whefs_hashval_type whefs_hash_cstring( char const * vstr)
         hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
     }
     return hash;
-#else
- /* "shift-and-xor" algo code taken from: http://eternallyconfuzzled.com/tuts/algorithms/jsw_tut_hashing.aspx
+}
+
+/** Returns the 8 bytes at p as a uint64_t, in native byte order. */
+static uint64_t whefs_hash_r8( unsigned char const * p )
+{
+    uint64_t v;
+    memcpy( &v, p, 8 );
+    return v;
+}
+
+/** Returns the 4 bytes at p as a uint64_t, in native byte order. */
+static uint64_t whefs_hash_r4( unsigned char const * p )
+{
+    uint32_t v;
+    memcpy( &v, p, 4 );
+    return v;
+}
 
+/**
+   Multiplies a and b to a 128-bit product and returns the xor of its
+   halves: the mixing step of wyhash.
 */
-    whefs_hashval_type hash = 0;
-    if(vstr) for( ; *vstr; ++vstr )
+static uint64_t whefs_hash_mum( uint64_t a, uint64_t b )
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t const r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+    uint64_t const ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t const rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t const t = rl + (rm0 << 32);
+    uint64_t lo = t + (rm1 << 32);
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + (t < rl) + (lo < t);
+    return lo ^ hi;
+#endif
+}
+
+whefs_hashval_type whefs_hash_wy( char const * vstr )
+{
+    /* built from 32-bit halves because C89 has no long long literals */
+    static const uint64_t s0 = ((uint64_t)0xa0761d64UL << 32) | 0x78bd642fUL;
+    static const uint64_t s1 = ((uint64_t)0xe7037ed1UL << 32) | 0xa0b428dbUL;
+    unsigned char const * p = (unsigned char const *)vstr;
+    uint64_t seed = s0, a, b, h;
+    size_t len, i;
+    if( ! vstr ) return 0U;
+    len = strlen( vstr );
+    if( len <= 16 )
+    {
+        if( len >= 4 )
+        { /* two (possibly overlapping) 4-byte reads from each end */
+            a = (whefs_hash_r4( p ) << 32) | whefs_hash_r4( p + ((len >> 3) << 2) );
+            b = (whefs_hash_r4( p + len - 4 ) << 32) | whefs_hash_r4( p + len - 4 - ((len >> 3) << 2) );
+        }
+        else if( len )
+        {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+            b = 0;
+        }
+        else a = b = 0;
+    }
+    else
     {
-        hash ^= ( hash << 5 ) + ( hash >> 2 ) + *vstr;
+        for( i = len; i > 16; i -= 16, p += 16 )
+        {
+            seed = whefs_hash_mum( whefs_hash_r8( p ) ^ s1, whefs_hash_r8( p + 8 ) ^ seed );
+        }
+        /* the last 16 bytes, which may overlap the last block */
+        a = whefs_hash_r8( p + i - 16 );
+        b = whefs_hash_r8( p + i - 8 );
     }
-   return hash;
+    h = whefs_hash_mum( s1 ^ len, whefs_hash_mum( a ^ s1, b ^ seed ) );
+#if WHEFS_CONFIG_HASHVAL_BITS == 64
+    return h;
+#else
+    return (whefs_hashval_type)(h ^ (h >> 32));
 #endif
 }
 
+whefs_hashval_type whefs_hash_cstring( char const * vstr )
+{
+    return whefs_hash_wy( vstr );
+}
+
 /**
    A compare routine for bsearch(). Compares the hash fields of lhs
    and rhs based on their hash member. They must be (whefs_hashid
@@ -289,3 +363,174 @@ int whefs_hashid_list_add_slots( whefs_hashid_list * li, whefs_id_type pos, whef
 }
 
 
+
+const whefs_hashid_table whefs_hashid_table_empty = whefs_hashid_table_empty_m;
+
+/**
+   Returns the home slot of the given hash value in tbl, which must
+   have at least one slot. The hash is mixed first because the low
+   bits of short strings' hash values are poorly distributed.
+*/
+static uint32_t whefs_hashid_table_home( whefs_hashid_table const * tbl, whefs_hashval_type hash )
+{
+    uint32_t h = (uint32_t)(hash ^ (hash >> 16 >> 16)); /* fold 64-bit hashes */
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return h & (tbl->alloced - 1);
+}
+
+/**
+   Returns the slot index of the given mapping, or tbl->alloced if
+   it is not in tbl.
+*/
+static uint32_t whefs_hashid_table_slot( whefs_hashid_table const * tbl, whefs_hashval_type hash, whefs_id_type id )
+{
+    uint32_t i;
+    if( ! tbl->count ) return tbl->alloced;
+    i = whefs_hashid_table_home( tbl, hash );
+    for( ; tbl->list[i].id; i = (i + 1) & (tbl->alloced - 1) )
+    {
+        if( (tbl->list[i].id == id) && (tbl->list[i].hash == hash) ) return i;
+    }
+    return tbl->alloced;
+}
+
+/** Puts a copy of h into the first free slot of its probe run. */
+static void whefs_hashid_table_put( whefs_hashid_table * tbl, whefs_hashid const * h )
+{
+    uint32_t i = whefs_hashid_table_home( tbl, h->hash );
+    while( tbl->list[i].id ) i = (i + 1) & (tbl->alloced - 1);
+    tbl->list[i] = *h;
+    ++tbl->count;
+}
+
+int whefs_hashid_table_reserve( whefs_hashid_table * tbl, uint32_t count )
+{
+    whefs_hashid * old;
+    uint32_t oldCount, n, i;
+    if( ! tbl ) return whefs_rc.ArgError;
+    /* Keep the table at most 3/4 full. */
+    n = tbl->alloced ? tbl->alloced : 16;
+    while( (n / 4 * 3) < count )
+    {
+        n *= 2;
+        if( ! n ) return whefs_rc.RangeError /* overflow */;
+    }
+    if( n == tbl->alloced ) return whefs_rc.OK;
+    old = tbl->list;
+    oldCount = tbl->alloced;
+    tbl->list = (whefs_hashid *) calloc( n, sizeof(whefs_hashid) );
+    if( ! tbl->list )
+    {
+        tbl->list = old;
+        return whefs_rc.AllocError;
+    }
+    tbl->alloced = n;
+    tbl->count = 0;
+    for( i = 0; i < oldCount; ++i )
+    {
+        if( old[i].id ) whefs_hashid_table_put( tbl, &old[i] );
+    }
+    free( old );
+    WHEFS_DBG_CACHE("Resized whefs_hashid_table to %"PRIu32" slots for %"PRIu32" entries.", n, tbl->count);
+    return whefs_rc.OK;
+}
+
+int whefs_hashid_table_insert( whefs_hashid_table * tbl, whefs_hashval_type hash, whefs_id_type id )
+{
+    int rc;
+    whefs_hashid h = whefs_hashid_empty;
+    if( ! tbl || ! id ) return whefs_rc.ArgError;
+    if( whefs_hashid_table_slot( tbl, hash, id ) != tbl->alloced ) return whefs_rc.OK;
+    rc = whefs_hashid_table_reserve( tbl, tbl->count + 1 );
+    if( whefs_rc.OK != rc ) return rc;
+    h.hash = hash;
+    h.id = id;
+    whefs_hashid_table_put( tbl, &h );
+    return whefs_rc.OK;
+}
+
+int whefs_hashid_table_remove( whefs_hashid_table * tbl, whefs_hashval_type hash, whefs_id_type id )
+{
+    uint32_t i, j, home;
+    uint32_t mask;
+    if( ! tbl ) return whefs_rc.ArgError;
+    i = whefs_hashid_table_slot( tbl, hash, id );
+    if( i == tbl->alloced ) return whefs_rc.RangeError;
+    mask = tbl->alloced - 1;
+    tbl->list[i] = whefs_hashid_empty;
+    --tbl->count;
+    /* Shift the rest of the probe run back so that it stays unbroken. */
+    for( j = (i + 1) & mask; tbl->list[j].id; j = (j + 1) & mask )
+    {
+        home = whefs_hashid_table_home( tbl, tbl->list[j].hash );
+        if( WHEFS_PROBE_CAN_FILL(i,j,home) )
+        {
+            tbl->list[i] = tbl->list[j];
+            tbl->list[j] = whefs_hashid_empty;
+            i = j;
+        }
+    }
+    return whefs_rc.OK;
+}
+
+whefs_id_type whefs_hashid_table_search( whefs_hashid_table const * tbl, whefs_hashval_type hash, uint32_t * cursor )
+{
+    uint32_t i;
+    if( ! tbl || ! cursor || ! tbl->count ) return 0;
+    i = (whefs_hashid_table_home( tbl, hash ) + *cursor) & (tbl->alloced - 1);
+    while( (*cursor < tbl->alloced) && tbl->list[i].id )
+    {
+        ++*cursor;
+        if( tbl->list[i].hash == hash )
+        {
+            ++tbl->list[i].hits;
+            return tbl->list[i].id;
+        }
+        i = (i + 1) & (tbl->alloced - 1);
+    }
+    return 0;
+}
+
+void whefs_hashid_table_clear( whefs_hashid_table * tbl )
+{
+    if( ! tbl ) return;
+    if( tbl->alloced )
+    {
+        WHEFS_DBG_CACHE("Freeing whefs_hashid_table with %"PRIu32"/%"PRIu32" used/allocated slots.",tbl->count,tbl->alloced);
+    }
+    free( tbl->list );
+    *tbl = whefs_hashid_table_empty;
+}
+
+size_t whefs_hashid_table_sizeof( whefs_hashid_table const * tbl )
+{
+    if( ! tbl ) return 0;
+    return sizeof(whefs_hashid_table)
+        + (sizeof(whefs_hashid) * tbl->alloced);
+}
+
+int whefs_hashid_table_chomp_lv( whefs_hashid_table * tbl )
+{
+    whefs_hashid * li;
+    whefs_hashid * x;
+    uint32_t i, n;
+    if( ! tbl ) return whefs_rc.ArgError;
+    if( tbl->count < 2 ) return whefs_rc.OK;
+    li = (whefs_hashid *) malloc( tbl->count * sizeof(whefs_hashid) );
+    if( ! li ) return whefs_rc.AllocError;
+    for( n = 0, x = tbl->list, i = 0; i < tbl->alloced; ++i, ++x )
+    {
+        if( x->id ) li[n++] = *x;
+    }
+    qsort( li, n, sizeof(whefs_hashid), whefs_hashid_cmp_hits );
+    memset( tbl->list, 0, tbl->alloced * sizeof(whefs_hashid) );
+    tbl->count = 0;
+    for( i = n / 2; i < n; ++i )
+    {
+        whefs_hashid_table_put( tbl, &li[i] );
+    }
+    free( li );
+    return whefs_rc.OK;
+}
@@ -15,25 +15,8 @@
 extern "C" {
 #endif
 
-/**
-   The integral type whefs uses to store hash values.
-
-   Reminder to self: if we'll add support for duplicate hash codes
-   to the inode names hash cache then we can drop this to
-   uint16_t and potentially save significant amounts of memory.
-   The difference is: with uint32_t we can cache 128 inode hashes
-   per 1k of memory. With uint16_t we can cache 170 hashes per
-   1k of memory.
-*/
-typedef uint32_t whefs_hashval_type;
-/**
-   printf format specifier for use with whefs_hashval_type.
-*/
-#define WHEFS_HASHVAL_TYPE_PFMT "08"PRIxLEAST32
-/**
-   scanf format specifier for use with whefs_hashval_type.
-*/
-#define WHEFS_HASHVAL_TYPE_SFMT SCNu32
+/* whefs_hashval_type and its format specifiers are defined in
+   whefs_config.h (see WHEFS_CONFIG_HASHVAL_BITS). */
 
 /**
    A container for mapping abstract hash values to abstract
@@ -244,7 +227,8 @@ int whefs_hashid_list_add_slots( whefs_hashid_list * li, whefs_id_type pos, whef
 /**
    Generates a hash code for the given null-terminated string.
    If str is null then 0 is returned. The exact hash routine
-   is not specified.
+   is not specified: it is the default of whefs_fs_setopt_name_hash()
+   (currently whefs_hash_wy()), so its values must never be stored.
 */
 whefs_hashval_type whefs_hash_cstring( char const * str );
 
@@ -265,6 +249,107 @@ size_t whefs_hashid_list_sizeof( whefs_hashid_list const * li );
 */
 int whefs_hashid_list_chomp_lv( whefs_hashid_list * li );
 
+/** @struct whefs_hashid_table
+
+   An open-addressing hashtable of whefs_hashid objects, keyed by
+   their hash values. Several entries may share a hash value (as long
+   as their IDs differ): they are all found on the same probe run, and
+   it is up to the client to decide which of them, if any, really
+   matches the object the hash was derived from.
+
+   Inserting and removing entries is amortized O(1) and never
+   reorders the rest of the table, so (unlike whefs_hashid_list)
+   there is never a need to re-sort it.
+
+   Entries with an id of 0 mark unused slots, so 0 is not a legal ID
+   for entries.
+
+   Currently this is used to map inode name hashes to inode IDs
+   to speed up lookups by name.
+*/
+struct whefs_hashid_table
+{
+    /** Number of slots in the list. 0 or a power of 2. */
+    uint32_t alloced;
+    /** Number of used slots. */
+    uint32_t count;
+    /** The slots. Collisions are resolved by linear probing. */
+    whefs_hashid * list;
+};
+typedef struct whefs_hashid_table whefs_hashid_table;
+/** Empty initializer object. */
+#define whefs_hashid_table_empty_m {0U/*alloced*/,0U/*count*/,0/*list*/}
+/** Empty initializer object. */
+extern const whefs_hashid_table whefs_hashid_table_empty;
+
+/**
+   Makes sure that tbl can hold at least count entries without
+   growing. Returns whefs_rc.OK on success, whefs_rc.ArgError if !tbl,
+   or whefs_rc.AllocError if allocation fails.
+*/
+int whefs_hashid_table_reserve( whefs_hashid_table * tbl, uint32_t count );
+
+/**
+   Maps the given hash to the given id in tbl, growing tbl if needed.
+   If that mapping already exists this is a no-op.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !tbl or !id,
+   or whefs_rc.AllocError.
+*/
+int whefs_hashid_table_insert( whefs_hashid_table * tbl, whefs_hashval_type hash, whefs_id_type id );
+
+/**
+   Removes the mapping of the given hash to the given id from tbl.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !tbl, or
+   whefs_rc.RangeError if no such mapping exists.
+*/
+int whefs_hashid_table_remove( whefs_hashid_table * tbl, whefs_hashval_type hash, whefs_id_type id );
+
+/**
+   Iterates over the IDs mapped to the given hash. *cursor must be
+   set to 0 before the first call and must not be modified by the
+   caller between calls. Each call returns the next matching ID (and
+   increments that entry's hits count), or 0 when there are no more.
+
+   Results are undefined if tbl is modified between calls for the
+   same cursor.
+*/
+whefs_id_type whefs_hashid_table_search( whefs_hashid_table const * tbl, whefs_hashval_type hash, uint32_t * cursor );
+
+/**
+   Frees all memory owned by tbl and re-initializes it to an empty
+   state. tbl itself is not freed.
+*/
+void whefs_hashid_table_clear( whefs_hashid_table * tbl );
+
+/**
+   Returns the amount of memory allocated to tbl, including the
+   table object itself.
+*/
+size_t whefs_hashid_table_sizeof( whefs_hashid_table const * tbl );
+
+/**
+   Removes the least-visited half of the entries from tbl, as for
+   whefs_hashid_list_chomp_lv(). The hits counts of the remaining
+   entries are kept.
+
+   Returns whefs_rc.OK on success, whefs_rc.ArgError if !tbl, or
+   whefs_rc.AllocError.
+*/
+int whefs_hashid_table_chomp_lv( whefs_hashid_table * tbl );
+
+/**
+   For backward-shift deletion from linearly-probed tables (this
+   file's whefs_hashid_table, the opened-inodes table and the on-disk
+   name index): evaluates to true if the entry in slot J, whose home
+   slot is HOME, may be moved into the hole at slot HOLE, i.e. if
+   HOME does not lie cyclically in (HOLE,J]. Each argument is
+   evaluated up to three times.
+*/
+#define WHEFS_PROBE_CAN_FILL(HOLE,J,HOME) \
+    (((HOLE) <= (J)) ? (((HOME) <= (HOLE)) || ((HOME) > (J))) : (((HOME) <= (HOLE)) && ((HOME) > (J))))
+
 #if 0
 
 /**
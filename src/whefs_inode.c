@@ -18,69 +18,168 @@ const whefs_inode whefs_inode_empty = whefs_inode_empty_m;
 const whefs_inode_list whefs_inode_list_empty = whefs_inode_list_empty_m;
 
 
-/**
-   If WHEFS_CONFIG_ENABLE_STATIC_MALLOC is true then we statically allocate
-   whefs_inode_list_alloc_count whefs_inode_list objects to dole out via
-   whefs_inode_list_alloc(), falling back to malloc() if the list is full.
-*/
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
 enum {
+/** Number of whefs_inode_list objects per slab of opened inodes. */
+whefs_inode_slab_count = 32,
+/** Initial number of slots in whefs_fs::opened_nodes. Must be a power of 2. */
+whefs_inode_opened_slots_min = 16
+};
+
 /**
-   The number of elements to statically allocate
-   in the whefs_inode_list_alloc_slots object.
+   A block of whefs_inode_list objects for opened inodes. Slabs are
+   only freed when their whefs_fs is, so the inodes in them never
+   move.
 */
-whefs_inode_list_alloc_count = 10
-};
-static struct
+struct whefs_inode_slab
 {
-    whefs_inode_list objs[whefs_inode_list_alloc_count];
-    char used[whefs_inode_list_alloc_count];
-    size_t next;
-} whefs_inode_list_alloc_slots = { {whefs_inode_list_empty_m}, {0}, 0 };
-#endif
+    struct whefs_inode_slab * next;
+    whefs_inode_list items[whefs_inode_slab_count];
+};
 
-static whefs_inode_list * whefs_inode_list_alloc()
+/**
+   Returns an unused whefs_inode_list from fs's slabs, allocating a
+   new slab if needed, or 0 on allocation error.
+*/
+static whefs_inode_list * whefs_inode_list_alloc( whefs_fs * fs )
 {
-    whefs_inode_list * obj = 0;
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
-    size_t i = whefs_inode_list_alloc_slots.next;
-    for( ; i < whefs_inode_list_alloc_count; ++i )
+    whefs_inode_list * obj = fs->opened_nodes.free;
+    if( ! obj )
     {
-	if( whefs_inode_list_alloc_slots.used[i] ) continue;
-	whefs_inode_list_alloc_slots.next = i+1;
-	whefs_inode_list_alloc_slots.used[i] = 1;
-	obj = &whefs_inode_list_alloc_slots.objs[i];
-	break;
+        int i;
+        struct whefs_inode_slab * sl = (struct whefs_inode_slab *) malloc( sizeof(struct whefs_inode_slab) );
+        if( ! sl ) return 0;
+        sl->next = fs->opened_nodes.slabs;
+        fs->opened_nodes.slabs = sl;
+        for( i = whefs_inode_slab_count - 1; i >= 0; --i )
+        {
+            sl->items[i] = whefs_inode_list_empty;
+#if WHEFS_CONFIG_ENABLE_THREADS
+            whefs_mutex_init_recursive( &sl->items[i].lock );
+#endif
+            sl->items[i].next = fs->opened_nodes.free;
+            fs->opened_nodes.free = &sl->items[i];
+        }
+        obj = fs->opened_nodes.free;
     }
-#endif /* WHEFS_CONFIG_ENABLE_STATIC_MALLOC */
-    if( ! obj ) obj = (whefs_inode_list *) malloc( sizeof(whefs_inode_list) );
-    if( obj ) *obj = whefs_inode_list_empty;
+    fs->opened_nodes.free = obj->next;
+    obj->inode = whefs_inode_empty; /* but keep obj->lock */
+    obj->next = 0;
     return obj;
 }
 
-static void whefs_inode_list_free( whefs_inode_list * obj )
+/** Returns obj, which must have come from whefs_inode_list_alloc(fs), to fs's free-list. */
+static void whefs_inode_list_free( whefs_fs * fs, whefs_inode_list * obj )
+{
+    if( ! obj ) return;
+    obj->inode = whefs_inode_empty;
+    obj->next = fs->opened_nodes.free;
+    fs->opened_nodes.free = obj;
+}
+
+#if WHEFS_CONFIG_ENABLE_THREADS
+void whefs_inode_lock( whefs_inode * ino )
 {
-    if( obj ) *obj = whefs_inode_list_empty;
-    else return;
-#if WHEFS_CONFIG_ENABLE_STATIC_MALLOC
-    if( (obj < &whefs_inode_list_alloc_slots.objs[0]) ||
-	(obj > &whefs_inode_list_alloc_slots.objs[whefs_inode_list_alloc_count-1]) )
-    { /* it does not belong to us */
-	free(obj);
-	return;
+    /* ino is the first member of its whefs_inode_list */
+    pthread_mutex_lock( &((whefs_inode_list *)ino)->lock );
+}
+
+void whefs_inode_unlock( whefs_inode * ino )
+{
+    pthread_mutex_unlock( &((whefs_inode_list *)ino)->lock );
+}
+#endif /* WHEFS_CONFIG_ENABLE_THREADS */
+
+/** Returns the home slot of inode ID id in fs->opened_nodes. */
+#define WHEFS_OPENED_HOME(FS,ID) ((whio_size_t)((ID) * 2654435761U) & (FS)->opened_nodes.mask)
+
+/**
+   Returns the index of the slot in fs->opened_nodes which holds inode
+   #id, or the index of the empty slot where it would go. The table
+   must have at least one empty slot.
+*/
+static whio_size_t whefs_inode_opened_find( whefs_fs const * fs, whefs_id_type id )
+{
+    whio_size_t i = WHEFS_OPENED_HOME(fs,id);
+    whefs_inode * const * slots = fs->opened_nodes.slots;
+    while( slots[i] && (slots[i]->id != id) ) i = (i + 1) & fs->opened_nodes.mask;
+    return i;
+}
+
+/**
+   Makes sure fs->opened_nodes has room for one more inode, keeping it
+   at most 3/4 full. Returns whefs_rc.OK or whefs_rc.AllocError.
+*/
+static int whefs_inode_opened_reserve( whefs_fs * fs )
+{
+    struct whefs_opened_nodes * on = &fs->opened_nodes;
+    whefs_inode ** old = on->slots;
+    const whio_size_t oldCount = old ? (on->mask + 1) : 0;
+    whio_size_t n, i;
+    if( old && (((on->count + 1) * 4) <= (oldCount * 3)) ) return whefs_rc.OK;
+    n = oldCount ? (oldCount * 2) : whefs_inode_opened_slots_min;
+    on->slots = (whefs_inode **) calloc( n, sizeof(whefs_inode*) );
+    if( ! on->slots )
+    {
+        on->slots = old;
+        return whefs_rc.AllocError;
     }
-    else
+    on->mask = n - 1;
+    for( i = 0; i < oldCount; ++i )
     {
-	const size_t ndx = (obj - &whefs_inode_list_alloc_slots.objs[0]);
-	whefs_inode_list_alloc_slots.used[ndx] = 0;
-	if( ndx < whefs_inode_list_alloc_slots.next ) whefs_inode_list_alloc_slots.next = ndx;
-	return;
+        if( old[i] ) on->slots[whefs_inode_opened_find( fs, old[i]->id )] = old[i];
     }
-#else
-    free(obj);
-#endif /* WHEFS_CONFIG_ENABLE_STATIC_MALLOC */
+    free( old );
+    return whefs_rc.OK;
 }
 
+/**
+   Removes the inode in slot i of fs->opened_nodes, moving any
+   following entries of the same probe run back so that lookups never
+   need tombstones.
+*/
+static void whefs_inode_opened_remove( whefs_fs * fs, whio_size_t i )
+{
+    struct whefs_opened_nodes * on = &fs->opened_nodes;
+    whio_size_t j = i;
+    on->slots[i] = 0;
+    --on->count;
+    while( 1 )
+    {
+        whio_size_t home;
+        j = (j + 1) & on->mask;
+        if( ! on->slots[j] ) break;
+        home = WHEFS_OPENED_HOME(fs,on->slots[j]->id);
+        if( WHEFS_PROBE_CAN_FILL(i,j,home) )
+        {
+            on->slots[i] = on->slots[j];
+            on->slots[j] = 0;
+            i = j;
+        }
+    }
+}
+
+void whefs_inode_opened_free( whefs_fs * fs )
+{
+    struct whefs_inode_slab * sl;
+    if( ! fs ) return;
+    while( (sl = fs->opened_nodes.slabs) )
+    {
+#if WHEFS_CONFIG_ENABLE_THREADS
+        int i;
+        for( i = 0; i < whefs_inode_slab_count; ++i )
+        {
+            pthread_mutex_destroy( &sl->items[i].lock );
+        }
+#endif
+        fs->opened_nodes.slabs = sl->next;
+        free( sl );
+    }
+    free( fs->opened_nodes.slots );
+    fs->opened_nodes.slots = 0;
+    fs->opened_nodes.mask = 0;
+    fs->opened_nodes.count = 0;
+    fs->opened_nodes.free = 0;
+}
 
 /**
    This updates the internal used-inodes cache (if enabled) and inode
@@ -118,34 +217,15 @@ int whefs_inode_name_set( whefs_fs * fs, whefs_id_type nid, char const * name )
            we can replace its hashvalue in the cache. If we don't do this we end
            up with stale/useless entries in the cache.
         */
-        whefs_hashid * H = 0;
-        char const * nameCheck = name;
         enum { bufSize = WHEFS_MAX_FILENAME_LENGTH + 1 };
         char buf[bufSize] = {0};
         whefs_string ncheck = whefs_string_empty;
-        whefs_id_type ndx;
         ncheck.string = buf;
         ncheck.alloced = bufSize;
-        if(1)
-        {
-            rc = whefs_inode_name_get( fs, nid, &ncheck );
-            assert( (ncheck.string == buf) && "illegal (re)alloc!");
-            if( whefs_rc.OK != rc ) return rc;
-            if( *buf && (0==strcmp(buf,name))) return whefs_rc.OK;
-            if( *buf ) nameCheck = ncheck.string;
-        }
-        WHEFS_DBG_CACHE("inode-name-set check for collision in [old=[%s]][new=[%s]][checkAgainst=[%s]].",ncheck.string,name,nameCheck);
-        ndx = whefs_inode_hash_cache_search_ndx( fs, nameCheck );
-        if( ndx != whefs_rc.IDTypeEnd )
-        {
-            WHEFS_DBG_CACHE("inode-name-set found an existing entry for [%s].",nameCheck);
-            H = &fs->cache.hashes->list[ndx];
-            if( H->id != nid )
-            {
-                WHEFS_DBG_ERR("Internal error: cache hash collision for name [%s]!",name);
-                return whefs_rc.InternalError;
-            }
-        }
+        rc = whefs_inode_name_get( fs, nid, &ncheck );
+        assert( (ncheck.string == buf) && "illegal (re)alloc!");
+        if( whefs_rc.OK != rc ) return rc;
+        if( 0==strcmp(buf,name) ) return whefs_rc.OK;
         /**
            Maintenance reminders:
            
@@ -159,15 +239,9 @@ int whefs_inode_name_set( whefs_fs * fs, whefs_id_type nid, char const * name )
         */
         rc = whefs_fs_name_write( fs, nid, name );
         if( whefs_rc.OK != rc ) return rc;
-#if 1
-        if( H )
-        {
-            H->hash = fs->cache.hashfunc(name);
-            /*fs->cache.hashes->isSorted = false; */
-            whefs_hashid_list_sort( fs->cache.hashes );
-            WHEFS_DBG_CACHE("Replacing hashcode for file [%s].",name);
-        }
-#endif
+        WHEFS_DBG_CACHE("Replacing hashcode for file [%s] (old name=[%s]).",name,buf);
+        whefs_inode_name_uncache( fs, nid, buf );
+        if( *name ) whefs_inode_hash_cache( fs, nid, name );
         return rc;
     }
 }
@@ -228,7 +302,6 @@ int whefs_inode_flush( whefs_fs * fs, whefs_inode const * n )
     else {
         enum { bufSize = whefs_sizeof_encoded_inode };
         unsigned char buf[bufSize];
-        int rc;
         whio_size_t wsz;
         if(0) WHEFS_DBG_FYI("Flushing inode #%"WHEFS_ID_TYPE_PFMT". inode->data_size=%u",
 			n->id, n->data_size );
@@ -239,10 +312,17 @@ int whefs_inode_flush( whefs_fs * fs, whefs_inode const * n )
 #if 0
         return whio_blockdev_write( &fs->fences.i, n->id - 1, buf );
 #else
-        rc = whefs_inode_id_seek( fs, n->id );
-        if( whefs_rc.OK != rc ) return rc;
-        wsz = whefs_fs_write( fs, buf, bufSize );
-        return (wsz == bufSize) ? whefs_rc.OK : whefs_rc.IOError;
+        wsz = whefs_fs_writeat( fs, whefs_inode_id_pos( fs, n->id ), buf, bufSize );
+        if( wsz != bufSize ) return whefs_rc.IOError;
+        if( fs->itable.list && (n->id <= fs->itable.count) )
+        {
+            whefs_inode_rec * r = &fs->itable.list[n->id - 1];
+            r->first_block = n->first_block;
+            r->data_size = n->data_size;
+            r->mtime = n->mtime;
+            r->flags = n->flags;
+        }
+        return whefs_rc.OK;
 #endif
     }
 }
@@ -254,6 +334,17 @@ int whefs_inode_id_read( whefs_fs * fs, whefs_id_type nid, whefs_inode * tgt )
     unsigned char buf[bufSize];
     whio_size_t rsz;
     if( !tgt || !whefs_inode_id_is_valid( fs, nid ) ) return whefs_rc.ArgError;
+    if( fs->itable.list && (nid <= fs->itable.count) )
+    {
+        whefs_inode_rec const * r = &fs->itable.list[nid - 1];
+        tgt->id = nid;
+        tgt->first_block = r->first_block;
+        tgt->data_size = r->data_size;
+        tgt->mtime = r->mtime;
+        tgt->flags = r->flags;
+        whefs_inode_update_used( fs, tgt );
+        return whefs_rc.OK;
+    }
     memset( buf, 0, bufSize );
 #if 0
     rc = whio_blockdev_read( &fs->fences.i, nid - 1, buf );
@@ -264,19 +355,12 @@ int whefs_inode_id_read( whefs_fs * fs, whefs_id_type nid, whefs_inode * tgt )
 	return rc;
     }
 #else
-    rc = whefs_inode_id_seek( fs, nid );
-    if( whefs_rc.OK != rc )
-    {
-	WHEFS_DBG_ERR("Error #%d while seeking to disk pos for inode #%"WHEFS_ID_TYPE_PFMT"!",
-		      rc, nid );
-	return rc;
-    }
-    rsz = whefs_fs_read( fs, buf, bufSize );
+    rsz = whefs_fs_readat( fs, whefs_inode_id_pos( fs, nid ), buf, bufSize );
     if( rsz != bufSize )
     {
 	WHEFS_DBG_ERR("Error reading %u bytes for inode #%"WHEFS_ID_TYPE_PFMT". Only got %"WHIO_SIZE_T_PFMT" bytes!",
 		      bufSize, nid, rsz );
-	return rc;
+	return whefs_rc.IOError;
     }
 #endif
     rc = whefs_inode_decode( tgt, buf );
@@ -290,6 +374,80 @@ int whefs_inode_id_read( whefs_fs * fs, whefs_id_type nid, whefs_inode * tgt )
     return rc;
 }
 
+int whefs_fs_itable_load( whefs_fs * fs )
+{
+    const whefs_id_type nc = fs->options.inode_count;
+    const whio_size_t rs = fs->sizes[WHEFS_SZ_INODE_NO_STR];
+    const whio_size_t len = nc * rs;
+    unsigned char * buf;
+    unsigned char const * bp;
+    whefs_inode_rec * list;
+    whefs_inode n = whefs_inode_empty;
+    whefs_id_type i;
+    int rc = whefs_rc.OK;
+    if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    whefs_fs_itable_free( fs );
+    if( ! nc ) return whefs_rc.OK;
+    list = (whefs_inode_rec *) malloc( nc * sizeof(whefs_inode_rec) );
+    buf = (unsigned char *) malloc( len );
+    if( !list || !buf )
+    {
+        free( list );
+        free( buf );
+        return whefs_rc.AllocError;
+    }
+    if( len != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_INODES_NO_STR], buf, len ) )
+    {
+        WHEFS_DBG_ERR("Could not read the %"WHIO_SIZE_T_PFMT"-byte inode table!", len );
+        rc = whefs_rc.IOError;
+    }
+    for( i = 0, bp = buf; (i < nc) && (whefs_rc.OK == rc); ++i, bp += rs )
+    {
+        rc = whefs_inode_decode( &n, bp );
+        if( (whefs_rc.OK == rc) && (n.id != (i + 1)) ) rc = whefs_rc.ConsistencyError;
+        if( whefs_rc.OK != rc )
+        {
+            WHEFS_DBG_ERR("Error #%d while decoding inode #%"WHEFS_ID_TYPE_PFMT"!", rc, i + 1 );
+            break;
+        }
+        list[i].first_block = n.first_block;
+        list[i].data_size = n.data_size;
+        list[i].mtime = n.mtime;
+        list[i].flags = n.flags;
+        if( i ) whefs_inode_update_used( fs, &n ); /* the root node is always considered used */
+    }
+    free( buf );
+    if( whefs_rc.OK != rc )
+    {
+        free( list );
+        return rc;
+    }
+    fs->itable.list = list;
+    fs->itable.count = nc;
+#if WHEFS_CONFIG_ENABLE_BITSET_CACHE
+    fs->bits.i_loaded = true;
+#endif
+    return whefs_rc.OK;
+}
+
+void whefs_fs_itable_free( whefs_fs * fs )
+{
+    if( ! fs ) return;
+    free( fs->itable.list );
+    fs->itable.list = 0;
+    fs->itable.count = 0;
+}
+
+int whefs_fs_setopt_inode_table( whefs_fs * fs, bool on )
+{
+    int rc = whefs_rc.OK;
+    if( ! fs ) return whefs_rc.ArgError;
+    if( on && !fs->itable.list && fs->dev ) rc = whefs_fs_itable_load( fs );
+    else if( ! on ) whefs_fs_itable_free( fs );
+    fs->itable.enabled = (on && (whefs_rc.OK == rc));
+    return rc;
+}
+
 int whefs_inode_read_flags( whefs_fs * fs, whefs_id_type nid, uint32_t * flags )
 {
     whefs_inode ino = whefs_inode_empty;
@@ -358,10 +516,11 @@ int whefs_inode_next_free( whefs_fs * fs, whefs_inode * tgt, bool markUsed )
     {
         int rc;
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE
-	if( fs->bits.i_loaded && WHEFS_ICACHE_IS_USED(fs,i) )
-	{
-	    /*WHEFS_DBG("Got cached inode USED entry for inode #%"WHEFS_ID_TYPE_PFMT"", i ); */
-	    continue;
+	if( fs->bits.i_loaded )
+	{ /* Jump straight to the next inode the cache doesn't mark as used. */
+	    const whbits_count_t x = whbits_find_unset( &fs->bits.i, i, (whbits_count_t)fs->options.inode_count + 1 );
+	    if( x > fs->options.inode_count ) break;
+	    i = (whefs_id_type)x;
 	}
 	/*WHEFS_DBG("Cache says inode #%i is unused.", i ); */
 #endif
@@ -417,20 +576,13 @@ int whefs_inode_search_opened( whefs_fs * fs, whefs_id_type nodeID, whefs_inode
 {
     /* FIXME: need to lock the fs here, or at least lock fs->opened_nodes. */
     if( ! whefs_inode_id_is_valid(fs, nodeID) || !tgt ) return whefs_rc.ArgError;
+    else if( ! fs->opened_nodes.count ) return whefs_rc.RangeError;
     else {
-        whefs_inode_list * li = fs->opened_nodes;
-        for( ; li; li = li->next )
-        {
-            if( li->inode.id < nodeID ) continue;
-            else if( li->inode.id > nodeID ) break;
-            else
-            {
-                /*WHEFS_DBG("Found opened node #%"WHEFS_ID_TYPE_PFMT".", nodeID ); */
-                *tgt = &li->inode;
-                return whefs_rc.OK;
-            }
-        }
-        return whefs_rc.RangeError;
+        whefs_inode * x = fs->opened_nodes.slots[whefs_inode_opened_find( fs, nodeID )];
+        if( ! x ) return whefs_rc.RangeError;
+        /*WHEFS_DBG("Found opened node #%"WHEFS_ID_TYPE_PFMT".", nodeID ); */
+        *tgt = x;
+        return whefs_rc.OK;
     }
 }
 
@@ -439,7 +591,6 @@ int whefs_inode_open( whefs_fs * fs, whefs_id_type nodeID, whefs_inode ** tgt, v
     whefs_inode * x = 0;
     int rc;
     whefs_inode_list * ent;
-    whefs_inode_list * li;
     if( ! whefs_inode_id_is_valid(fs, nodeID) || !tgt ) return whefs_rc.ArgError;
     /*WHEFS_DBG_FYI( "Got request to open inode #%"WHEFS_ID_TYPE_PFMT". writer=@0x%p", nodeID, writer ); */
     rc = whefs_inode_search_opened( fs, nodeID, &x );
@@ -487,51 +638,27 @@ int whefs_inode_open( whefs_fs * fs, whefs_id_type nodeID, whefs_inode ** tgt, v
        Design note/reminder: the preference would have been to use an
        expanding array of whefs_inode for the opened nodes list, but
        when we realloc() it that could invalidate older pointers to
-       those inodes (been there, done that). Thus we suffer a linked
-       list and the associated mallocs...
+       those inodes (been there, done that). Thus the inodes live in
+       slabs which never move, and the hash table only holds
+       pointers to them.
     */
-    ent = whefs_inode_list_alloc();
+    rc = whefs_inode_opened_reserve( fs );
+    if( whefs_rc.OK != rc ) return rc;
+    ent = whefs_inode_list_alloc( fs );
     if( ! ent ) return whefs_rc.AllocError;
-    *ent = whefs_inode_list_empty;
     ent->inode.id = nodeID;
     rc = whefs_inode_id_read( fs, nodeID, &ent->inode );
     if( whefs_rc.OK != rc )
     {
-        whefs_inode_list_free(ent);
-	WHEFS_DBG_ERR("Opening inode #%"WHEFS_ID_TYPE_PFMT" FAILED - whefs_inode_id_read() returned %d", ent->inode.id, rc );
+	WHEFS_DBG_ERR("Opening inode #%"WHEFS_ID_TYPE_PFMT" FAILED - whefs_inode_id_read() returned %d", nodeID, rc );
+        whefs_inode_list_free( fs, ent );
 	return rc;
     }
     /*WHEFS_DBG("Opened inode #%"WHEFS_ID_TYPE_PFMT" with name [%s]", ent->inode.id, ent->inode.name.string ); */
     x = &ent->inode;
     x->writer = writer;
-    li = fs->opened_nodes;
-    if( ! li )
-    { /* we have the distinction of being the first entry. */
-	fs->opened_nodes = li = ent;
-    }
-    else
-    { /* let's keep the list sorted here, as that can save us some comparisons later. */
-	while( li->next && (li->inode.id < ent->inode.id) )
-	{
-	    li = li->next;
-	}
-	if( (li->inode.id < ent->inode.id) )
-	{ /* insert on the right */
-	    ent->prev = li;
-	    ent->next = li->next;
-	    li->next = ent;
-	    if( ent->next ) ent->next->prev = ent;
-	}
-	else
-	{ /* insert on the left */
-	    ent->next = li;
-	    ent->prev = li->prev;
-	    li->prev = ent;
-	    if( ent->prev ) ent->prev->next = ent;
-	}
-    }
-    /* make sure we keep the list at the proper position... */
-    while( fs->opened_nodes->prev ) fs->opened_nodes = fs->opened_nodes->prev;
+    fs->opened_nodes.slots[whefs_inode_opened_find( fs, nodeID )] = x;
+    ++fs->opened_nodes.count;
     if(0) WHEFS_DBG_FYI("Newly opened inode #%"WHEFS_ID_TYPE_PFMT".", x->id, x->open_count );
     x->open_count = 1;
     *tgt = x;
@@ -541,22 +668,14 @@ int whefs_inode_open( whefs_fs * fs, whefs_id_type nodeID, whefs_inode ** tgt, v
 int whefs_inode_close( whefs_fs * fs, whefs_inode * src, void const * writer )
 {
     whefs_inode * np = 0;
-    whefs_inode_list * li;
+    whio_size_t slot = 0;
     if( ! whefs_inode_is_valid(fs, src) ) return whefs_rc.ArgError;
     if(0) WHEFS_DBG_FYI("Closing shared inode #%"WHEFS_ID_TYPE_PFMT": Use count=%u, data size=%u",
 			src->id, src->open_count, src->data_size );
-    li = fs->opened_nodes;
-    for( ; li; li = li->next )
+    if( fs->opened_nodes.count )
     {
-	if( li->inode.id < src->id ) continue;
-	else if( li->inode.id > src->id) break;
-	/*if( li->inode.id != src->id ) continue; */
-	else
-	{
-	    if(0) WHEFS_DBG_FYI("Found opened node #%"WHEFS_ID_TYPE_PFMT". We'll close this one.", src->id );
-	    np = &li->inode;
-	    break;
-	}
+        slot = whefs_inode_opened_find( fs, src->id );
+        np = fs->opened_nodes.slots[slot];
     }
     if( ! np )
     {
@@ -581,15 +700,13 @@ int whefs_inode_close( whefs_fs * fs, whefs_inode * src, void const * writer )
     {
 	if(0) WHEFS_DBG_FYI("REALLY closing inode #%"WHEFS_ID_TYPE_PFMT": Use count=%u, data size=%u",
 			    src->id, src->open_count, src->data_size );
-	if( li == fs->opened_nodes ) fs->opened_nodes = (li->next ? li->next : li->prev);
-	if( li->prev ) li->prev->next = li->next;
-	if( li->next ) li->next->prev = li->prev;
+	whefs_inode_opened_remove( fs, slot );
 	if( np->blocks.list )
 	{
 	    free(np->blocks.list);
 	}
 	np->blocks = whefs_block_list_empty;
-	whefs_inode_list_free(li);
+	whefs_inode_list_free( fs, (whefs_inode_list *)np ); /* inode is the first member */
     }
     if(0) WHEFS_DBG_FYI("%p %p Closed shared inode #%"WHEFS_ID_TYPE_PFMT": Use count=%u, data size=%u",
 			np, src, src->id, src->open_count, src->data_size );
@@ -647,10 +764,11 @@ int whefs_inode_by_name( whefs_fs * fs, char const * name, whefs_inode * tgt )
     size_t slen;
     whefs_string ns = whefs_string_empty;
     int rc = whefs_rc.OK;
-    bool expectExact = false; /* when true, we stop with error if first guess isn't correct */
     whefs_hashval_type nameHash;
-    char const * cname;
-    whefs_id_type i;
+    char const * cname = NULL; /* matching name entry */
+    whefs_id_type i = 2; /* 2 = first client-usable inode. */
+    bool filtered = false; /* true if the name filter said "maybe" */
+    char const * mem; /* a name in the in-memory names table */
     enum { bufSize = WHEFS_MAX_FILENAME_LENGTH+1 };
     unsigned char buf[bufSize] = {0};
     if( ! fs || !name || !*name || !tgt ) return whefs_rc.ArgError;
@@ -660,35 +778,102 @@ int whefs_inode_by_name( whefs_fs * fs, char const * name, whefs_inode * tgt )
     {
 	return whefs_rc.RangeError;
     }
+    memset(buf,0,bufSize);
+    ns.string = (char *)buf;
+    ns.alloced = bufSize;
+    ns.length = 0;
+    if( fs->cache.filter.enabled && ! fs->cache.filter.loaded && ! fs->nameidx.slots )
+    { /* Build the name filter on first use. This also fills (and
+         completes) the hash cache. An error just leaves it unbuilt. */
+        whefs_name_filter_load( fs );
+    }
     nameHash = fs->cache.hashfunc( name );
-#if 1
-    if( fs->cache.hashes && !fs->cache.hashes->isSorted )
+    if( fs->cache.hashes.count )
     {
-        whefs_inode_hash_cache_sort(fs);
+        /**
+           Check the inodes with the same name hash. We collect them
+           before reading their names because whefs_inode_name_get()
+           may add to (and thereby rehash) the cache. More than a few
+           real collisions are extremely unlikely, and if we overflow
+           the list we simply fall back to the full scan.
+        */
+        enum { maxCandidates = 8 };
+        whefs_id_type cand[maxCandidates];
+        uint32_t cursor = 0;
+        int n = 0, c;
+        while( n < maxCandidates )
+        {
+            cand[n] = whefs_hashid_table_search( &fs->cache.hashes, nameHash, &cursor );
+            if( ! cand[n] ) break;
+            ++n;
+        }
+        for( c = 0; c < n; ++c )
+        {
+            if( whefs_rc.OK != whefs_inode_name_get( fs, cand[c], &ns ) ) continue;
+            assert( (ns.string == (char const *)buf) && "Internal consistency error!");
+            if( ns.length && (0 == strcmp( ns.string, name )) )
+            {
+                WHEFS_DBG_CACHE("Filename matched cached inode #%"WHEFS_ID_TYPE_PFMT" for hash code 0x%"WHEFS_HASHVAL_TYPE_PFMT" for name [%s]",cand[c], nameHash,name);
+                i = cand[c];
+                cname = ns.string;
+                break;
+            }
+        }
+        if( !cname && (n < maxCandidates) && fs->cache.complete ) return whefs_rc.RangeError;
+    }
+    else if( fs->cache.complete && WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) ) return whefs_rc.RangeError;
+    if( ! cname && fs->nameidx.slots )
+    { /* Ask the on-disk name index. */
+        enum { maxCandidates = 8 };
+        whefs_id_type cand[maxCandidates];
+        uint32_t n = 0, c;
+        rc = whefs_fs_name_index_search( fs, name, cand, maxCandidates, &n );
+        for( c = 0; c < n; ++c )
+        {
+            if( whefs_rc.OK != whefs_inode_name_get( fs, cand[c], &ns ) ) continue;
+            if( ns.length && (0 == strcmp( ns.string, name )) )
+            {
+                i = cand[c];
+                cname = ns.string;
+                break;
+            }
+        }
+        if( !cname && (whefs_rc.OK == rc) ) return whefs_rc.RangeError;
+        rc = whefs_rc.OK;
     }
-#endif
-    cname = NULL; /* cached name entry */
-    i = whefs_hashid_list_index_of( fs->cache.hashes, nameHash );
-    if( whefs_rc.IDTypeEnd == i )
-    { /* no cached record. Start from the beginning. */
-        i = 2; /* 2 = first client-usable inode. */
+    if( ! cname && fs->cache.filter.loaded )
+    { /* Ask the name filter. */
+        ++fs->cache.filter.stats.checks;
+        if( ! whefs_name_filter_test( fs, name ) )
+        {
+            ++fs->cache.filter.stats.negatives;
+            return whefs_rc.RangeError;
+        }
+        filtered = true;
     }
-    else
-    { /* we know directly what inode record to jump to now... */
-        whefs_hashid * H;
-        expectExact = true;
-        WHEFS_DBG_CACHE("Filename matched cached INDEX (%"WHEFS_ID_TYPE_PFMT") for hash code 0x%"WHEFS_HASHVAL_TYPE_PFMT" for name [%s]",i, nameHash,name);
-        H = &fs->cache.hashes->list[i];
-        ++H->hits;
-        i = H->id;
+    if( ! cname )
+    {
+        memset(buf,0,bufSize);
+        ns.length = 0;
+        rc = whefs_rc.RangeError;
+    }
+    if( ! cname && ! WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) )
+    { /* There is nothing to cache, so compare the name records
+         without decoding (or reading) them one at a time. */
+        whefs_id_type hit = 0;
+        rc = whefs_fs_name_scan( fs, name, false, i, &hit );
+        if( whefs_rc.OK != rc ) return rc;
+        if( ! hit )
+        {
+            if( filtered ) ++fs->cache.filter.stats.false_positives;
+            return whefs_rc.RangeError;
+        }
+        i = hit;
+        rc = whefs_inode_name_get( fs, i, &ns );
+        if( whefs_rc.OK != rc ) return rc;
+        cname = ns.string;
     }
-
-    memset(buf,0,bufSize);
-    ns.string = (char *)buf;
-    ns.alloced = bufSize;
-    ns.length = 0;
-    rc = whefs_rc.RangeError;
-    for( ; i <= fs->options.inode_count; ++i )
+    for( ; !cname && (i <= fs->options.inode_count); ++i )
     { /* brute force... walk the inodes and compare them... */
 #if WHEFS_CONFIG_ENABLE_BITSET_CACHE /* we can't rely on this here. */
         if( fs->bits.i_loaded )
@@ -696,17 +881,22 @@ int whefs_inode_by_name( whefs_fs * fs, char const * name, whefs_inode * tgt )
             if( ! WHEFS_ICACHE_IS_USED(fs,i) )
             {
                 /*WHEFS_DBG("Skipping unused inode entry #%"WHEFS_ID_TYPE_PFMT, i ); */
-                if( expectExact )
-                {
-                    assert(0 && "If we have a cached entry for a specific bit then it must have been flagged as used.");
-                    rc = whefs_rc.ConsistencyError;
-                    break;
-                }
-                else continue;
+                continue;
             }
         }
         /*WHEFS_DBG("Cache says inode #%i is used.", i ); */
 #endif
+        mem = whefs_fs_name_peek( fs, i );
+        if( mem )
+        { /* compare in place in the in-memory names table */
+            if( ! *mem ) continue;
+            whefs_inode_hash_cache( fs, i, mem );
+            if( 0 != strcmp( mem, name ) ) continue;
+            rc = whefs_string_copy_cstring( &ns, mem );
+            if( whefs_rc.OK != rc ) break;
+            cname = ns.string;
+            break;
+        }
         rc = whefs_inode_name_get( fs, i, &ns );
         assert( (ns.string == (char const *)buf) && "Internal consistency error!");
         if( whefs_rc.OK != rc )
@@ -722,13 +912,16 @@ int whefs_inode_by_name( whefs_fs * fs, char const * name, whefs_inode * tgt )
             cname = ns.string;
             break;
         }
-        if( expectExact )
-        { /* can't happen */
-            assert( 0 && "If expectExact is true then cname must also be non-zero!");
-            return whefs_rc.ConsistencyError;
-        }
         memset(buf,0,ns.length);
     }
+    if( ! cname && (i > fs->options.inode_count) )
+    {
+        if( filtered ) ++fs->cache.filter.stats.false_positives;
+        if( WHEFS_FS_HASH_CACHE_IS_ENABLED(fs) )
+        { /* the scan visited (and so cached) every named inode. */
+            fs->cache.complete = true;
+        }
+    }
     if( whefs_rc.OK != rc )
     {
         return rc;
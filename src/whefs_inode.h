@@ -10,6 +10,9 @@
 */
 #include <wh/whefs/whefs.h>
 #include <wh/whefs/whefs_string.h>
+#if WHEFS_CONFIG_ENABLE_THREADS
+#include <pthread.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -78,13 +81,20 @@ typedef struct whefs_block_list
     whefs_id_type alloced;
     /** Number of items used. */
     whefs_id_type count;
+    /**
+       Number of items at the end of the list whose headers have not
+       been written to the EFS yet because a write() is about to write
+       them along with its data (see whefs_block_for_pos()). Always 0
+       outside of whio_dev_inode_write().
+    */
+    whefs_id_type unflushed;
 } whefs_block_list;
 
 /**
    Empty initialization object. Convenience macro for places where a
    whefs_block_list object must be statically initialized.
 */
-#define whefs_block_list_empty_m {0,0,0}
+#define whefs_block_list_empty_m {0,0,0,0}
 /**
    Empty initialization object.
 */
@@ -142,6 +152,12 @@ typedef struct whefs_inode
        Transient.
     */
     whefs_block_list blocks;
+    /**
+       Incremented by every write to or truncation of an opened
+       inode, so that i/o devices holding read-ahead data for it can
+       tell that their copy is stale. Transient.
+    */
+    uint32_t gen;
     /** Transient string used only by opened nodes. */
     /*whefs_string name; */
 } whefs_inode;
@@ -155,24 +171,38 @@ typedef struct whefs_inode
         0, /* mtime */ \
         0, /* open_count */ \
         0, /* writer */ \
-	whefs_block_list_empty_m /*blocks */ \
+	whefs_block_list_empty_m, /*blocks */ \
+        0 /* gen */ \
     }
 /** Empty inode initialization object. */
 extern const whefs_inode whefs_inode_empty;
 
 /** @struct whefs_inode_list
 
-   whefs_inode_list is a doubly-linked list of inode objects, used for
-   holding a list of "opened" inodes.
+   whefs_inode_list holds one "opened" inode. They are allocated in
+   slabs (see whefs_fs::opened_nodes), and unused ones are kept in a
+   singly-linked free-list.
 */
 typedef struct whefs_inode_list
 {
+    /** Must be the first member: see whefs_inode_lock(). */
     whefs_inode inode;
+    /** Next entry in the free-list. */
     struct whefs_inode_list * next;
-    struct whefs_inode_list * prev;
+#if WHEFS_CONFIG_ENABLE_THREADS
+    /**
+       Serializes i/o on the inode while it is opened. Initialized
+       along with its slab and kept when the entry is recycled.
+    */
+    pthread_mutex_t lock;
+#endif
 } whefs_inode_list;
 /** Empty inode_list initialization object. */
-#define whefs_inode_list_empty_m { whefs_inode_empty_m, 0, 0 }
+#if WHEFS_CONFIG_ENABLE_THREADS
+#  define whefs_inode_list_empty_m { whefs_inode_empty_m, 0, PTHREAD_MUTEX_INITIALIZER }
+#else
+#  define whefs_inode_list_empty_m { whefs_inode_empty_m, 0 }
+#endif
 /** Empty inode_list initialization object. */
 extern const whefs_inode_list whefs_inode_list_empty;
 
@@ -0,0 +1,328 @@
+/**
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+  License: Public Domain
+
+  This file contains the optional persistent name index: an on-disk
+  open-addressing hashtable mapping inode name hashes to inode IDs,
+  stored directly after the inode names table. It lets a freshly
+  opened EFS resolve a name with one small read of the index plus a
+  read of the candidate's name record, instead of scanning (or first
+  caching) every name.
+
+  On-disk layout (starting at fs->offsets[WHEFS_OFF_NAME_INDEX]):
+
+  - 1 tag byte ('N')
+  - encoded uint32: the number of slots (a power of 2)
+  - the slots, each an encoded inode ID followed by an encoded uint32
+    hash value. An ID of 0 marks an empty slot.
+
+  The hash values are whefs_hash_djb2() of the names and the home
+  slot of a hash is whefs_nameidx_home(), regardless of which hash
+  function fs->cache uses. Both are part of the file format.
+
+  Collisions are resolved by linear probing and removal shifts the
+  rest of the probe run back, so a lookup may stop at the first empty
+  slot. The index has at least twice as many slots as there are
+  inodes, so it is never more than half full.
+
+  whefs_fs_name_write() keeps the index up to date.
+*/
+
+#include "whefs_details.c"
+#include "whefs_encode.h"
+#include <string.h> /* memset() */
+
+static const unsigned char whefs_nameidx_tag_char = 'N';
+
+enum {
+/** Encoded size of one index slot. */
+whefs_nameidx_slot_size = whefs_sizeof_encoded_id_type + whio_sizeof_encoded_uint32,
+/** Encoded size of the index header. */
+whefs_nameidx_header_size = 1 + whio_sizeof_encoded_uint32,
+/** Number of slots read per i/o while probing. */
+whefs_nameidx_chunk_slots = 16
+};
+
+/** A decoded index slot. */
+typedef struct
+{
+    whefs_id_type id;
+    uint32_t hash;
+} whefs_nameidx_slot;
+
+uint32_t whefs_fs_name_index_slots( whefs_fs_options const * opt )
+{
+    uint32_t n = 16, want;
+    if( ! opt || ! opt->name_index ) return 0;
+    want = (uint32_t)opt->inode_count * 2;
+    if( want < opt->name_index ) want = opt->name_index;
+    while( n < want ) n *= 2;
+    return n;
+}
+
+whio_size_t whefs_fs_sizeof_name_index( whefs_fs_options const * opt )
+{
+    const uint32_t slots = whefs_fs_name_index_slots( opt );
+    return slots
+        ? (whio_size_t)(whefs_nameidx_header_size + (slots * whefs_nameidx_slot_size))
+        : 0;
+}
+
+/** Returns the home slot of the given hash in an index of the given (power of 2) size. */
+static uint32_t whefs_nameidx_home( uint32_t hash, uint32_t slots )
+{
+    uint32_t h = hash;
+    h ^= h >> 16;
+    h *= 0x45d9f3bU;
+    h ^= h >> 16;
+    return h & (slots - 1);
+}
+
+/** Returns the on-disk position of the given slot. */
+static whio_size_t whefs_nameidx_slot_pos( whefs_fs const * fs, uint32_t slot )
+{
+    return fs->offsets[WHEFS_OFF_NAME_INDEX] + whefs_nameidx_header_size
+        + (slot * whefs_nameidx_slot_size);
+}
+
+/**
+   Reads up to n slots starting at slot #first (without wrapping
+   around the end of the index) into dest. Returns the number of slots
+   read, or 0 on error (in which case fs->err is set).
+*/
+static uint32_t whefs_nameidx_read( whefs_fs * fs, uint32_t first, uint32_t n, whefs_nameidx_slot * dest )
+{
+    unsigned char buf[whefs_nameidx_chunk_slots * whefs_nameidx_slot_size];
+    unsigned char const * bp = buf;
+    const uint32_t slots = fs->nameidx.slots;
+    whio_size_t len;
+    uint32_t i;
+    if( n > whefs_nameidx_chunk_slots ) n = whefs_nameidx_chunk_slots;
+    if( n > (slots - first) ) n = slots - first;
+    len = n * whefs_nameidx_slot_size;
+    if( len != whefs_fs_readat( fs, whefs_nameidx_slot_pos( fs, first ), buf, len ) )
+    {
+        fs->err = whefs_rc.IOError;
+        return 0;
+    }
+    for( i = 0; i < n; ++i, bp += whefs_nameidx_slot_size )
+    {
+        if( (whefs_rc.OK != whefs_id_decode( bp, &dest[i].id ))
+            || (whefs_rc.OK != whio_decode_uint32( bp + whefs_sizeof_encoded_id_type, &dest[i].hash )) )
+        {
+            fs->err = whefs_rc.ConsistencyError;
+            return 0;
+        }
+    }
+    return n;
+}
+
+/** Writes the given slot. Returns whefs_rc.OK on success. */
+static int whefs_nameidx_write( whefs_fs * fs, uint32_t slot, whefs_nameidx_slot const * src )
+{
+    unsigned char buf[whefs_nameidx_slot_size];
+    whefs_id_encode( buf, src->id );
+    whio_encode_uint32( buf + whefs_sizeof_encoded_id_type, src->hash );
+    return (whefs_nameidx_slot_size == whefs_fs_writeat( fs, whefs_nameidx_slot_pos( fs, slot ), buf, whefs_nameidx_slot_size ))
+        ? whefs_rc.OK
+        : (fs->err = whefs_rc.IOError);
+}
+
+/**
+   Walks the probe run starting at the home slot of hash, calling
+   visit(fs,slot,&entry,state) for each used slot until visit()
+   returns non-0 or an empty slot is found. If emptySlot is not null
+   then it is set to the first empty slot (or to fs->nameidx.slots if
+   visit() stopped the walk first).
+
+   Returns whefs_rc.OK, or an i/o error code.
+*/
+static int whefs_nameidx_walk( whefs_fs * fs, uint32_t hash,
+                               int (*visit)( whefs_fs *, uint32_t, whefs_nameidx_slot const *, void * ),
+                               void * state, uint32_t * emptySlot )
+{
+    whefs_nameidx_slot chunk[whefs_nameidx_chunk_slots];
+    const uint32_t slots = fs->nameidx.slots;
+    uint32_t pos = whefs_nameidx_home( hash, slots );
+    uint32_t seen = 0, n, i;
+    if( emptySlot ) *emptySlot = slots;
+    while( seen < slots )
+    {
+        n = whefs_nameidx_read( fs, pos, whefs_nameidx_chunk_slots, chunk );
+        if( ! n ) return fs->err;
+        for( i = 0; (i < n) && (seen < slots); ++i, ++seen )
+        {
+            if( ! chunk[i].id )
+            {
+                if( emptySlot ) *emptySlot = pos + i;
+                return whefs_rc.OK;
+            }
+            if( visit && visit( fs, pos + i, &chunk[i], state ) ) return whefs_rc.OK;
+        }
+        pos = (pos + n) & (slots - 1);
+    }
+    return whefs_rc.OK;
+}
+
+int whefs_fs_name_index_write( whefs_fs * fs )
+{
+    unsigned char buf[whefs_nameidx_chunk_slots * whefs_nameidx_slot_size];
+    unsigned char hdr[whefs_nameidx_header_size];
+    const uint32_t slots = whefs_fs_name_index_slots( &fs->options );
+    whio_size_t pos;
+    uint32_t i;
+    fs->nameidx.slots = 0;
+    if( ! slots ) return whefs_rc.OK;
+    for( i = 0; i < whefs_nameidx_chunk_slots; ++i )
+    {
+        whefs_id_encode( buf + (i * whefs_nameidx_slot_size), 0 );
+        whio_encode_uint32( buf + (i * whefs_nameidx_slot_size) + whefs_sizeof_encoded_id_type, 0 );
+    }
+    hdr[0] = whefs_nameidx_tag_char;
+    whio_encode_uint32( hdr + 1, slots );
+    pos = fs->offsets[WHEFS_OFF_NAME_INDEX];
+    if( whefs_nameidx_header_size != whefs_fs_writeat( fs, pos, hdr, whefs_nameidx_header_size ) )
+    {
+        return fs->err = whefs_rc.IOError;
+    }
+    pos += whefs_nameidx_header_size;
+    for( i = 0; i < slots; i += whefs_nameidx_chunk_slots )
+    { /* slots is a power of 2 >= whefs_nameidx_chunk_slots */
+        if( sizeof(buf) != whefs_fs_writeat( fs, pos, buf, sizeof(buf) ) )
+        {
+            return fs->err = whefs_rc.IOError;
+        }
+        pos += sizeof(buf);
+    }
+    fs->nameidx.slots = slots;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_name_index_read( whefs_fs * fs )
+{
+    unsigned char hdr[whefs_nameidx_header_size];
+    const uint32_t slots = whefs_fs_name_index_slots( &fs->options );
+    uint32_t n = 0;
+    fs->nameidx.slots = 0;
+    if( ! slots ) return whefs_rc.OK;
+    if( whefs_nameidx_header_size != whefs_fs_readat( fs, fs->offsets[WHEFS_OFF_NAME_INDEX], hdr, whefs_nameidx_header_size ) )
+    {
+        return fs->err = whefs_rc.IOError;
+    }
+    if( (whefs_nameidx_tag_char != hdr[0])
+        || (whefs_rc.OK != whio_decode_uint32( hdr + 1, &n ))
+        || (n != slots) )
+    {
+        return fs->err = whefs_rc.ConsistencyError;
+    }
+    fs->nameidx.slots = slots;
+    return whefs_rc.OK;
+}
+
+/** whefs_nameidx_walk() callback which stops at the slot holding *(whefs_nameidx_slot*)state. */
+static int whefs_nameidx_visit_find( whefs_fs * fs, uint32_t slot, whefs_nameidx_slot const * e, void * state )
+{
+    whefs_nameidx_slot * want = (whefs_nameidx_slot *)state;
+    if( (e->id != want->id) || (e->hash != want->hash) ) return 0;
+    want->id = 0; /* tells the caller that it was found... */
+    want->hash = slot; /* ... and where. */
+    return 1;
+}
+
+int whefs_fs_name_index_insert( whefs_fs * fs, char const * name, whefs_id_type id )
+{
+    whefs_nameidx_slot e;
+    whefs_nameidx_slot probe;
+    uint32_t empty;
+    int rc;
+    if( ! fs->nameidx.slots || !name || !*name ) return whefs_rc.OK;
+    e.id = id;
+    e.hash = (uint32_t)whefs_hash_djb2( name );
+    probe = e;
+    rc = whefs_nameidx_walk( fs, e.hash, whefs_nameidx_visit_find, &probe, &empty );
+    if( whefs_rc.OK != rc ) return rc;
+    if( ! probe.id ) return whefs_rc.OK; /* already there */
+    if( empty == fs->nameidx.slots ) return fs->err = whefs_rc.ConsistencyError /* can't happen: the index is at most half full */;
+    return whefs_nameidx_write( fs, empty, &e );
+}
+
+int whefs_fs_name_index_remove( whefs_fs * fs, char const * name, whefs_id_type id )
+{
+    whefs_nameidx_slot chunk[whefs_nameidx_chunk_slots];
+    whefs_nameidx_slot probe;
+    const uint32_t slots = fs->nameidx.slots;
+    uint32_t hole, j, n, i, home;
+    int rc;
+    if( ! slots || !name || !*name ) return whefs_rc.OK;
+    probe.id = id;
+    probe.hash = (uint32_t)whefs_hash_djb2( name );
+    rc = whefs_nameidx_walk( fs, probe.hash, whefs_nameidx_visit_find, &probe, 0 );
+    if( whefs_rc.OK != rc ) return rc;
+    if( probe.id ) return whefs_rc.OK; /* not in the index */
+    hole = (uint32_t)probe.hash;
+    /* Shift the rest of the probe run back so that it stays unbroken. */
+    j = (hole + 1) & (slots - 1);
+    while( 1 )
+    {
+        n = whefs_nameidx_read( fs, j, whefs_nameidx_chunk_slots, chunk );
+        if( ! n ) return fs->err;
+        for( i = 0; i < n; ++i, j = (j + 1) & (slots - 1) )
+        {
+            if( ! chunk[i].id ) goto end;
+            home = whefs_nameidx_home( chunk[i].hash, slots );
+            if( WHEFS_PROBE_CAN_FILL(hole,j,home) )
+            {
+                rc = whefs_nameidx_write( fs, hole, &chunk[i] );
+                if( whefs_rc.OK != rc ) return rc;
+                hole = j;
+            }
+        }
+    }
+    end:
+    chunk[0].id = 0;
+    chunk[0].hash = 0;
+    return whefs_nameidx_write( fs, hole, &chunk[0] );
+}
+
+/** State for whefs_nameidx_visit_collect(). */
+typedef struct
+{
+    uint32_t hash;
+    whefs_id_type * ids;
+    uint32_t max;
+    uint32_t count;
+    bool overflow;
+} whefs_nameidx_collect;
+
+/** whefs_nameidx_walk() callback which collects the IDs with a given hash. */
+static int whefs_nameidx_visit_collect( whefs_fs * fs, uint32_t slot, whefs_nameidx_slot const * e, void * state )
+{
+    whefs_nameidx_collect * c = (whefs_nameidx_collect *)state;
+    if( e->hash != c->hash ) return 0;
+    if( c->count == c->max )
+    {
+        c->overflow = true;
+        return 1;
+    }
+    c->ids[c->count++] = e->id;
+    return 0;
+}
+
+int whefs_fs_name_index_search( whefs_fs * fs, char const * name, whefs_id_type * ids, uint32_t max, uint32_t * count )
+{
+    whefs_nameidx_collect c;
+    int rc;
+    if( ! fs || !name || !ids || !count ) return whefs_rc.ArgError;
+    *count = 0;
+    if( ! fs->nameidx.slots ) return whefs_rc.RangeError;
+    c.hash = (uint32_t)whefs_hash_djb2( name );
+    c.ids = ids;
+    c.max = max;
+    c.count = 0;
+    c.overflow = false;
+    rc = whefs_nameidx_walk( fs, c.hash, whefs_nameidx_visit_collect, &c, 0 );
+    *count = c.count;
+    if( whefs_rc.OK != rc ) return rc;
+    return c.overflow ? whefs_rc.RangeError : whefs_rc.OK;
+}
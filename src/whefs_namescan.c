@@ -0,0 +1,117 @@
+/*
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+  License: Public Domain
+
+  Implementation of whefs_name_scan(). See whefs_namescan.h.
+
+  Each record's first W bytes (W being the vector or word width) are
+  compared with the key in one go, and only records which pass that
+  test are compared further with memcmp(). Names which differ at all
+  nearly always differ in their first W bytes, so in practice this
+  costs one load and one compare per record, independent of the name
+  lengths, without the per-call overhead of strcmp(). The loop is
+  unrolled four records deep so that the loads of neighbouring
+  records overlap.
+*/
+#include <string.h>
+#include "whefs_namescan.h"
+
+#if WHEFS_CONFIG_ENABLE_SIMD && defined(__AVX2__)
+#  include <immintrin.h>
+#  define WHEFS_NAME_SCAN_WIDTH 32
+#elif WHEFS_CONFIG_ENABLE_SIMD && (defined(__SSE2__) || defined(_M_X64))
+#  include <emmintrin.h>
+#  define WHEFS_NAME_SCAN_WIDTH 16
+#else
+#  define WHEFS_NAME_SCAN_WIDTH 8
+#endif
+
+char const * whefs_name_scan_impl()
+{
+#if WHEFS_NAME_SCAN_WIDTH == 32
+    return "avx2";
+#elif WHEFS_NAME_SCAN_WIDTH == 16
+    return "sse2";
+#else
+    return "word";
+#endif
+}
+
+#if WHEFS_NAME_SCAN_WIDTH == 32
+/** Returns a bitmask with bit N set if byte N of P equals byte N of KV. */
+#  define WHEFS_NAME_SCAN_MASK(P) ((uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( _mm256_loadu_si256( (__m256i const *)(P) ), kv ) ))
+#elif WHEFS_NAME_SCAN_WIDTH == 16
+#  define WHEFS_NAME_SCAN_MASK(P) ((uint32_t)_mm_movemask_epi8( _mm_cmpeq_epi8( _mm_loadu_si128( (__m128i const *)(P) ), kv ) ))
+#endif
+
+size_t whefs_name_scan( unsigned char const * base, size_t stride, size_t count,
+                        char const * key, size_t n )
+{
+    enum { W = WHEFS_NAME_SCAN_WIDTH };
+    unsigned char kbuf[W];
+    size_t const k = (n < W) ? n : W; /* bytes tested in one go */
+    size_t const rest = n - k; /* bytes left for memcmp() */
+    size_t i = 0;
+    unsigned char const * p;
+    if( ! n ) return 0;
+    memset( kbuf, 0, W );
+    memcpy( kbuf, key, k );
+/** True if record #I, whose first k bytes match, also matches in the rest. */
+#define WHEFS_NAME_SCAN_REST(I) ((0 == rest) || (0 == memcmp( base + ((I) * stride) + k, key + k, rest )))
+    {
+#if WHEFS_NAME_SCAN_WIDTH > 8
+#  if WHEFS_NAME_SCAN_WIDTH == 32
+        __m256i const kv = _mm256_loadu_si256( (__m256i const *)kbuf );
+#  else
+        __m128i const kv = _mm_loadu_si128( (__m128i const *)kbuf );
+#  endif
+        uint32_t const want = (k >= 32) ? 0xFFFFFFFFU : ((((uint32_t)1) << k) - 1);
+        uint32_t m0, m1, m2, m3;
+        for( ; (i + 4) <= count; i += 4 )
+        {
+            p = base + (i * stride);
+            m0 = WHEFS_NAME_SCAN_MASK( p ) & want;
+            m1 = WHEFS_NAME_SCAN_MASK( p + stride ) & want;
+            m2 = WHEFS_NAME_SCAN_MASK( p + (2 * stride) ) & want;
+            m3 = WHEFS_NAME_SCAN_MASK( p + (3 * stride) ) & want;
+            if( (m0 == want) && WHEFS_NAME_SCAN_REST(i) ) return i;
+            if( (m1 == want) && WHEFS_NAME_SCAN_REST(i+1) ) return i + 1;
+            if( (m2 == want) && WHEFS_NAME_SCAN_REST(i+2) ) return i + 2;
+            if( (m3 == want) && WHEFS_NAME_SCAN_REST(i+3) ) return i + 3;
+        }
+        for( ; i < count; ++i )
+        {
+            p = base + (i * stride);
+            if( ((WHEFS_NAME_SCAN_MASK( p ) & want) == want) && WHEFS_NAME_SCAN_REST(i) ) return i;
+        }
+#else
+        unsigned char mbuf[W];
+        uint64_t kw, mw, w0, w1, w2, w3;
+        memset( mbuf, 0, W );
+        memset( mbuf, 0xFF, k );
+        memcpy( &kw, kbuf, W );
+        memcpy( &mw, mbuf, W );
+        for( ; (i + 4) <= count; i += 4 )
+        {
+            p = base + (i * stride);
+            memcpy( &w0, p, W );
+            memcpy( &w1, p + stride, W );
+            memcpy( &w2, p + (2 * stride), W );
+            memcpy( &w3, p + (3 * stride), W );
+            if( !((w0 ^ kw) & mw) && WHEFS_NAME_SCAN_REST(i) ) return i;
+            if( !((w1 ^ kw) & mw) && WHEFS_NAME_SCAN_REST(i+1) ) return i + 1;
+            if( !((w2 ^ kw) & mw) && WHEFS_NAME_SCAN_REST(i+2) ) return i + 2;
+            if( !((w3 ^ kw) & mw) && WHEFS_NAME_SCAN_REST(i+3) ) return i + 3;
+        }
+        for( ; i < count; ++i )
+        {
+            memcpy( &w0, base + (i * stride), W );
+            if( !((w0 ^ kw) & mw) && WHEFS_NAME_SCAN_REST(i) ) return i;
+        }
+#endif
+    }
+#undef WHEFS_NAME_SCAN_REST
+    return count;
+}
+#undef WHEFS_NAME_SCAN_MASK
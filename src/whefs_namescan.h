@@ -0,0 +1,59 @@
+#ifndef WANDERINGHORSE_NET_WHEFS_NAMESCAN_H_INCLUDED
+#define WANDERINGHORSE_NET_WHEFS_NAMESCAN_H_INCLUDED 1
+/*
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+  License: Public Domain
+
+
+  A matcher for tables of fixed-width name records, as found in the
+  inode names table (on storage and in memory). It compares the
+  leading bytes of each record with a key using SSE2 or AVX2 when the
+  compiler targets them (see WHEFS_CONFIG_ENABLE_SIMD), else one
+  machine word at a time.
+*/
+
+#include <wh/whefs/whefs_config.h> /* stdint types */
+#include <stddef.h> /* size_t */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+   The number of bytes past the start of the last record which
+   whefs_name_scan() may read, beyond the end of that record. Buffers
+   passed to it must be at least this many bytes longer than
+   (count * stride) (the extra bytes need not hold anything in
+   particular).
+*/
+enum { whefs_name_scan_pad = 32 };
+
+/**
+   Searches the count records of stride bytes each, starting at base,
+   for the first record whose first n bytes equal the first n bytes
+   of key. Returns the index of that record, or count if none
+   matches.
+
+   To find an exact match in a table of NUL-terminated names, pass
+   strlen(key)+1 as n. To find a prefix match pass strlen(key).
+
+   base must be readable for at least (count * stride) +
+   whefs_name_scan_pad bytes, and n must not be larger than stride.
+   If n is 0 then 0 is returned.
+*/
+size_t whefs_name_scan( unsigned char const * base, size_t stride, size_t count,
+                        char const * key, size_t n );
+
+/**
+   Returns the name of the implementation used by whefs_name_scan():
+   "avx2", "sse2" or "word". Intended for benchmarks and debugging
+   output.
+*/
+char const * whefs_name_scan_impl();
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* WANDERINGHORSE_NET_WHEFS_NAMESCAN_H_INCLUDED */
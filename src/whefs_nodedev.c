@@ -15,6 +15,7 @@
 #include <assert.h>
 #include <string.h> /* memset() */
 #include "whefs_details.c"
+#include <wh/whio/whio_devs.h> /* whio_dev_uring_xxx() */
 
 /**
    Ensures that ino->block.list is at least count items long,
@@ -59,7 +60,8 @@ static int whefs_inode_block_list_reserve( whefs_fs * fs,
 /**
    Appends a copy of bl to ino's block list, expanding the list as
    necessary. If ino has blocks already, the last block has bl added
-   as its next block and that block is flushed to disk.
+   as its next block and that block is flushed to disk (unless its
+   header is still pending: see whefs_block_list::unflushed).
 
    ino is assumed to be an opened inode. If it is not, results
    are undefined.
@@ -83,7 +85,7 @@ static int whefs_inode_block_list_append( whefs_fs * fs,
 	if( ! prev->next_block )
 	{
 	    prev->next_block = bl->id;
-	    whefs_block_flush( fs, prev );
+	    if( ! ino->blocks.unflushed ) whefs_block_flush( fs, prev );
 	}
 	else if( prev->next_block != bl->id )
 	{
@@ -116,6 +118,24 @@ static int whefs_inode_block_list_append( whefs_fs * fs,
     return whefs_rc.OK;
 }
 
+/**
+   Writes the pending headers (see whefs_block_list::unflushed) of the
+   blocks of ino's block list whose index is lower than end. Returns
+   whefs_rc.OK on success.
+*/
+static int whefs_inode_block_list_flush_pending( whefs_fs * fs, whefs_inode * ino, whefs_id_type end )
+{
+    int rc = whefs_rc.OK;
+    whefs_id_type i = ino->blocks.count - ino->blocks.unflushed;
+    for( ; ino->blocks.unflushed && (i < end); ++i )
+    {
+        rc = whefs_block_flush( fs, &ino->blocks.list[i] );
+        if( whefs_rc.OK != rc ) break;
+        --ino->blocks.unflushed;
+    }
+    return rc;
+}
+
 /**
    Assumes ino is an opened inode and loads a block list cache for it.
    If !ino->first_block then this function does nothing but returns
@@ -184,6 +204,12 @@ static int whefs_inode_block_list_load( whefs_fs * fs,
    false and pos is not within the inode's current data size then the
    function fails.
 
+   If deferHeaders is true, the headers of the new blocks are not
+   written: they are counted in ino->blocks.unflushed instead, and
+   the caller must write them (whio_dev_inode_write() does so as part
+   of its data writes). The blocks are marked as used in the
+   free-space map either way.
+
    On success, tgt is populated with the block associated with the
    given position and inode, and ino *may* be updated (if it had no
    blocks associated with it beforehand). To figure out the proper
@@ -230,7 +256,7 @@ static int whefs_inode_block_list_load( whefs_fs * fs,
    it does).
 
 */
-static int whefs_block_for_pos( whefs_fs * fs, whefs_inode * ino, whio_size_t pos, whefs_block * tgt, bool expand )
+static int whefs_block_for_pos( whefs_fs * fs, whefs_inode * ino, whio_size_t pos, whefs_block * tgt, bool expand, bool deferHeaders )
 {
     whefs_id_type bc;
     whio_size_t bs;
@@ -284,18 +310,38 @@ static int whefs_block_for_pos( whefs_fs * fs, whefs_inode * ino, whio_size_t po
 			    bc, pos );
 	    return whefs_rc.RangeError;
 	}
-	/*bl = ino->blocks.list[ino->blocks.count-1]; */
+	/*
+	  Allocate the missing blocks as extents of adjacent blocks,
+	  preferably continuing directly after the current tail
+	  block. Unless deferHeaders is set, whefs_block_next_free_run()
+	  chains each run on disk, so appending its blocks only has to
+	  re-flush the old tail.
+	*/
 	i = ino->blocks.count;
 	blP = NULL;
-	for( ; i < bc; ++i )
+	while( i < bc )
 	{
-	    rc = whefs_block_next_free( fs, &bl, true );
-	    if( whefs_rc.OK == rc ) rc = whefs_inode_block_list_append( fs, ino, &bl );
+	    whefs_id_type first = 0;
+	    whefs_id_type got = 0;
+	    whefs_id_type k;
+	    const whefs_id_type near = i ? (ino->blocks.list[i-1].id + 1) : 0;
+	    rc = whefs_block_next_free_run( fs, near, bc - i, &first, &got, !deferHeaders );
 	    if( whefs_rc.OK != rc ) return rc;
+	    for( k = 0; k < got; ++k, ++i )
+	    {
+		bl = whefs_block_empty;
+		bl.id = first + k;
+		bl.flags = WHEFS_FLAG_Used;
+		bl.next_block = ((k+1) < got) ? (bl.id + 1) : 0;
+		rc = whefs_inode_block_list_append( fs, ino, &bl );
+		if( whefs_rc.OK != rc ) return rc;
+		/* keep the pending headers a suffix of the list */
+		if( deferHeaders || ino->blocks.unflushed ) ++ino->blocks.unflushed;
+	    }
 	    /**
 	       We "might" want to truncate the inode back to its
-	       previous length, but why add room for yet another error
-	       on top of the one we just encountered?
+	       previous length on error, but why add room for yet
+	       another error on top of the one we just encountered?
 	    */
 	}
 	blP = &bl;
@@ -328,6 +374,55 @@ typedef struct whio_dev_inode_meta
     bool rw;
     /** inode associated with device. */
     whefs_inode * inode;
+    /**
+       Scratch buffer for the block headers of coalesced multi-block
+       reads and writes. Owned by this object.
+    */
+    unsigned char * iobuf;
+    /** Allocated size of iobuf. */
+    whio_size_t iobufLen;
+    /**
+       Segment list for coalesced multi-block reads and writes.
+       Owned by this object.
+    */
+    whio_iovec * iov;
+    /** Allocated number of entries in iov. */
+    whio_size_t iovLen;
+    /**
+       Read-ahead state. See whio_dev_inode_ra_fill().
+    */
+    struct
+    {
+        /** Window buffer. Owned by this object. */
+        unsigned char * buf;
+        /** Allocated size of buf. */
+        whio_size_t alloced;
+        /** File position of buf[0]. */
+        whio_size_t start;
+        /**
+           Number of bytes in the window. While asynchronous requests
+           are pending this is the number of bytes requested.
+        */
+        whio_size_t len;
+        /** Number of bytes the window's requests have delivered. */
+        whio_size_t got;
+        /**
+           File position at which the previous read() ended. A read
+           starting there is taken to be sequential.
+        */
+        whio_size_t next;
+        /** inode->gen at the time the window was filled. */
+        uint32_t gen;
+        /** Number of asynchronous requests for the window still in flight. */
+        uint32_t pending;
+        /** Set if an asynchronous request for the window failed. */
+        bool failed;
+    } ra;
+    /**
+       This device's entry in fs->closers. See
+       whefs_fs_closer_dev_add().
+    */
+    whefs_fs_closer_list closer;
 } whio_dev_inode_meta;
 
 /** Initializer object. */
@@ -336,7 +431,23 @@ typedef struct whio_dev_inode_meta
 0, /* bs */ \
 0, /* posabs */ \
 false, /* read/write */ \
-0 /* inode */  \
+0, /* inode */  \
+0, /* iobuf */ \
+0, /* iobufLen */ \
+0, /* iov */ \
+0, /* iovLen */ \
+{ /* ra */ \
+0, /* buf */ \
+0, /* alloced */ \
+0, /* start */ \
+0, /* len */ \
+0, /* got */ \
+0, /* next */ \
+0, /* gen */ \
+0, /* pending */ \
+false /* failed */ \
+}, \
+whefs_fs_closer_list_empty_m /* closer */ \
 }
 
 static const whio_dev_inode_meta whio_dev_inode_meta_empty = WHIO_DEV_INODE_META_INIT;
@@ -408,6 +519,200 @@ static void whio_dev_inode_meta_free( whio_dev_inode_meta * obj )
 #define WHIO_DEV_DECL(RV) whio_dev_inode_meta * meta = (dev ? (whio_dev_inode_meta*)dev->impl.data : 0); \
     if( !meta || ((void const *)&whio_dev_inode_meta_empty != dev->impl.typeID) ) return RV
 
+#if WHEFS_CONFIG_COALESCE_MAX_BYTES
+/**
+   A helper for the coalesced read/write routines. Returns how many
+   physically adjacent blocks, starting at index bi of
+   meta->inode->blocks.list, an i/o of n bytes starting at meta->posabs
+   touches, stopping at the first non-adjacent block and at
+   WHEFS_CONFIG_COALESCE_MAX_BYTES. If the return value is at least 2,
+   *want is set to the number of bytes of the i/o which fall in those
+   blocks and *span to the number of on-disk bytes (data plus the
+   interleaved block headers) they cover.
+*/
+static whefs_id_type whio_dev_inode_run_length( whio_dev_inode_meta const * meta, whefs_id_type bi,
+                                                whio_size_t n, whio_size_t * want, whio_size_t * span )
+{
+    whefs_block const * list = meta->inode->blocks.list;
+    const whio_size_t bs = meta->bs;
+    const whio_size_t dsz = meta->fs->sizes[WHEFS_SZ_BLOCK]; /* on-disk distance between adjacent blocks */
+    const whio_size_t pos = meta->posabs % bs;
+    whio_size_t last;
+    whefs_id_type k = 1;
+    if( ((pos + n) <= bs) || (bi >= meta->inode->blocks.count) ) return 0;
+    while( ((bi + k) < meta->inode->blocks.count)
+           && ((k * bs) < (pos + n))
+           && (list[bi+k].id == (list[bi+k-1].id + 1))
+           && (((k * dsz) + bs) <= WHEFS_CONFIG_COALESCE_MAX_BYTES) )
+    {
+        ++k;
+    }
+    if( k < 2 ) return k;
+    *want = (k * bs) - pos;
+    if( *want > n ) *want = n;
+    last = pos + *want - 1; /* offset of the last byte, counting only data bytes */
+    *span = ((last / bs) * dsz) + (last % bs) + 1 - pos;
+    return k;
+}
+
+/**
+   Ensures that meta->iobuf is at least n bytes long and meta->iov
+   has room for at least segs entries. Returns false on allocation
+   error.
+*/
+static bool whio_dev_inode_iobuf_reserve( whio_dev_inode_meta * meta, whio_size_t n, whio_size_t segs )
+{
+    if( meta->iobufLen < n )
+    {
+        unsigned char * x = (unsigned char *) realloc( meta->iobuf, n );
+        if( ! x ) return false;
+        meta->iobuf = x;
+        meta->iobufLen = n;
+    }
+    if( meta->iovLen < segs )
+    {
+        whio_iovec * x = (whio_iovec *) realloc( meta->iov, segs * sizeof(whio_iovec) );
+        if( ! x ) return false;
+        meta->iov = x;
+        meta->iovLen = segs;
+    }
+    return true;
+}
+
+/**
+   Fills in meta->iov for a coalesced i/o of want bytes, starting
+   at offset off of a block and spanning k adjacent blocks: one
+   segment per block's share of buf, with a segment for the header of
+   the next block between each of them. If lead is true, the list
+   starts with a segment for the first block's own header. The header
+   segments point into meta->iobuf, in order. The buffers must already
+   be reserved via whio_dev_inode_iobuf_reserve(). Returns the number
+   of segments.
+*/
+static whio_size_t whio_dev_inode_iov_fill( whio_dev_inode_meta * meta, whio_size_t off,
+                                            void * buf, whio_size_t want, bool lead )
+{
+    const whio_size_t bs = meta->bs;
+    const whio_size_t hsz = meta->fs->sizes[WHEFS_SZ_BLOCK] - bs;
+    whio_size_t done = 0, len = bs - off, n = 0, h = 0;
+    if( lead )
+    {
+        meta->iov[n].base = meta->iobuf;
+        meta->iov[n++].len = hsz;
+        ++h;
+    }
+    while( done < want )
+    {
+        if( len > (want - done) ) len = want - done;
+        meta->iov[n].base = WHIO_VOID_PTR_ADD(buf,done);
+        meta->iov[n++].len = len;
+        done += len;
+        if( done < want )
+        {
+            meta->iov[n].base = meta->iobuf + (h * hsz);
+            meta->iov[n++].len = hsz;
+            ++h;
+        }
+        len = bs;
+    }
+    return n;
+}
+#endif /* WHEFS_CONFIG_COALESCE_MAX_BYTES */
+
+/**
+   A helper for whio_dev_inode_read_impl(). Tries to serve a read
+   which starts at meta->posabs and spans more than one block with a
+   single vectored read of the EFS, covering as many physically
+   adjacent blocks (per meta->inode->blocks.list) as
+   WHEFS_CONFIG_COALESCE_MAX_BYTES allows. bi is the list index of the
+   block holding meta->posabs and n must already be clipped to the
+   inode's EOF.
+
+   Each block's data is scattered directly into dest and the block
+   headers between them into meta->iobuf. Returns the number of bytes
+   read into dest, which is 0 if the read does not span adjacent
+   blocks or if anything fails, in which case the caller should read
+   one block at a time. Does not modify meta->posabs.
+*/
+static whio_size_t whio_dev_inode_read_run( whio_dev_inode_meta * meta, whefs_id_type bi,
+                                            void * dest, whio_size_t n )
+{
+#if WHEFS_CONFIG_COALESCE_MAX_BYTES
+    const whio_size_t hsz = meta->fs->sizes[WHEFS_SZ_BLOCK] - meta->bs;
+    const whio_size_t rdpos = meta->posabs % meta->bs;
+    whio_size_t want = 0, span = 0, segs;
+    whefs_id_type k;
+    k = whio_dev_inode_run_length( meta, bi, n, &want, &span );
+    if( k < 2 ) return 0;
+    if( ! whio_dev_inode_iobuf_reserve( meta, (k - 1) * hsz, (2 * k) - 1 ) ) return 0;
+    segs = whio_dev_inode_iov_fill( meta, rdpos, dest, want, false );
+    if( span != whefs_fs_readvat( meta->fs, whefs_block_data_pos( meta->fs, &meta->inode->blocks.list[bi] ) + rdpos,
+                                  meta->iov, segs ) )
+    {
+        return 0;
+    }
+    return want;
+#else
+    return 0;
+#endif /* WHEFS_CONFIG_COALESCE_MAX_BYTES */
+}
+
+/**
+   The write counterpart of whio_dev_inode_read_run(). The blocks
+   must already be allocated (in meta->inode->blocks.list). The
+   headers of the blocks after the first are encoded into meta->iobuf
+   and written, interleaved with the data for each block, with a
+   single vectored write to the EFS. If the first block's header is
+   still pending (see whefs_block_list::unflushed) and the write
+   starts at the beginning of its data, that header leads the same
+   write; otherwise it (and any pending headers before it) is flushed
+   first. The headers the write covers are no longer pending
+   afterwards.
+
+   Returns the number of bytes of src which were written, or 0 if
+   the write does not span adjacent blocks or if anything fails, in
+   which case the caller should write one block at a time. Does not
+   modify meta->posabs.
+*/
+static whio_size_t whio_dev_inode_write_run( whio_dev_inode_meta * meta, whefs_id_type bi,
+                                             void const * src, whio_size_t n )
+{
+#if WHEFS_CONFIG_COALESCE_MAX_BYTES
+    whefs_block_list * bl = &meta->inode->blocks;
+    const whio_size_t hsz = meta->fs->sizes[WHEFS_SZ_BLOCK] - meta->bs;
+    const whio_size_t wpos = meta->posabs % meta->bs;
+    whio_size_t want = 0, span = 0, segs;
+    whefs_id_type k, m, lead;
+    k = whio_dev_inode_run_length( meta, bi, n, &want, &span );
+    if( k < 2 ) return 0;
+    lead = (bl->unflushed && ((bl->count - bl->unflushed) <= bi) && !wpos) ? 1 : 0;
+    if( whefs_rc.OK != whefs_inode_block_list_flush_pending( meta->fs, meta->inode, lead ? bi : (bi + 1) ) ) return 0;
+    if( ! whio_dev_inode_iobuf_reserve( meta, (k - 1 + lead) * hsz, (2 * k) - 1 + lead ) ) return 0;
+    /* The iovec type is shared with readv(), so it takes a non-const pointer. */
+    segs = whio_dev_inode_iov_fill( meta, wpos, (void *)src, want, lead ? true : false );
+    if( hsz > whefs_sizeof_encoded_block )
+    { /* zero the padding of aligned (whefs_fs_options::data_alignment) headers */
+        memset( meta->iobuf, 0, (k - 1 + lead) * hsz );
+    }
+    for( m = 1 - lead; (2 * m) <= (segs - lead); ++m )
+    {
+        whefs_block_encode( &bl->list[bi+m], meta->iobuf + ((m - 1 + lead) * hsz) );
+    }
+    if( (span + (lead * hsz)) != whefs_fs_writevat( meta->fs, whefs_block_data_pos( meta->fs, &bl->list[bi] ) + wpos - (lead * hsz),
+                                                    meta->iov, segs ) )
+    {
+        return 0;
+    }
+    if( bl->unflushed && ((bl->count - bl->unflushed) < (bi + k)) )
+    { /* the headers of blocks bi+1 .. bi+k-1 (and bi, if lead) went out with the data */
+        bl->unflushed = bl->count - (bi + k);
+    }
+    return want;
+#else
+    return 0;
+#endif /* WHEFS_CONFIG_COALESCE_MAX_BYTES */
+}
+
 /**
    Internal implementation of whio_dev_inode_read(). All arguments
    are as for whio_dev::read() except keepGoing:
@@ -436,7 +741,7 @@ static whio_size_t whio_dev_inode_read_impl( whio_dev * dev,
     if( ! n ) return 0U;
     else if( meta->posabs >= meta->inode->data_size ) return 0;
     /*whio_size_t eofpos = meta->inode->data_size; */
-    rc = whefs_block_for_pos( meta->fs, meta->inode, meta->posabs, &block, false );
+    rc = whefs_block_for_pos( meta->fs, meta->inode, meta->posabs, &block, false, false );
     if( whefs_rc.OK != rc )
     {
 #if 0
@@ -470,20 +775,28 @@ static whio_size_t whio_dev_inode_read_impl( whio_dev * dev,
 
     if( meta->posabs >= meta->inode->data_size ) return 0;
     else {
+        const whio_size_t avail = meta->inode->data_size - meta->posabs;
+        whio_size_t sz = whio_dev_inode_read_run( meta, (whefs_id_type)(meta->posabs / meta->bs),
+                                                  dest, (n > avail) ? avail : n );
+        if( sz )
+        {
+            meta->posabs += sz;
+            *keepGoing = (sz < n) && (meta->posabs < meta->inode->data_size);
+            return sz;
+        }
+    }
+    {
         const whio_size_t rdpos = (meta->posabs % meta->bs);
         const whio_size_t left = meta->bs - rdpos;
         const whio_size_t bdpos = whefs_block_data_pos( meta->fs, &block );
         whio_size_t rdlen = ( n > left ) ? left : n;
-        whio_dev * fd;
         whio_size_t sz, szCheck;
         if( (rdlen + meta->posabs) >= meta->inode->data_size )
         {
             rdlen = meta->inode->data_size - meta->posabs;
         }
         /*WHEFS_DBG("rdpos=%u left=%u bdpos=%u rdlen=%u", rdpos, left, bdpos, rdlen ); */
-        fd = meta->fs->dev;
-        fd->api->seek( fd, bdpos + rdpos, SEEK_SET );
-        sz = fd->api->read( fd, dest, rdlen );
+        sz = whefs_fs_readat( meta->fs, bdpos + rdpos, dest, rdlen );
         if( ! sz ) return 0;
         szCheck = meta->posabs + sz;
         if( szCheck > meta->posabs )
@@ -518,16 +831,207 @@ static whio_size_t whio_dev_inode_read_impl( whio_dev * dev,
     }
 }
 
+/**
+   Hands the completions of asynchronous read-ahead requests on
+   fs->dev (which must be a whio_dev_for_filename_uring() device) to
+   the inode devices which queued them. Every request queued on
+   fs->dev must carry its whio_dev_inode_meta as its tag. If wait is
+   true, blocks until at least one completion is available. Returns
+   the number of completions processed.
+*/
+static whio_size_t whio_dev_inode_ra_reap( whefs_fs * fs, bool wait )
+{
+    enum { MaxBatch = 16 };
+    whio_dev_uring_completion done[MaxBatch];
+    whio_size_t i, n;
+    n = wait
+        ? whio_dev_uring_wait( fs->dev, done, MaxBatch, 1 )
+        : whio_dev_uring_poll( fs->dev, done, MaxBatch );
+    for( i = 0; i < n; ++i )
+    {
+        whio_dev_inode_meta * m = (whio_dev_inode_meta *)done[i].tag;
+        if( m->ra.pending ) --m->ra.pending;
+        if( done[i].err ) m->ra.failed = true;
+        else m->ra.got += done[i].bytes;
+    }
+    return n;
+}
+
+/**
+   Waits for meta's asynchronous read-ahead requests, if any, to
+   complete. If any of them failed or came up short, the window is
+   dropped.
+*/
+static void whio_dev_inode_ra_settle( whio_dev_inode_meta * meta )
+{
+    /* Other inodes' readers reap our completions (and update our
+       ra.pending/got/failed) while holding the io lock. */
+    WHEFS_FS_IO_LOCK(meta->fs);
+    while( meta->ra.pending )
+    {
+        if( ! whio_dev_inode_ra_reap( meta->fs, true ) )
+        { /* nothing is in flight any more */
+            meta->ra.pending = 0;
+            meta->ra.failed = true;
+        }
+    }
+    WHEFS_FS_IO_UNLOCK(meta->fs);
+    if( meta->ra.failed || (meta->ra.got != meta->ra.len) )
+    {
+        meta->ra.len = 0;
+        meta->ra.got = 0;
+        meta->ra.failed = false;
+    }
+}
+
+/**
+   Refills meta's read-ahead window so that it starts at file
+   position pos and holds up to meta->fs->readahead.blocks blocks'
+   worth of data, clipped to the inode's EOF.
+
+   If async is true and the EFS device supports asynchronous i/o, one
+   read per block is queued and submitted, and the data is only
+   usable after whio_dev_inode_ra_settle(). Otherwise the window is
+   read synchronously, using coalesced reads where the blocks are
+   adjacent.
+
+   Returns whefs_rc.OK on success. On error the window is left
+   empty.
+*/
+static int whio_dev_inode_ra_fill( whio_dev_inode_meta * meta, whio_size_t pos, bool async )
+{
+    whefs_fs * fs = meta->fs;
+    whio_size_t want = meta->bs * fs->readahead.blocks;
+    whefs_block bl = whefs_block_empty;
+    int rc;
+    whio_dev_inode_ra_settle( meta );
+    meta->ra.len = meta->ra.got = 0;
+    if( ! want || (pos >= meta->inode->data_size) ) return whefs_rc.RangeError;
+    if( want > (meta->inode->data_size - pos) ) want = meta->inode->data_size - pos;
+    /* ensures that the block list is loaded */
+    rc = whefs_block_for_pos( fs, meta->inode, pos, &bl, false, false );
+    if( whefs_rc.OK != rc ) return rc;
+    if( meta->ra.alloced < want )
+    {
+        unsigned char * x = (unsigned char *) realloc( meta->ra.buf, want );
+        if( ! x ) return whefs_rc.AllocError;
+        meta->ra.buf = x;
+        meta->ra.alloced = want;
+    }
+    meta->ra.start = pos;
+    meta->ra.gen = meta->inode->gen;
+    meta->ra.failed = false;
+    if( async && whio_dev_is_uring( fs->dev ) )
+    {
+        whefs_id_type bi = (whefs_id_type)(pos / meta->bs);
+        whio_size_t off = pos % meta->bs;
+        whio_size_t done = 0;
+        while( (done < want) && (bi < meta->inode->blocks.count) )
+        {
+            whio_size_t len = meta->bs - off;
+            const whio_size_t bpos = whefs_block_data_pos( fs, &meta->inode->blocks.list[bi] ) + off;
+            if( len > (want - done) ) len = want - done;
+            rc = whefs_fs_pcache_sync( fs, bpos, len ); /* the read bypasses the page cache */
+            if( whefs_rc.OK != rc ) break;
+            rc = whio_dev_uring_queue_read( fs->dev, bpos, meta->ra.buf + done, len, meta );
+            if( whio_rc.OK != rc ) break;
+            ++meta->ra.pending;
+            done += len;
+            off = 0;
+            ++bi;
+        }
+        meta->ra.len = want;
+        if( done < want ) meta->ra.failed = true;
+        whio_dev_uring_submit( fs->dev );
+        return whefs_rc.OK;
+    }
+    else
+    {
+        const whio_size_t posabs = meta->posabs;
+        bool keepGoing = true;
+        whio_size_t got = 0;
+        meta->posabs = pos;
+        while( keepGoing )
+        {
+            const whio_size_t sz = whio_dev_inode_read_impl( 0, meta, meta->ra.buf + got, want - got, &keepGoing );
+            got += sz;
+        }
+        meta->posabs = posabs;
+        if( got != want ) return whefs_rc.IOError;
+        meta->ra.len = meta->ra.got = want;
+        return whefs_rc.OK;
+    }
+}
+
+/**
+   Copies as much of a read of n bytes at meta->posabs as meta's
+   read-ahead window holds into dest, and advances meta->posabs
+   accordingly. Returns the number of bytes copied.
+*/
+static whio_size_t whio_dev_inode_ra_copy( whio_dev_inode_meta * meta, void * dest, whio_size_t n )
+{
+    whio_size_t off, sz;
+    if( ! meta->ra.len
+        || (meta->posabs < meta->ra.start)
+        || (meta->posabs >= (meta->ra.start + meta->ra.len)) )
+    {
+        return 0;
+    }
+    whio_dev_inode_ra_settle( meta );
+    if( meta->ra.gen != meta->inode->gen )
+    { /* the inode was modified since the window was filled */
+        meta->ra.len = 0;
+    }
+    if( ! meta->ra.len ) return 0;
+    off = meta->posabs - meta->ra.start;
+    sz = meta->ra.len - off;
+    if( sz > n ) sz = n;
+    memcpy( dest, meta->ra.buf + off, sz );
+    meta->posabs += sz;
+    return sz;
+}
+
 static whio_size_t whio_dev_inode_read( whio_dev * dev, void * dest, whio_size_t n )
 {
     bool keepGoing = true;
+    bool seq;
     whio_size_t total = 0;
+    uint32_t win;
     WHIO_DEV_DECL(0);
+    win = meta->fs->readahead.blocks;
+    seq = (meta->posabs == meta->ra.next);
+    /* Copies out of the read-ahead window do not need the io lock,
+       so concurrent readers of other inodes only serialize on
+       actual i/o. */
+    total = whio_dev_inode_ra_copy( meta, dest, n );
+    if( (total < n) && seq && win
+        && ((n - total) < (meta->bs * win)) /* larger reads gain nothing from a window */ )
+    {
+        int rc;
+        WHEFS_FS_IO_LOCK(meta->fs);
+        rc = whio_dev_inode_ra_fill( meta, meta->posabs, false );
+        WHEFS_FS_IO_UNLOCK(meta->fs);
+        if( whefs_rc.OK == rc )
+        {
+            total += whio_dev_inode_ra_copy( meta, WHIO_VOID_PTR_ADD(dest,total), n - total );
+        }
+    }
+    keepGoing = (total < n);
+    WHEFS_FS_IO_LOCK(meta->fs);
     while( keepGoing )
     {
 	const whio_size_t sz = whio_dev_inode_read_impl( dev, meta, WHIO_VOID_PTR_ADD(dest,total), n - total, &keepGoing );
 	total += sz;
     }
+    meta->ra.next = meta->posabs;
+    if( seq && win && meta->ra.len && !meta->ra.pending
+        && (meta->posabs == (meta->ra.start + meta->ra.len))
+        && (meta->posabs < meta->inode->data_size)
+        && whio_dev_is_uring( meta->fs->dev ) )
+    { /* The window is used up: start fetching the next one while the client works. */
+        whio_dev_inode_ra_fill( meta, meta->posabs, true );
+    }
+    WHEFS_FS_IO_UNLOCK(meta->fs);
     return total;
 }
 
@@ -550,24 +1054,36 @@ static whio_size_t whio_dev_inode_write_impl( whio_dev * dev,
     }
     *keepGoing = false;
     /*whio_size_t eofpos = meta->inode->data_size; */
-    rc = whefs_block_for_pos( meta->fs, meta->inode, meta->posabs, &block, true );
+    rc = whefs_block_for_pos( meta->fs, meta->inode, meta->posabs, &block, true, false );
     if( whefs_rc.OK != rc )
     {
 	WHEFS_DBG("Error #%d getting block for meta->posabs==%u", rc, meta->posabs );
 	return 0;
     }
     else {
+        whio_size_t sz = whio_dev_inode_write_run( meta, (whefs_id_type)(meta->posabs / meta->bs), src, n );
+        if( sz )
+        {
+            meta->posabs += sz;
+            if( meta->inode->data_size < meta->posabs )
+            {
+                meta->inode->data_size = meta->posabs;
+            }
+            *keepGoing = (sz < n);
+            return sz;
+        }
+    }
+    {
         const whio_size_t wpos = (meta->posabs % meta->bs);
         const whio_size_t left = meta->bs - wpos;
         const whio_size_t bdpos = whefs_block_data_pos( meta->fs, &block );
         const whio_size_t wlen = ( n > left ) ? left : n;
         /*WHEFS_DBG("wpos=%u left=%u bdpos=%u wlen=%u", wpos, left, bdpos, wlen ); */
-        whio_dev * fd = meta->fs->dev;
         whio_size_t sz, szCheck;
-        fd->api->seek( fd, bdpos + wpos, SEEK_SET );
-        sz = fd->api->write( fd, src, wlen );
+        rc = whefs_inode_block_list_flush_pending( meta->fs, meta->inode, (whefs_id_type)(meta->posabs / meta->bs) + 1 );
+        if( whefs_rc.OK != rc ) return 0;
+        sz = whefs_fs_writeat( meta->fs, bdpos + wpos, src, wlen );
         if( ! sz ) return 0;
-        whefs_inode_update_mtime( meta->fs, meta->inode );
         szCheck = meta->posabs + sz;
         if( szCheck > meta->posabs )
         {
@@ -608,11 +1124,37 @@ static whio_size_t whio_dev_inode_write( whio_dev * dev, void const * src, whio_
     else {
         bool keepGoing = true;
         whio_size_t total = 0;
+        WHEFS_FS_IO_LOCK(meta->fs);
+        if( n && ((meta->posabs + n) > meta->posabs) )
+        {
+            /*
+              Reserve every block this write needs in one go, so that
+              they can be allocated as contiguous extents instead of
+              one block per chunk. Their headers are left for the
+              writes below, which put them in the same vectored
+              writes as the data where they can, so each header is
+              written once. Errors are ignored here: the chunked
+              writes below will run into them again and report a
+              short write.
+            */
+            whefs_block bl = whefs_block_empty;
+            whefs_block_for_pos( meta->fs, meta->inode, meta->posabs + n - 1, &bl, true, true );
+        }
         while( keepGoing )
         {
             const whio_size_t sz = whio_dev_inode_write_impl( dev, meta, WHIO_VOID_CPTR_ADD(src,total), n - total, &keepGoing );
             total += sz;
         }
+        /* headers of blocks the data writes did not cover (e.g. after a short write) */
+        whefs_inode_block_list_flush_pending( meta->fs, meta->inode, meta->inode->blocks.count );
+        WHEFS_FS_IO_UNLOCK(meta->fs);
+        /* The mtime (like the size) only reaches the disk when the
+           inode is flushed, so one update per write() is enough. */
+        if( total )
+        {
+            whefs_inode_update_mtime( meta->fs, meta->inode );
+            ++meta->inode->gen; /* invalidates read-ahead windows */
+        }
         return total;
     }
 }
@@ -682,9 +1224,15 @@ static int whio_dev_inode_flush( whio_dev * dev )
 			meta->rw ? "read/write" : "read-only", meta->inode->id,
 			meta->inode->data_size, meta->posabs
 			);
+    WHEFS_FS_IO_LOCK(meta->fs);
     rc = meta->rw
 	? whefs_inode_flush( meta->fs, meta->inode )
 	: whefs_rc.OK;
+    if( meta->rw && (whefs_rc.OK == rc) )
+    { /* write back buffered writes, but leave syncing the storage to whefs_fs_flush() */
+        rc = whefs_fs_pcache_flush( meta->fs );
+    }
+    WHEFS_FS_IO_UNLOCK(meta->fs);
 #if 0 /* having this decreases performance by 50% or so in my simple tests. */
     if( meta->rw )
     {
@@ -699,7 +1247,11 @@ static int whio_dev_inode_flush( whio_dev * dev )
     return rc;
 }
 
-static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
+/**
+   The implementation of whio_dev_inode_trunc(), which must be called
+   with meta->fs's io lock held.
+*/
+static int whio_dev_inode_trunc_impl( whio_dev * dev, whio_off_t len )
 {
     /* Man, this was a bitch to do! */
     whio_size_t off;
@@ -710,6 +1262,7 @@ static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
     off = (whio_size_t)len;
     if( off > len ) return whio_rc.RangeError; /* overflow */
     if( off == meta->inode->data_size ) return whefs_rc.OK;
+    ++meta->inode->gen; /* invalidates read-ahead windows */
     if( 0 == len )
     { /* special (simpler) case for 0 byte truncate */
 	/* (WTF?) FIXME: update ino->blocks.list[0] */
@@ -748,7 +1301,7 @@ static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
             return rc;
         }
         /* Update block info... */
-        rc = whefs_block_for_pos( meta->fs, meta->inode, off-1, &bl, true );
+        rc = whefs_block_for_pos( meta->fs, meta->inode, off-1, &bl, true, false );
         if( whefs_rc.OK != rc )
         {
             WHEFS_DBG_ERR("Could not get block for write position %u of inode #%u. Error code=%d.",
@@ -818,18 +1371,18 @@ static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
             const whio_size_t dest = off;
             whio_size_t wlen, iorc, wsz;
             memset( buf, 0, bufSize );
-            dev->api->seek( dev, orig, SEEK_SET );
+            whio_dev_inode_seek( dev, orig, SEEK_SET );
             wlen = dest - orig;
             iorc = 0;
             wsz = 0;
             do
             {
                 wsz = (wlen < bufSize) ? wlen : bufSize;
-                iorc = dev->api->write( dev, buf, wsz );
+                iorc = whio_dev_inode_write( dev, buf, wsz );
                 wlen -= iorc;
             }
             while( iorc && (iorc == wsz) );
-            iorc = dev->api->seek( dev, PosAbs, SEEK_SET );
+            iorc = whio_dev_inode_seek( dev, PosAbs, SEEK_SET );
             return (iorc == PosAbs)
                 ? whefs_rc.OK
                 : whefs_rc.IOError;
@@ -844,6 +1397,16 @@ static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
     }
 }
 
+static int whio_dev_inode_trunc( whio_dev * dev, whio_off_t len )
+{
+    int rc;
+    WHIO_DEV_DECL(whio_rc.ArgError);
+    WHEFS_FS_IO_LOCK(meta->fs);
+    rc = whio_dev_inode_trunc_impl( dev, len );
+    WHEFS_FS_IO_UNLOCK(meta->fs);
+    return rc;
+}
+
 short whio_dev_inode_iomode( whio_dev * dev )
 {
     WHIO_DEV_DECL(-1);
@@ -877,6 +1440,16 @@ static bool whio_dev_inode_close( whio_dev * dev )
 	{
             whefs_fs_closer_dev_remove( meta->fs, dev );
             if( meta->rw ) dev->api->flush(dev);
+            free( meta->iobuf );
+            meta->iobuf = 0;
+            meta->iobufLen = 0;
+            free( meta->iov );
+            meta->iov = 0;
+            meta->iovLen = 0;
+            whio_dev_inode_ra_settle( meta ); /* the kernel may still be writing to ra.buf */
+            free( meta->ra.buf );
+            meta->ra.buf = 0;
+            meta->ra.alloced = 0;
 	    dev->impl.data = 0;
 	    if(0) WHEFS_DBG_FYI("Closing i/o %s device for inode #%u. "
 				"inode->data_size=%u posabs=%u",
@@ -885,6 +1458,10 @@ static bool whio_dev_inode_close( whio_dev * dev )
 				meta->inode->data_size, meta->posabs
 				);
 	    whefs_inode_close( meta->fs, meta->inode, dev );
+            if( meta->rw )
+            { /* whefs_inode_close() may have updated the inode record. */
+                whefs_fs_pcache_flush( meta->fs );
+            }
 	    whio_dev_inode_meta_free( meta );
 	    return true;
 	}
@@ -912,22 +1489,137 @@ static void whio_dev_inode_finalize( whio_dev * dev )
     }
 }
 
+#if WHEFS_CONFIG_ENABLE_THREADS
+/*
+  Locking wrappers for the whio_dev_inode API. Operations on a device
+  hold its fs's metadata lock shared and its inode's lock, so that
+  devices for different inodes can be used concurrently. Closing a
+  device changes the fs's opened-node table and closer list, so it
+  holds the metadata lock exclusively.
+*/
+
+/** Locks meta's fs (shared) and inode. */
+#define WHIO_DEV_INODE_LOCK(META) WHEFS_FS_RDLOCK((META)->fs); WHEFS_INODE_LOCK((META)->inode)
+/** Undoes WHIO_DEV_INODE_LOCK(META). */
+#define WHIO_DEV_INODE_UNLOCK(META) WHEFS_INODE_UNLOCK((META)->inode); WHEFS_FS_UNLOCK((META)->fs)
+
+static whio_size_t whio_dev_inode_read_mt( whio_dev * dev, void * dest, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_DEV_DECL(0);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_read( dev, dest, n );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static whio_size_t whio_dev_inode_write_mt( whio_dev * dev, void const * src, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_DEV_DECL(0);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_write( dev, src, n );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static bool whio_dev_inode_close_mt( whio_dev * dev )
+{
+    whefs_fs * fs;
+    bool rc;
+    WHIO_DEV_DECL(false);
+    fs = meta->fs; /* meta is freed by close() */
+    WHEFS_FS_WRLOCK(fs);
+    rc = whio_dev_inode_close( dev );
+    WHEFS_FS_UNLOCK(fs);
+    return rc;
+}
+
+static int whio_dev_inode_eof_mt( whio_dev * dev )
+{
+    int rc;
+    WHIO_DEV_DECL(whio_rc.ArgError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_eof( dev );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static whio_size_t whio_dev_inode_tell_mt( whio_dev * dev )
+{
+    whio_size_t rc;
+    WHIO_DEV_DECL(whio_rc.SizeTError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_tell( dev );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static whio_size_t whio_dev_inode_seek_mt( whio_dev * dev, whio_off_t pos, int whence )
+{
+    whio_size_t rc;
+    WHIO_DEV_DECL(whio_rc.SizeTError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_seek( dev, pos, whence );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static int whio_dev_inode_flush_mt( whio_dev * dev )
+{
+    int rc;
+    WHIO_DEV_DECL(whio_rc.ArgError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_flush( dev );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static int whio_dev_inode_trunc_mt( whio_dev * dev, whio_off_t len )
+{
+    int rc;
+    WHIO_DEV_DECL(whio_rc.ArgError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_trunc( dev, len );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+static int whio_dev_inode_ioctl_mt( whio_dev * dev, int arg, va_list vargs )
+{
+    int rc;
+    WHIO_DEV_DECL(whio_rc.ArgError);
+    WHIO_DEV_INODE_LOCK(meta);
+    rc = whio_dev_inode_ioctl( dev, arg, vargs );
+    WHIO_DEV_INODE_UNLOCK(meta);
+    return rc;
+}
+
+#undef WHIO_DEV_INODE_LOCK
+#undef WHIO_DEV_INODE_UNLOCK
+/** Expands to the name of the whio_dev_inode API function F for the api table. */
+#  define WHIO_DEV_INODE_API(F) F ## _mt
+#else
+#  define WHIO_DEV_INODE_API(F) F
+#endif /* WHEFS_CONFIG_ENABLE_THREADS */
+
 static const whio_dev_api whio_dev_api_inode_empty =
     {
-    whio_dev_inode_read,
-    whio_dev_inode_write,
-    whio_dev_inode_close,
-    whio_dev_inode_finalize,
+    WHIO_DEV_INODE_API(whio_dev_inode_read),
+    WHIO_DEV_INODE_API(whio_dev_inode_write),
+    WHIO_DEV_INODE_API(whio_dev_inode_close),
+    whio_dev_inode_finalize, /* calls dev->api->close() */
     whio_dev_inode_error,
     whio_dev_inode_clear_error,
-    whio_dev_inode_eof,
-    whio_dev_inode_tell,
-    whio_dev_inode_seek,
-    whio_dev_inode_flush,
-    whio_dev_inode_trunc,
-    whio_dev_inode_ioctl,
+    WHIO_DEV_INODE_API(whio_dev_inode_eof),
+    WHIO_DEV_INODE_API(whio_dev_inode_tell),
+    WHIO_DEV_INODE_API(whio_dev_inode_seek),
+    WHIO_DEV_INODE_API(whio_dev_inode_flush),
+    WHIO_DEV_INODE_API(whio_dev_inode_trunc),
+    WHIO_DEV_INODE_API(whio_dev_inode_ioctl),
     whio_dev_inode_iomode
     };
+#undef WHIO_DEV_INODE_API
 
 static const whio_dev whio_dev_inode_empty =
     {
@@ -942,6 +1634,13 @@ static const whio_dev whio_dev_inode_empty =
 
 
 
+whefs_fs_closer_list * whefs_dev_closer_entry( whio_dev const * dev )
+{
+    return (dev && dev->impl.data && ((void const *)&whio_dev_inode_meta_empty == dev->impl.typeID))
+        ? &((whio_dev_inode_meta*)dev->impl.data)->closer
+        : 0;
+}
+
 whio_dev * whefs_dev_for_inode( whefs_fs * fs, whefs_id_type nid, bool writeMode )
 {
     /*WHEFS_DBG("trying to open dev for inode #%u", nid ); */
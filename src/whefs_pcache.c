@@ -0,0 +1,493 @@
+/**
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/
+
+  License: Public Domain
+
+  This file contains the page cache which sits between whefs and its
+  storage device. whefs_fs_readat() and friends serve small reads of
+  fs->dev (block data, block headers, inode records, names, ...) from
+  fixed-size pages of the device, kept in memory up to a configurable
+  budget and evicted with the CLOCK (second-chance) algorithm.
+
+  Reads larger than an eighth of the budget bypass the cache so that
+  streaming a big pseudofile does not flush out the small, hot data
+  the cache is there for.
+
+  If fs->pcache.dirtyMax is non-zero, small writes are buffered
+  (write-back): they are copied into their pages, which are marked as
+  dirty, and each page remembers the range of bytes which changed, so
+  repeated writes to the same header or inode record cost one device
+  write. Dirty pages are written back when they are evicted, when too
+  many of them pile up or get too old, and by whefs_fs_pcache_flush(),
+  which sorts them and writes runs of adjacent pages with one
+  vectored write. Dirty pages of the free-space map are always written
+  back before any other page. Writes which are large, or which would extend the
+  device, go straight to fs->dev (write-through) and update any
+  cached copies of the pages they touch.
+
+  Any code which reads fs->dev directly must first write back the
+  range it reads with whefs_fs_pcache_sync(). Any code which modifies
+  fs->dev other than via whefs_fs_writeat(), whefs_fs_writevat() or
+  whefs_fs_write() (e.g. mkfs, or truncating the device) must call
+  whefs_fs_pcache_clear() before doing so.
+*/
+
+#include "whefs_details.c"
+#include <stdlib.h> /* malloc(), calloc(), qsort(), free() */
+#include <string.h> /* memcpy() */
+#include <time.h> /* time() */
+
+const whefs_cache_stats whefs_cache_stats_empty = whefs_cache_stats_empty_m;
+
+/** Returns c's page with the given page number, or 0 if it is not cached. */
+static whefs_pcache_page * whefs_pcache_find( struct whefs_pcache * c, whio_size_t pgno )
+{
+    whio_size_t i = c->buckets[pgno & c->bucketMask];
+    while( i )
+    {
+        whefs_pcache_page * p = &c->pages[i-1];
+        if( p->pgno == pgno ) return p;
+        i = p->next;
+    }
+    return 0;
+}
+
+/** Removes p from c's hash chains and marks it as unused. */
+static void whefs_pcache_drop( struct whefs_pcache * c, whefs_pcache_page * p )
+{
+    whio_size_t * link = &c->buckets[p->pgno & c->bucketMask];
+    const whio_size_t self = (whio_size_t)(p - c->pages) + 1;
+    while( *link && (*link != self) ) link = &c->pages[*link - 1].next;
+    if( *link ) *link = p->next;
+    if( p->dirty ) --c->stats.dirty;
+    *p = whefs_pcache_page_empty;
+    --c->stats.pages;
+}
+
+/** Returns the memory holding page p of cache c. */
+#define WHEFS_PCACHE_MEM(C,P) ((C)->mem + (((P) - (C)->pages) * (C)->stats.page_size))
+
+/** Returns true if page p of fs's cache holds part of the free-space map. */
+static bool whefs_pcache_is_freemap( whefs_fs const * fs, whefs_pcache_page const * p )
+{
+    const whio_size_t ps = fs->pcache.stats.page_size;
+    const whio_size_t fm = fs->offsets[WHEFS_OFF_FREEMAP];
+    return fs->sizes[WHEFS_SZ_FREEMAP]
+        && ((p->pgno * ps) < (fm + fs->sizes[WHEFS_SZ_FREEMAP]))
+        && (((p->pgno + 1) * ps) > fm);
+}
+
+/**
+   If p is dirty, writes its dirty bytes to fs->dev and marks it as
+   clean. Returns whefs_rc.OK on success. On error p stays dirty.
+
+   Unless p is itself part of the free-space map, any dirty freemap
+   pages are written back first, so that a block header which marks
+   a block as used never reaches the storage before the map does (see
+   whefs_freemap.c).
+*/
+static int whefs_pcache_writeback( whefs_fs * fs, whefs_pcache_page * p )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t len = p->dhi - p->dlo;
+    whio_size_t wrc;
+    int rc;
+    if( ! p->dirty ) return whefs_rc.OK;
+    if( ! whefs_pcache_is_freemap( fs, p ) )
+    {
+        rc = whefs_fs_pcache_sync( fs, fs->offsets[WHEFS_OFF_FREEMAP], fs->sizes[WHEFS_SZ_FREEMAP] );
+        if( whefs_rc.OK != rc ) return rc;
+    }
+    wrc = whio_dev_writeat( fs->dev, (p->pgno * c->stats.page_size) + p->dlo,
+                            WHEFS_PCACHE_MEM(c,p) + p->dlo, len );
+    if( wrc != len )
+    {
+        WHEFS_DBG_ERR("Write-back of page #%"WHIO_SIZE_T_PFMT" failed!", p->pgno );
+        return fs->err = whefs_rc.IOError;
+    }
+    p->dirty = false;
+    --c->stats.dirty;
+    ++c->stats.writebacks;
+    return whefs_rc.OK;
+}
+
+/**
+   Allocates fs->pcache's memory for its current budget. Returns
+   false if the cache is disabled or allocation fails, in which case
+   the cache is disabled.
+*/
+static bool whefs_pcache_init( whefs_fs * fs )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    whio_size_t cap, nb = 1;
+    if( c->mem ) return true;
+    cap = c->budget / c->stats.page_size;
+    if( ! cap ) return false;
+    while( nb < cap ) nb <<= 1;
+    c->mem = (unsigned char *) malloc( cap * c->stats.page_size );
+    c->pages = (whefs_pcache_page *) calloc( cap, sizeof(whefs_pcache_page) );
+    c->buckets = (whio_size_t *) calloc( nb, sizeof(whio_size_t) );
+    if( !c->mem || !c->pages || !c->buckets )
+    {
+        WHEFS_DBG_WARN("Could not allocate %"WHIO_SIZE_T_PFMT" bytes of page cache. Disabling it.", c->budget );
+        whefs_fs_pcache_free( fs );
+        c->budget = 0;
+        return false;
+    }
+    c->stats.capacity = (uint32_t)cap;
+    c->bucketMask = nb - 1;
+    c->hand = 0;
+    return true;
+}
+
+/**
+   Picks a page slot for a new page using the CLOCK algorithm,
+   evicting (and, if needed, writing back) its current page, and
+   returns it. The slot is not yet linked into the hash table. Returns
+   0 if a dirty page could not be written back.
+*/
+static whefs_pcache_page * whefs_pcache_victim( whefs_fs * fs )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    while( 1 )
+    {
+        whefs_pcache_page * p = &c->pages[c->hand];
+        c->hand = (c->hand + 1) % c->stats.capacity;
+        if( ! p->used ) return p;
+        if( p->ref )
+        { /* second chance */
+            p->ref = false;
+            continue;
+        }
+        if( whefs_rc.OK != whefs_pcache_writeback( fs, p ) ) return 0;
+        whefs_pcache_drop( c, p );
+        ++c->stats.evictions;
+        return p;
+    }
+}
+
+/**
+   Reads page #pgno of fs->dev into the cache and returns it, or
+   returns 0 if nothing could be read (e.g. the page lies past the end
+   of the device) or no slot could be freed for it.
+*/
+static whefs_pcache_page * whefs_pcache_load( whefs_fs * fs, whio_size_t pgno )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whefs_pcache_page * p = whefs_pcache_victim( fs );
+    whio_size_t ndx, got;
+    if( ! p ) return 0;
+    ndx = (whio_size_t)(p - c->pages);
+    got = whio_dev_readat( fs->dev, pgno * ps, c->mem + (ndx * ps), ps );
+    if( (whio_rc.SizeTError == got) || !got ) return 0;
+    p->pgno = pgno;
+    p->len = got;
+    p->used = true;
+    p->next = c->buckets[pgno & c->bucketMask];
+    c->buckets[pgno & c->bucketMask] = ndx + 1;
+    ++c->stats.pages;
+    return p;
+}
+
+whio_size_t whefs_fs_pcache_read( whefs_fs * fs, whio_size_t pos, void * dest, whio_size_t n )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whio_size_t done = 0;
+    if( (n > (c->budget / 8)) || (fs->flags & WHEFS_FLAG_FS_IsMMapped) || !whefs_pcache_init( fs ) )
+    {
+        if( c->budget ) ++c->stats.bypasses;
+        if( whefs_rc.OK != whefs_fs_pcache_sync( fs, pos, n ) ) return 0;
+        done = whio_dev_readat( fs->dev, pos, dest, n );
+        return (whio_rc.SizeTError == done) ? 0 : done;
+    }
+    while( done < n )
+    {
+        const whio_size_t pgno = (pos + done) / ps;
+        const whio_size_t off = (pos + done) % ps;
+        whio_size_t len;
+        whefs_pcache_page * p = whefs_pcache_find( c, pgno );
+        if( p ) ++c->stats.hits;
+        else
+        {
+            ++c->stats.misses;
+            p = whefs_pcache_load( fs, pgno );
+            if( ! p ) break;
+        }
+        p->ref = true;
+        if( off >= p->len ) break;
+        len = p->len - off;
+        if( len > (n - done) ) len = n - done;
+        memcpy( WHIO_VOID_PTR_ADD(dest,done), WHEFS_PCACHE_MEM(c,p) + off, len );
+        done += len;
+        if( p->len < ps ) break; /* the rest is past the end of the device */
+    }
+    return done;
+}
+
+void whefs_fs_pcache_update( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whio_size_t done = 0;
+    if( ! c->stats.pages ) return;
+    while( done < n )
+    {
+        const whio_size_t pgno = (pos + done) / ps;
+        const whio_size_t off = (pos + done) % ps;
+        whio_size_t len = ps - off;
+        whefs_pcache_page * p = whefs_pcache_find( c, pgno );
+        if( len > (n - done) ) len = n - done;
+        if( p )
+        {
+            if( ! src || (off > p->len) )
+            { /* can't tell what lies between the cached bytes and the new ones */
+                whefs_pcache_writeback( fs, p );
+                whefs_pcache_drop( c, p );
+            }
+            else
+            {
+                memcpy( WHEFS_PCACHE_MEM(c,p) + off, WHIO_VOID_CPTR_ADD(src,done), len );
+                if( (off + len) > p->len ) p->len = off + len;
+            }
+        }
+        done += len;
+    }
+}
+
+/**
+   Writes n bytes of src to position pos of fs->dev, bypassing the
+   cache but updating any cached pages. Returns the number of bytes
+   written.
+*/
+static whio_size_t whefs_pcache_write_through( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n )
+{
+    whio_size_t x = whio_dev_writeat( fs->dev, pos, src, n );
+    if( whio_rc.SizeTError == x ) return 0;
+    whefs_fs_pcache_update( fs, pos, src, x );
+    return x;
+}
+
+whio_size_t whefs_fs_pcache_write( whefs_fs * fs, whio_size_t pos, void const * src, whio_size_t n )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whio_size_t done = 0;
+    if( !c->dirtyMax || (n > (c->budget / 8)) || (fs->flags & WHEFS_FLAG_FS_IsMMapped) || !whefs_pcache_init( fs ) )
+    {
+        return whefs_pcache_write_through( fs, pos, src, n );
+    }
+    while( done < n )
+    {
+        const whio_size_t pgno = (pos + done) / ps;
+        const whio_size_t off = (pos + done) % ps;
+        whio_size_t len = ps - off;
+        whefs_pcache_page * p = whefs_pcache_find( c, pgno );
+        if( len > (n - done) ) len = n - done;
+        if( ! p ) p = whefs_pcache_load( fs, pgno );
+        if( !p || ((off + len) > p->len) )
+        { /* past the end of the device: let the device grow now */
+            done += whefs_pcache_write_through( fs, pos + done, WHIO_VOID_CPTR_ADD(src,done), n - done );
+            break;
+        }
+        memcpy( WHEFS_PCACHE_MEM(c,p) + off, WHIO_VOID_CPTR_ADD(src,done), len );
+        p->ref = true;
+        if( p->dirty )
+        { /* merge with the earlier changes */
+            if( off < p->dlo ) p->dlo = off;
+            if( (off + len) > p->dhi ) p->dhi = off + len;
+        }
+        else
+        {
+            p->dirty = true;
+            p->dlo = off;
+            p->dhi = off + len;
+            if( ! c->stats.dirty++ ) c->dirtySince = time(0);
+        }
+        done += len;
+    }
+    if( c->stats.dirty
+        && (((c->stats.dirty * ps) > c->dirtyMax)
+            || ((time(0) - c->dirtySince) >= (time_t)c->dirtyAge)) )
+    {
+        whefs_fs_pcache_flush( fs );
+    }
+    return done;
+}
+
+int whefs_fs_pcache_sync( whefs_fs * fs, whio_size_t pos, whio_size_t n )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whio_size_t first, last, i;
+    int rc = whefs_rc.OK;
+    if( !c->stats.dirty || !n ) return whefs_rc.OK;
+    first = pos / ps;
+    last = (pos + n - 1) / ps;
+    if( (last - first) < c->stats.capacity )
+    { /* look up each page of the range */
+        for( i = first; (i <= last) && (whefs_rc.OK == rc); ++i )
+        {
+            whefs_pcache_page * p = whefs_pcache_find( c, i );
+            if( p ) rc = whefs_pcache_writeback( fs, p );
+        }
+    }
+    else
+    { /* the range is bigger than the cache: scan the cache */
+        for( i = 0; (i < c->stats.capacity) && (whefs_rc.OK == rc); ++i )
+        {
+            whefs_pcache_page * p = &c->pages[i];
+            if( p->dirty && (p->pgno >= first) && (p->pgno <= last) ) rc = whefs_pcache_writeback( fs, p );
+        }
+    }
+    return rc;
+}
+
+/** qsort() comparison function for (whefs_pcache_page*) by page number. */
+static int whefs_pcache_cmp_pgno( void const * lhs, void const * rhs )
+{
+    whefs_pcache_page const * l = *((whefs_pcache_page const * const *)lhs);
+    whefs_pcache_page const * r = *((whefs_pcache_page const * const *)rhs);
+    return (l->pgno < r->pgno) ? -1 : ((l->pgno > r->pgno) ? 1 : 0);
+}
+
+int whefs_fs_pcache_flush( whefs_fs * fs )
+{
+    enum { MaxSegments = 64 };
+    struct whefs_pcache * c = &fs->pcache;
+    const whio_size_t ps = c->stats.page_size;
+    whio_iovec iov[MaxSegments];
+    whefs_pcache_page ** list;
+    whio_size_t count = 0, i, k, seg, total;
+    int rc;
+    if( ! c->stats.dirty ) return whefs_rc.OK;
+    /* the free-space map goes first, as for single-page write-backs */
+    rc = whefs_fs_pcache_sync( fs, fs->offsets[WHEFS_OFF_FREEMAP], fs->sizes[WHEFS_SZ_FREEMAP] );
+    if( whefs_rc.OK != rc ) return rc;
+    if( ! c->stats.dirty ) return whefs_rc.OK;
+    list = (whefs_pcache_page **) malloc( c->stats.dirty * sizeof(whefs_pcache_page*) );
+    if( ! list )
+    { /* write them back one at a time */
+        for( i = 0; i < c->stats.capacity; ++i )
+        {
+            if( whefs_rc.OK != whefs_pcache_writeback( fs, &c->pages[i] ) ) rc = whefs_rc.IOError;
+        }
+        return rc;
+    }
+    for( i = 0; i < c->stats.capacity; ++i )
+    {
+        if( c->pages[i].dirty ) list[count++] = &c->pages[i];
+    }
+    qsort( list, count, sizeof(whefs_pcache_page*), whefs_pcache_cmp_pgno );
+    for( i = 0; i < count; i += seg )
+    { /* write each run of adjacent dirty bytes with one call */
+        whefs_pcache_page * p = list[i];
+        iov[0].base = WHEFS_PCACHE_MEM(c,p) + p->dlo;
+        iov[0].len = total = p->dhi - p->dlo;
+        for( seg = 1; ((i + seg) < count) && (seg < MaxSegments); ++seg )
+        {
+            whefs_pcache_page * q = list[i + seg];
+            whefs_pcache_page * prev = list[i + seg - 1];
+            if( (prev->dhi != ps) || (q->pgno != (prev->pgno + 1)) || q->dlo ) break;
+            iov[seg].base = WHEFS_PCACHE_MEM(c,q);
+            iov[seg].len = q->dhi;
+            total += q->dhi;
+        }
+        if( total != whio_dev_writevat( fs->dev, (p->pgno * ps) + p->dlo, iov, seg ) )
+        {
+            WHEFS_DBG_ERR("Write-back of %"WHIO_SIZE_T_PFMT" page(s) starting at page #%"WHIO_SIZE_T_PFMT" failed!", seg, p->pgno );
+            rc = fs->err = whefs_rc.IOError;
+            continue;
+        }
+        for( k = 0; k < seg; ++k )
+        {
+            list[i + k]->dirty = false;
+            --c->stats.dirty;
+            ++c->stats.writebacks;
+        }
+    }
+    free( list );
+    return rc;
+}
+
+int whefs_fs_writeback( whefs_fs * fs, bool force )
+{
+    int rc = whefs_rc.OK;
+    if( ! fs || !fs->dev ) return whefs_rc.ArgError;
+    WHEFS_FS_WRLOCK(fs);
+    if( fs->pcache.stats.dirty
+        && (force || ((time(0) - fs->pcache.dirtySince) >= (time_t)fs->pcache.dirtyAge)) )
+    {
+        rc = whefs_fs_pcache_flush( fs );
+    }
+    WHEFS_FS_UNLOCK(fs);
+    return rc;
+}
+
+void whefs_fs_pcache_clear( whefs_fs * fs )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    whio_size_t i;
+    if( ! c->mem ) return;
+    if( c->stats.dirty && (whefs_rc.OK != whefs_fs_pcache_flush( fs )) )
+    {
+        WHEFS_DBG_ERR("Discarding %"PRIu32" dirty page(s) which could not be written back!", c->stats.dirty );
+    }
+    for( i = 0; i < c->stats.capacity; ++i ) c->pages[i] = whefs_pcache_page_empty;
+    memset( c->buckets, 0, (c->bucketMask + 1) * sizeof(whio_size_t) );
+    c->stats.pages = 0;
+    c->stats.dirty = 0;
+    c->hand = 0;
+}
+
+void whefs_fs_pcache_free( whefs_fs * fs )
+{
+    struct whefs_pcache * c = &fs->pcache;
+    if( c->stats.dirty && fs->dev && (whefs_rc.OK != whefs_fs_pcache_flush( fs )) )
+    {
+        WHEFS_DBG_ERR("Discarding %"PRIu32" dirty page(s) which could not be written back!", c->stats.dirty );
+    }
+    free( c->mem );
+    free( c->pages );
+    free( c->buckets );
+    c->mem = 0;
+    c->pages = 0;
+    c->buckets = 0;
+    c->bucketMask = 0;
+    c->hand = 0;
+    c->stats.capacity = 0;
+    c->stats.pages = 0;
+    c->stats.dirty = 0;
+}
+
+int whefs_fs_setopt_cache_size( whefs_fs * fs, whio_size_t bytes )
+{
+    if( ! fs ) return whefs_rc.ArgError;
+    whefs_fs_pcache_free( fs );
+    fs->pcache.budget = bytes;
+    return whefs_rc.OK;
+}
+
+int whefs_fs_setopt_writeback( whefs_fs * fs, whio_size_t maxDirtyBytes, uint32_t maxAgeSeconds )
+{
+    int rc = whefs_rc.OK;
+    if( ! fs ) return whefs_rc.ArgError;
+    if( ! maxDirtyBytes && fs->dev ) rc = whefs_fs_pcache_flush( fs );
+    fs->pcache.dirtyMax = maxDirtyBytes;
+    fs->pcache.dirtyAge = maxAgeSeconds;
+    return rc;
+}
+
+int whefs_fs_cache_stats( whefs_fs const * fs, whefs_cache_stats * tgt )
+{
+    if( ! fs || !tgt ) return whefs_rc.ArgError;
+    /* readers of pseudofiles update the stats while holding only the io lock */
+    WHEFS_FS_RDLOCK((whefs_fs *)fs);
+    WHEFS_FS_IO_LOCK((whefs_fs *)fs);
+    *tgt = fs->pcache.stats;
+    WHEFS_FS_IO_UNLOCK((whefs_fs *)fs);
+    WHEFS_FS_UNLOCK((whefs_fs *)fs);
+    if( ! tgt->capacity ) tgt->capacity = (uint32_t)(fs->pcache.budget / fs->pcache.stats.page_size);
+    return whefs_rc.OK;
+}
@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <stdlib.h> /* calloc() */
+#include <string.h> /* strlen(), strncmp() */
 #include <wh/whglob.h>
 #ifdef __cplusplus
 extern "C" {
@@ -222,7 +224,6 @@ static int patternCompare(
           return 0;
         }
       }else if( c==matchSet ){
-	  if( (esc==0) || (matchSet<0x80) ) return 0;
         while( *zString && patternCompare(&zPattern[-1],zString,pInfo,esc)==0 ){
           SQLITE_SKIP_UTF8(zString);
         }
@@ -318,6 +319,329 @@ int whglob_matches_like( char const *pattern, char const * str, char caseSensiti
 }
 
 
+/*
+** Compiled glob patterns. See whglob_compile().
+**
+** whglob_compile() parses the pattern the same way patternCompare()
+** does (quirks included, e.g. an escaped '[' still opens a set) into a
+** list of tokens. Runs of literal characters become a single token
+** which is compared with strncmp(), and the pattern's literal prefix
+** and suffix are checked before anything else.
+*/
+
+/** Token types of a compiled pattern. */
+enum whglob_op {
+WHGLOB_OP_LITERAL = 1, /* a run of literal bytes */
+WHGLOB_OP_ONE,         /* any one character ('?') */
+WHGLOB_OP_SET,         /* one character of a [...] set */
+WHGLOB_OP_STAR         /* any run of characters ('*') */
+};
+
+/** One token of a compiled pattern. */
+typedef struct whglob_tok
+{
+    u8 op;
+    /** For WHGLOB_OP_SET: true for [^...] sets. */
+    u8 invert;
+    /** LITERAL: offset of the bytes in whglob::bytes. SET: index of
+        the set's first entry in whglob::ranges. */
+    unsigned int off;
+    /** LITERAL: number of bytes. SET: number of ranges. */
+    unsigned int len;
+} whglob_tok;
+
+/** A range of characters in a [...] set. */
+typedef struct whglob_range
+{
+    int lo;
+    int hi;
+} whglob_range;
+
+struct whglob
+{
+    whglob_tok * toks;
+    unsigned int ntoks;
+    whglob_range * ranges;
+    unsigned int nranges;
+    /** The bytes of all literal tokens. */
+    u8 * bytes;
+    unsigned int nbytes;
+    /** NUL-terminated copy of the leading literal token, if any. */
+    char * prefix;
+    size_t prefixLen;
+    /** The trailing literal token, if any (not NUL-terminated). */
+    u8 const * suffix;
+    size_t suffixLen;
+    /** The minimum length, in bytes, of a matching string. */
+    size_t minLen;
+    /** True if the pattern can never match, e.g. "[abc". */
+    int never;
+};
+
+/** Appends a token with the given op to g and returns it. */
+static whglob_tok * whglob_push( whglob * g, u8 op )
+{
+    whglob_tok * t = g->toks + g->ntoks++;
+    t->op = op;
+    return t;
+}
+
+/** Appends the bytes [begin,end) to g's literal token, starting one
+    if the last token is not a literal. */
+static void whglob_literal( whglob * g, const u8 * begin, const u8 * end )
+{
+    whglob_tok * t = g->ntoks ? (g->toks + g->ntoks - 1) : 0;
+    if( !t || (t->op != WHGLOB_OP_LITERAL) )
+    {
+        t = whglob_push( g, WHGLOB_OP_LITERAL );
+        t->off = g->nbytes;
+    }
+    for( ; begin != end; ++begin, ++t->len ) g->bytes[g->nbytes++] = *begin;
+}
+
+/** Appends the range [lo,hi] to g's last (set) token. */
+static void whglob_range_add( whglob * g, int lo, int hi )
+{
+    g->ranges[g->nranges].lo = lo;
+    g->ranges[g->nranges].hi = hi;
+    ++g->nranges;
+    ++g->toks[g->ntoks-1].len;
+}
+
+whglob * whglob_compile( char const * pattern )
+{
+    enum { esc = '\\' };
+    const u8 * z = (const u8 *)pattern;
+    const u8 * start;
+    size_t plen, i;
+    whglob * g;
+    whglob_tok * t;
+    int c, c2, prior_c;
+    int prevEscape = 0;
+    if( ! pattern ) return 0;
+    plen = strlen( pattern ) + 1;
+    /* Each pattern byte yields at most one token, range and literal byte. */
+    g = (whglob *)calloc( 1, sizeof(whglob) + (plen * (sizeof(whglob_tok) + sizeof(whglob_range) + 2)) );
+    if( ! g ) return 0;
+    g->toks = (whglob_tok *)(g + 1);
+    g->ranges = (whglob_range *)(g->toks + plen);
+    g->bytes = (u8 *)(g->ranges + plen);
+    g->prefix = (char *)(g->bytes + plen);
+    while( (start = z), (c = sqlite3Utf8Read(z, 0, &z)) != 0 )
+    {
+        if( !prevEscape && c=='*' )
+        {
+            whglob_push( g, WHGLOB_OP_STAR );
+            while( (start = z), ((c = sqlite3Utf8Read(z, 0, &z)) == '*') || (c == '?') )
+            {
+                if( c=='?' ) whglob_push( g, WHGLOB_OP_ONE );
+            }
+            if( c==0 ) break;
+            else if( c==esc )
+            {
+                start = z;
+                if( sqlite3Utf8Read(z, 0, &z) == 0 )
+                {
+                    g->never = 1;
+                    break;
+                }
+                whglob_literal( g, start, z );
+            }
+            else if( c=='[' ) z = start; /* parsed as a set in the next pass */
+            else whglob_literal( g, start, z );
+        }
+        else if( !prevEscape && c=='?' )
+        {
+            whglob_push( g, WHGLOB_OP_ONE );
+        }
+        else if( c=='[' )
+        {
+            t = whglob_push( g, WHGLOB_OP_SET );
+            t->off = g->nranges;
+            prior_c = 0;
+            c2 = sqlite3Utf8Read(z, 0, &z);
+            if( c2=='^' )
+            {
+                t->invert = 1;
+                c2 = sqlite3Utf8Read(z, 0, &z);
+            }
+            if( c2==']' )
+            {
+                whglob_range_add( g, ']', ']' );
+                c2 = sqlite3Utf8Read(z, 0, &z);
+            }
+            while( c2 && c2!=']' )
+            {
+                if( c2=='-' && z[0]!=']' && z[0]!=0 && prior_c>0 )
+                {
+                    c2 = sqlite3Utf8Read(z, 0, &z);
+                    whglob_range_add( g, prior_c, c2 );
+                    prior_c = 0;
+                }
+                else
+                {
+                    whglob_range_add( g, c2, c2 );
+                    prior_c = c2;
+                }
+                c2 = sqlite3Utf8Read(z, 0, &z);
+            }
+            if( c2==0 )
+            {
+                g->never = 1;
+                break;
+            }
+        }
+        else if( c==esc && !prevEscape )
+        {
+            prevEscape = 1;
+        }
+        else
+        {
+            whglob_literal( g, start, z );
+            prevEscape = 0;
+        }
+    }
+    for( i = 0; i < g->ntoks; ++i )
+    {
+        t = g->toks + i;
+        if( t->op == WHGLOB_OP_LITERAL ) g->minLen += t->len;
+        else if( t->op != WHGLOB_OP_STAR ) ++g->minLen;
+    }
+    if( g->ntoks && (g->toks[0].op == WHGLOB_OP_LITERAL) )
+    {
+        g->prefixLen = g->toks[0].len;
+        memcpy( g->prefix, g->bytes, g->prefixLen );
+    }
+    g->prefix[g->prefixLen] = 0;
+    if( (g->ntoks > 1) && (g->toks[g->ntoks-1].op == WHGLOB_OP_LITERAL) )
+    {
+        t = g->toks + g->ntoks - 1;
+        g->suffix = g->bytes + t->off;
+        g->suffixLen = t->len;
+    }
+    return g;
+}
+
+void whglob_free( whglob * g )
+{
+    free( g );
+}
+
+char const * whglob_prefix( whglob const * g, size_t * len )
+{
+    if( len ) *len = g ? g->prefixLen : 0;
+    return g ? g->prefix : 0;
+}
+
+/**
+   If the non-star token t matches at *pz then *pz is moved past the
+   matched bytes and 1 is returned, else 0 is returned.
+*/
+static int whglob_tok_matches( whglob const * g, whglob_tok const * t, const u8 ** pz )
+{
+    const u8 * z = *pz;
+    whglob_range const * r;
+    whglob_range const * end;
+    int c, seen = 0;
+    switch( t->op )
+    {
+      case WHGLOB_OP_LITERAL:
+          if( 0 != strncmp( (char const *)z, (char const *)g->bytes + t->off, t->len ) ) return 0;
+          z += t->len;
+          break;
+      case WHGLOB_OP_ONE:
+          if( ! *z ) return 0;
+          SQLITE_SKIP_UTF8(z);
+          break;
+      case WHGLOB_OP_SET:
+          if( ! *z ) return 0;
+          c = sqlite3Utf8Read(z, 0, &z);
+          for( r = g->ranges + t->off, end = r + t->len; r != end; ++r )
+          {
+              if( c>=r->lo && c<=r->hi )
+              {
+                  seen = 1;
+                  break;
+              }
+          }
+          if( seen == t->invert ) return 0;
+          break;
+      default:
+          return 0;
+    };
+    *pz = z;
+    return 1;
+}
+
+/**
+   Lets the last star (whose following token is toks[starT]) swallow
+   one more character, i.e. moves *starZ forward by one character.
+   Returns 0 if there is no star or the string is exhausted.
+*/
+static int whglob_star_advance( unsigned int starT, const u8 ** starZ )
+{
+    const u8 * z = *starZ;
+    if( !starT || !z || !*z ) return 0;
+    SQLITE_SKIP_UTF8(z);
+    *starZ = z;
+    return 1;
+}
+
+int whglob_compiled_matches( whglob const * g, char const * str )
+{
+    const u8 * z = (const u8 *)str;
+    const u8 * starZ = 0; /* where the last star's match ends */
+    unsigned int t = 0, starT = 0;
+    size_t slen;
+    if( !g || !str || g->never ) return 0;
+    if( g->prefixLen )
+    {
+        if( 0 != strncmp( str, g->prefix, g->prefixLen ) ) return 0;
+        z += g->prefixLen;
+        t = 1;
+    }
+    if( g->suffixLen )
+    {
+        slen = strlen( str );
+        if( (slen < g->minLen)
+            || (0 != memcmp( str + slen - g->suffixLen, g->suffix, g->suffixLen )) ) return 0;
+    }
+    /* Match left to right. On a mismatch, let the last star swallow
+       one more character and retry from the token after it. If that
+       token is a literal, the star can skip straight to the next
+       occurrence of the literal's first byte. */
+    for( ;; )
+    {
+        if( (t < g->ntoks) && (g->toks[t].op == WHGLOB_OP_STAR) )
+        {
+            if( ++t == g->ntoks ) return 1;
+            starT = t;
+            starZ = z;
+        }
+        else if( (t < g->ntoks) && whglob_tok_matches( g, g->toks + t, &z ) )
+        {
+            ++t;
+            continue;
+        }
+        else if( (t == g->ntoks) && !*z )
+        {
+            return 1;
+        }
+        else
+        {
+            if( ! whglob_star_advance( starT, &starZ ) ) return 0;
+            z = starZ;
+            t = starT;
+        }
+        if( g->toks[t].op == WHGLOB_OP_LITERAL )
+        {
+            starZ = (const u8 *)strchr( (char const *)starZ, g->bytes[g->toks[t].off] );
+            if( ! starZ ) return 0;
+            z = starZ;
+        }
+    }}
+
+
 #undef SQLITE_ASCII
 #undef SQLITE_SKIP_UTF8
 #undef READ_UTF8
@@ -119,6 +119,7 @@ whio_size_t whio_dev_write( whio_dev * dev, void const * data, whio_size_t n )
 whio_size_t whio_dev_writeat( whio_dev * dev, whio_size_t pos, void const * data, whio_size_t n )
 {
     if( ! dev || ! data || !n ) return 0;
+    else if( dev->api->writeat ) return dev->api->writeat( dev, pos, data, n );
     else {
         whio_size_t rc = dev->api->seek( dev, pos, SEEK_SET );
         /*WHIO_DEBUG("Writing %u bytes at pos %u\n", n, pos ); */
@@ -131,15 +132,84 @@ whio_size_t whio_dev_writeat( whio_dev * dev, whio_size_t pos, void const * data
 whio_size_t whio_dev_readat( whio_dev * dev, whio_size_t pos, void * data, whio_size_t n )
 {
     if( ! dev || ! data || !n ) return 0;
+    else if( dev->api->readat ) return dev->api->readat( dev, pos, data, n );
     else {
         whio_size_t rc = dev->api->seek( dev, pos, SEEK_SET );
-        /*WHIO_DEBUG("Writing %u bytes at pos %u\n", n, pos ); */
+        /*WHIO_DEBUG("Reading %u bytes at pos %u\n", n, pos ); */
         return (whio_rc.SizeTError == rc)
             ? rc
             : whio_dev_read( dev, data, n );
     }
 }
 
+whio_size_t whio_dev_readv( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t i, rc, total = 0;
+    if( ! dev || ! iov || !count ) return 0;
+    else if( dev->api->readv ) return dev->api->readv( dev, iov, count );
+    for( i = 0; i < count; ++i )
+    {
+        if( ! iov[i].len ) continue;
+        rc = dev->api->read( dev, iov[i].base, iov[i].len );
+        total += rc;
+        if( rc != iov[i].len ) break;
+    }
+    return total;
+}
+
+whio_size_t whio_dev_writev( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t i, rc, total = 0;
+    if( ! dev || ! iov || !count ) return 0;
+    else if( dev->api->writev ) return dev->api->writev( dev, iov, count );
+    for( i = 0; i < count; ++i )
+    {
+        if( ! iov[i].len ) continue;
+        rc = dev->api->write( dev, iov[i].base, iov[i].len );
+        total += rc;
+        if( rc != iov[i].len ) break;
+    }
+    return total;
+}
+
+/**
+   Fallback for whio_dev_readvat() and whio_dev_writevat() for devices
+   which have readat()/writeat() but no vectored i/o: does one
+   positional call per segment, so the cursor is not used.
+*/
+static whio_size_t whio_dev_iov_at( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count, bool doWrite )
+{
+    whio_size_t i, rc, total = 0;
+    for( i = 0; i < count; ++i )
+    {
+        if( ! iov[i].len ) continue;
+        rc = doWrite
+            ? dev->api->writeat( dev, pos + total, iov[i].base, iov[i].len )
+            : dev->api->readat( dev, pos + total, iov[i].base, iov[i].len );
+        if( whio_rc.SizeTError == rc ) break;
+        total += rc;
+        if( rc != iov[i].len ) break;
+    }
+    return total;
+}
+
+whio_size_t whio_dev_readvat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    if( ! dev || ! iov || !count ) return 0;
+    else if( dev->api->readvat ) return dev->api->readvat( dev, pos, iov, count );
+    else if( dev->api->readat && !dev->api->readv ) return whio_dev_iov_at( dev, pos, iov, count, false );
+    else if( pos != dev->api->seek( dev, pos, SEEK_SET ) ) return whio_rc.SizeTError;
+    else return whio_dev_readv( dev, iov, count );
+}
+
+whio_size_t whio_dev_writevat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    if( ! dev || ! iov || !count ) return 0;
+    else if( dev->api->writevat ) return dev->api->writevat( dev, pos, iov, count );
+    else if( dev->api->writeat && !dev->api->writev ) return whio_dev_iov_at( dev, pos, iov, count, true );
+    else if( pos != dev->api->seek( dev, pos, SEEK_SET ) ) return whio_rc.SizeTError;
+    else return whio_dev_writev( dev, iov, count );
+}
 
 whio_size_t whio_dev_size( whio_dev * dev )
 {
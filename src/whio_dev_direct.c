@@ -0,0 +1,502 @@
+/*
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+  License: Public Domain
+*/
+/************************************************************************
+Implementations for a whio_dev type which does unbuffered ("direct")
+i/o on a file, bypassing the OS page cache where the platform allows
+it (O_DIRECT on Linux, F_NOCACHE on Mac OS X).
+
+Direct i/o requires that file offsets, transfer lengths and memory
+addresses all be multiples of the device's logical block size. This
+device hides that from the client: requests which are fully aligned
+go straight to pread()/pwrite(), and everything else goes through an
+aligned bounce buffer, with read-modify-write of partially-covered
+units on writes.
+************************************************************************/
+
+#if !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE /* O_DIRECT */
+#endif
+#if !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200809L /* pread(), pwrite(), posix_memalign() */
+#endif
+
+#include <stdlib.h>
+#include <string.h> /* memcpy(), memset() */
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <wh/whio/whio_devs.h>
+
+/**
+   Internal implementation details for the direct-i/o whio_dev.
+*/
+typedef struct whio_dev_direct_meta
+{
+    /** Underlying file descriptor. Owned by this object. */
+    int fileno;
+    /** File name passed to the factory function. Not owned. */
+    char const * filename;
+    /** Current cursor position. */
+    whio_size_t pos;
+    /** Logical size of the file. */
+    whio_size_t size;
+    /**
+       Physical size of the file. May be larger than size after a
+       write which had to be padded to a unit boundary. The padding
+       is trimmed off by flush(), truncate() and close(), not after
+       every write, because that would cost an ftruncate() per
+       (typically appending) write.
+    */
+    whio_size_t phys;
+    bool atEOF;
+    int errstate;
+    short iomode;
+    /** True if O_DIRECT (or equivalent) is in effect. */
+    bool direct;
+    /** Aligned bounce buffer, whio_dev_direct_buffer_size bytes. */
+    unsigned char * buf;
+} whio_dev_direct_meta;
+
+/**
+   Initialization object for whio_dev_direct_meta objects. Also used
+   as whio_dev::typeID for such objects.
+*/
+#define WHIO_DEV_DIRECT_META_INIT { \
+    -1, /* fileno */ \
+    0, /* filename */ \
+    0, /* pos */ \
+    0, /* size */ \
+    0, /* phys */ \
+    false, /* atEOF */ \
+    0, /* errstate */ \
+    -1, /* iomode */ \
+    false, /* direct */ \
+    0 /* buf */ \
+    }
+static const whio_dev_direct_meta whio_dev_direct_meta_empty = WHIO_DEV_DIRECT_META_INIT;
+
+/**
+   A helper for the whio_dev_direct API. Requires that the 'dev'
+   parameter be-a whio_dev and that that device is-a whio_dev_direct.
+ */
+#define WHIO_direct_DECL(RV) whio_dev_direct_meta * f = (dev ? (whio_dev_direct_meta*)dev->impl.data : 0); \
+    if( !f || (f->fileno < 0) || ((void const *)&whio_dev_direct_meta_empty != dev->impl.typeID) ) return RV
+
+/** Rounds x down to a multiple of whio_dev_direct_alignment. */
+#define WHIO_DIRECT_FLOOR(X) ((X) & ~((whio_size_t)whio_dev_direct_alignment - 1))
+/** Rounds x up to a multiple of whio_dev_direct_alignment. */
+#define WHIO_DIRECT_CEIL(X) WHIO_DIRECT_FLOOR((X) + whio_dev_direct_alignment - 1)
+/** True if pointer P is suitably aligned for direct i/o. */
+#define WHIO_DIRECT_PTR_ALIGNED(P) (0 == (((size_t)(P)) & (whio_dev_direct_alignment - 1)))
+
+/**
+   pread()s one aligned unit of n bytes at pos into dest, zero-filling
+   whatever lies past the physical EOF. Returns false on i/o error.
+*/
+static bool whio_dev_direct_read_unit( whio_dev_direct_meta * f, unsigned char * dest, whio_size_t pos, whio_size_t n )
+{
+    ssize_t rc = 0;
+    if( pos < f->phys )
+    {
+        rc = pread( f->fileno, dest, n, (off_t)pos );
+        if( rc < 0 )
+        {
+            f->errstate = errno;
+            return false;
+        }
+    }
+    if( (whio_size_t)rc < n ) memset( dest + rc, 0, n - rc );
+    return true;
+}
+
+static whio_size_t whio_dev_direct_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    whio_size_t done = 0;
+    WHIO_direct_DECL(0);
+    if( ! dest || !n || (pos >= f->size) ) return 0;
+    if( n > (f->size - pos) ) n = f->size - pos;
+    while( done < n )
+    {
+        const whio_size_t cur = pos + done;
+        const whio_size_t a0 = WHIO_DIRECT_FLOOR(cur);
+        const whio_size_t off = cur - a0;
+        const whio_size_t left = n - done;
+        unsigned char * out = (unsigned char *)dest + done;
+        ssize_t rc;
+        if( !off && (left >= whio_dev_direct_alignment) && WHIO_DIRECT_PTR_ALIGNED(out) )
+        { /* Fully aligned: no bounce buffer needed. */
+            rc = pread( f->fileno, out, WHIO_DIRECT_FLOOR(left), (off_t)cur );
+            if( rc <= 0 )
+            {
+                if( rc < 0 ) f->errstate = errno;
+                break;
+            }
+            done += (whio_size_t)rc;
+        }
+        else
+        {
+            whio_size_t span = WHIO_DIRECT_CEIL(off + left);
+            whio_size_t take;
+            if( span > whio_dev_direct_buffer_size ) span = whio_dev_direct_buffer_size;
+            rc = pread( f->fileno, f->buf, span, (off_t)a0 );
+            if( rc < 0 ) f->errstate = errno;
+            if( rc <= (ssize_t)off ) break;
+            take = (whio_size_t)rc - off;
+            if( take > left ) take = left;
+            memcpy( out, f->buf + off, take );
+            done += take;
+        }
+    }
+    return done;
+}
+
+/**
+   Truncates the file back to its logical size if padded writes left
+   it physically longer. Returns false on error.
+*/
+static bool whio_dev_direct_trim( whio_dev_direct_meta * f )
+{
+    if( f->phys <= f->size ) return true;
+    if( 0 != ftruncate( f->fileno, (off_t)f->size ) )
+    {
+        f->errstate = errno;
+        return false;
+    }
+    f->phys = f->size;
+    return true;
+}
+
+static whio_size_t whio_dev_direct_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    whio_size_t done = 0;
+    WHIO_direct_DECL(0);
+    if( ! src || !n || (f->iomode <= 0) ) return 0;
+    while( done < n )
+    {
+        const whio_size_t cur = pos + done;
+        const whio_size_t a0 = WHIO_DIRECT_FLOOR(cur);
+        const whio_size_t off = cur - a0;
+        const whio_size_t left = n - done;
+        unsigned char const * in = (unsigned char const *)src + done;
+        whio_size_t span, take;
+        ssize_t rc;
+        if( !off && (left >= whio_dev_direct_alignment) && WHIO_DIRECT_PTR_ALIGNED(in) )
+        { /* Fully aligned: no bounce buffer needed. */
+            span = take = WHIO_DIRECT_FLOOR(left);
+            rc = pwrite( f->fileno, in, span, (off_t)cur );
+        }
+        else
+        {
+            take = whio_dev_direct_buffer_size - off;
+            if( take > left ) take = left;
+            span = WHIO_DIRECT_CEIL(off + take);
+            /* Read-modify-write the partially-covered head and tail units. */
+            if( off && ! whio_dev_direct_read_unit( f, f->buf, a0, whio_dev_direct_alignment ) ) break;
+            if( ((off + take) % whio_dev_direct_alignment)
+                && ((span > whio_dev_direct_alignment) || !off) )
+            {
+                const whio_size_t t = span - whio_dev_direct_alignment;
+                if( ! whio_dev_direct_read_unit( f, f->buf + t, a0 + t, whio_dev_direct_alignment ) ) break;
+            }
+            memcpy( f->buf + off, in, take );
+            rc = pwrite( f->fileno, f->buf, span, (off_t)a0 );
+        }
+        if( rc < 0 )
+        {
+            f->errstate = errno;
+            break;
+        }
+        else if( (whio_size_t)rc != span ) break;
+        if( (a0 + span) > f->phys ) f->phys = a0 + span;
+        if( (cur + take) > f->size ) f->size = cur + take;
+        done += take;
+    }
+    return done;
+}
+
+static whio_size_t whio_dev_direct_read( whio_dev * dev, void * dest, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_direct_DECL(whio_rc.SizeTError);
+    rc = whio_dev_direct_readat( dev, f->pos, dest, n );
+    f->pos += rc;
+    if( rc < n ) f->atEOF = true;
+    return rc;
+}
+
+static whio_size_t whio_dev_direct_write( whio_dev * dev, void const * src, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_direct_DECL(0);
+    rc = whio_dev_direct_writeat( dev, f->pos, src, n );
+    f->pos += rc;
+    return rc;
+}
+
+static int whio_dev_direct_error( whio_dev * dev )
+{
+    WHIO_direct_DECL(whio_rc.ArgError);
+    return f->errstate;
+}
+
+static int whio_dev_direct_clear_error( whio_dev * dev )
+{
+    WHIO_direct_DECL(whio_rc.ArgError);
+    f->errstate = 0;
+    f->atEOF = false;
+    return whio_rc.OK;
+}
+
+static int whio_dev_direct_eof( whio_dev * dev )
+{
+    WHIO_direct_DECL(whio_rc.ArgError);
+    return f->atEOF ? 1 : 0;
+}
+
+static whio_size_t whio_dev_direct_tell( whio_dev * dev )
+{
+    WHIO_direct_DECL(whio_rc.SizeTError);
+    return f->pos;
+}
+
+static whio_size_t whio_dev_direct_seek( whio_dev * dev, whio_off_t pos, int whence )
+{
+    whio_off_t to;
+    WHIO_direct_DECL(whio_rc.SizeTError);
+    switch( whence )
+    {
+      case SEEK_SET: to = pos; break;
+      case SEEK_CUR: to = (whio_off_t)f->pos + pos; break;
+      case SEEK_END: to = (whio_off_t)f->size + pos; break;
+      default: return whio_rc.SizeTError;
+    }
+    if( to < 0 ) return whio_rc.SizeTError;
+    f->pos = (whio_size_t)to;
+    f->atEOF = false;
+    return f->pos;
+}
+
+static int whio_dev_direct_flush( whio_dev * dev )
+{
+    WHIO_direct_DECL(whio_rc.ArgError);
+    if( f->iomode <= 0 ) return whio_rc.OK;
+    if( ! whio_dev_direct_trim( f ) ) return whio_rc.IOError;
+    /* Direct writes bypass the page cache, but the file's metadata
+       (e.g. its size) still needs to reach the disk. */
+    return fsync( f->fileno );
+}
+
+static int whio_dev_direct_trunc( whio_dev * dev, whio_off_t len )
+{
+    int rc;
+    WHIO_direct_DECL(whio_rc.ArgError);
+    if( len < 0 ) return whio_rc.RangeError;
+    rc = ftruncate( f->fileno, len );
+    if( 0 == rc )
+    {
+        f->size = f->phys = (whio_size_t)len;
+        whio_dev_direct_flush( dev );
+    }
+    else
+    {
+        f->errstate = errno;
+    }
+    return rc;
+}
+
+static short whio_dev_direct_iomode( whio_dev * dev )
+{
+    WHIO_direct_DECL(-1);
+    return f->iomode;
+}
+
+static int whio_dev_direct_ioctl( whio_dev * dev, int arg, va_list vargs )
+{
+    int rc = whio_rc.UnsupportedError;
+    WHIO_direct_DECL(whio_rc.ArgError);
+    switch( arg )
+    {
+      case whio_dev_ioctl_FILE_fd:
+	  rc = whio_rc.OK;
+	  *(va_arg(vargs,int*)) = f->fileno;
+	  break;
+      case whio_dev_ioctl_GENERAL_name:
+	  do
+	  {
+	      char const ** cpp = (va_arg(vargs,char const **));
+	      if( cpp )
+	      {
+		  rc = whio_rc.OK;
+		  *cpp = f->filename;
+	      }
+	      else
+	      {
+		  rc = whio_rc.ArgError;
+	      }
+	  } while(0);
+	  break;
+      case whio_dev_ioctl_FCNTL_lock_nowait:
+      case whio_dev_ioctl_FCNTL_lock_wait:
+      case whio_dev_ioctl_FCNTL_lock_get:
+	  do
+	  {
+	      struct flock * fl = (va_arg(vargs,struct flock *));
+	      if( fl )
+	      {
+		  int lockCmd = (whio_dev_ioctl_FCNTL_lock_nowait == arg)
+		      ? F_SETLK
+		      : ((whio_dev_ioctl_FCNTL_lock_get == arg) ? F_GETLK :  F_SETLKW);
+		  rc = fcntl( f->fileno, lockCmd, fl );
+	      }
+	      else
+	      {
+		  rc = whio_rc.ArgError;
+	      }
+	  } while(0);
+	  break;
+      default: break;
+    };
+    return rc;
+}
+
+static bool whio_dev_direct_close( whio_dev * dev )
+{
+    if( dev )
+    {
+        whio_dev_direct_meta * f;
+	dev->api->flush(dev);
+	if( dev->client.dtor ) dev->client.dtor( dev->client.data );
+	dev->client = whio_client_data_empty;
+	f = (whio_dev_direct_meta*)dev->impl.data;
+	if( f )
+	{
+	    dev->impl.data = 0;
+	    if( f->fileno >= 0 ) close( f->fileno );
+	    free( f->buf );
+	    *f = whio_dev_direct_meta_empty;
+	    free( f );
+	    return true;
+	}
+    }
+    return false;
+}
+
+static void whio_dev_direct_finalize( whio_dev * dev )
+{
+    if( dev )
+    {
+	dev->api->close( dev );
+	whio_dev_free(dev);
+    }
+}
+#undef WHIO_direct_DECL
+
+static const whio_dev_api whio_dev_direct_api =
+    {
+    whio_dev_direct_read,
+    whio_dev_direct_write,
+    whio_dev_direct_close,
+    whio_dev_direct_finalize,
+    whio_dev_direct_error,
+    whio_dev_direct_clear_error,
+    whio_dev_direct_eof,
+    whio_dev_direct_tell,
+    whio_dev_direct_seek,
+    whio_dev_direct_flush,
+    whio_dev_direct_trunc,
+    whio_dev_direct_ioctl,
+    whio_dev_direct_iomode,
+    whio_dev_direct_readat,
+    whio_dev_direct_writeat
+    };
+
+static const whio_dev whio_dev_direct_empty =
+    {
+    &whio_dev_direct_api,
+    { /* impl */
+    0, /* data. Must be-a (whio_dev_direct_meta*) */
+    (void const *)&whio_dev_direct_meta_empty /* typeID */
+    }
+    };
+
+/**
+   Converts an fopen()-style mode string to open() flags. The file is
+   always opened read/write when writing is requested, because
+   unaligned writes need to read back the surrounding data.
+*/
+static int whio_dev_direct_mode_flags( char const * mode )
+{
+    int flags;
+    const bool plus = (0 != strchr( mode, '+' ));
+    switch( *mode )
+    {
+      case 'r': flags = plus ? O_RDWR : O_RDONLY; break;
+      case 'w': flags = O_RDWR | O_CREAT | O_TRUNC; break;
+      case 'a': flags = O_RDWR | O_CREAT; break;
+      default: return -1;
+    }
+    return flags;
+}
+
+bool whio_dev_is_direct( whio_dev * dev )
+{
+    whio_dev_direct_meta const * f = (dev && ((void const *)&whio_dev_direct_meta_empty == dev->impl.typeID))
+        ? (whio_dev_direct_meta const *)dev->impl.data
+        : 0;
+    return f ? f->direct : false;
+}
+
+whio_dev * whio_dev_for_filename_direct( char const * fname, char const * mode )
+{
+    whio_dev * dev;
+    whio_dev_direct_meta * meta;
+    struct stat st;
+    void * buf = 0;
+    int flags, fd = -1;
+    bool direct = false;
+    if( !fname || !*fname || !mode || !*mode ) return 0;
+    flags = whio_dev_direct_mode_flags( mode );
+    if( flags < 0 ) return 0;
+#if defined(O_DIRECT)
+    fd = open( fname, flags | O_DIRECT, 0666 );
+    direct = (fd >= 0);
+    /* Some filesystems (e.g. tmpfs) reject O_DIRECT with EINVAL. */
+#endif
+    if( fd < 0 ) fd = open( fname, flags, 0666 );
+    if( fd < 0 ) return 0;
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    direct = (0 == fcntl( fd, F_NOCACHE, 1 ));
+#endif
+    if( (0 != fstat( fd, &st ))
+        || (0 != posix_memalign( &buf, whio_dev_direct_alignment, whio_dev_direct_buffer_size )) )
+    {
+        close( fd );
+        return 0;
+    }
+    dev = whio_dev_alloc();
+    meta = dev ? (whio_dev_direct_meta *) malloc( sizeof(whio_dev_direct_meta) ) : 0;
+    if( ! meta )
+    {
+        if( dev ) whio_dev_free( dev );
+        free( buf );
+        close( fd );
+        return 0;
+    }
+    *dev = whio_dev_direct_empty;
+    *meta = whio_dev_direct_meta_empty;
+    dev->impl.data = meta;
+    meta->fileno = fd;
+    meta->filename = fname;
+    meta->iomode = whio_mode_to_iomode( mode );
+    meta->direct = direct;
+    meta->buf = (unsigned char *)buf;
+    meta->size = meta->phys = (whio_size_t)st.st_size;
+    if( 'a' == *mode ) meta->pos = meta->size;
+    return dev;
+}
@@ -18,16 +18,22 @@ to provide dramatic speed increases.
 
 #if !defined(_POSIX_C_SOURCE)
 /* required for for fileno(), ftello(), fdatasync(), maybe others */
-#  define _POSIX_C_SOURCE 200112L
+#  define _POSIX_C_SOURCE 200809L /* pread(), pwrite() */
+/*#  define _POSIX_C_SOURCE 200112L */
 /*#  define _POSIX_C_SOURCE 199309L */
 /*#  define _POSIX_C_SOURCE 199506L */
 #endif
+#if !defined(_DEFAULT_SOURCE)
+#  define _DEFAULT_SOURCE /* preadv(), pwritev() */
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h> /* ftruncate(), fdatasync() */
 #include <fcntl.h>
 #include <errno.h>
+#include <limits.h> /* IOV_MAX */
+#include <sys/uio.h> /* readv(), writev() */
 
 #if defined(__GNUC__) || defined(__TINYC__)
 #if !defined(GCC_VERSION) || (GCC_VERSION < 40100)
@@ -171,6 +177,132 @@ static whio_size_t whio_dev_fileno_write( whio_dev * dev, void const * src, whio
     }
 }
 
+static whio_size_t whio_dev_fileno_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    WHIO_fileno_DECL(0);
+    if( ! dest || !n ) return 0;
+    else {
+        ssize_t rc = pread( f->fileno, dest, n, (off_t)pos );
+        if( (ssize_t)-1 == rc )
+        {
+            f->errstate = errno;
+            rc = 0;
+        }
+        return (whio_size_t)rc;
+    }
+}
+
+static whio_size_t whio_dev_fileno_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    WHIO_fileno_DECL(0);
+    if( ! src || !n ) return 0;
+    else {
+        ssize_t rc = pwrite( f->fileno, src, n, (off_t)pos );
+        if( (ssize_t)-1 == rc )
+        {
+            f->errstate = errno;
+            rc = 0;
+        }
+        return (whio_size_t)rc;
+    }
+}
+
+/**
+   The maximum number of segments whio_dev_fileno_iov() passes to a
+   single readv() or writev() call. Larger requests are split.
+*/
+#if defined(IOV_MAX) && (IOV_MAX < 64)
+#  define WHIO_FILENO_IOV_MAX IOV_MAX
+#else
+#  define WHIO_FILENO_IOV_MAX 64
+#endif
+
+/**
+   If WHIO_FILENO_HAVE_PREADV is true, the readvat() and writevat()
+   members are implemented with preadv() and pwritev(), which are not
+   POSIX but are available on Linux and the BSDs. Otherwise they are 0
+   and whio_dev_readvat() falls back to seek() plus readv().
+*/
+#if !defined(WHIO_FILENO_HAVE_PREADV)
+#  if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#    define WHIO_FILENO_HAVE_PREADV 1
+#  else
+#    define WHIO_FILENO_HAVE_PREADV 0
+#  endif
+#endif
+
+/**
+   Implementation for whio_dev_fileno_readv(), whio_dev_fileno_writev()
+   and their positional counterparts. Translates iov into native
+   struct iovec objects, WHIO_FILENO_IOV_MAX at a time, and stops at
+   the first short read or write. If pos is not 0 then the i/o starts
+   at *pos, using preadv()/pwritev(), and the cursor is not used.
+*/
+static whio_size_t whio_dev_fileno_iov( whio_dev * dev, whio_size_t const * pos, whio_iovec const * iov, whio_size_t count, bool doWrite )
+{
+    struct iovec vec[WHIO_FILENO_IOV_MAX];
+    whio_size_t i = 0, total = 0;
+    WHIO_fileno_DECL(0);
+    if( ! iov ) return 0;
+    while( i < count )
+    {
+        int n = 0;
+        size_t want = 0;
+        ssize_t rc;
+        for( ; (i < count) && (n < WHIO_FILENO_IOV_MAX); ++i )
+        {
+            if( ! iov[i].len ) continue;
+            vec[n].iov_base = iov[i].base;
+            vec[n].iov_len = iov[i].len;
+            want += iov[i].len;
+            ++n;
+        }
+        if( ! n ) break;
+#if WHIO_FILENO_HAVE_PREADV
+        if( pos )
+        {
+            const off_t at = (off_t)(*pos + total);
+            rc = doWrite ? pwritev( f->fileno, vec, n, at ) : preadv( f->fileno, vec, n, at );
+        }
+        else
+#endif
+        rc = doWrite ? writev( f->fileno, vec, n ) : readv( f->fileno, vec, n );
+        if( (ssize_t)-1 == rc )
+        {
+            f->errstate = errno;
+            break;
+        }
+        total += (whio_size_t)rc;
+        if( (size_t)rc != want ) break;
+    }
+    return total;
+}
+
+static whio_size_t whio_dev_fileno_readv( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_fileno_iov( dev, 0, iov, count, false );
+}
+
+static whio_size_t whio_dev_fileno_writev( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_fileno_iov( dev, 0, iov, count, true );
+}
+
+#if WHIO_FILENO_HAVE_PREADV
+static whio_size_t whio_dev_fileno_readvat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_fileno_iov( dev, &pos, iov, count, false );
+}
+
+static whio_size_t whio_dev_fileno_writevat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_fileno_iov( dev, &pos, iov, count, true );
+}
+#else
+#  define whio_dev_fileno_readvat 0
+#  define whio_dev_fileno_writevat 0
+#endif
+
 static int whio_dev_fileno_error( whio_dev * dev )
 {
     WHIO_fileno_DECL(whio_rc.ArgError);
@@ -358,7 +490,13 @@ static const whio_dev_api whio_dev_fileno_api =
     whio_dev_fileno_flush,
     whio_dev_fileno_trunc,
     whio_dev_fileno_ioctl,
-    whio_dev_fileno_iomode
+    whio_dev_fileno_iomode,
+    whio_dev_fileno_readat,
+    whio_dev_fileno_writeat,
+    whio_dev_fileno_readv,
+    whio_dev_fileno_writev,
+    whio_dev_fileno_readvat,
+    whio_dev_fileno_writevat
     };
 
 static const whio_dev whio_dev_fileno_empty =
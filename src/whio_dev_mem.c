@@ -216,6 +216,34 @@ static whio_size_t whio_dev_membuf_write( whio_dev * dev, void const * src, whio
     return wlen;
 }
 
+static whio_size_t whio_dev_membuf_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    whio_size_t rlen;
+    WHIO_MEMBUF_DECL(0);
+    if( ! dest || (pos >= mb->size) ) return 0;
+    rlen = n;
+    if( ((pos + n) >= mb->size )
+	|| ((pos + n) < pos)
+	)
+    {
+	rlen = mb->size - pos;
+    }
+    if( rlen ) memcpy( dest, mb->buffer + pos, rlen );
+    return rlen;
+}
+
+static whio_size_t whio_dev_membuf_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    whio_size_t oldPos, rc;
+    WHIO_MEMBUF_DECL(0);
+    /* Re-use write()'s expansion logic, but leave the cursor alone. */
+    oldPos = mb->pos;
+    mb->pos = pos;
+    rc = whio_dev_membuf_write( dev, src, n );
+    mb->pos = oldPos;
+    return rc;
+}
+
 static int whio_dev_membuf_error( whio_dev * dev )
 {
     WHIO_MEMBUF_DECL(whio_rc.ArgError);
@@ -425,7 +453,9 @@ const whio_dev_api whio_dev_api_membuf =
     whio_dev_membuf_flush,
     whio_dev_membuf_trunc,
     whio_dev_membuf_ioctl,
-    whio_dev_membuf_iomode
+    whio_dev_membuf_iomode,
+    whio_dev_membuf_readat,
+    whio_dev_membuf_writeat
     };
 
 #define WHIO_DEV_MEMBUF_INIT { \
@@ -664,6 +694,38 @@ static whio_size_t whio_dev_memmap_write( whio_dev * dev, void const * src, whio
     }
 }
 
+static whio_size_t whio_dev_memmap_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    whio_size_t rlen;
+    WHIO_MEMMAP_DECL(0);
+    if( ! dest || !mb->ro || (pos >= mb->size) ) return 0;
+    rlen = n;
+    if( ((pos + n) >= mb->size )
+        || ((pos + n) < pos)
+        )
+    {
+        rlen = mb->size - pos;
+    }
+    if( rlen ) memcpy( dest, WHIO_VOID_CPTR_ADD(mb->ro,pos), rlen );
+    return rlen;
+}
+
+static whio_size_t whio_dev_memmap_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    whio_size_t wlen;
+    WHIO_MEMMAP_DECL(0);
+    if( ! n || !src || !mb->rw || (pos >= mb->size) ) return 0;
+    wlen = n;
+    if( ((pos + n) >= mb->size )
+        || ((pos + n) < pos)
+        )
+    {
+        wlen = mb->size - pos;
+    }
+    if( wlen ) memcpy( WHIO_VOID_PTR_ADD(mb->rw,pos), src, wlen );
+    return wlen;
+}
+
 static int whio_dev_memmap_error( whio_dev * dev )
 {
     WHIO_MEMMAP_DECL(whio_rc.ArgError);
@@ -832,7 +894,9 @@ const whio_dev_api whio_dev_api_memmap =
     whio_dev_memmap_flush,
     whio_dev_memmap_trunc,
     whio_dev_memmap_ioctl,
-    whio_dev_memmap_iomode
+    whio_dev_memmap_iomode,
+    whio_dev_memmap_readat,
+    whio_dev_memmap_writeat
     };
 
 static const whio_dev whio_dev_memmap_dev_empty =
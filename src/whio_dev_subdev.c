@@ -192,6 +192,42 @@ static whio_size_t whio_dev_subdev_write( whio_dev * dev, void const * src, whio
     }
 }
 
+/**
+   Clamps a positional request of n bytes at sub-device position pos
+   to the device bounds. Returns the parent-relative position in
+   *ppos and the clamped length, or 0 if pos is out of bounds.
+*/
+static whio_size_t whio_dev_subdev_clamp( whio_dev_subdev_meta const * sub, whio_size_t pos, whio_size_t n, whio_size_t * ppos )
+{
+    whio_size_t p = sub->lower + pos;
+    whio_size_t rend;
+    if( (p < sub->lower) || (p >= sub->upper) ) return 0;
+    rend = p + n;
+    if( (rend > sub->upper) || (rend < p) ) rend = sub->upper;
+    *ppos = p;
+    return rend - p;
+}
+
+static whio_size_t whio_dev_subdev_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    whio_size_t ppos = 0, rlen, rc;
+    WHIO_subdev_DECL(whio_rc.SizeTError);
+    rlen = whio_dev_subdev_clamp( sub, pos, n, &ppos );
+    if( ! rlen ) return 0;
+    rc = whio_dev_readat( sub->dev, ppos, dest, rlen );
+    return (whio_rc.SizeTError == rc) ? 0 : rc;
+}
+
+static whio_size_t whio_dev_subdev_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    whio_size_t ppos = 0, wlen, rc;
+    WHIO_subdev_DECL(0);
+    wlen = whio_dev_subdev_clamp( sub, pos, n, &ppos );
+    if( ! wlen ) return 0;
+    rc = whio_dev_writeat( sub->dev, ppos, src, wlen );
+    return (whio_rc.SizeTError == rc) ? 0 : rc;
+}
+
 static int whio_dev_subdev_error( whio_dev * dev )
 {
     WHIO_subdev_DECL(whio_rc.ArgError);
@@ -347,7 +383,9 @@ static const whio_dev_api whio_dev_api_subdev =
     whio_dev_subdev_flush,
     whio_dev_subdev_trunc,
     whio_dev_subdev_ioctl,
-    whio_dev_subdev_iomode
+    whio_dev_subdev_iomode,
+    whio_dev_subdev_readat,
+    whio_dev_subdev_writeat
     };
 
 static const whio_dev whio_dev_subdev_empty =
@@ -0,0 +1,864 @@
+/*
+  Author: Stephan Beal (http://wanderinghorse.net/home/stephan/)
+
+  License: Public Domain
+*/
+/************************************************************************
+Implementations for a whio_dev type which does its file i/o through a
+Linux io_uring instance.
+
+The synchronous whio_dev_api members each cost a single
+io_uring_enter() call (the same as pread()/pwrite()), and the
+vectored members submit a whole segment list at once. The real gain
+is the asynchronous API (whio_dev_uring_queue_read() and friends),
+which lets clients queue any number of requests, submit them in one
+system call and reap their completions in batches.
+
+This talks to the kernel directly, using only <linux/io_uring.h>, so
+it does not need liburing.
+************************************************************************/
+
+#if !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE /* syscall() */
+#endif
+
+#include <stdlib.h>
+#include <string.h> /* memset() */
+#include <errno.h>
+
+#include <wh/whio/whio_devs.h>
+
+#if WHIO_CONFIG_ENABLE_URING
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h> /* struct iovec */
+#include <linux/io_uring.h>
+
+/**
+   The maximum number of segments the readv()/writev() members pass
+   to a single READV/WRITEV operation. Larger requests are split.
+*/
+#define WHIO_URING_IOV_MAX 64
+
+/**
+   Internal implementation details for the io_uring whio_dev.
+*/
+typedef struct whio_dev_uring_meta
+{
+    /** Underlying file descriptor. Owned by this object. */
+    int fileno;
+    /** The io_uring's descriptor. Owned by this object. */
+    int ringfd;
+    /** File name passed to the factory function. Not owned. */
+    char const * filename;
+    /** Current cursor position. */
+    whio_size_t pos;
+    bool atEOF;
+    int errstate;
+    short iomode;
+    /** Submission queue, mapped from the kernel. */
+    struct {
+        void * ring;
+        size_t ringSize;
+        struct io_uring_sqe * sqes;
+        size_t sqesSize;
+        unsigned * head;
+        unsigned * tail;
+        unsigned * mask;
+        unsigned * array;
+        unsigned entries;
+    } sq;
+    /** Completion queue, mapped from the kernel. */
+    struct {
+        void * ring; /* may be the same mapping as sq.ring */
+        size_t ringSize;
+        struct io_uring_cqe * cqes;
+        unsigned * head;
+        unsigned * tail;
+        unsigned * mask;
+        unsigned entries;
+    } cq;
+    /** Number of SQEs filled in but not yet passed to the kernel. */
+    unsigned queued;
+    /** Number of requests queued or submitted whose CQE has not been reaped. */
+    unsigned inflight;
+    /**
+       Completions of asynchronous requests which were reaped while
+       waiting for a synchronous one, and not yet handed to the
+       client.
+    */
+    struct {
+        whio_dev_uring_completion * list;
+        whio_size_t count;
+        whio_size_t alloced;
+    } stash;
+    /** Result of the most recent synchronous request. */
+    int syncResult;
+} whio_dev_uring_meta;
+
+/**
+   Initialization object for whio_dev_uring_meta objects. Also used
+   as whio_dev::typeID for such objects.
+*/
+static const whio_dev_uring_meta whio_dev_uring_meta_empty = {
+    -1, /* fileno */
+    -1, /* ringfd */
+    0, /* filename */
+    0, /* pos */
+    false, /* atEOF */
+    0, /* errstate */
+    -1, /* iomode */
+    {0,0,0,0,0,0,0,0,0}, /* sq */
+    {0,0,0,0,0,0,0}, /* cq */
+    0, /* queued */
+    0, /* inflight */
+    {0,0,0}, /* stash */
+    0 /* syncResult */
+};
+
+/**
+   The user_data value of synchronous requests. Asynchronous requests
+   carry the client's tag instead.
+*/
+#define WHIO_URING_SYNC_TAG ((__u64)(uintptr_t)&whio_dev_uring_meta_empty)
+
+/**
+   A helper for the whio_dev_uring API. Requires that the 'dev'
+   parameter be-a whio_dev and that that device is-a whio_dev_uring.
+ */
+#define WHIO_uring_DECL(RV) whio_dev_uring_meta * f = (dev ? (whio_dev_uring_meta*)dev->impl.data : 0); \
+    if( !f || (f->ringfd < 0) || ((void const *)&whio_dev_uring_meta_empty != dev->impl.typeID) ) return RV
+
+static int whio_uring_enter( int ringfd, unsigned toSubmit, unsigned minComplete )
+{
+    return (int) syscall( __NR_io_uring_enter, ringfd, toSubmit, minComplete,
+                          minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0 );
+}
+
+/**
+   Passes all queued SQEs to the kernel and, if minComplete is not 0,
+   waits until at least that many completions are available. Returns
+   0 on success or an errno value.
+*/
+static int whio_dev_uring_enter( whio_dev_uring_meta * f, unsigned minComplete )
+{
+    int rc;
+    do
+    {
+        rc = whio_uring_enter( f->ringfd, f->queued, minComplete );
+        if( rc >= 0 )
+        {
+            f->queued -= ((unsigned)rc > f->queued) ? f->queued : (unsigned)rc;
+            /* the kernel may consume fewer SQEs than asked to */
+            if( !f->queued || !minComplete ) return 0;
+        }
+    } while( (rc >= 0) || (EINTR == errno) );
+    return f->errstate = errno;
+}
+
+/**
+   Ensures that f->stash has room for at least n completions. Returns
+   false on allocation error.
+*/
+static bool whio_dev_uring_stash_reserve( whio_dev_uring_meta * f, whio_size_t n )
+{
+    whio_dev_uring_completion * c;
+    whio_size_t x = f->stash.alloced ? f->stash.alloced : f->cq.entries;
+    if( n <= f->stash.alloced ) return true;
+    while( x < n ) x *= 2;
+    c = (whio_dev_uring_completion *) realloc( f->stash.list, x * sizeof(whio_dev_uring_completion) );
+    if( ! c ) return false;
+    f->stash.list = c;
+    f->stash.alloced = x;
+    return true;
+}
+
+/**
+   Appends a reaped asynchronous completion to f->stash. Room for it
+   was reserved when the request was queued (see
+   whio_dev_uring_prep()), so this cannot fail. The out-of-room case is
+   handled anyway, by dropping the completion and setting f->errstate
+   to ENOMEM, because the CQE must come off of the ring regardless.
+*/
+static void whio_dev_uring_stash( whio_dev_uring_meta * f, struct io_uring_cqe const * cqe )
+{
+    whio_dev_uring_completion * c;
+    if( (f->stash.count == f->stash.alloced)
+        && !whio_dev_uring_stash_reserve( f, f->stash.count + 1 ) )
+    {
+        f->errstate = ENOMEM;
+        return;
+    }
+    c = &f->stash.list[f->stash.count++];
+    c->tag = (void *)(uintptr_t)cqe->user_data;
+    c->bytes = (cqe->res > 0) ? (whio_size_t)cqe->res : 0;
+    c->err = (cqe->res < 0) ? -cqe->res : 0;
+}
+
+/**
+   Moves every available CQE off of the completion ring. Asynchronous
+   completions go to f->stash and a synchronous one sets
+   f->syncResult. Returns true if a synchronous completion was seen.
+
+   Every CQE is consumed, even if it cannot be stashed: callers loop
+   until a given completion (or all of them) has been reaped, and
+   would never finish if one was left on the ring.
+*/
+static bool whio_dev_uring_reap( whio_dev_uring_meta * f )
+{
+    bool gotSync = false;
+    unsigned head = *f->cq.head;
+    const unsigned tail = __atomic_load_n( f->cq.tail, __ATOMIC_ACQUIRE );
+    for( ; head != tail; ++head )
+    {
+        struct io_uring_cqe const * cqe = &f->cq.cqes[head & *f->cq.mask];
+        if( WHIO_URING_SYNC_TAG == cqe->user_data )
+        {
+            f->syncResult = cqe->res;
+            gotSync = true;
+        }
+        else
+        {
+            whio_dev_uring_stash( f, cqe );
+        }
+        --f->inflight;
+    }
+    __atomic_store_n( f->cq.head, head, __ATOMIC_RELEASE );
+    return gotSync;
+}
+
+/**
+   Returns the next free SQE, zeroed, or 0 if the ring is full even
+   after handing queued entries to the kernel. As a side effect this
+   may reap completions in order to keep the number of requests in
+   flight within the completion ring's capacity.
+*/
+static struct io_uring_sqe * whio_dev_uring_get_sqe( whio_dev_uring_meta * f )
+{
+    struct io_uring_sqe * sqe;
+    unsigned tail;
+    while( f->inflight >= f->cq.entries )
+    { /* don't let the CQ ring overflow */
+        if( 0 != whio_dev_uring_enter( f, 1 ) ) return 0;
+        whio_dev_uring_reap( f );
+    }
+    tail = *f->sq.tail;
+    if( (tail - __atomic_load_n( f->sq.head, __ATOMIC_ACQUIRE )) >= f->sq.entries )
+    {
+        if( 0 != whio_dev_uring_enter( f, 0 ) ) return 0;
+        if( (tail - __atomic_load_n( f->sq.head, __ATOMIC_ACQUIRE )) >= f->sq.entries ) return 0;
+    }
+    sqe = &f->sq.sqes[tail & *f->sq.mask];
+    memset( sqe, 0, sizeof(*sqe) );
+    f->sq.array[tail & *f->sq.mask] = tail & *f->sq.mask;
+    __atomic_store_n( f->sq.tail, tail + 1, __ATOMIC_RELEASE );
+    ++f->queued;
+    ++f->inflight;
+    return sqe;
+}
+
+/**
+   Queues one request. For an asynchronous request (any tag other than
+   WHIO_URING_SYNC_TAG) this first reserves a f->stash entry for its
+   completion, so that reaping it later cannot fail. Returns
+   whio_rc.OK, whio_rc.AllocError if that reservation fails, or
+   whio_rc.IOError if no SQE could be had.
+*/
+static int whio_dev_uring_prep( whio_dev_uring_meta * f, __u8 op, whio_size_t pos,
+                                void const * buf, __u32 len, __u64 tag )
+{
+    struct io_uring_sqe * sqe;
+    if( (WHIO_URING_SYNC_TAG != tag)
+        && !whio_dev_uring_stash_reserve( f, f->stash.count + f->inflight + 1 ) )
+    {
+        return whio_rc.AllocError;
+    }
+    sqe = whio_dev_uring_get_sqe( f );
+    if( ! sqe ) return whio_rc.IOError;
+    sqe->opcode = op;
+    sqe->fd = f->fileno;
+    sqe->off = pos;
+    sqe->addr = (__u64)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->user_data = tag;
+    return whio_rc.OK;
+}
+
+/**
+   Queues one synchronous request, submits everything queued and
+   waits for the request to complete. Completions of asynchronous
+   requests which arrive in the meantime are stashed. Returns the
+   operation's result (a byte count, or a negative errno value).
+*/
+static int whio_dev_uring_sync( whio_dev_uring_meta * f, __u8 op, whio_size_t pos,
+                                void const * buf, __u32 len )
+{
+    int rc = whio_dev_uring_prep( f, op, pos, buf, len, WHIO_URING_SYNC_TAG );
+    if( whio_rc.OK != rc ) return -EIO;
+    while( 1 )
+    {
+        rc = whio_dev_uring_enter( f, 1 );
+        if( 0 != rc ) return -rc;
+        if( whio_dev_uring_reap( f ) ) break;
+    }
+    if( f->syncResult < 0 ) f->errstate = -f->syncResult;
+    return f->syncResult;
+}
+
+static whio_size_t whio_dev_uring_readat( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n )
+{
+    int rc;
+    WHIO_uring_DECL(0);
+    if( ! dest || !n ) return 0;
+    rc = whio_dev_uring_sync( f, IORING_OP_READ, pos, dest, n );
+    return (rc > 0) ? (whio_size_t)rc : 0;
+}
+
+static whio_size_t whio_dev_uring_writeat( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n )
+{
+    int rc;
+    WHIO_uring_DECL(0);
+    if( ! src || !n ) return 0;
+    rc = whio_dev_uring_sync( f, IORING_OP_WRITE, pos, src, n );
+    return (rc > 0) ? (whio_size_t)rc : 0;
+}
+
+static whio_size_t whio_dev_uring_read( whio_dev * dev, void * dest, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_uring_DECL(whio_rc.SizeTError);
+    rc = whio_dev_uring_readat( dev, f->pos, dest, n );
+    f->pos += rc;
+    if( rc < n ) f->atEOF = true;
+    return rc;
+}
+
+static whio_size_t whio_dev_uring_write( whio_dev * dev, void const * src, whio_size_t n )
+{
+    whio_size_t rc;
+    WHIO_uring_DECL(0);
+    rc = whio_dev_uring_writeat( dev, f->pos, src, n );
+    f->pos += rc;
+    return rc;
+}
+
+/**
+   Implementation for the readv(), writev(), readvat() and writevat()
+   members: submits the segments as one READV/WRITEV operation per
+   WHIO_URING_IOV_MAX segments, starting at *pos, and advances *pos.
+*/
+static whio_size_t whio_dev_uring_iov( whio_dev * dev, whio_size_t * pos, whio_iovec const * iov, whio_size_t count, bool doWrite )
+{
+    struct iovec vec[WHIO_URING_IOV_MAX];
+    whio_size_t i = 0, total = 0;
+    WHIO_uring_DECL(0);
+    if( ! iov ) return 0;
+    while( i < count )
+    {
+        int n = 0, rc;
+        size_t want = 0;
+        for( ; (i < count) && (n < WHIO_URING_IOV_MAX); ++i )
+        {
+            if( ! iov[i].len ) continue;
+            vec[n].iov_base = iov[i].base;
+            vec[n].iov_len = iov[i].len;
+            want += iov[i].len;
+            ++n;
+        }
+        if( ! n ) break;
+        rc = whio_dev_uring_sync( f, doWrite ? IORING_OP_WRITEV : IORING_OP_READV,
+                                  *pos, vec, (__u32)n );
+        if( rc <= 0 ) break;
+        total += (whio_size_t)rc;
+        *pos += (whio_size_t)rc;
+        if( (size_t)rc != want ) break;
+    }
+    if( !doWrite && (i < count) && (pos == &f->pos) ) f->atEOF = true;
+    return total;
+}
+
+static whio_size_t whio_dev_uring_readv( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    WHIO_uring_DECL(0);
+    return whio_dev_uring_iov( dev, &f->pos, iov, count, false );
+}
+
+static whio_size_t whio_dev_uring_writev( whio_dev * dev, whio_iovec const * iov, whio_size_t count )
+{
+    WHIO_uring_DECL(0);
+    return whio_dev_uring_iov( dev, &f->pos, iov, count, true );
+}
+
+static whio_size_t whio_dev_uring_readvat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_uring_iov( dev, &pos, iov, count, false );
+}
+
+static whio_size_t whio_dev_uring_writevat( whio_dev * dev, whio_size_t pos, whio_iovec const * iov, whio_size_t count )
+{
+    return whio_dev_uring_iov( dev, &pos, iov, count, true );
+}
+
+static int whio_dev_uring_error( whio_dev * dev )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    return f->errstate;
+}
+
+static int whio_dev_uring_clear_error( whio_dev * dev )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    f->errstate = 0;
+    f->atEOF = false;
+    return whio_rc.OK;
+}
+
+static int whio_dev_uring_eof( whio_dev * dev )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    return f->atEOF ? 1 : 0;
+}
+
+static whio_size_t whio_dev_uring_tell( whio_dev * dev )
+{
+    WHIO_uring_DECL(whio_rc.SizeTError);
+    return f->pos;
+}
+
+static whio_size_t whio_dev_uring_seek( whio_dev * dev, whio_off_t pos, int whence )
+{
+    whio_off_t to;
+    struct stat st;
+    WHIO_uring_DECL(whio_rc.SizeTError);
+    switch( whence )
+    {
+      case SEEK_SET: to = pos; break;
+      case SEEK_CUR: to = (whio_off_t)f->pos + pos; break;
+      case SEEK_END:
+          if( 0 != fstat( f->fileno, &st ) ) return whio_rc.SizeTError;
+          to = (whio_off_t)st.st_size + pos;
+          break;
+      default: return whio_rc.SizeTError;
+    }
+    if( to < 0 ) return whio_rc.SizeTError;
+    f->pos = (whio_size_t)to;
+    f->atEOF = false;
+    return f->pos;
+}
+
+/**
+   Submits all queued requests and waits until every request in flight
+   has completed, stashing their completions. Returns whio_rc.OK or
+   whio_rc.IOError.
+*/
+static int whio_dev_uring_drain( whio_dev_uring_meta * f )
+{
+    while( f->inflight )
+    {
+        if( 0 != whio_dev_uring_enter( f, 1 ) ) return whio_rc.IOError;
+        whio_dev_uring_reap( f );
+    }
+    return whio_rc.OK;
+}
+
+static int whio_dev_uring_flush( whio_dev * dev )
+{
+    int rc;
+    WHIO_uring_DECL(whio_rc.ArgError);
+    /* io_uring does not order requests, so an fsync only covers
+       writes which have already completed. */
+    rc = whio_dev_uring_drain( f );
+    if( whio_rc.OK != rc ) return rc;
+    if( f->iomode <= 0 ) return whio_rc.OK;
+    return (0 == whio_dev_uring_sync( f, IORING_OP_FSYNC, 0, 0, 0 ))
+        ? whio_rc.OK
+        : whio_rc.IOError;
+}
+
+static int whio_dev_uring_trunc( whio_dev * dev, whio_off_t len )
+{
+    int rc;
+    WHIO_uring_DECL(whio_rc.ArgError);
+    rc = whio_dev_uring_drain( f );
+    if( whio_rc.OK != rc ) return rc;
+    rc = ftruncate( f->fileno, len );
+    if( 0 == rc )
+    {
+	whio_dev_uring_flush( dev );
+    }
+    else
+    {
+        f->errstate = errno;
+    }
+    return rc;
+}
+
+static short whio_dev_uring_iomode( whio_dev * dev )
+{
+    WHIO_uring_DECL(-1);
+    return f->iomode;
+}
+
+static int whio_dev_uring_ioctl( whio_dev * dev, int arg, va_list vargs )
+{
+    int rc = whio_rc.UnsupportedError;
+    WHIO_uring_DECL(whio_rc.ArgError);
+    switch( arg )
+    {
+      case whio_dev_ioctl_FILE_fd:
+	  rc = whio_rc.OK;
+	  *(va_arg(vargs,int*)) = f->fileno;
+	  break;
+      case whio_dev_ioctl_GENERAL_name:
+	  do
+	  {
+	      char const ** cpp = (va_arg(vargs,char const **));
+	      if( cpp )
+	      {
+		  rc = whio_rc.OK;
+		  *cpp = f->filename;
+	      }
+	      else
+	      {
+		  rc = whio_rc.ArgError;
+	      }
+	  } while(0);
+	  break;
+      case whio_dev_ioctl_FCNTL_lock_nowait:
+      case whio_dev_ioctl_FCNTL_lock_wait:
+      case whio_dev_ioctl_FCNTL_lock_get:
+	  do
+	  {
+	      struct flock * fl = (va_arg(vargs,struct flock *));
+	      if( fl )
+	      {
+		  int lockCmd = (whio_dev_ioctl_FCNTL_lock_nowait == arg)
+		      ? F_SETLK
+		      : ((whio_dev_ioctl_FCNTL_lock_get == arg) ? F_GETLK :  F_SETLKW);
+		  rc = fcntl( f->fileno, lockCmd, fl );
+	      }
+	      else
+	      {
+		  rc = whio_rc.ArgError;
+	      }
+	  } while(0);
+	  break;
+      default: break;
+    };
+    return rc;
+}
+
+/** Unmaps f's rings and closes its descriptors. */
+static void whio_dev_uring_cleanup( whio_dev_uring_meta * f )
+{
+    if( f->sq.sqes ) munmap( f->sq.sqes, f->sq.sqesSize );
+    if( f->cq.ring && (f->cq.ring != f->sq.ring) ) munmap( f->cq.ring, f->cq.ringSize );
+    if( f->sq.ring ) munmap( f->sq.ring, f->sq.ringSize );
+    if( f->ringfd >= 0 ) close( f->ringfd );
+    if( f->fileno >= 0 ) close( f->fileno );
+    free( f->stash.list );
+    *f = whio_dev_uring_meta_empty;
+}
+
+static bool whio_dev_uring_close( whio_dev * dev )
+{
+    if( dev )
+    {
+        whio_dev_uring_meta * f;
+	dev->api->flush(dev); /* also waits for requests in flight */
+	if( dev->client.dtor ) dev->client.dtor( dev->client.data );
+	dev->client = whio_client_data_empty;
+	f = (whio_dev_uring_meta*)dev->impl.data;
+	if( f )
+	{
+	    dev->impl.data = 0;
+            whio_dev_uring_drain( f );
+            whio_dev_uring_cleanup( f );
+	    free( f );
+	    return true;
+	}
+    }
+    return false;
+}
+
+static void whio_dev_uring_finalize( whio_dev * dev )
+{
+    if( dev )
+    {
+	dev->api->close( dev );
+	whio_dev_free(dev);
+    }
+}
+
+static const whio_dev_api whio_dev_uring_api =
+    {
+    whio_dev_uring_read,
+    whio_dev_uring_write,
+    whio_dev_uring_close,
+    whio_dev_uring_finalize,
+    whio_dev_uring_error,
+    whio_dev_uring_clear_error,
+    whio_dev_uring_eof,
+    whio_dev_uring_tell,
+    whio_dev_uring_seek,
+    whio_dev_uring_flush,
+    whio_dev_uring_trunc,
+    whio_dev_uring_ioctl,
+    whio_dev_uring_iomode,
+    whio_dev_uring_readat,
+    whio_dev_uring_writeat,
+    whio_dev_uring_readv,
+    whio_dev_uring_writev,
+    whio_dev_uring_readvat,
+    whio_dev_uring_writevat
+    };
+
+static const whio_dev whio_dev_uring_empty =
+    {
+    &whio_dev_uring_api,
+    { /* impl */
+    0, /* data. Must be-a (whio_dev_uring_meta*) */
+    (void const *)&whio_dev_uring_meta_empty /* typeID */
+    }
+    };
+
+/**
+   Sets up f's io_uring with the given queue depth. Returns
+   whio_rc.OK or an error code, in which case the caller must call
+   whio_dev_uring_cleanup().
+*/
+static int whio_dev_uring_setup( whio_dev_uring_meta * f, unsigned depth )
+{
+    struct io_uring_params p;
+    memset( &p, 0, sizeof(p) );
+    f->ringfd = (int) syscall( __NR_io_uring_setup, depth, &p );
+    if( f->ringfd < 0 ) return whio_rc.UnsupportedError;
+    f->sq.entries = p.sq_entries;
+    f->cq.entries = p.cq_entries;
+    f->sq.ringSize = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+    f->cq.ringSize = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+    if( p.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if( f->cq.ringSize > f->sq.ringSize ) f->sq.ringSize = f->cq.ringSize;
+        f->cq.ringSize = f->sq.ringSize;
+    }
+    f->sq.ring = mmap( 0, f->sq.ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       f->ringfd, IORING_OFF_SQ_RING );
+    if( MAP_FAILED == f->sq.ring )
+    {
+        f->sq.ring = 0;
+        return whio_rc.IOError;
+    }
+    if( p.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        f->cq.ring = f->sq.ring;
+    }
+    else
+    {
+        f->cq.ring = mmap( 0, f->cq.ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           f->ringfd, IORING_OFF_CQ_RING );
+        if( MAP_FAILED == f->cq.ring )
+        {
+            f->cq.ring = 0;
+            return whio_rc.IOError;
+        }
+    }
+    f->sq.sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    f->sq.sqes = (struct io_uring_sqe *) mmap( 0, f->sq.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                               f->ringfd, IORING_OFF_SQES );
+    if( MAP_FAILED == (void *)f->sq.sqes )
+    {
+        f->sq.sqes = 0;
+        return whio_rc.IOError;
+    }
+#define SQ(M) (unsigned *)((unsigned char *)f->sq.ring + p.sq_off.M)
+#define CQ(M) (unsigned *)((unsigned char *)f->cq.ring + p.cq_off.M)
+    f->sq.head = SQ(head);
+    f->sq.tail = SQ(tail);
+    f->sq.mask = SQ(ring_mask);
+    f->sq.array = SQ(array);
+    f->cq.head = CQ(head);
+    f->cq.tail = CQ(tail);
+    f->cq.mask = CQ(ring_mask);
+    f->cq.cqes = (struct io_uring_cqe *)((unsigned char *)f->cq.ring + p.cq_off.cqes);
+#undef SQ
+#undef CQ
+    return whio_rc.OK;
+}
+
+bool whio_dev_uring_is_available()
+{
+    struct io_uring_params p;
+    int fd;
+    memset( &p, 0, sizeof(p) );
+    fd = (int) syscall( __NR_io_uring_setup, 1, &p );
+    if( fd < 0 ) return false;
+    close( fd );
+    return true;
+}
+
+bool whio_dev_is_uring( whio_dev * dev )
+{
+    WHIO_uring_DECL(false);
+    return true;
+}
+
+whio_dev * whio_dev_for_filename_uring( char const * fname, char const * mode, unsigned int depth )
+{
+    whio_dev * dev;
+    whio_dev_uring_meta * meta;
+    int flags;
+    const bool plus = (mode && strchr( mode, '+' ));
+    if( !fname || !*fname || !mode || !*mode ) return 0;
+    switch( *mode )
+    {
+      case 'r': flags = plus ? O_RDWR : O_RDONLY; break;
+      case 'w': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+      case 'a': flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT; break;
+      default: return 0;
+    }
+    meta = (whio_dev_uring_meta *) malloc( sizeof(whio_dev_uring_meta) );
+    if( ! meta ) return 0;
+    *meta = whio_dev_uring_meta_empty;
+    if( whio_rc.OK != whio_dev_uring_setup( meta, depth ? depth : whio_dev_uring_default_depth ) )
+    {
+        whio_dev_uring_cleanup( meta );
+        free( meta );
+        return 0;
+    }
+    meta->fileno = open( fname, flags, 0666 );
+    dev = (meta->fileno >= 0) ? whio_dev_alloc() : 0;
+    if( ! dev )
+    {
+        whio_dev_uring_cleanup( meta );
+        free( meta );
+        return 0;
+    }
+    *dev = whio_dev_uring_empty;
+    dev->impl.data = meta;
+    meta->filename = fname;
+    meta->iomode = whio_mode_to_iomode( mode );
+    if( 'a' == *mode ) whio_dev_uring_seek( dev, 0, SEEK_END );
+    return dev;
+}
+
+int whio_dev_uring_queue_read( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n, void * tag )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    if( ! dest || !n ) return whio_rc.ArgError;
+    return whio_dev_uring_prep( f, IORING_OP_READ, pos, dest, n, (__u64)(uintptr_t)tag );
+}
+
+int whio_dev_uring_queue_write( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n, void * tag )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    if( ! src || !n ) return whio_rc.ArgError;
+    if( f->iomode <= 0 ) return whio_rc.AccessError;
+    return whio_dev_uring_prep( f, IORING_OP_WRITE, pos, src, n, (__u64)(uintptr_t)tag );
+}
+
+int whio_dev_uring_submit( whio_dev * dev )
+{
+    WHIO_uring_DECL(whio_rc.ArgError);
+    return (0 == whio_dev_uring_enter( f, 0 )) ? whio_rc.OK : whio_rc.IOError;
+}
+
+/**
+   Moves up to max stashed completions to dest, oldest first, and
+   returns how many were moved.
+*/
+static whio_size_t whio_dev_uring_unstash( whio_dev_uring_meta * f, whio_dev_uring_completion * dest, whio_size_t max )
+{
+    whio_size_t n = (f->stash.count < max) ? f->stash.count : max;
+    if( ! n ) return 0;
+    memcpy( dest, f->stash.list, n * sizeof(whio_dev_uring_completion) );
+    f->stash.count -= n;
+    if( f->stash.count )
+    {
+        memmove( f->stash.list, f->stash.list + n, f->stash.count * sizeof(whio_dev_uring_completion) );
+    }
+    return n;
+}
+
+whio_size_t whio_dev_uring_poll( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max )
+{
+    WHIO_uring_DECL(0);
+    if( ! dest || !max ) return 0;
+    if( f->queued ) whio_dev_uring_enter( f, 0 );
+    whio_dev_uring_reap( f );
+    return whio_dev_uring_unstash( f, dest, max );
+}
+
+whio_size_t whio_dev_uring_wait( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max, whio_size_t min )
+{
+    WHIO_uring_DECL(0);
+    if( ! dest || !max ) return 0;
+    if( min > max ) min = max;
+    whio_dev_uring_reap( f );
+    while( (f->stash.count < min) && f->inflight )
+    {
+        if( 0 != whio_dev_uring_enter( f, 1 ) ) break;
+        whio_dev_uring_reap( f );
+    }
+    return whio_dev_uring_unstash( f, dest, max );
+}
+
+whio_size_t whio_dev_uring_pending( whio_dev * dev )
+{
+    WHIO_uring_DECL(0);
+    return f->inflight + f->stash.count;
+}
+
+#undef WHIO_uring_DECL
+
+#else /* !WHIO_CONFIG_ENABLE_URING */
+
+bool whio_dev_uring_is_available()
+{
+    return false;
+}
+
+bool whio_dev_is_uring( whio_dev * dev )
+{
+    return false;
+}
+
+whio_dev * whio_dev_for_filename_uring( char const * fname, char const * mode, unsigned int depth )
+{
+    return 0;
+}
+
+int whio_dev_uring_queue_read( whio_dev * dev, whio_size_t pos, void * dest, whio_size_t n, void * tag )
+{
+    return whio_rc.UnsupportedError;
+}
+
+int whio_dev_uring_queue_write( whio_dev * dev, whio_size_t pos, void const * src, whio_size_t n, void * tag )
+{
+    return whio_rc.UnsupportedError;
+}
+
+int whio_dev_uring_submit( whio_dev * dev )
+{
+    return whio_rc.UnsupportedError;
+}
+
+whio_size_t whio_dev_uring_poll( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max )
+{
+    return 0;
+}
+
+whio_size_t whio_dev_uring_wait( whio_dev * dev, whio_dev_uring_completion * dest, whio_size_t max, whio_size_t min )
+{
+    return 0;
+}
+
+whio_size_t whio_dev_uring_pending( whio_dev * dev )
+{
+    return 0;
+}
+
+#endif /* WHIO_CONFIG_ENABLE_URING */
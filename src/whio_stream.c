@@ -108,6 +108,36 @@ whio_size_t whio_stream_writefv( whio_stream * str, const char *fmt, va_list ap
     return (rc < 0) ? 0 : (whio_size_t)rc;
 }
 
+whio_size_t whio_stream_readv( whio_stream * str, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t i, rc, total = 0;
+    if( ! str || ! iov || !count ) return 0;
+    else if( str->api->readv ) return str->api->readv( str, iov, count );
+    for( i = 0; i < count; ++i )
+    {
+        if( ! iov[i].len ) continue;
+        rc = str->api->read( str, iov[i].base, iov[i].len );
+        total += rc;
+        if( rc != iov[i].len ) break;
+    }
+    return total;
+}
+
+whio_size_t whio_stream_writev( whio_stream * str, whio_iovec const * iov, whio_size_t count )
+{
+    whio_size_t i, rc, total = 0;
+    if( ! str || ! iov || !count ) return 0;
+    else if( str->api->writev ) return str->api->writev( str, iov, count );
+    for( i = 0; i < count; ++i )
+    {
+        if( ! iov[i].len ) continue;
+        rc = str->api->write( str, iov[i].base, iov[i].len );
+        total += rc;
+        if( rc != iov[i].len ) break;
+    }
+    return total;
+}
+
 whio_size_t whio_stream_writef( whio_stream * str, const char *fmt, ... )
 {
     va_list vargs;
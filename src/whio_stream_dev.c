@@ -18,6 +18,8 @@ static int whio_stream_dev_flush( whio_stream * ARG_UNUSED(self) );
 static bool whio_stream_dev_close( whio_stream * self );
 static void whio_stream_dev_finalize( whio_stream * self );
 static short whio_stream_dev_iomode( whio_stream * self );
+static whio_size_t whio_stream_dev_readv( whio_stream * self, whio_iovec const * iov, whio_size_t count );
+static whio_size_t whio_stream_dev_writev( whio_stream * self, whio_iovec const * iov, whio_size_t count );
 /** whio_dev::impl::typeID value for whio_stream_dev objects. */
 
 const whio_stream_api whio_stream_api_dev = 
@@ -28,7 +30,9 @@ const whio_stream_api whio_stream_api_dev =
     whio_stream_dev_finalize,
     whio_stream_dev_flush,
     whio_stream_dev_isgood,
-    whio_stream_dev_iomode
+    whio_stream_dev_iomode,
+    whio_stream_dev_readv,
+    whio_stream_dev_writev
     };
 
 const whio_stream whio_stream_dev =
@@ -77,6 +81,18 @@ whio_size_t whio_stream_dev_write( whio_stream * self, void const * src, whio_si
     return meta->dev ? meta->dev->api->write(meta->dev, src, len) : 0;
 }
 
+whio_size_t whio_stream_dev_readv( whio_stream * self, whio_iovec const * iov, whio_size_t count )
+{
+    WHIO_STR_DEV_DECL(0);
+    return meta->dev ? whio_dev_readv(meta->dev, iov, count) : 0;
+}
+
+whio_size_t whio_stream_dev_writev( whio_stream * self, whio_iovec const * iov, whio_size_t count )
+{
+    WHIO_STR_DEV_DECL(0);
+    return meta->dev ? whio_dev_writev(meta->dev, iov, count) : 0;
+}
+
 int whio_stream_dev_flush( whio_stream * ARG_UNUSED(self) )
 {
     WHIO_STR_DEV_DECL(whio_rc.ArgError);